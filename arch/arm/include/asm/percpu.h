@@ -3,4 +3,58 @@
 
 #include <asm-generic/percpu.h>
 
+#ifdef CONFIG_CMPXCHG_LOCAL
+#include <linux/types.h>
+
+/*
+ * Compare and replace two adjacent words with a single ldrexd/strexd
+ * pair. An interrupt taken in between clears the exclusive monitor and
+ * makes the strexd fail, so the only thing the caller has to keep out is
+ * migration to another cpu. The words must be doubleword aligned.
+ */
+static inline int __arm_cmpxchg_double_local(unsigned long *ptr,
+					     u64 old, u64 new)
+{
+	u64 oldval;
+	unsigned long res;
+
+	do {
+		__asm__ __volatile__("@ cmpxchg_double_local\n"
+		"ldrexd		%1, %H1, [%2]\n"
+		"mov		%0, #0\n"
+		"teq		%1, %3\n"
+		"teqeq		%H1, %H3\n"
+		"strexdeq	%0, %4, %H4, [%2]"
+		: "=&r" (res), "=&r" (oldval)
+		: "r" (ptr), "r" (old), "r" (new)
+		: "cc", "memory");
+	} while (res);
+
+	return oldval == old;
+}
+
+/* ldrexd loads the word at the lower address into the first register */
+#ifdef __ARMEB__
+#define __arm_word_pair(first, second)					\
+	(((u64)(unsigned long)(first) << 32) | (unsigned long)(second))
+#else
+#define __arm_word_pair(first, second)					\
+	(((u64)(unsigned long)(second) << 32) | (unsigned long)(first))
+#endif
+
+#define irqsafe_cpu_cmpxchg_double(pcp1, pcp2, oval1, oval2, nval1, nval2) \
+({									\
+	int __ret;							\
+	BUILD_BUG_ON(sizeof(pcp1) != sizeof(long) ||			\
+		     sizeof(pcp2) != sizeof(long));			\
+	preempt_disable();						\
+	__ret = __arm_cmpxchg_double_local(				\
+			(unsigned long *)__this_cpu_ptr(&(pcp1)),	\
+			__arm_word_pair((oval1), (oval2)),		\
+			__arm_word_pair((nval1), (nval2)));		\
+	preempt_enable();						\
+	__ret;								\
+})
+#endif
+
 #endif
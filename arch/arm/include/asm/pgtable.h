@@ -260,7 +260,6 @@ extern struct page *empty_zero_page;
 #define pfn_pte(pfn,prot)	(__pte(((pfn) << PAGE_SHIFT) | pgprot_val(prot)))
 
 #define pte_none(pte)		(!pte_val(pte))
-#define pte_clear(mm,addr,ptep)	set_pte_ext(ptep, __pte(0), 0)
 #define pte_page(pte)		(pfn_to_page(pte_pfn(pte)))
 #define pte_offset_kernel(dir,addr)	(pmd_page_vaddr(*(dir)) + __pte_index(addr))
 
@@ -279,6 +278,46 @@ extern struct page *empty_zero_page;
 
 #define set_pte_ext(ptep,pte,ext) cpu_set_pte_ext(ptep,pte,ext)
 
+#ifdef CONFIG_LARGE_ANON_PAGES
+/*
+ * Blocks of anonymous memory may be mapped with 64K large pages, see
+ * arch/arm/mm/largepage.c.  The Linux ptes of such a block are ordinary
+ * small page ptes; only the hardware entries hold the large page
+ * descriptor, so the block must be split back into small pages before
+ * any of its ptes changes.
+ */
+#define LARGE_ANON_ORDER	4
+#define LARGE_ANON_NR		(1 << LARGE_ANON_ORDER)
+#define LARGE_ANON_SIZE		(PAGE_SIZE << LARGE_ANON_ORDER)
+#define LARGE_ANON_MASK		(~(LARGE_ANON_SIZE-1))
+
+#define pte_large_anon(ptep)	\
+	((pte_val((ptep)[-PTRS_PER_PTE]) & PTE_TYPE_MASK) == PTE_TYPE_LARGE)
+
+extern void __split_large_anon(struct mm_struct *mm, unsigned long addr,
+			       pte_t *ptep);
+extern int arch_promote_large_anon(struct mm_struct *mm, unsigned long addr,
+				   pte_t *ptep);
+
+static inline void split_large_anon(struct mm_struct *mm, unsigned long addr,
+				    pte_t *ptep)
+{
+	if (addr < TASK_SIZE && unlikely(pte_large_anon(ptep)))
+		__split_large_anon(mm, addr, ptep);
+}
+#else
+static inline void split_large_anon(struct mm_struct *mm, unsigned long addr,
+				    pte_t *ptep)
+{
+}
+#endif
+
+#define pte_clear(mm,addr,ptep)					\
+	do {							\
+		split_large_anon(mm, addr, ptep);		\
+		set_pte_ext(ptep, __pte(0), 0);			\
+	} while (0)
+
 #ifndef CONFIG_SMP
 static inline void __sync_icache_dcache(pte_t pteval)
 {
@@ -293,6 +332,7 @@ static inline void set_pte_at(struct mm_struct *mm, unsigned long addr,
 	if (addr >= TASK_SIZE)
 		set_pte_ext(ptep, pteval, 0);
 	else {
+		split_large_anon(mm, addr, ptep);
 		__sync_icache_dcache(pteval);
 		set_pte_ext(ptep, pteval, PTE_EXT_NG);
 	}
@@ -21,6 +21,66 @@ static inline void dsb_sev(void)
 #endif
 }
 
+#ifdef CONFIG_ARM_QUEUED_SPINLOCKS
+/*
+ * Queued spin-locking.
+ *
+ * The uncontended case is the same as below: one exclusive store of 1
+ * into an unlocked (zero) lock.  Under contention the cpus queue up in
+ * arrival order on per-cpu nodes, each spinning on its own node until
+ * its predecessor hands over, so only the head of the queue watches
+ * the lock word itself.  See arch/arm/kernel/qspinlock.c.
+ */
+
+/* only the lock byte, a queue may be left behind while nobody holds it */
+#define arch_spin_is_locked(x)		((x)->locked != 0)
+#define arch_spin_is_contended(x)	((x)->tail != 0)
+#define arch_spin_unlock_wait(lock) \
+	do { while (arch_spin_is_locked(lock)) cpu_relax(); } while (0)
+
+#define arch_spin_lock_flags(lock, flags) arch_spin_lock(lock)
+
+extern void queued_spin_lock_slowpath(arch_spinlock_t *lock);
+
+static inline int arch_spin_trylock(arch_spinlock_t *lock)
+{
+	unsigned long tmp;
+
+	__asm__ __volatile__(
+"	ldrex	%0, [%1]\n"
+"	teq	%0, #0\n"
+"	strexeq	%0, %2, [%1]"
+	: "=&r" (tmp)
+	: "r" (&lock->lock), "r" (1)
+	: "cc");
+
+	if (tmp == 0) {
+		smp_mb();
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+static inline void arch_spin_lock(arch_spinlock_t *lock)
+{
+	if (!arch_spin_trylock(lock))
+		queued_spin_lock_slowpath(lock);
+}
+
+/*
+ * Only clear the lock byte: the tail may be changing under us.  A byte
+ * store clears the exclusive monitor of anybody queueing up meanwhile,
+ * so their strex fails and they retry.
+ */
+static inline void arch_spin_unlock(arch_spinlock_t *lock)
+{
+	smp_mb();
+	lock->locked = 0;
+}
+
+#else /* !CONFIG_ARM_QUEUED_SPINLOCKS */
+
 /*
  * ARMv6 Spin-locking.
  *
@@ -92,6 +152,8 @@ static inline void arch_spin_unlock(arch_spinlock_t *lock)
 	dsb_sev();
 }
 
+#endif /* CONFIG_ARM_QUEUED_SPINLOCKS */
+
 /*
  * RWLOCKS
  *
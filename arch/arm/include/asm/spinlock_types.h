@@ -5,11 +5,36 @@
 # error "please don't include this file directly"
 #endif
 
+#ifdef CONFIG_ARM_QUEUED_SPINLOCKS
+/*
+ * The low byte is the lock itself, the high halfword names the last cpu
+ * queued up for it, see arch/arm/kernel/qspinlock.c.
+ */
+typedef struct {
+	union {
+		volatile unsigned int lock;
+		struct {
+#ifdef __ARMEB__
+			volatile unsigned short tail;
+			unsigned char __pad;
+			volatile unsigned char locked;
+#else
+			volatile unsigned char locked;
+			unsigned char __pad;
+			volatile unsigned short tail;
+#endif
+		};
+	};
+} arch_spinlock_t;
+
+#define __ARCH_SPIN_LOCK_UNLOCKED	{ { 0 } }
+#else
 typedef struct {
 	volatile unsigned int lock;
 } arch_spinlock_t;
 
 #define __ARCH_SPIN_LOCK_UNLOCKED	{ 0 }
+#endif
 
 typedef struct {
 	volatile unsigned int lock;
@@ -543,6 +543,9 @@ static inline void clean_pmd_entry(pmd_t *pmd)
 #define local_flush_tlb_range(vma,start,end)	__cpu_flush_user_tlb_range(start,end,vma)
 #define local_flush_tlb_kernel_range(s,e)	__cpu_flush_kern_tlb_range(s,e)
 
+/* This cpu's entries for all mms, for batched unmap TLB flushes */
+#define local_flush_tlb()			local_flush_tlb_all()
+
 #ifndef CONFIG_SMP
 #define flush_tlb_all		local_flush_tlb_all
 #define flush_tlb_mm		local_flush_tlb_mm
@@ -557,6 +560,15 @@ extern void flush_tlb_page(struct vm_area_struct *vma, unsigned long uaddr);
 extern void flush_tlb_kernel_page(unsigned long kaddr);
 extern void flush_tlb_range(struct vm_area_struct *vma, unsigned long start, unsigned long end);
 extern void flush_tlb_kernel_range(unsigned long start, unsigned long end);
+
+#include <asm/smp_plat.h>
+
+/*
+ * Batching reclaim's TLB flushes only pays when flushing the other cpus
+ * takes IPIs.  The TLB operations of ARMv7 MP cores are broadcast in
+ * hardware, a single page flush is cheaper than the batched full flush.
+ */
+#define arch_tlbbatch_should_defer(mm)	tlb_ops_need_broadcast()
 #endif
 
 /*
@@ -0,0 +1,134 @@
+/*
+ *  linux/arch/arm/kernel/qspinlock.c
+ *
+ *  Queued spinlock slowpath
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Contended lockers queue up MCS style: each one spins on its own
+ * per-cpu node until the cpu queued before it passes on the head of
+ * the queue, and only the head spins on the lock word.  The lock stays
+ * one word, with the lock byte at the bottom and the last queued cpu
+ * in the tail halfword, so that the queue nodes don't have to be
+ * passed in by the callers:
+ *
+ *   locked:   set while somebody holds the lock
+ *   tail:     (cpu + 1) * QNODES + node index of the last queued cpu,
+ *             0 if the queue is empty
+ *
+ * Nobody but the head of the queue sets the lock byte while the tail
+ * is non-zero, since the fastpath only locks a zero word.  That makes
+ * the lock fair: once somebody has queued up, the lock goes to the
+ * cpus in the order they came.
+ */
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/smp.h>
+#include <linux/spinlock.h>
+
+#include <asm/system.h>
+
+/*
+ * A cpu spins on at most one lock per context: task, softirq, hardirq
+ * and FIQ.
+ */
+#define QNODES		4
+
+#define Q_LOCKED	1U
+#define Q_TAIL_SHIFT	16
+#define Q_TAIL_MASK	(~0U << Q_TAIL_SHIFT)
+
+struct qnode {
+	struct qnode	*next;
+	int		locked;
+	int		count;		/* nodes in use, in qnodes[0] only */
+};
+
+static DEFINE_PER_CPU_ALIGNED(struct qnode, qnodes[QNODES]);
+
+static inline unsigned int encode_tail(int cpu, int idx)
+{
+	return ((cpu + 1) * QNODES + idx) << Q_TAIL_SHIFT;
+}
+
+static inline struct qnode *decode_tail(unsigned int val)
+{
+	unsigned int tail = val >> Q_TAIL_SHIFT;
+
+	return &per_cpu(qnodes, tail / QNODES - 1)[tail % QNODES];
+}
+
+void queued_spin_lock_slowpath(arch_spinlock_t *lock)
+{
+	struct qnode *node, *next;
+	unsigned int tail, val, old;
+	int idx;
+
+	node = __get_cpu_var(qnodes);
+	idx = node->count++;
+	if (unlikely(idx >= QNODES)) {
+		/* cannot happen, but don't deadlock if it does */
+		while (!arch_spin_trylock(lock))
+			cpu_relax();
+		goto release;
+	}
+
+	tail = encode_tail(smp_processor_id(), idx);
+	node += idx;
+	node->locked = 0;
+	node->next = NULL;
+
+	/* the lock may have been released while we set up the node */
+	if (arch_spin_trylock(lock))
+		goto release;
+
+	/*
+	 * Queue up.  This orders the node setup before our predecessor
+	 * can find the node, and keeps the lock byte as it is.
+	 */
+	val = lock->lock;
+	for (;;) {
+		old = cmpxchg(&lock->lock, val, (val & ~Q_TAIL_MASK) | tail);
+		if (old == val)
+			break;
+		val = old;
+	}
+
+	if (val & Q_TAIL_MASK) {
+		ACCESS_ONCE(decode_tail(val)->next) = node;
+		while (!ACCESS_ONCE(node->locked))
+			cpu_relax();
+	}
+
+	/* head of the queue: wait for the owner to release the lock */
+	while ((val = ACCESS_ONCE(lock->lock)) & Q_LOCKED)
+		cpu_relax();
+
+	/*
+	 * If we are the last one queued, take the lock and empty the queue
+	 * in one go.  Otherwise setting the lock byte is enough; the byte
+	 * store fails any concurrent tail update, which will then retry.
+	 */
+	for (;;) {
+		if ((val & Q_TAIL_MASK) != tail) {
+			lock->locked = Q_LOCKED;
+			break;
+		}
+		old = cmpxchg(&lock->lock, val, Q_LOCKED);
+		if (old == val)
+			goto release;
+		val = old;
+	}
+
+	/* make the next cpu in the queue its head */
+	while (!(next = ACCESS_ONCE(node->next)))
+		cpu_relax();
+	ACCESS_ONCE(next->locked) = 1;
+
+release:
+	smp_mb();
+	__get_cpu_var(qnodes)[0].count--;
+}
+EXPORT_SYMBOL(queued_spin_lock_slowpath);
@@ -396,6 +396,142 @@ out:
 }
 EXPORT_SYMBOL(clk_set_rate);
 
+/* leaves a lockdep subclass for the lock of each clock and of its bus */
+#define TEGRA_CLK_MAX_RATES	4
+
+static DEFINE_MUTEX(clk_set_rates_lock);
+
+/*
+ * Updates the dvfs requirements of the clocks of a batch in one go.  The
+ * requirement of a shared bus user is that of its bus, which follows the
+ * highest rate of its users.  When raising, each clock is covered up to
+ * the higher of its current and its requested rate; otherwise it is set
+ * to the rate it runs at.  Called with the locks of the clocks held.
+ */
+static int clk_set_rates_dvfs(struct tegra_dvfs_rate_req *reqs, int n,
+			      bool raise)
+{
+	struct tegra_dvfs_rate_req dvfs_reqs[TEGRA_CLK_MAX_RATES];
+	struct clk *buses[TEGRA_CLK_MAX_RATES];
+	struct clk *d;
+	int nr_dvfs = 0;
+	int nr_buses = 0;
+	int ret;
+	int i, j;
+
+	for (i = 0; i < n; i++) {
+		d = reqs[i].c;
+		if (!clk_is_auto_dvfs(d)) {
+			d = d->parent;
+			if (!d || !clk_is_auto_dvfs(d))
+				continue;
+			for (j = 0; j < nr_buses; j++)
+				if (buses[j] == d)
+					break;
+			if (j == nr_buses) {
+				mutex_lock_nested(&d->mutex, n + nr_buses);
+				buses[nr_buses++] = d;
+			}
+		}
+
+		if (d->refcnt == 0)
+			continue;
+
+		for (j = 0; j < nr_dvfs; j++)
+			if (dvfs_reqs[j].c == d)
+				break;
+		if (j == nr_dvfs) {
+			dvfs_reqs[j].c = d;
+			dvfs_reqs[j].rate = clk_get_rate_locked(d);
+			nr_dvfs++;
+		}
+		if (raise)
+			dvfs_reqs[j].rate = max(dvfs_reqs[j].rate,
+						reqs[i].rate);
+	}
+
+	ret = tegra_dvfs_set_rates(dvfs_reqs, nr_dvfs);
+
+	while (nr_buses--)
+		mutex_unlock(&buses[nr_buses]->mutex);
+
+	return ret;
+}
+
+/*
+ * Changes the rates of several clocks as one dvfs transition, e.g. the
+ * cpu together with its emc vote.  Before any rate changes, the rails are
+ * raised once to cover both the old and the new rate of every clock;
+ * after all of them changed, the rails are lowered once to the new rates.
+ * clk_set_rate on each clock instead updates the rails once or twice per
+ * clock.  Only clocks that can sleep, as all dvfs clocks do, are allowed,
+ * and none may be the parent of another, since all their locks are held
+ * for the whole transition.
+ */
+int tegra_clk_set_rates(struct tegra_dvfs_rate_req *reqs, int n)
+{
+	struct clk *c;
+	long new_rate;
+	int ret;
+	int i, j;
+
+	if (n > TEGRA_CLK_MAX_RATES)
+		return -EINVAL;
+
+	for (i = 0; i < n; i++) {
+		c = reqs[i].c;
+		if (!clk_cansleep(c) || !c->ops || !c->ops->set_rate)
+			return -EINVAL;
+		for (j = 0; j < n; j++)
+			if (j != i && (reqs[j].c == c ||
+				       reqs[j].c == c->parent))
+				return -EINVAL;
+	}
+
+	mutex_lock(&clk_set_rates_lock);
+	for (i = 0; i < n; i++)
+		mutex_lock_nested(&reqs[i].c->mutex, i);
+
+	for (i = 0; i < n; i++) {
+		c = reqs[i].c;
+		if (reqs[i].rate > c->max_rate)
+			reqs[i].rate = c->max_rate;
+
+		if (c->ops->round_rate) {
+			new_rate = c->ops->round_rate(c, reqs[i].rate);
+			if (new_rate < 0) {
+				ret = new_rate;
+				goto out;
+			}
+			reqs[i].rate = new_rate;
+		}
+	}
+
+	ret = clk_set_rates_dvfs(reqs, n, true);
+	if (ret)
+		goto out;
+
+	for (i = 0; i < n; i++) {
+		ret = reqs[i].c->ops->set_rate(reqs[i].c, reqs[i].rate);
+		if (ret)
+			break;
+	}
+
+	/* lower to the rates the clocks run at, even after a failure */
+	if (!ret)
+		ret = clk_set_rates_dvfs(reqs, n, false);
+	else
+		clk_set_rates_dvfs(reqs, n, false);
+
+out:
+	for (i = n - 1; i >= 0; i--)
+		mutex_unlock(&reqs[i].c->mutex);
+	mutex_unlock(&clk_set_rates_lock);
+
+	return ret;
+}
+EXPORT_SYMBOL(tegra_clk_set_rates);
+
 /* Must be called with clocks lock and all indvidual clock locks held */
 unsigned long clk_get_rate_all_locked(struct clk *c)
 {
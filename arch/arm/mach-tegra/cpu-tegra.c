@@ -207,6 +207,7 @@ static int tegra_update_cpu_speed(unsigned long rate)
 {
 	int ret = 0;
 	struct cpufreq_freqs freqs;
+	struct tegra_dvfs_rate_req reqs[2];
 
 	freqs.old = tegra_getspeed(0);
 	freqs.new = rate;
@@ -218,16 +219,20 @@ static int tegra_update_cpu_speed(unsigned long rate)
 	 * Vote on memory bus frequency based on cpu frequency
 	 * This sets the minimum frequency, display or avp may request higher
 	 */
+	reqs[0].c = emc_clk;
 	if (rate >= 816000)
-		clk_set_rate(emc_clk, 600000000); /* cpu 816 MHz, emc max */
+		reqs[0].rate = 600000000; /* cpu 816 MHz, emc max */
 	else if (rate >= 608000)
-		clk_set_rate(emc_clk, 300000000); /* cpu 608 MHz, emc 150Mhz */
+		reqs[0].rate = 300000000; /* cpu 608 MHz, emc 150Mhz */
 	else if (rate >= 456000)
-		clk_set_rate(emc_clk, 150000000); /* cpu 456 MHz, emc 75Mhz */
+		reqs[0].rate = 150000000; /* cpu 456 MHz, emc 75Mhz */
 	else if (rate >= 312000)
-		clk_set_rate(emc_clk, 100000000); /* cpu 312 MHz, emc 50Mhz */
+		reqs[0].rate = 100000000; /* cpu 312 MHz, emc 50Mhz */
 	else
-		clk_set_rate(emc_clk, 50000000);  /* emc 25Mhz */
+		reqs[0].rate = 50000000;  /* emc 25Mhz */
+
+	reqs[1].c = cpu_clk;
+	reqs[1].rate = freqs.new * 1000;
 
 	for_each_online_cpu(freqs.cpu)
 		cpufreq_notify_transition(&freqs, CPUFREQ_PRECHANGE);
@@ -237,7 +242,11 @@ static int tegra_update_cpu_speed(unsigned long rate)
 	       freqs.old, freqs.new);
 #endif
 
-	ret = clk_set_rate(cpu_clk, freqs.new * 1000);
+	/*
+	 * Change both rates in one dvfs transition, so the core and cpu
+	 * rails are each raised and lowered once rather than per clock.
+	 */
+	ret = tegra_clk_set_rates(reqs, ARRAY_SIZE(reqs));
 	if (ret) {
 		pr_err("cpu-tegra: Failed to set cpu frequency to %d kHz\n",
 			freqs.new);
@@ -29,6 +29,7 @@
 #include <linux/suspend.h>
 #include <linux/delay.h>
 #include <linux/reboot.h>
+#include <linux/uaccess.h>
 
 #include <asm/clkdev.h>
 
@@ -87,6 +88,32 @@ static int dvfs_solve_relationship(struct dvfs_relationship *rel)
 	return rel->solve(rel->from, rel->to);
 }
 
+static inline bool dvfs_rail_connected(struct dvfs_rail *rail)
+{
+#ifdef CONFIG_TEGRA_DVFS_SIM
+	return rail->sim_connected;
+#else
+	return rail->reg != NULL;
+#endif
+}
+
+/* Writes a single voltage step to the rail's regulator.  With
+ * CONFIG_TEGRA_DVFS_SIM the regulator is never touched, the write is
+ * only recorded so the solver can be exercised without hardware. */
+static int dvfs_rail_write_voltage(struct dvfs_rail *rail, int millivolts)
+{
+	int ret = 0;
+
+#ifndef CONFIG_TEGRA_DVFS_SIM
+	ret = regulator_set_voltage(rail->reg, millivolts * 1000,
+		rail->max_millivolts * 1000);
+#endif
+	if (!ret)
+		rail->reg_writes++;
+
+	return ret;
+}
+
 /* Sets the voltage on a dvfs rail to a specific value, and updates any
  * rails that depend on this rail. */
 static int dvfs_rail_set_voltage(struct dvfs_rail *rail, int millivolts)
@@ -97,7 +124,7 @@ static int dvfs_rail_set_voltage(struct dvfs_rail *rail, int millivolts)
 	int i;
 	int steps;
 
-	if (!rail->reg) {
+	if (!dvfs_rail_connected(rail)) {
 		if (millivolts == rail->millivolts)
 			return 0;
 		else
@@ -127,11 +154,9 @@ static int dvfs_rail_set_voltage(struct dvfs_rail *rail, int millivolts)
 				return ret;
 		}
 
-		if (!rail->disabled) {
-			ret = regulator_set_voltage(rail->reg,
-				rail->new_millivolts * 1000,
-				rail->max_millivolts * 1000);
-		}
+		if (!rail->disabled)
+			ret = dvfs_rail_write_voltage(rail,
+				rail->new_millivolts);
 		if (ret) {
 			pr_err("Failed to set dvfs regulator %s\n", rail->reg_id);
 			return ret;
@@ -175,7 +200,7 @@ static int dvfs_rail_update(struct dvfs_rail *rail)
 		return 0;
 
 	/* if regulators are not connected yet, return and handle it later */
-	if (!rail->reg)
+	if (!dvfs_rail_connected(rail))
 		return 0;
 
 	/* Find the maximum voltage requested by any clock */
@@ -194,6 +219,14 @@ static int dvfs_rail_update(struct dvfs_rail *rail)
 	return ret;
 }
 
+#ifdef CONFIG_TEGRA_DVFS_SIM
+static int dvfs_rail_connect_to_regulator(struct dvfs_rail *rail)
+{
+	pr_info("tegra_dvfs: simulating regulator %s\n", rail->reg_id);
+	rail->sim_connected = true;
+	return 0;
+}
+#else
 static int dvfs_rail_connect_to_regulator(struct dvfs_rail *rail)
 {
 	struct regulator *reg;
@@ -207,12 +240,12 @@ static int dvfs_rail_connect_to_regulator(struct dvfs_rail *rail)
 
 	return 0;
 }
+#endif
 
-static int
-__tegra_dvfs_set_rate(struct dvfs *d, unsigned long rate)
+/* Looks up the voltage required to run a dvfs clock at a rate */
+static int dvfs_rate_to_millivolts(struct dvfs *d, unsigned long rate)
 {
 	int i = 0;
-	int ret;
 
 	if (d->freqs == NULL || d->millivolts == NULL)
 		return -ENODEV;
@@ -223,15 +256,26 @@ __tegra_dvfs_set_rate(struct dvfs *d, unsigned long rate)
 		return -EINVAL;
 	}
 
-	if (rate == 0) {
-		d->cur_millivolts = 0;
-	} else {
-		while (i < d->num_freqs && rate > d->freqs[i])
-			i++;
+	if (rate == 0)
+		return 0;
+
+	while (i < d->num_freqs && rate > d->freqs[i])
+		i++;
 
-		d->cur_millivolts = d->millivolts[i];
-	}
+	return d->millivolts[i];
+}
+
+static int
+__tegra_dvfs_set_rate(struct dvfs *d, unsigned long rate)
+{
+	int millivolts;
+	int ret;
+
+	millivolts = dvfs_rate_to_millivolts(d, rate);
+	if (millivolts < 0)
+		return millivolts;
 
+	d->cur_millivolts = millivolts;
 	d->cur_rate = rate;
 
 	ret = dvfs_rail_update(d->dvfs_rail);
@@ -257,6 +301,108 @@ int tegra_dvfs_set_rate(struct clk *c, unsigned long rate)
 }
 EXPORT_SYMBOL(tegra_dvfs_set_rate);
 
+/* Returns true if any rail that "to" depends on is still waiting to be
+ * solved in the current batch. */
+static bool dvfs_rail_from_rails_pending(struct dvfs_rail *to)
+{
+	struct dvfs_relationship *rel;
+
+	list_for_each_entry(rel, &to->relationships_from, from_node)
+		if (rel->from->batch_pending)
+			return true;
+
+	return false;
+}
+
+/* Solves one pending rail whose "from" rails have all been solved, so
+ * that a rail is never revisited because a rail it depends on moved
+ * after it.  Returns 0 when there is nothing left to solve. */
+static int dvfs_rail_update_one_pending(struct dvfs_rail **failed)
+{
+	struct dvfs_rail *rail;
+	struct dvfs_rail *next = NULL;
+
+	list_for_each_entry(rail, &dvfs_rail_list, node) {
+		if (!rail->batch_pending)
+			continue;
+		next = rail;
+		if (!dvfs_rail_from_rails_pending(rail))
+			break;
+	}
+
+	if (!next)
+		return 0;
+
+	/* a relationship cycle falls back to list order */
+	next->batch_pending = false;
+	*failed = next;
+
+	return dvfs_rail_update(next) ?: 1;
+}
+
+/*
+ * Updates the voltage requirements of several dvfs clocks as a single
+ * transaction.  All the requests are validated and applied to their
+ * clocks before any rail is touched, then each affected rail is solved
+ * once, so a transition that changes several clocks issues one stepped
+ * regulator update per rail instead of one per clock.
+ *
+ * Each rate is taken as the clock's requirement from then on, so a batch
+ * that raises some clocks and lowers others is applied in two steps, as
+ * tegra_clk_set_rates does: before any rate changes, with the higher of
+ * the old and the new rate of every clock, and once all rates changed,
+ * with the new rates.
+ */
+int tegra_dvfs_set_rates(struct tegra_dvfs_rate_req *reqs, int n)
+{
+	struct dvfs_rail *rail;
+	struct dvfs_rail *failed = NULL;
+	struct dvfs *d;
+	int millivolts;
+	int ret = 0;
+	int i;
+
+	mutex_lock(&dvfs_lock);
+
+	for (i = 0; i < n; i++) {
+		d = reqs[i].c->dvfs;
+		if (!d) {
+			ret = -EINVAL;
+			goto out;
+		}
+
+		millivolts = dvfs_rate_to_millivolts(d, reqs[i].rate);
+		if (millivolts < 0) {
+			ret = millivolts;
+			goto out;
+		}
+		reqs[i].millivolts = millivolts;
+	}
+
+	for (i = 0; i < n; i++) {
+		d = reqs[i].c->dvfs;
+		d->cur_millivolts = reqs[i].millivolts;
+		d->cur_rate = reqs[i].rate;
+		d->dvfs_rail->batch_pending = true;
+	}
+
+	while ((ret = dvfs_rail_update_one_pending(&failed)) > 0)
+		;
+
+	if (ret) {
+		pr_err("Failed to set regulator %s for dvfs batch\n",
+			failed->reg_id);
+		list_for_each_entry(rail, &dvfs_rail_list, node)
+			rail->batch_pending = false;
+	}
+
+out:
+	mutex_unlock(&dvfs_lock);
+
+	return ret;
+}
+EXPORT_SYMBOL(tegra_dvfs_set_rates);
+
 /* May only be called during clock init, does not take any locks on clock c. */
 int __init tegra_enable_dvfs_on_clk(struct clk *c, struct dvfs *d)
 {
@@ -526,8 +672,9 @@ static int dvfs_tree_show(struct seq_file *s, void *data)
 	mutex_lock(&dvfs_lock);
 
 	list_for_each_entry(rail, &dvfs_rail_list, node) {
-		seq_printf(s, "%s %d mV%s:\n", rail->reg_id,
-			rail->millivolts, rail->disabled ? " disabled" : "");
+		seq_printf(s, "%s %d mV%s (%u writes):\n", rail->reg_id,
+			rail->millivolts, rail->disabled ? " disabled" : "",
+			rail->reg_writes);
 		list_for_each_entry(rel, &rail->relationships_from, from_node) {
 			seq_printf(s, "   %-10s %-7d mV %-4d mV\n",
 				rel->from->reg_id,
@@ -560,6 +707,63 @@ static const struct file_operations dvfs_tree_fops = {
 	.release	= single_release,
 };
 
+#ifdef CONFIG_TEGRA_DVFS_SIM
+#define DVFS_SIM_MAX_REQS	8
+
+/*
+ * Applies a batch of "<clock> <rate>" pairs to the simulated rails, e.g.
+ *   echo "cpu 1000000000 emc 600000000" > /d/clock/dvfs_batch
+ * Only the dvfs requirements change, the clocks themselves are not
+ * touched.  The resulting voltages and regulator write counts can be
+ * read back from the dvfs file.
+ */
+static ssize_t dvfs_batch_write(struct file *file,
+	const char __user *userbuf, size_t count, loff_t *ppos)
+{
+	struct tegra_dvfs_rate_req reqs[DVFS_SIM_MAX_REQS];
+	char buf[128];
+	char *p = buf;
+	char *name;
+	char *rate;
+	int n = 0;
+	int ret;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(buf, userbuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	while ((name = strsep(&p, " \t\n")) != NULL) {
+		if (!*name)
+			continue;
+
+		rate = strsep(&p, " \t\n");
+		if (!rate || n == DVFS_SIM_MAX_REQS)
+			return -EINVAL;
+
+		reqs[n].c = tegra_get_clock_by_name(name);
+		if (!reqs[n].c)
+			return -EINVAL;
+
+		if (strict_strtoul(rate, 10, &reqs[n].rate))
+			return -EINVAL;
+		n++;
+	}
+
+	ret = tegra_dvfs_set_rates(reqs, n);
+	if (ret)
+		return ret;
+
+	return count;
+}
+
+static const struct file_operations dvfs_batch_fops = {
+	.write		= dvfs_batch_write,
+};
+#endif
+
 int __init dvfs_debugfs_init(struct dentry *clk_debugfs_root)
 {
 	struct dentry *d;
@@ -569,6 +773,13 @@ int __init dvfs_debugfs_init(struct dentry *clk_debugfs_root)
 	if (!d)
 		return -ENOMEM;
 
+#ifdef CONFIG_TEGRA_DVFS_SIM
+	d = debugfs_create_file("dvfs_batch", S_IWUSR, clk_debugfs_root, NULL,
+		&dvfs_batch_fops);
+	if (!d)
+		return -ENOMEM;
+#endif
+
 	return 0;
 }
 
@@ -56,6 +56,11 @@ struct dvfs_rail {
 	int millivolts;
 	int new_millivolts;
 	bool suspended;
+	bool batch_pending;
+	unsigned int reg_writes;
+#ifdef CONFIG_TEGRA_DVFS_SIM
+	bool sim_connected;
+#endif
 };
 
 struct dvfs {
@@ -22,10 +22,18 @@
 
 struct dvfs;
 
+struct tegra_dvfs_rate_req {
+	struct clk *c;
+	unsigned long rate;
+	int millivolts;		/* filled in by tegra_dvfs_set_rates */
+};
+
 void tegra_periph_reset_deassert(struct clk *c);
 void tegra_periph_reset_assert(struct clk *c);
 
 int tegra_dvfs_set_rate(struct clk *c, unsigned long rate);
+int tegra_dvfs_set_rates(struct tegra_dvfs_rate_req *reqs, int n);
+int tegra_clk_set_rates(struct tegra_dvfs_rate_req *reqs, int n);
 unsigned long clk_get_rate_all_locked(struct clk *c);
 void tegra_sdmmc_tap_delay(struct clk *c, int delay);
 
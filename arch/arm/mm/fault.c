@@ -277,6 +277,22 @@ do_page_fault(unsigned long addr, unsigned int fsr, struct pt_regs *regs)
 	if (in_atomic() || !mm)
 		goto no_context;
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	/*
+	 * Most faults on anonymous memory can be handled without mmap_sem,
+	 * which the mmap() and munmap() of other threads may be holding.
+	 */
+	if (!(fsr & FSR_LNX_PF) &&
+	    (user_mode(regs) || search_exception_tables(regs->ARM_pc)) &&
+	    !handle_speculative_fault(mm, addr,
+			(fsr & FSR_WRITE) ? FAULT_FLAG_WRITE : 0)) {
+		tsk->min_flt++;
+		perf_sw_event(PERF_COUNT_SW_PAGE_FAULTS, 1, 0, regs, addr);
+		perf_sw_event(PERF_COUNT_SW_PAGE_FAULTS_MIN, 1, 0, regs, addr);
+		return 0;
+	}
+#endif
+
 	/*
 	 * As per x86, we may deadlock here.  However, since the kernel only
 	 * validly references user space from well defined areas of the code,
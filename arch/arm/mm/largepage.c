@@ -0,0 +1,104 @@
+/*
+ *  linux/arch/arm/mm/largepage.c
+ *
+ *  64K large page mappings for anonymous memory
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * mm/large_anon.c hands us blocks of sixteen ptes mapping sixteen
+ * physically contiguous, naturally aligned pages, and we replace the
+ * sixteen small page descriptors in the hardware table by the large
+ * page descriptor, which the architecture wants repeated in each of
+ * them.  The Linux ptes are not touched, so the rest of the mm never
+ * notices, except that set_pte_at() and pte_clear() call back here to
+ * turn the block back into small pages before they change a pte.
+ *
+ * The page size of a mapping may only change through an invalid entry
+ * (break-before-make), or the TLB could end up holding overlapping
+ * entries for the same address.  The callers hold the pte lock, so the
+ * only thing that can happen in between is a fault on another cpu,
+ * which waits for the lock and then finds the pte as it was.
+ */
+#include <linux/mm.h>
+#include <linux/vmstat.h>
+
+#include <asm/cacheflush.h>
+#include <asm/pgtable.h>
+#include <asm/tlbflush.h>
+
+/*
+ * Small page descriptor bits that keep their place in a large page
+ * descriptor: B, C, AP[1:0], APX, S and nG.  TEX moves from bits 6-8 to
+ * bits 12-14 and XN from bit 0 to bit 15.
+ */
+#define LPTE_SAME_BITS		(PTE_BUFFERABLE | PTE_CACHEABLE | \
+				 PTE_EXT_AP_MASK | PTE_EXT_APX | \
+				 PTE_EXT_SHARED | PTE_EXT_NG)
+#define LPTE_TEX_SHIFT		6
+#define LPTE_XN			(1 << 15)
+
+static void large_anon_break(struct mm_struct *mm, unsigned long addr,
+			     pte_t *hw)
+{
+	struct vm_area_struct vma = {
+		.vm_mm		= mm,
+		.vm_flags	= VM_EXEC,
+	};
+	int i;
+
+	for (i = 0; i < LARGE_ANON_NR; i++)
+		hw[i] = __pte(0);
+	clean_dcache_area(hw, LARGE_ANON_NR * sizeof(pte_t));
+	flush_tlb_range(&vma, addr, addr + LARGE_ANON_SIZE);
+}
+
+/*
+ * Rewrite the small page descriptors of the block around ptep from the
+ * Linux ptes.  Called with the pte lock held.
+ */
+void __split_large_anon(struct mm_struct *mm, unsigned long addr,
+			pte_t *ptep)
+{
+	unsigned long haddr = addr & LARGE_ANON_MASK;
+	pte_t *first = ptep - ((addr - haddr) >> PAGE_SHIFT);
+	int i;
+
+	large_anon_break(mm, haddr, first - PTRS_PER_PTE);
+	for (i = 0; i < LARGE_ANON_NR; i++)
+		set_pte_ext(first + i, first[i], PTE_EXT_NG);
+	count_vm_event(LARGE_ANON_SPLIT);
+}
+
+/*
+ * Map the block starting at addr, whose first pte is ptep, with a large
+ * page if its ptes allow it: all present and young, physically contiguous
+ * and aligned, and with the same attributes.  Called with the pte lock
+ * held.  Returns 1 if the block is now mapped by a large page.
+ */
+int arch_promote_large_anon(struct mm_struct *mm, unsigned long addr,
+			    pte_t *ptep)
+{
+	pte_t *hw = ptep - PTRS_PER_PTE;
+	unsigned long small = pte_val(hw[0]), large;
+	int i;
+
+	if (pte_large_anon(ptep))
+		return 1;
+	if (!(small & PTE_TYPE_SMALL) || (small & ~LARGE_ANON_MASK & PAGE_MASK))
+		return 0;
+	for (i = 1; i < LARGE_ANON_NR; i++)
+		if (pte_val(hw[i]) != small + i * PAGE_SIZE)
+			return 0;
+
+	large = (small & LARGE_ANON_MASK) | (small & LPTE_SAME_BITS) |
+		((small & PTE_EXT_TEX(7)) << LPTE_TEX_SHIFT) |
+		((small & PTE_EXT_XN) ? LPTE_XN : 0) | PTE_TYPE_LARGE;
+
+	large_anon_break(mm, addr, hw);
+	for (i = 0; i < LARGE_ANON_NR; i++)
+		hw[i] = __pte(large);
+	clean_dcache_area(hw, LARGE_ANON_NR * sizeof(pte_t));
+	return 1;
+}
@@ -129,6 +129,9 @@ static inline void reset_lazy_tlbstate(void)
 
 #define local_flush_tlb() __flush_tlb()
 
+/* flushing the other cpus always takes IPIs, batch them */
+#define arch_tlbbatch_should_defer(mm)	true
+
 extern void flush_tlb_all(void);
 extern void flush_tlb_current_task(void);
 extern void flush_tlb_mm(struct mm_struct *);
@@ -27,6 +27,7 @@
 #include <linux/sched.h>
 #include <linux/async.h>
 #include <linux/timer.h>
+#include <linux/suspend.h>
 
 #include "../base.h"
 #include "power.h"
@@ -176,7 +177,7 @@ void device_pm_move_last(struct device *dev)
 
 static ktime_t initcall_debug_start(struct device *dev)
 {
-	ktime_t calltime = ktime_set(0, 0);
+	ktime_t calltime = pm_profile_start();
 
 	if (initcall_debug) {
 		pr_info("calling  %s+ @ %i\n",
@@ -225,6 +226,30 @@ static void dpm_wait_for_children(struct device *dev, bool async)
        device_for_each_child(dev, &async, dpm_wait_fn);
 }
 
+static char *pm_verb(int event)
+{
+	switch (event) {
+	case PM_EVENT_SUSPEND:
+		return "suspend";
+	case PM_EVENT_RESUME:
+		return "resume";
+	case PM_EVENT_FREEZE:
+		return "freeze";
+	case PM_EVENT_QUIESCE:
+		return "quiesce";
+	case PM_EVENT_HIBERNATE:
+		return "hibernate";
+	case PM_EVENT_THAW:
+		return "thaw";
+	case PM_EVENT_RESTORE:
+		return "restore";
+	case PM_EVENT_RECOVER:
+		return "recover";
+	default:
+		return "(unknown PM event)";
+	}
+}
+
 /**
  * pm_op - Execute the PM operation appropriate for given PM event.
  * @dev: Device to handle.
@@ -288,6 +313,8 @@ static int pm_op(struct device *dev,
 	}
 
 	initcall_debug_report(dev, calltime, error);
+	pm_profile_record(PM_PROFILE_DEVICES, dev_name(dev), "",
+			  pm_verb(state.event), calltime, error);
 
 	return error;
 }
@@ -308,6 +335,7 @@ static int pm_noirq_op(struct device *dev,
 	int error = 0;
 	ktime_t calltime, delta, rettime;
 
+	calltime = pm_profile_start();
 	if (initcall_debug) {
 		pr_info("calling  %s+ @ %i, parent: %s\n",
 				dev_name(dev), task_pid_nr(current),
@@ -369,34 +397,12 @@ static int pm_noirq_op(struct device *dev,
 			dev_name(dev), error,
 			(unsigned long long)ktime_to_ns(delta) >> 10);
 	}
+	pm_profile_record(PM_PROFILE_DEVICES, dev_name(dev), "noirq ",
+			  pm_verb(state.event), calltime, error);
 
 	return error;
 }
 
-static char *pm_verb(int event)
-{
-	switch (event) {
-	case PM_EVENT_SUSPEND:
-		return "suspend";
-	case PM_EVENT_RESUME:
-		return "resume";
-	case PM_EVENT_FREEZE:
-		return "freeze";
-	case PM_EVENT_QUIESCE:
-		return "quiesce";
-	case PM_EVENT_HIBERNATE:
-		return "hibernate";
-	case PM_EVENT_THAW:
-		return "thaw";
-	case PM_EVENT_RESTORE:
-		return "restore";
-	case PM_EVENT_RECOVER:
-		return "recover";
-	default:
-		return "(unknown PM event)";
-	}
-}
-
 static void pm_dev_dbg(struct device *dev, pm_message_t state, char *info)
 {
 	dev_dbg(dev, "%s%s%s\n", info, pm_verb(state.event),
@@ -514,6 +520,8 @@ static int legacy_resume(struct device *dev, int (*cb)(struct device *dev))
 	suspend_report_result(cb, error);
 
 	initcall_debug_report(dev, calltime, error);
+	pm_profile_record(PM_PROFILE_DEVICES, dev_name(dev), "legacy ",
+			  pm_verb(pm_transition.event), calltime, error);
 
 	return error;
 }
@@ -858,6 +866,8 @@ static int legacy_suspend(struct device *dev, pm_message_t state,
 	suspend_report_result(cb, error);
 
 	initcall_debug_report(dev, calltime, error);
+	pm_profile_record(PM_PROFILE_DEVICES, dev_name(dev), "legacy ",
+			  pm_verb(state.event), calltime, error);
 
 	return error;
 }
@@ -1114,6 +1124,7 @@ int dpm_suspend_start(pm_message_t state)
 	int error;
 
 	might_sleep();
+	pm_profile_begin(PM_PROFILE_DEVICES);
 	error = dpm_prepare(state);
 	if (!error)
 		error = dpm_suspend(state);
@@ -377,6 +377,8 @@ int bprm_mm_init(struct linux_binprm *bprm)
 	if (err)
 		goto err;
 
+	/* the error path above uses mmdrop(), which does not unlist it */
+	lru_gen_add_mm(mm);
 	return 0;
 
 err:
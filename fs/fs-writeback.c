@@ -25,6 +25,7 @@
 #include <linux/writeback.h>
 #include <linux/blkdev.h>
 #include <linux/backing-dev.h>
+#include <linux/memcontrol.h>
 #include <linux/buffer_head.h>
 #include <linux/tracepoint.h>
 #include "internal.h"
@@ -39,6 +40,7 @@ struct wb_writeback_work {
 	unsigned int for_kupdate:1;
 	unsigned int range_cyclic:1;
 	unsigned int for_background:1;
+	unsigned short memcg_id;	/* only for this memory cgroup */
 
 	struct list_head list;		/* pending work list */
 	struct completion *done;	/* set if the caller waits */
@@ -101,7 +103,7 @@ static void bdi_queue_work(struct backing_dev_info *bdi,
 
 static void
 __bdi_start_writeback(struct backing_dev_info *bdi, long nr_pages,
-		bool range_cyclic, bool for_background)
+		bool range_cyclic, bool for_background, unsigned short memcg_id)
 {
 	struct wb_writeback_work *work;
 
@@ -122,6 +124,7 @@ __bdi_start_writeback(struct backing_dev_info *bdi, long nr_pages,
 	work->nr_pages	= nr_pages;
 	work->range_cyclic = range_cyclic;
 	work->for_background = for_background;
+	work->memcg_id = memcg_id;
 
 	bdi_queue_work(bdi, work);
 }
@@ -139,7 +142,7 @@ __bdi_start_writeback(struct backing_dev_info *bdi, long nr_pages,
  */
 void bdi_start_writeback(struct backing_dev_info *bdi, long nr_pages)
 {
-	__bdi_start_writeback(bdi, nr_pages, true, false);
+	__bdi_start_writeback(bdi, nr_pages, true, false, 0);
 }
 
 /**
@@ -153,7 +156,38 @@ void bdi_start_writeback(struct backing_dev_info *bdi, long nr_pages)
  */
 void bdi_start_background_writeback(struct backing_dev_info *bdi)
 {
-	__bdi_start_writeback(bdi, LONG_MAX, true, true);
+	__bdi_start_writeback(bdi, LONG_MAX, true, true, 0);
+}
+
+/**
+ * bdi_start_memcg_writeback - start background writeback for a cgroup
+ * @bdi: the backing device to write from
+ * @memcg_id: css id of the memory cgroup over its background dirty limit
+ *
+ * Description:
+ *   As bdi_start_background_writeback(), but only the inodes that the
+ *   memory cgroup dirtied are written, until the cgroup is below its own
+ *   background dirty threshold.  Nothing is queued if such a work for the
+ *   cgroup is already waiting on @bdi.
+ */
+void bdi_start_memcg_writeback(struct backing_dev_info *bdi,
+			       unsigned short memcg_id)
+{
+	struct wb_writeback_work *work;
+	bool pending = false;
+
+	/* Each dirtier of the cgroup asks: one queued work will do for all */
+	spin_lock_bh(&bdi->wb_lock);
+	list_for_each_entry(work, &bdi->work_list, list) {
+		if (work->memcg_id == memcg_id) {
+			pending = true;
+			break;
+		}
+	}
+	spin_unlock_bh(&bdi->wb_lock);
+
+	if (!pending)
+		__bdi_start_writeback(bdi, LONG_MAX, true, true, memcg_id);
 }
 
 /*
@@ -215,10 +249,13 @@ static bool inode_dirtied_after(struct inode *inode, unsigned long t)
 
 /*
  * Move expired dirty inodes from @delaying_queue to @dispatch_queue.
+ * With a @memcg_id, the inodes that other memory cgroups dirtied stay
+ * where they are, their dirtied_when untouched.
  */
 static void move_expired_inodes(struct list_head *delaying_queue,
 			       struct list_head *dispatch_queue,
-				unsigned long *older_than_this)
+				unsigned long *older_than_this,
+				unsigned short memcg_id)
 {
 	LIST_HEAD(tmp);
 	struct list_head *pos, *node;
@@ -226,11 +263,14 @@ static void move_expired_inodes(struct list_head *delaying_queue,
 	struct inode *inode;
 	int do_sb_sort = 0;
 
-	while (!list_empty(delaying_queue)) {
-		inode = list_entry(delaying_queue->prev, struct inode, i_list);
+	for (pos = delaying_queue->prev; pos != delaying_queue; pos = node) {
+		node = pos->prev;
+		inode = list_entry(pos, struct inode, i_list);
 		if (older_than_this &&
 		    inode_dirtied_after(inode, *older_than_this))
 			break;
+		if (!mem_cgroup_mapping_dirtied_by(inode->i_mapping, memcg_id))
+			continue;
 		if (sb && sb != inode->i_sb)
 			do_sb_sort = 1;
 		sb = inode->i_sb;
@@ -266,10 +306,15 @@ static void move_expired_inodes(struct list_head *delaying_queue,
  *                                           |
  *                                           +--> dequeue for IO
  */
-static void queue_io(struct bdi_writeback *wb, unsigned long *older_than_this)
+static void queue_io(struct bdi_writeback *wb, unsigned long *older_than_this,
+		     unsigned short memcg_id)
 {
-	list_splice_init(&wb->b_more_io, &wb->b_io);
-	move_expired_inodes(&wb->b_dirty, &wb->b_io, older_than_this);
+	if (memcg_id)
+		move_expired_inodes(&wb->b_more_io, &wb->b_io, NULL, memcg_id);
+	else
+		list_splice_init(&wb->b_more_io, &wb->b_io);
+	move_expired_inodes(&wb->b_dirty, &wb->b_io, older_than_this,
+			    memcg_id);
 }
 
 static int write_inode(struct inode *inode, struct writeback_control *wbc)
@@ -419,6 +464,8 @@ writeback_single_inode(struct inode *inode, struct writeback_control *wbc)
 			 */
 			list_move(&inode->i_list, &inode_unused);
 		}
+		if (!(inode->i_state & I_DIRTY_PAGES))
+			mem_cgroup_mapping_clean(mapping);
 	}
 	inode_sync_complete(inode);
 	return ret;
@@ -491,6 +538,17 @@ static int writeback_sb_inodes(struct super_block *sb, struct bdi_writeback *wb,
 			requeue_io(inode);
 			continue;
 		}
+		/*
+		 * Writeback for a memory cgroup over its dirty limits skips
+		 * the inodes that other cgroups dirtied.  queue_io() did not
+		 * queue them, but b_io can still hold some from an earlier
+		 * writeback; park them on b_more_io, keeping dirtied_when.
+		 */
+		if (!mem_cgroup_mapping_dirtied_by(inode->i_mapping,
+						   wbc->memcg_id)) {
+			requeue_io(inode);
+			continue;
+		}
 		/*
 		 * Was this inode dirtied after sync_sb_inodes was called?
 		 * This keeps sync from extra jobs and livelock.
@@ -533,7 +591,7 @@ void writeback_inodes_wb(struct bdi_writeback *wb,
 		wbc->wb_start = jiffies; /* livelock avoidance */
 	spin_lock(&inode_lock);
 	if (!wbc->for_kupdate || list_empty(&wb->b_io))
-		queue_io(wb, wbc->older_than_this);
+		queue_io(wb, wbc->older_than_this, wbc->memcg_id);
 
 	while (!list_empty(&wb->b_io)) {
 		struct inode *inode = list_entry(wb->b_io.prev,
@@ -561,7 +619,7 @@ static void __writeback_inodes_sb(struct super_block *sb,
 
 	spin_lock(&inode_lock);
 	if (!wbc->for_kupdate || list_empty(&wb->b_io))
-		queue_io(wb, wbc->older_than_this);
+		queue_io(wb, wbc->older_than_this, wbc->memcg_id);
 	writeback_sb_inodes(sb, wb, wbc, true);
 	spin_unlock(&inode_lock);
 }
@@ -575,10 +633,14 @@ static void __writeback_inodes_sb(struct super_block *sb,
  */
 #define MAX_WRITEBACK_PAGES     1024
 
-static inline bool over_bground_thresh(void)
+static inline bool over_bground_thresh(unsigned short memcg_id)
 {
 	unsigned long background_thresh, dirty_thresh;
 
+	if (memcg_id)
+		return mem_cgroup_over_bground_thresh(memcg_id,
+						determine_dirtyable_memory());
+
 	global_dirty_limits(&background_thresh, &dirty_thresh);
 
 	return (global_page_state(NR_FILE_DIRTY) +
@@ -609,6 +671,7 @@ static long wb_writeback(struct bdi_writeback *wb,
 		.for_kupdate		= work->for_kupdate,
 		.for_background		= work->for_background,
 		.range_cyclic		= work->range_cyclic,
+		.memcg_id		= work->memcg_id,
 	};
 	unsigned long oldest_jif;
 	long wrote = 0;
@@ -636,7 +699,8 @@ static long wb_writeback(struct bdi_writeback *wb,
 		 * For background writeout, stop when we are below the
 		 * background dirty threshold
 		 */
-		if (work->for_background && !over_bground_thresh())
+		if (work->for_background &&
+		    !over_bground_thresh(work->memcg_id))
 			break;
 
 		wbc.more_io = 0;
@@ -861,7 +925,26 @@ void wakeup_flusher_threads(long nr_pages)
 	list_for_each_entry_rcu(bdi, &bdi_list, bdi_list) {
 		if (!bdi_has_dirty_io(bdi))
 			continue;
-		__bdi_start_writeback(bdi, nr_pages, false, false);
+		__bdi_start_writeback(bdi, nr_pages, false, false, 0);
+	}
+	rcu_read_unlock();
+}
+
+/*
+ * Start background writeback of the inodes that memory cgroup `memcg_id'
+ * dirtied, on every bdi that has dirty inodes.  Writeback already going
+ * on there, global background or kupdate writeback, may stop while the
+ * cgroup is still over its own limits, so the work is queued behind it.
+ */
+void wakeup_memcg_flusher_threads(unsigned short memcg_id)
+{
+	struct backing_dev_info *bdi;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(bdi, &bdi_list, bdi_list) {
+		if (!bdi_has_dirty_io(bdi))
+			continue;
+		bdi_start_memcg_writeback(bdi, memcg_id);
 	}
 	rcu_read_unlock();
 }
@@ -83,6 +83,7 @@
 #include <linux/pid_namespace.h>
 #include <linux/fs_struct.h>
 #include <linux/slab.h>
+#include <linux/ksm.h>
 #include "internal.h"
 
 /* NOTE:
@@ -2692,6 +2693,24 @@ static int proc_pid_personality(struct seq_file *m, struct pid_namespace *ns,
 	return 0;
 }
 
+#ifdef CONFIG_KSM
+static int proc_pid_ksm_stat(struct seq_file *m, struct pid_namespace *ns,
+			     struct pid *pid, struct task_struct *task)
+{
+	struct mm_struct *mm;
+
+	if (!ptrace_may_access(task, PTRACE_MODE_READ))
+		return -EACCES;
+
+	mm = get_task_mm(task);
+	if (mm) {
+		ksm_mm_stat(m, mm);
+		mmput(mm);
+	}
+	return 0;
+}
+#endif
+
 /*
  * Thread groups
  */
@@ -2773,6 +2792,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 #ifdef CONFIG_TASK_IO_ACCOUNTING
 	INF("io",	S_IRUGO, proc_tgid_io_accounting),
 #endif
+#ifdef CONFIG_KSM
+	ONE("ksm_stat",	S_IRUSR, proc_pid_ksm_stat),
+#endif
 };
 
 static int proc_tgid_base_readdir(struct file * filp,
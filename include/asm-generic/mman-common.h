@@ -45,6 +45,9 @@
 #define MADV_MERGEABLE   12		/* KSM may merge identical pages */
 #define MADV_UNMERGEABLE 13		/* KSM may not merge identical pages */
 
+#define MADV_HUGEPAGE	14		/* Worth mapping with large pages */
+#define MADV_NOHUGEPAGE	15		/* Not worth mapping with large pages */
+
 /* compatibility flags */
 #define MAP_FILE	0
 
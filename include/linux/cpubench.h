@@ -0,0 +1,72 @@
+#ifndef _LINUX_CPUBENCH_H
+#define _LINUX_CPUBENCH_H
+
+/*
+ * Harness for the benchmark modules that run the same code on every cpu
+ * at the same time.  cpu_bench_run() starts one kthread per online cpu
+ * (or nr_threads of them), bound round robin to the online cpus, and
+ * calls fn(bench, thread, round) on each of them for every round.  All
+ * threads start a round together, so they contend with each other the
+ * whole time.  fn keeps the times it measures with cpu_bench_clock_*()
+ * in the slots cpu_bench_time() returns, and cpu_bench_report() prints
+ * them per operation, averaged over the threads and for the slowest one.
+ * cpu_bench_free() frees the times again.
+ */
+
+#include <linux/hrtimer.h>
+#include <linux/timex.h>
+#include <asm/atomic.h>
+
+struct cpu_bench_time {
+	unsigned long long cycles;	/* 0 without a get_cycles() */
+	unsigned long long nsecs;
+};
+
+struct cpu_bench {
+	const char *name;	/* of the threads, and report prefix */
+	int nr_threads;		/* 0 for one per online cpu */
+	int nr_rounds;
+	int nr_tests;		/* times kept per thread and round */
+	void (*fn)(struct cpu_bench *bench, int thread, int round);
+	void *data;
+
+	/* private to the harness */
+	struct cpu_bench_time *times;
+	atomic_t *start_barrier;
+	atomic_t threads_done;
+	struct completion *done;
+};
+
+extern int cpu_bench_run(struct cpu_bench *bench);
+extern void cpu_bench_free(struct cpu_bench *bench);
+extern void cpu_bench_report(struct cpu_bench *bench, int round, int test,
+			     unsigned long ops, const char *label);
+
+static inline struct cpu_bench_time *cpu_bench_time(struct cpu_bench *bench,
+					int thread, int round, int test)
+{
+	return &bench->times[(thread * bench->nr_rounds + round) *
+			     bench->nr_tests + test];
+}
+
+struct cpu_bench_clock {
+	cycles_t cycles;
+	ktime_t time;
+};
+
+static inline void cpu_bench_clock_start(struct cpu_bench_clock *clk)
+{
+	clk->time = ktime_get();
+	clk->cycles = get_cycles();
+}
+
+static inline void cpu_bench_clock_stop(struct cpu_bench_clock *clk,
+					struct cpu_bench_time *time)
+{
+	cycles_t cycles = get_cycles();
+
+	time->nsecs = ktime_to_ns(ktime_sub(ktime_get(), clk->time));
+	time->cycles = cycles - clk->cycles;
+}
+
+#endif /* _LINUX_CPUBENCH_H */
@@ -20,6 +20,11 @@
 #define FUTEX_WAKE_BITSET	10
 #define FUTEX_WAIT_REQUEUE_PI	11
 #define FUTEX_CMP_REQUEUE_PI	12
+/*
+ * Kept well clear of the op numbers mainline hands out in order, so that
+ * no later mainline op means something else to this kernel.
+ */
+#define FUTEX_WAITV		64
 
 #define FUTEX_PRIVATE_FLAG	128
 #define FUTEX_CLOCK_REALTIME	256
@@ -40,6 +45,30 @@
 #define FUTEX_CMP_REQUEUE_PI_PRIVATE	(FUTEX_CMP_REQUEUE_PI | \
 					 FUTEX_PRIVATE_FLAG)
 
+/*
+ * FUTEX_WAITV: wait on several futexes at once.
+ *
+ * uaddr points to an array of struct futex_waitv, val is the number of
+ * entries (at most FUTEX_WAITV_MAX) and utime is an optional absolute
+ * timeout, against CLOCK_MONOTONIC or, with FUTEX_CLOCK_REALTIME, against
+ * CLOCK_REALTIME. The call sleeps as long as every futex word still holds
+ * its expected value and returns the index of the futex that was woken.
+ *
+ * Shared or private is chosen for each entry through its flags, the
+ * FUTEX_PRIVATE_FLAG bit of the op is ignored.
+ *
+ * NOTE: this structure is part of the syscall ABI, and must not be
+ * changed.
+ */
+struct futex_waitv {
+	__u64 val;		/* expected value, only the low 32 bits count */
+	__u64 uaddr;		/* user address of the futex word */
+	__u32 flags;		/* 0 or FUTEX_PRIVATE_FLAG */
+	__u32 __reserved;	/* must be zero */
+};
+
+#define FUTEX_WAITV_MAX		128
+
 /*
  * Support for robust futexes: the kernel cleans up held futexes at
  * thread exit time.
@@ -176,6 +205,7 @@ union futex_key {
 #ifdef CONFIG_FUTEX
 extern void exit_robust_list(struct task_struct *curr);
 extern void exit_pi_state_list(struct task_struct *curr);
+extern void futex_mm_release(struct mm_struct *mm);
 extern int futex_cmpxchg_enabled;
 #else
 static inline void exit_robust_list(struct task_struct *curr)
@@ -184,6 +214,9 @@ static inline void exit_robust_list(struct task_struct *curr)
 static inline void exit_pi_state_list(struct task_struct *curr)
 {
 }
+static inline void futex_mm_release(struct mm_struct *mm)
+{
+}
 #endif
 #endif /* __KERNEL__ */
 
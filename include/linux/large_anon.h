@@ -0,0 +1,79 @@
+#ifndef _LINUX_LARGE_ANON_H
+#define _LINUX_LARGE_ANON_H
+/*
+ * Large pages for anonymous memory, see mm/large_anon.c.
+ *
+ * The architecture provides LARGE_ANON_ORDER, LARGE_ANON_NR,
+ * LARGE_ANON_SIZE and LARGE_ANON_MASK for the size of a block,
+ * pte_large_anon() to tell whether the block of a pte is mapped by a
+ * large page, and arch_promote_large_anon() to map a block that way.
+ */
+
+#include <linux/errno.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+
+#ifdef CONFIG_LARGE_ANON_PAGES
+#define LARGE_ANON_NEVER	0
+#define LARGE_ANON_MADVISE	1
+#define LARGE_ANON_ALWAYS	2
+extern unsigned int large_anon_mode;
+
+int large_anon_madvise(struct vm_area_struct *vma, unsigned long *vm_flags,
+		       int advice);
+int __large_anon_enter(struct mm_struct *mm);
+void __large_anon_exit(struct mm_struct *mm);
+int do_large_anon_page(struct mm_struct *mm, struct vm_area_struct *vma,
+		       unsigned long address, pmd_t *pmd);
+
+static inline int large_anon_enabled(struct vm_area_struct *vma)
+{
+	if (large_anon_mode == LARGE_ANON_ALWAYS)
+		return 1;
+	return large_anon_mode == LARGE_ANON_MADVISE &&
+		(vma->vm_flags & VM_HUGEPAGE);
+}
+
+static inline int large_anon_fork(struct mm_struct *mm,
+				  struct mm_struct *oldmm)
+{
+	if (test_bit(MMF_VM_LARGE_ANON, &oldmm->flags))
+		return __large_anon_enter(mm);
+	return 0;
+}
+
+static inline void large_anon_exit(struct mm_struct *mm)
+{
+	if (test_bit(MMF_VM_LARGE_ANON, &mm->flags))
+		__large_anon_exit(mm);
+}
+#else
+static inline int large_anon_madvise(struct vm_area_struct *vma,
+				     unsigned long *vm_flags, int advice)
+{
+	return -EINVAL;
+}
+
+static inline int large_anon_enabled(struct vm_area_struct *vma)
+{
+	return 0;
+}
+
+static inline int do_large_anon_page(struct mm_struct *mm,
+		struct vm_area_struct *vma, unsigned long address, pmd_t *pmd)
+{
+	return -ENODEV;
+}
+
+static inline int large_anon_fork(struct mm_struct *mm,
+				  struct mm_struct *oldmm)
+{
+	return 0;
+}
+
+static inline void large_anon_exit(struct mm_struct *mm)
+{
+}
+#endif
+
+#endif /* _LINUX_LARGE_ANON_H */
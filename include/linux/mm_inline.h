@@ -19,9 +19,155 @@ static inline int page_is_file_cache(struct page *page)
 	return !PageSwapBacked(page);
 }
 
+#ifdef CONFIG_LRU_GEN
+extern int lru_gen_enabled;
+
+static inline int lru_gen_from_seq(unsigned long seq)
+{
+	return seq % MAX_NR_GENS;
+}
+
+/* The generation of a page, or -1 if it is not on a generation list */
+static inline int page_lru_gen(struct page *page)
+{
+	return (int)((page->flags >> LRU_GEN_PGSHIFT) & LRU_GEN_MASK) - 1;
+}
+
+static inline void set_page_lru_gen(struct page *page, int gen)
+{
+	unsigned long old, new;
+
+	/* other flags of the page are changed without the lru_lock */
+	do {
+		old = ACCESS_ONCE(page->flags);
+		new = (old & ~(LRU_GEN_MASK << LRU_GEN_PGSHIFT)) |
+		      ((gen + 1UL) << LRU_GEN_PGSHIFT);
+	} while (cmpxchg(&page->flags, old, new) != old);
+}
+
+/* The statistics list a generation is accounted to */
+static inline enum lru_list lru_gen_lru(struct zone *zone, int gen, int file)
+{
+	unsigned long max_seq = zone->lrugen.max_seq;
+	enum lru_list l = file ? LRU_INACTIVE_FILE : LRU_INACTIVE_ANON;
+
+	if (gen == lru_gen_from_seq(max_seq) ||
+	    gen == lru_gen_from_seq(max_seq - 1))
+		l += LRU_ACTIVE;
+	return l;
+}
+
+static inline void lru_gen_update_size(struct zone *zone, int gen, int file,
+				       int delta)
+{
+	zone->lrugen.nr_pages[gen][file] += delta;
+	__mod_zone_page_state(zone, NR_LRU_BASE + lru_gen_lru(zone, gen, file),
+			      delta);
+}
+
+/*
+ * Pages headed for an active list start in the youngest generation.
+ * Others start in the oldest, except anon pages not yet in the swap
+ * cache, which get one generation more to be written out.
+ */
+static inline int lru_gen_add_page(struct zone *zone, struct page *page,
+				   enum lru_list l)
+{
+	struct zone_lru_gen *lrugen = &zone->lrugen;
+	int file = page_is_file_cache(page);
+	unsigned long seq;
+	int gen;
+
+	if (!lru_gen_enabled || is_unevictable_lru(l))
+		return 0;
+
+	if (is_active_lru(l)) {
+		ClearPageActive(page);
+		seq = lrugen->max_seq;
+	} else if (!file && !PageSwapCache(page))
+		seq = lrugen->min_seq[0] + 1;
+	else
+		seq = lrugen->min_seq[file];
+
+	gen = lru_gen_from_seq(seq);
+	set_page_lru_gen(page, gen);
+	list_add(&page->lru, &lrugen->lists[gen][file]);
+	lru_gen_update_size(zone, gen, file, 1);
+	return 1;
+}
+
+/*
+ * Unless @keep_active is 0, as when the page is being reclaimed or freed,
+ * a page taken out of an active generation gets PG_active, so that it
+ * goes back into the youngest generation when it is put back.
+ */
+static inline int lru_gen_del_page(struct zone *zone, struct page *page,
+				   int keep_active)
+{
+	int gen = page_lru_gen(page);
+	int file;
+
+	if (gen < 0)
+		return 0;
+
+	file = page_is_file_cache(page);
+	if (keep_active && (PageYoung(page) ||
+	    is_active_lru(lru_gen_lru(zone, gen, file))))
+		SetPageActive(page);
+	list_del(&page->lru);
+	lru_gen_update_size(zone, gen, file, -1);
+	set_page_lru_gen(page, -1);
+	return 1;
+}
+
+/* Move a page to the tail of the oldest generation of its type */
+static inline int lru_gen_rotate_page(struct zone *zone, struct page *page)
+{
+	int gen = page_lru_gen(page);
+	int file, new_gen;
+
+	if (gen < 0)
+		return 0;
+
+	file = page_is_file_cache(page);
+	new_gen = lru_gen_from_seq(zone->lrugen.min_seq[file]);
+	if (new_gen != gen) {
+		lru_gen_update_size(zone, gen, file, -1);
+		set_page_lru_gen(page, new_gen);
+		lru_gen_update_size(zone, new_gen, file, 1);
+	}
+	list_move_tail(&page->lru, &zone->lrugen.lists[new_gen][file]);
+	return 1;
+}
+#else
+static inline int page_lru_gen(struct page *page)
+{
+	return -1;
+}
+
+static inline int lru_gen_add_page(struct zone *zone, struct page *page,
+				   enum lru_list l)
+{
+	return 0;
+}
+
+static inline int lru_gen_del_page(struct zone *zone, struct page *page,
+				   int keep_active)
+{
+	return 0;
+}
+
+static inline int lru_gen_rotate_page(struct zone *zone, struct page *page)
+{
+	return 0;
+}
+#endif
+
 static inline void
 add_page_to_lru_list(struct zone *zone, struct page *page, enum lru_list l)
 {
+	if (lru_gen_add_page(zone, page, l))
+		return;
 	list_add(&page->lru, &zone->lru[l].list);
 	__inc_zone_state(zone, NR_LRU_BASE + l);
 	mem_cgroup_add_lru_list(page, l);
@@ -30,6 +176,8 @@ add_page_to_lru_list(struct zone *zone, struct page *page, enum lru_list l)
 static inline void
 del_page_from_lru_list(struct zone *zone, struct page *page, enum lru_list l)
 {
+	if (lru_gen_del_page(zone, page, 1))
+		return;
 	list_del(&page->lru);
 	__dec_zone_state(zone, NR_LRU_BASE + l);
 	mem_cgroup_del_lru_list(page, l);
@@ -55,6 +203,8 @@ del_page_from_lru(struct zone *zone, struct page *page)
 {
 	enum lru_list l;
 
+	if (lru_gen_del_page(zone, page, 0))
+		return;
 	list_del(&page->lru);
 	if (PageUnevictable(page)) {
 		__ClearPageUnevictable(page);
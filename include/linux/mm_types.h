@@ -12,6 +12,7 @@
 #include <linux/completion.h>
 #include <linux/cpumask.h>
 #include <linux/page-debug-flags.h>
+#include <linux/seqlock.h>
 #include <asm/page.h>
 #include <asm/mmu.h>
 
@@ -72,9 +73,21 @@ struct page {
 		pgoff_t index;		/* Our offset within mapping. */
 		void *freelist;		/* SLUB: freelist req. slab lock */
 	};
-	struct list_head lru;		/* Pageout list, eg. active_list
+	union {
+		struct list_head lru;	/* Pageout list, eg. active_list
 					 * protected by zone->lru_lock !
 					 */
+		struct {		/* SLUB: per cpu partial slabs */
+			struct page *next;	/* Next partial slab */
+#ifdef CONFIG_64BIT
+			int pages;	/* Nr of partial slabs left */
+			int pobjects;	/* Approximate # of objects */
+#else
+			short int pages;
+			short int pobjects;
+#endif
+		};
+	};
 	/*
 	 * On machines where all RAM is mapped into kernel address space,
 	 * we can simply calculate the virtual address. On machines with
@@ -183,6 +196,9 @@ struct vm_area_struct {
 #ifdef CONFIG_NUMA
 	struct mempolicy *vm_policy;	/* NUMA policy for the VMA */
 #endif
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	seqcount_t vm_sequence;		/* Changes to the VMA while linked */
+#endif
 };
 
 struct core_thread {
@@ -310,6 +326,32 @@ struct mm_struct {
 #ifdef CONFIG_MMU_NOTIFIER
 	struct mmu_notifier_mm *mmu_notifier_mm;
 #endif
+#ifdef CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH
+	/*
+	 * Non-zero when reclaim unmapped a pte of this mm and deferred its
+	 * TLB flush: whoever changes ptes under the pte lock and relies on
+	 * pte_none() entries needing no flush must flush first, see
+	 * flush_tlb_batched_pending().
+	 */
+	atomic_t tlb_flush_batched;
+#endif
+#ifdef CONFIG_LRU_GEN
+	/* on the list of mms walked for the accessed bit, see vmscan.c */
+	struct list_head lru_gen_list;
+#endif
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	/*
+	 * Speculative page faults look up the VMA under mm_rb_lock, taken
+	 * for writing around every change to mm_rb; move_sequence covers
+	 * mremap moving page tables.  See handle_speculative_fault().
+	 */
+	rwlock_t mm_rb_lock;
+	seqcount_t move_sequence;
+#endif
+#ifdef CONFIG_FUTEX
+	/* hash table for private futexes, see kernel/futex.c */
+	struct futex_hash *futex_hash;
+#endif
 };
 
 /* Future-safe accessor for struct mm_struct's cpu_vm_mask. */
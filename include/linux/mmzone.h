@@ -155,6 +155,26 @@ static inline int is_unevictable_lru(enum lru_list l)
 	return (l == LRU_UNEVICTABLE);
 }
 
+#ifdef CONFIG_LRU_GEN
+/*
+ * The multi-generational LRU, see mm/vmscan.c.  Generations are numbered
+ * by an ever increasing sequence and kept in lists[seq % MAX_NR_GENS].
+ * Anon and file pages share max_seq, the youngest generation, but each
+ * type has its own oldest generation, min_seq.  The two youngest
+ * generations count as active in the zone statistics, the older ones as
+ * inactive; eviction keeps at least MIN_NR_GENS generations around.
+ */
+#define MIN_NR_GENS		2
+#define MAX_NR_GENS		4
+
+struct zone_lru_gen {
+	unsigned long		max_seq;
+	unsigned long		min_seq[2];	/* anon, file */
+	struct list_head	lists[MAX_NR_GENS][2];
+	unsigned long		nr_pages[MAX_NR_GENS][2];
+};
+#endif
+
 enum zone_watermarks {
 	WMARK_MIN,
 	WMARK_LOW,
@@ -345,6 +365,9 @@ struct zone {
 	struct zone_lru {
 		struct list_head list;
 	} lru[NR_LRU_LISTS];
+#ifdef CONFIG_LRU_GEN
+	struct zone_lru_gen	lrugen;
+#endif
 
 	struct zone_reclaim_stat reclaim_stat;
 
@@ -635,6 +658,11 @@ typedef struct pglist_data {
 	wait_queue_head_t kswapd_wait;
 	struct task_struct *kswapd;
 	int kswapd_max_order;
+#ifdef CONFIG_COMPACTION
+	wait_queue_head_t kcompactd_wait;
+	struct task_struct *kcompactd;
+	int kcompactd_max_order;
+#endif
 } pg_data_t;
 
 #define node_present_pages(nid)	(NODE_DATA(nid)->node_present_pages)
@@ -107,6 +107,9 @@ enum pageflags {
 #endif
 #ifdef CONFIG_MEMORY_FAILURE
 	PG_hwpoison,		/* hardware poisoned page. Don't touch */
+#endif
+#ifdef CONFIG_LRU_GEN
+	PG_young,		/* Accessed since the last aging walk */
 #endif
 	__NR_PAGEFLAGS,
 
@@ -280,6 +283,12 @@ PAGEFLAG_FALSE(HWPoison)
 #define __PG_HWPOISON 0
 #endif
 
+#ifdef CONFIG_LRU_GEN
+PAGEFLAG(Young, young) TESTCLEARFLAG(Young, young)
+#else
+PAGEFLAG_FALSE(Young) TESTCLEARFLAG_FALSE(Young)
+#endif
+
 u64 stable_page_flags(struct page *page);
 
 static inline int PageUptodate(struct page *page)
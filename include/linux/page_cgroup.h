@@ -40,7 +40,11 @@ enum {
 	PCG_USED, /* this object is in use. */
 	PCG_ACCT_LRU, /* page has been accounted for */
 	PCG_FILE_MAPPED, /* page is accounted as "mapped" */
+	PCG_FILE_DIRTY, /* page is accounted as "dirty" */
+	PCG_FILE_WRITEBACK, /* page is accounted as "writeback" */
+	PCG_FILE_UNSTABLE_NFS, /* page is accounted as "unstable NFS" */
 	PCG_MIGRATION, /* under page migration */
+	PCG_MOVE_LOCK, /* for stable pc->mem_cgroup in page stat updates */
 };
 
 #define TESTPCGFLAG(uname, lname)			\
@@ -80,6 +84,10 @@ SETPCGFLAG(FileMapped, FILE_MAPPED)
 CLEARPCGFLAG(FileMapped, FILE_MAPPED)
 TESTPCGFLAG(FileMapped, FILE_MAPPED)
 
+TESTPCGFLAG(FileDirty, FILE_DIRTY)
+TESTPCGFLAG(FileWriteback, FILE_WRITEBACK)
+TESTPCGFLAG(FileUnstableNFS, FILE_UNSTABLE_NFS)
+
 SETPCGFLAG(Migration, MIGRATION)
 CLEARPCGFLAG(Migration, MIGRATION)
 TESTPCGFLAG(Migration, MIGRATION)
@@ -104,6 +112,25 @@ static inline void unlock_page_cgroup(struct page_cgroup *pc)
 	bit_spin_unlock(PCG_LOCK, &pc->flags);
 }
 
+/*
+ * The dirty and writeback statistics are updated from interrupt context,
+ * where lock_page_cgroup() cannot be taken: this lock only keeps
+ * pc->mem_cgroup from being moved to another cgroup meanwhile.
+ */
+static inline void move_lock_page_cgroup(struct page_cgroup *pc,
+					 unsigned long *flags)
+{
+	local_irq_save(*flags);
+	bit_spin_lock(PCG_MOVE_LOCK, &pc->flags);
+}
+
+static inline void move_unlock_page_cgroup(struct page_cgroup *pc,
+					   unsigned long *flags)
+{
+	bit_spin_unlock(PCG_MOVE_LOCK, &pc->flags);
+	local_irq_restore(*flags);
+}
+
 #else /* CONFIG_CGROUP_MEM_RES_CTLR */
 struct page_cgroup;
 
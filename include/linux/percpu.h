@@ -630,4 +630,33 @@ do {									\
 # define irqsafe_cpu_xor(pcp, val) __pcpu_size_call(irqsafe_cpu_xor_, (val))
 #endif
 
+/*
+ * irqsafe_cpu_cmpxchg_double replaces two adjacent, word sized per cpu
+ * variables at once if both still hold the expected values, and returns
+ * whether it did. Architectures that can do this without disabling
+ * interrupts (and which then usually need the pair aligned to twice the
+ * word size) define their own version.
+ */
+#define irqsafe_generic_cpu_cmpxchg_double(pcp1, pcp2, oval1, oval2,	\
+					   nval1, nval2)		\
+({									\
+	int __ret = 0;							\
+	unsigned long __flags;						\
+	local_irq_save(__flags);					\
+	if (*__this_cpu_ptr(&(pcp1)) == (oval1) &&			\
+	    *__this_cpu_ptr(&(pcp2)) == (oval2)) {			\
+		*__this_cpu_ptr(&(pcp1)) = (nval1);			\
+		*__this_cpu_ptr(&(pcp2)) = (nval2);			\
+		__ret = 1;						\
+	}								\
+	local_irq_restore(__flags);					\
+	__ret;								\
+})
+
+#ifndef irqsafe_cpu_cmpxchg_double
+# define irqsafe_cpu_cmpxchg_double(pcp1, pcp2, oval1, oval2, nval1, nval2) \
+	irqsafe_generic_cpu_cmpxchg_double((pcp1), (pcp2), (oval1), (oval2), \
+					   (nval1), (nval2))
+#endif
+
 #endif /* __LINUX_PERCPU_H */
@@ -22,6 +22,14 @@ struct rw_semaphore;
 #include <asm/rwsem.h> /* use an arch-specific implementation */
 #endif
 
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+/*
+ * ->owner of a read locked rwsem. Readers don't clear it on release, so
+ * it only says that the last owner was a reader.
+ */
+#define RWSEM_READER_OWNED	((struct thread_info *)1UL)
+#endif
+
 /*
  * lock for reading
  */
@@ -310,6 +310,36 @@ static inline int unregister_pm_notifier(struct notifier_block *nb)
 #define pm_notifier(fn, pri)	do { (void)(fn); } while (0)
 #endif /* !CONFIG_PM_SLEEP */
 
+/* kernel/power/profile.c */
+enum {
+	PM_PROFILE_EARLY_SUSPEND,
+	PM_PROFILE_DEVICES,
+	PM_PROFILE_NR
+};
+
+#ifdef CONFIG_PM_SLEEP_PROFILE
+static inline ktime_t pm_profile_start(void)
+{
+	return ktime_get();
+}
+
+extern void pm_profile_begin(int log);
+extern void pm_profile_record(int log, const char *name, const char *info,
+			      const char *verb, ktime_t calltime, int error);
+extern void pm_profile_record_fn(int log, void *fn, const char *info,
+				 const char *verb, ktime_t calltime,
+				 int error);
+#else /* !CONFIG_PM_SLEEP_PROFILE */
+static inline ktime_t pm_profile_start(void) { return ktime_set(0, 0); }
+static inline void pm_profile_begin(int log) {}
+static inline void pm_profile_record(int log, const char *name,
+				     const char *info, const char *verb,
+				     ktime_t calltime, int error) {}
+static inline void pm_profile_record_fn(int log, void *fn, const char *info,
+					const char *verb, ktime_t calltime,
+					int error) {}
+#endif /* !CONFIG_PM_SLEEP_PROFILE */
+
 extern struct mutex pm_mutex;
 
 #ifndef CONFIG_HIBERNATION
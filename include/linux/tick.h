@@ -45,6 +45,11 @@ enum tick_nohz_mode {
  * @iowait_sleeptime:	Sum of the time slept in idle with sched tick stopped, with IO outstanding
  * @sleep_length:	Duration of the current idle sleep
  * @do_timer_lst:	CPU was the last one doing do_timer before going idle
+ * @idle_batched:	Idle sleeps with RCU callbacks pending, see nohz_batch=
+ * @wakeups_avoided:	Ticks slept through in those, each one also delaying
+ *			the RCU callbacks of this CPU
+ * @batch_jiffies:	jiffies when the current batched sleep started
+ * @batch_active:	CPU is in a batched sleep
  */
 struct tick_sched {
 	struct hrtimer			sched_timer;
@@ -67,6 +72,10 @@ struct tick_sched {
 	unsigned long			next_jiffies;
 	ktime_t				idle_expires;
 	int				do_timer_last;
+	unsigned long			idle_batched;
+	unsigned long			wakeups_avoided;
+	unsigned long			batch_jiffies;
+	int				batch_active;
 };
 
 extern void __init tick_init(void);
@@ -36,6 +36,8 @@ struct writeback_control {
 	long nr_to_write;		/* Write this many pages, and decrement
 					   this for each page written */
 	long pages_skipped;		/* Pages which were not written */
+	unsigned short memcg_id;	/* If non-zero, only write back inodes
+					   dirtied by this memory cgroup */
 
 	/*
 	 * For a_ops->writepages(): is start or end are non-zero then this is
@@ -66,6 +68,7 @@ void writeback_inodes_wb(struct bdi_writeback *wb,
 		struct writeback_control *wbc);
 long wb_do_writeback(struct bdi_writeback *wb, int force_wait);
 void wakeup_flusher_threads(long nr_pages);
+void wakeup_memcg_flusher_threads(unsigned short memcg_id);
 
 /* writeback.h requires fs.h; it, too, is not included from here. */
 static inline void wait_on_inode(struct inode *inode)
@@ -70,6 +70,34 @@ TRACE_EVENT(power_end,
 
 );
 
+TRACE_EVENT(pm_callback,
+
+	TP_PROTO(const char *name, const char *info, const char *verb,
+		 s64 usecs, int error),
+
+	TP_ARGS(name, info, verb, usecs, error),
+
+	TP_STRUCT__entry(
+		__string(	name,		name		)
+		__string(	info,		info		)
+		__string(	verb,		verb		)
+		__field(	s64,		usecs		)
+		__field(	int,		error		)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__assign_str(info, info);
+		__assign_str(verb, verb);
+		__entry->usecs = usecs;
+		__entry->error = error;
+	),
+
+	TP_printk("%s %s%s usecs=%lld error=%d", __get_str(name),
+		__get_str(info), __get_str(verb),
+		(long long)__entry->usecs, __entry->error)
+);
+
 #endif /* _TRACE_POWER_H */
 
 /* This part must be outside protection */
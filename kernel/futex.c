@@ -49,6 +49,7 @@
 #include <linux/fs.h>
 #include <linux/file.h>
 #include <linux/jhash.h>
+#include <linux/log2.h>
 #include <linux/init.h>
 #include <linux/futex.h>
 #include <linux/mount.h>
@@ -132,17 +133,230 @@ struct futex_hash_bucket {
 	struct plist_head chain;
 };
 
+/*
+ * A hash table of futex_hash_buckets. Shared futexes, and the private
+ * futexes of processes that could not get a table of their own, live in
+ * futex_global. Every other process gets a private table, sized by its
+ * thread count, the first time it uses a private futex, so that unrelated
+ * processes do not contend on the same bucket locks. The private table is
+ * replaced by a bigger one when the process grows more threads.
+ */
+struct futex_hash {
+	unsigned int mask;
+	struct futex_hash_bucket *buckets;
+	struct futex_hash *prev;	/* the table this one replaced */
+};
+
 static struct futex_hash_bucket futex_queues[1<<FUTEX_HASHBITS];
 
+static struct futex_hash futex_global = {
+	.mask		= (1 << FUTEX_HASHBITS) - 1,
+	.buckets	= futex_queues,
+};
+
+/* Serializes the private table replacements, see futex_private_hash_grow() */
+static DEFINE_MUTEX(futex_grow_mutex);
+
+static void futex_hash_init(struct futex_hash *fh, unsigned int size)
+{
+	unsigned int i;
+
+	fh->mask = size - 1;
+	fh->prev = NULL;
+	for (i = 0; i < size; i++) {
+		plist_head_init(&fh->buckets[i].chain, &fh->buckets[i].lock);
+		spin_lock_init(&fh->buckets[i].lock);
+	}
+}
+
+static u32 futex_key_hash(union futex_key *key)
+{
+	return jhash2((u32*)&key->both.word,
+		      (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
+		      key->both.offset);
+}
+
+/*
+ * Pick the table for the private futexes of @mm. Once set, mm->futex_hash
+ * is either &futex_global for good, or a private table, which may only be
+ * replaced by a bigger private table. A bucket found in a replaced table
+ * has to be looked up again once its lock is held, see lock_hash_futex().
+ */
+static struct futex_hash *futex_private_hash(struct mm_struct *mm)
+{
+	struct futex_hash *fh = ACCESS_ONCE(mm->futex_hash);
+
+	if (likely(fh))
+		return fh;
+
+	fh = cmpxchg(&mm->futex_hash, NULL, &futex_global);
+	return fh ? fh : &futex_global;
+}
+
+/*
+ * A private table gets 4 buckets per thread, or per online cpu if there are
+ * fewer threads than cpus, capped at the size of the global table.
+ */
+static struct futex_hash *futex_private_hash_new(struct mm_struct *mm)
+{
+	struct futex_hash *fh;
+	unsigned int size;
+
+	size = max_t(unsigned int, atomic_read(&mm->mm_users),
+		     num_online_cpus());
+	size = roundup_pow_of_two(4 * size);
+	size = clamp_t(unsigned int, size, 16, 1 << FUTEX_HASHBITS);
+
+	fh = kmalloc(sizeof(*fh) + size * sizeof(struct futex_hash_bucket),
+		     GFP_KERNEL);
+	if (fh) {
+		fh->buckets = (struct futex_hash_bucket *)(fh + 1);
+		futex_hash_init(fh, size);
+	}
+	return fh;
+}
+
+/*
+ * Allocate a private table for @mm, called before the first private futex
+ * of the process is hashed. Falls back to the global table if we are out
+ * of memory.
+ */
+static void futex_private_hash_alloc(struct mm_struct *mm)
+{
+	struct futex_hash *fh;
+
+	fh = futex_private_hash_new(mm);
+	if (!fh) {
+		futex_private_hash(mm);
+		return;
+	}
+
+	if (cmpxchg(&mm->futex_hash, NULL, fh))
+		kfree(fh);
+}
+
+static inline int futex_private_hash_small(struct mm_struct *mm)
+{
+	struct futex_hash *fh = ACCESS_ONCE(mm->futex_hash);
+
+	return fh != &futex_global && fh->mask < (1 << FUTEX_HASHBITS) - 1 &&
+	       4 * atomic_read(&mm->mm_users) > fh->mask + 1;
+}
+
+/*
+ * Replace the private table of @mm by a bigger one once it has more than a
+ * thread per 4 buckets. All the waiters are moved over with every bucket
+ * lock of the old table held, and the new table is published before those
+ * locks are dropped, so whoever gets one of them next finds out that the
+ * table changed. The old table is only freed with the mm, others may still
+ * be about to take its locks. As the old table has at most half the size
+ * of the global one, all its locks fit in the preempt count.
+ */
+static void futex_private_hash_grow(struct mm_struct *mm)
+{
+	struct futex_hash *old, *fh;
+	struct futex_hash_bucket *hb;
+	struct futex_q *this, *next;
+	unsigned int i, hash;
+
+	fh = futex_private_hash_new(mm);
+	if (!fh)
+		return;
+
+	mutex_lock(&futex_grow_mutex);
+	old = mm->futex_hash;
+	if (fh->mask <= old->mask) {
+		mutex_unlock(&futex_grow_mutex);
+		kfree(fh);
+		return;
+	}
+
+	for (i = 0; i <= old->mask; i++)
+		spin_lock_nest_lock(&old->buckets[i].lock, &futex_grow_mutex);
+
+	for (i = 0; i <= old->mask; i++) {
+		plist_for_each_entry_safe(this, next, &old->buckets[i].chain,
+					  list) {
+			hash = futex_key_hash(&this->key);
+			hb = &fh->buckets[hash & fh->mask];
+			spin_lock_nest_lock(&hb->lock, &futex_grow_mutex);
+			plist_del(&this->list, &old->buckets[i].chain);
+			plist_add(&this->list, &hb->chain);
+			this->lock_ptr = &hb->lock;
+#ifdef CONFIG_DEBUG_PI_LIST
+			this->list.plist.spinlock = &hb->lock;
+#endif
+			spin_unlock(&hb->lock);
+		}
+	}
+
+	fh->prev = old;
+	smp_wmb();
+	mm->futex_hash = fh;
+
+	for (i = 0; i <= old->mask; i++)
+		spin_unlock(&old->buckets[i].lock);
+	mutex_unlock(&futex_grow_mutex);
+}
+
+void futex_mm_release(struct mm_struct *mm)
+{
+	struct futex_hash *fh = mm->futex_hash, *prev;
+
+	if (fh != &futex_global) {
+		while (fh) {
+			prev = fh->prev;
+			kfree(fh);
+			fh = prev;
+		}
+	}
+	mm->futex_hash = NULL;
+}
+
+static struct futex_hash *futex_key_table(union futex_key *key)
+{
+	if (!(key->both.offset & (FUT_OFF_INODE|FUT_OFF_MMSHARED)) &&
+	    key->private.mm)
+		return futex_private_hash(key->private.mm);
+	return &futex_global;
+}
+
 /*
  * We hash on the keys returned from get_futex_key (see below).
  */
 static struct futex_hash_bucket *hash_futex(union futex_key *key)
 {
-	u32 hash = jhash2((u32*)&key->both.word,
-			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
-			  key->both.offset);
-	return &futex_queues[hash & ((1 << FUTEX_HASHBITS)-1)];
+	struct futex_hash *fh = futex_key_table(key);
+
+	return &fh->buckets[futex_key_hash(key) & fh->mask];
+}
+
+/*
+ * With the lock of @hb held, its table cannot be replaced anymore: check
+ * that it had not been replaced before we got the lock.
+ */
+static inline int hash_futex_current(union futex_key *key,
+				     struct futex_hash_bucket *hb)
+{
+	struct futex_hash *fh = futex_key_table(key);
+
+	return hb >= fh->buckets && hb <= fh->buckets + fh->mask;
+}
+
+/*
+ * Look up and lock the hash bucket of @key.
+ */
+static struct futex_hash_bucket *lock_hash_futex(union futex_key *key)
+{
+	struct futex_hash_bucket *hb;
+
+	for (;;) {
+		hb = hash_futex(key);
+		spin_lock(&hb->lock);
+		if (likely(hash_futex_current(key, hb)))
+			return hb;
+		spin_unlock(&hb->lock);
+	}
 }
 
 /*
@@ -242,6 +456,10 @@ get_futex_key(u32 __user *uaddr, int fshared, union futex_key *key)
 		key->private.mm = mm;
 		key->private.address = address;
 		get_futex_key_refs(key);
+		if (unlikely(mm && !mm->futex_hash))
+			futex_private_hash_alloc(mm);
+		else if (unlikely(mm && futex_private_hash_small(mm)))
+			futex_private_hash_grow(mm);
 		return 0;
 	}
 
@@ -465,10 +683,9 @@ void exit_pi_state_list(struct task_struct *curr)
 		next = head->next;
 		pi_state = list_entry(next, struct futex_pi_state, list);
 		key = pi_state->key;
-		hb = hash_futex(&key);
 		raw_spin_unlock_irq(&curr->pi_lock);
 
-		spin_lock(&hb->lock);
+		hb = lock_hash_futex(&key);
 
 		raw_spin_lock_irq(&curr->pi_lock);
 		/*
@@ -866,6 +1083,26 @@ double_unlock_hb(struct futex_hash_bucket *hb1, struct futex_hash_bucket *hb2)
 		spin_unlock(&hb2->lock);
 }
 
+/*
+ * Look up and lock the hash buckets of @key1 and @key2, see
+ * lock_hash_futex().
+ */
+static void double_lock_hash_futex(union futex_key *key1,
+				   union futex_key *key2,
+				   struct futex_hash_bucket **hb1,
+				   struct futex_hash_bucket **hb2)
+{
+	for (;;) {
+		*hb1 = hash_futex(key1);
+		*hb2 = hash_futex(key2);
+		double_lock_hb(*hb1, *hb2);
+		if (likely(hash_futex_current(key1, *hb1) &&
+			   hash_futex_current(key2, *hb2)))
+			return;
+		double_unlock_hb(*hb1, *hb2);
+	}
+}
+
 /*
  * Wake up waiters matching bitset queued on this futex (uaddr).
  */
@@ -884,8 +1121,7 @@ static int futex_wake(u32 __user *uaddr, int fshared, int nr_wake, u32 bitset)
 	if (unlikely(ret != 0))
 		goto out;
 
-	hb = hash_futex(&key);
-	spin_lock(&hb->lock);
+	hb = lock_hash_futex(&key);
 	head = &hb->chain;
 
 	plist_for_each_entry_safe(this, next, head, list) {
@@ -933,11 +1169,8 @@ retry:
 	if (unlikely(ret != 0))
 		goto out_put_key1;
 
-	hb1 = hash_futex(&key1);
-	hb2 = hash_futex(&key2);
-
 retry_private:
-	double_lock_hb(hb1, hb2);
+	double_lock_hash_futex(&key1, &key2, &hb1, &hb2);
 	op_ret = futex_atomic_op_inuser(op, uaddr2);
 	if (unlikely(op_ret < 0)) {
 
@@ -1195,11 +1428,8 @@ retry:
 	if (unlikely(ret != 0))
 		goto out_put_key1;
 
-	hb1 = hash_futex(&key1);
-	hb2 = hash_futex(&key2);
-
 retry_private:
-	double_lock_hb(hb1, hb2);
+	double_lock_hash_futex(&key1, &key2, &hb1, &hb2);
 
 	if (likely(cmpval != NULL)) {
 		u32 curval;
@@ -1363,10 +1593,8 @@ static inline struct futex_hash_bucket *queue_lock(struct futex_q *q)
 {
 	struct futex_hash_bucket *hb;
 
-	hb = hash_futex(&q->key);
+	hb = lock_hash_futex(&q->key);
 	q->lock_ptr = &hb->lock;
-
-	spin_lock(&hb->lock);
 	return hb;
 }
 
@@ -1881,6 +2109,242 @@ static long futex_wait_restart(struct restart_block *restart)
 				restart->futex.flags & FLAGS_CLOCKRT);
 }
 
+/*
+ * One entry of a FUTEX_WAITV call: the user supplied description of the
+ * futex and the futex_q that gets queued on it. All the futex_qs of a call
+ * share the same task, so a wakeup on any one of them wakes the waiter.
+ */
+struct futex_vector {
+	struct futex_waitv w;
+	struct futex_q q;
+};
+
+/**
+ * unqueue_multiple() - Remove the futex_qs of a FUTEX_WAITV call
+ * @vs:		the futex vector
+ * @count:	number of queued entries, from the start of @vs
+ *
+ * Drops the key references of the @count entries.
+ *
+ * Returns:
+ *  the index of the last entry that had already been woken, or -1
+ */
+static int unqueue_multiple(struct futex_vector *vs, int count)
+{
+	int ret = -1, i;
+
+	for (i = 0; i < count; i++) {
+		if (!unqueue_me(&vs[i].q))
+			ret = i;
+	}
+	return ret;
+}
+
+static void put_multiple_keys(struct futex_vector *vs, int from, int to)
+{
+	int i;
+
+	for (i = from; i < to; i++)
+		put_futex_key(!(vs[i].w.flags & FUTEX_PRIVATE_FLAG),
+			      &vs[i].q.key);
+}
+
+/**
+ * futex_wait_multiple_setup() - Queue a waiter on every futex of the vector
+ * @vs:		the futex vector
+ * @count:	number of entries in @vs
+ * @woken:	index of the woken futex, if one fired during the setup
+ *
+ * The keys are all looked up first, because get_futex_key() may sleep and
+ * the task state has to be TASK_INTERRUPTIBLE before the first futex_q is
+ * queued, or a wakeup could be lost. Then each hash bucket is locked in
+ * turn, the value checked and the futex_q queued, which drops the bucket
+ * lock again before the next one is taken.
+ *
+ * Returns:
+ *  0 - all the futex_qs are queued and hold a key reference, current is
+ *      TASK_INTERRUPTIBLE
+ *  1 - a futex was woken while the others were queued, its index is in
+ *      @woken
+ * <0 - -EFAULT, -EWOULDBLOCK (a futex does not contain its value) or
+ *      -EINVAL
+ * Nothing is queued and no key reference is held on a non-zero return.
+ */
+static int futex_wait_multiple_setup(struct futex_vector *vs, int count,
+				     int *woken)
+{
+	struct futex_hash_bucket *hb;
+	u32 __user *uaddr;
+	int ret, i;
+	u32 uval;
+
+retry:
+	for (i = 0; i < count; i++) {
+		uaddr = (u32 __user *)(unsigned long)vs[i].w.uaddr;
+		vs[i].q.key = FUTEX_KEY_INIT;
+		ret = get_futex_key(uaddr, !(vs[i].w.flags & FUTEX_PRIVATE_FLAG),
+				    &vs[i].q.key);
+		if (unlikely(ret)) {
+			put_multiple_keys(vs, 0, i);
+			return ret;
+		}
+	}
+
+	set_current_state(TASK_INTERRUPTIBLE);
+
+	for (i = 0; i < count; i++) {
+		struct futex_q *q = &vs[i].q;
+		u32 val = (u32)vs[i].w.val;
+
+		uaddr = (u32 __user *)(unsigned long)vs[i].w.uaddr;
+
+		hb = queue_lock(q);
+		ret = get_futex_value_locked(&uval, uaddr);
+		if (!ret && uval == val) {
+			queue_me(q, hb);
+			continue;
+		}
+
+		queue_unlock(q, hb);
+		__set_current_state(TASK_RUNNING);
+
+		/*
+		 * Undo what is queued so far. If one of those has been
+		 * woken in the meantime, report it rather than the error.
+		 */
+		*woken = unqueue_multiple(vs, i);
+		put_multiple_keys(vs, i, count);
+		if (*woken >= 0)
+			return 1;
+
+		if (ret) {
+			/*
+			 * The page has to be faulted in without any bucket
+			 * locked and nothing queued, so that no wakeup can be
+			 * missed. Then start over from the key lookup.
+			 */
+			if (get_user(uval, uaddr))
+				return -EFAULT;
+			goto retry;
+		}
+		return -EWOULDBLOCK;
+	}
+
+	return 0;
+}
+
+static int futex_wait_multiple(struct futex_vector *vs, int count,
+			       ktime_t *abs_time, int clockrt)
+{
+	struct hrtimer_sleeper timeout, *to = NULL;
+	int ret, woken = -1, i;
+
+	if (abs_time) {
+		to = &timeout;
+
+		hrtimer_init_on_stack(&to->timer, clockrt ? CLOCK_REALTIME :
+				      CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+		hrtimer_init_sleeper(to, current);
+		hrtimer_set_expires_range_ns(&to->timer, *abs_time,
+					     current->timer_slack_ns);
+		hrtimer_start_expires(&to->timer, HRTIMER_MODE_ABS);
+		if (!hrtimer_active(&to->timer))
+			to->task = NULL;
+	}
+
+	for (;;) {
+		ret = futex_wait_multiple_setup(vs, count, &woken);
+		if (ret) {
+			if (ret > 0)
+				ret = woken;
+			break;
+		}
+
+		/*
+		 * Only sleep if nobody has woken us while we were queueing,
+		 * and if the timer has not expired yet.
+		 */
+		for (i = 0; i < count; i++)
+			if (!vs[i].q.lock_ptr)
+				break;
+		if (i == count && (!to || to->task))
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		/* unqueue_multiple() drops the key references */
+		ret = unqueue_multiple(vs, count);
+		if (ret >= 0)
+			break;
+
+		ret = -ETIMEDOUT;
+		if (to && !to->task)
+			break;
+
+		/*
+		 * The timeout is absolute, so a restart after a signal
+		 * waits for the same deadline: no restart block needed.
+		 */
+		ret = -ERESTARTSYS;
+		if (signal_pending(current))
+			break;
+
+		/* spurious wakeup, queue again */
+	}
+
+	if (to) {
+		hrtimer_cancel(&to->timer);
+		destroy_hrtimer_on_stack(&to->timer);
+	}
+	return ret;
+}
+
+/*
+ * FUTEX_WAITV: uaddr is the user array of struct futex_waitv, nr the number
+ * of entries in it. See include/linux/futex.h for the ABI.
+ */
+static int futex_waitv(void __user *uaddr, unsigned int nr,
+		       ktime_t *abs_time, int clockrt)
+{
+	struct futex_vector *vs;
+	unsigned int i;
+	int ret;
+
+	if (!nr || nr > FUTEX_WAITV_MAX)
+		return -EINVAL;
+
+	vs = kcalloc(nr, sizeof(*vs), GFP_KERNEL);
+	if (!vs)
+		return -ENOMEM;
+
+	ret = -EFAULT;
+	for (i = 0; i < nr; i++) {
+		if (copy_from_user(&vs[i].w, uaddr + i * sizeof(vs[i].w),
+				   sizeof(vs[i].w)))
+			goto out;
+	}
+
+	ret = -EINVAL;
+	for (i = 0; i < nr; i++) {
+		struct futex_waitv *w = &vs[i].w;
+
+		if ((w->flags & ~FUTEX_PRIVATE_FLAG) || w->__reserved)
+			goto out;
+		if ((unsigned long)w->uaddr != w->uaddr ||
+		    w->uaddr % sizeof(u32))
+			goto out;
+
+		vs[i].q.bitset = FUTEX_BITSET_MATCH_ANY;
+		vs[i].q.pi_state = NULL;
+		vs[i].q.rt_waiter = NULL;
+		vs[i].q.requeue_pi_key = NULL;
+	}
+
+	ret = futex_wait_multiple(vs, nr, abs_time, clockrt);
+out:
+	kfree(vs);
+	return ret;
+}
+
 
 /*
  * Userspace tried a 0 -> TID atomic transition of the futex value
@@ -2035,8 +2499,7 @@ retry:
 	if (unlikely(ret != 0))
 		goto out;
 
-	hb = hash_futex(&key);
-	spin_lock(&hb->lock);
+	hb = lock_hash_futex(&key);
 
 	/*
 	 * To avoid races, try to do the TID -> 0 atomic transition
@@ -2199,7 +2662,7 @@ static int futex_wait_requeue_pi(u32 __user *uaddr, int fshared,
 	struct rt_mutex_waiter rt_waiter;
 	struct rt_mutex *pi_mutex = NULL;
 	struct futex_hash_bucket *hb;
-	union futex_key key2;
+	union futex_key key1, key2;
 	struct futex_q q;
 	int res, ret;
 
@@ -2240,10 +2703,16 @@ static int futex_wait_requeue_pi(u32 __user *uaddr, int fshared,
 	if (ret)
 		goto out_key2;
 
+	/*
+	 * The requeue code changes q.key, and the table of key1 may have
+	 * grown while we slept: keep key1 to find its bucket again.
+	 */
+	key1 = q.key;
+
 	/* Queue the futex_q, drop the hb lock, wait for wakeup. */
 	futex_wait_queue_me(hb, &q, to);
 
-	spin_lock(&hb->lock);
+	hb = lock_hash_futex(&key1);
 	ret = handle_early_requeue_pi_wakeup(hb, &q, &key2, to);
 	spin_unlock(&hb->lock);
 	if (ret)
@@ -2551,7 +3020,8 @@ long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 		fshared = 1;
 
 	clockrt = op & FUTEX_CLOCK_REALTIME;
-	if (clockrt && cmd != FUTEX_WAIT_BITSET && cmd != FUTEX_WAIT_REQUEUE_PI)
+	if (clockrt && cmd != FUTEX_WAIT_BITSET &&
+	    cmd != FUTEX_WAIT_REQUEUE_PI && cmd != FUTEX_WAITV)
 		return -ENOSYS;
 
 	switch (cmd) {
@@ -2596,6 +3066,9 @@ long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 		ret = futex_requeue(uaddr, fshared, uaddr2, val, val2, &val3,
 				    1);
 		break;
+	case FUTEX_WAITV:
+		ret = futex_waitv((void __user *)uaddr, val, timeout, clockrt);
+		break;
 	default:
 		ret = -ENOSYS;
 	}
@@ -2614,7 +3087,7 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 
 	if (utime && (cmd == FUTEX_WAIT || cmd == FUTEX_LOCK_PI ||
 		      cmd == FUTEX_WAIT_BITSET ||
-		      cmd == FUTEX_WAIT_REQUEUE_PI)) {
+		      cmd == FUTEX_WAIT_REQUEUE_PI || cmd == FUTEX_WAITV)) {
 		if (copy_from_user(&ts, utime, sizeof(ts)) != 0)
 			return -EFAULT;
 		if (!timespec_valid(&ts))
@@ -2639,7 +3112,6 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 static int __init futex_init(void)
 {
 	u32 curval;
-	int i;
 
 	/*
 	 * This will fail and we want it. Some arch implementations do
@@ -2655,10 +3127,7 @@ static int __init futex_init(void)
 	if (curval == -EFAULT)
 		futex_cmpxchg_enabled = 1;
 
-	for (i = 0; i < ARRAY_SIZE(futex_queues); i++) {
-		plist_head_init(&futex_queues[i].chain, &futex_queues[i].lock);
-		spin_lock_init(&futex_queues[i].lock);
-	}
+	futex_hash_init(&futex_global, ARRAY_SIZE(futex_queues));
 
 	return 0;
 }
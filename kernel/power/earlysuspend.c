@@ -13,10 +13,12 @@
  *
  */
 
+#include <linux/async.h>
 #include <linux/earlysuspend.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
+#include <linux/suspend.h>
 #include <linux/syscalls.h> /* sys_sync */
 #include <linux/wakelock.h>
 #include <linux/workqueue.h>
@@ -29,9 +31,12 @@ enum {
 };
 static int debug_mask = DEBUG_USER_STATE;
 module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
+static int async_handlers = 1;
+module_param_named(async, async_handlers, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
 static DEFINE_MUTEX(early_suspend_lock);
 static LIST_HEAD(early_suspend_handlers);
+static LIST_HEAD(early_suspend_domain);
 static void early_suspend(struct work_struct *work);
 static void late_resume(struct work_struct *work);
 static DECLARE_WORK(early_suspend_work, early_suspend);
@@ -70,10 +75,51 @@ void unregister_early_suspend(struct early_suspend *handler)
 }
 EXPORT_SYMBOL(unregister_early_suspend);
 
+static void early_suspend_call(void *data, async_cookie_t cookie)
+{
+	struct early_suspend *pos = data;
+	ktime_t calltime = pm_profile_start();
+
+	pos->suspend(pos);
+	pm_profile_record_fn(PM_PROFILE_EARLY_SUSPEND, pos->suspend,
+			     "early ", "suspend", calltime, 0);
+}
+
+static void late_resume_call(void *data, async_cookie_t cookie)
+{
+	struct early_suspend *pos = data;
+	ktime_t calltime = pm_profile_start();
+
+	pos->resume(pos);
+	pm_profile_record_fn(PM_PROFILE_EARLY_SUSPEND, pos->resume,
+			     "late ", "resume", calltime, 0);
+}
+
+/* Handlers of the same level run concurrently on the early suspend async
+ * domain.  A level is only started once every handler of the previous
+ * level has returned, so the order between levels is kept.  Must be
+ * called with early_suspend_lock held, and followed by
+ * async_synchronize_full_domain(&early_suspend_domain). */
+static void early_suspend_schedule(struct early_suspend *pos, int *level,
+				   async_func_ptr *func)
+{
+	if (!async_handlers) {
+		func(pos, 0);
+		return;
+	}
+
+	if (pos->level != *level) {
+		async_synchronize_full_domain(&early_suspend_domain);
+		*level = pos->level;
+	}
+	async_schedule_domain(func, pos, &early_suspend_domain);
+}
+
 static void early_suspend(struct work_struct *work)
 {
 	struct early_suspend *pos;
 	unsigned long irqflags;
+	int level = INT_MIN;
 	int abort = 0;
 
 	mutex_lock(&early_suspend_lock);
@@ -93,10 +139,12 @@ static void early_suspend(struct work_struct *work)
 
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("early_suspend: call handlers\n");
+	pm_profile_begin(PM_PROFILE_EARLY_SUSPEND);
 	list_for_each_entry(pos, &early_suspend_handlers, link) {
 		if (pos->suspend != NULL)
-			pos->suspend(pos);
+			early_suspend_schedule(pos, &level, early_suspend_call);
 	}
+	async_synchronize_full_domain(&early_suspend_domain);
 	mutex_unlock(&early_suspend_lock);
 
 	if (debug_mask & DEBUG_SUSPEND)
@@ -114,6 +162,7 @@ static void late_resume(struct work_struct *work)
 {
 	struct early_suspend *pos;
 	unsigned long irqflags;
+	int level = INT_MIN;
 	int abort = 0;
 
 	mutex_lock(&early_suspend_lock);
@@ -131,9 +180,11 @@ static void late_resume(struct work_struct *work)
 	}
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: call handlers\n");
-	list_for_each_entry_reverse(pos, &early_suspend_handlers, link)
+	list_for_each_entry_reverse(pos, &early_suspend_handlers, link) {
 		if (pos->resume != NULL)
-			pos->resume(pos);
+			early_suspend_schedule(pos, &level, late_resume_call);
+	}
+	async_synchronize_full_domain(&early_suspend_domain);
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: done\n");
 abort:
@@ -0,0 +1,177 @@
+/*
+ * kernel/power/profile.c - Suspend and resume latency profiling.
+ *
+ * This file is released under the GPLv2.
+ *
+ * Records how long each early suspend handler and each device PM callback
+ * took during the last suspend/resume cycle, so slow drivers can be found
+ * without rebuilding with initcall_debug.  The early suspend log is
+ * restarted when the screen goes off, the device log when devices start
+ * being prepared for a system transition.  Both are shown in
+ * /sys/kernel/debug/suspend_profile, and every record is also emitted as
+ * a pm_callback trace event.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/init.h>
+#include <linux/kallsyms.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/suspend.h>
+#include <trace/events/power.h>
+
+#define PM_PROFILE_ENTRIES	256
+#define PM_PROFILE_NAME_LEN	32
+
+struct pm_profile_entry {
+	char name[PM_PROFILE_NAME_LEN];
+	const char *info;
+	const char *verb;
+	s64 start_us;
+	s64 usecs;
+	int error;
+};
+
+struct pm_profile_log {
+	const char *title;
+	ktime_t begin;
+	unsigned int count;
+	unsigned int dropped;
+	struct pm_profile_entry entries[PM_PROFILE_ENTRIES];
+};
+
+static DEFINE_SPINLOCK(pm_profile_lock);
+static struct pm_profile_log pm_profile_logs[PM_PROFILE_NR] = {
+	[PM_PROFILE_EARLY_SUSPEND] = { .title = "early suspend/late resume" },
+	[PM_PROFILE_DEVICES] = { .title = "devices" },
+};
+
+/**
+ * pm_profile_begin - Start a new profiling cycle.
+ * @log: Log to restart, PM_PROFILE_EARLY_SUSPEND or PM_PROFILE_DEVICES.
+ */
+void pm_profile_begin(int log)
+{
+	struct pm_profile_log *l = &pm_profile_logs[log];
+	unsigned long flags;
+
+	spin_lock_irqsave(&pm_profile_lock, flags);
+	l->begin = ktime_get();
+	l->count = 0;
+	l->dropped = 0;
+	spin_unlock_irqrestore(&pm_profile_lock, flags);
+}
+
+/**
+ * pm_profile_record - Record a completed suspend or resume callback.
+ * @log: Log to add the record to.
+ * @name: Device or handler the callback was run for.
+ * @info: Phase prefix, e.g. "early " or "legacy ", may be empty.
+ * @verb: Transition, e.g. "suspend" or "resume".
+ * @calltime: Time the callback was started, from pm_profile_start().
+ * @error: Value returned by the callback.
+ *
+ * May be called concurrently for devices that suspend and resume
+ * asynchronously, and with interrupts disabled for "noirq" callbacks.
+ */
+void pm_profile_record(int log, const char *name, const char *info,
+		       const char *verb, ktime_t calltime, int error)
+{
+	struct pm_profile_log *l = &pm_profile_logs[log];
+	struct pm_profile_entry *e;
+	unsigned long flags;
+	ktime_t rettime = ktime_get();
+	s64 usecs = ktime_to_us(ktime_sub(rettime, calltime));
+
+	trace_pm_callback(name, info, verb, usecs, error);
+
+	spin_lock_irqsave(&pm_profile_lock, flags);
+	if (l->count == PM_PROFILE_ENTRIES) {
+		l->dropped++;
+		goto out;
+	}
+
+	e = &l->entries[l->count++];
+	strlcpy(e->name, name, sizeof(e->name));
+	e->info = info;
+	e->verb = verb;
+	e->start_us = ktime_to_us(ktime_sub(calltime, l->begin));
+	e->usecs = usecs;
+	e->error = error;
+out:
+	spin_unlock_irqrestore(&pm_profile_lock, flags);
+}
+
+/**
+ * pm_profile_record_fn - Record a callback that is named by its function.
+ * @fn: Callback that was run, its symbol name is used for the record.
+ *
+ * See pm_profile_record() for the other arguments.
+ */
+void pm_profile_record_fn(int log, void *fn, const char *info,
+			  const char *verb, ktime_t calltime, int error)
+{
+	char name[KSYM_SYMBOL_LEN];
+
+	snprintf(name, sizeof(name), "%pf", fn);
+	pm_profile_record(log, name, info, verb, calltime, error);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int pm_profile_show(struct seq_file *s, void *data)
+{
+	struct pm_profile_log *l;
+	struct pm_profile_entry *e;
+	unsigned long flags;
+	s64 total;
+	int i;
+	int j;
+
+	spin_lock_irqsave(&pm_profile_lock, flags);
+
+	for (i = 0; i < PM_PROFILE_NR; i++) {
+		l = &pm_profile_logs[i];
+		total = 0;
+
+		seq_printf(s, "%s:\n", l->title);
+		seq_printf(s, "  %10s %10s %5s  %-14s %s\n",
+			   "start(us)", "time(us)", "error", "phase", "name");
+		for (j = 0; j < l->count; j++) {
+			e = &l->entries[j];
+			seq_printf(s, "  %10lld %10lld %5d  %s%-*s %s\n",
+				   e->start_us, e->usecs, e->error, e->info,
+				   14 - (int)strlen(e->info), e->verb, e->name);
+			total += e->usecs;
+		}
+		seq_printf(s, "  %d callbacks, %lld us total", l->count, total);
+		if (l->dropped)
+			seq_printf(s, ", %u not recorded", l->dropped);
+		seq_printf(s, "\n\n");
+	}
+
+	spin_unlock_irqrestore(&pm_profile_lock, flags);
+
+	return 0;
+}
+
+static int pm_profile_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pm_profile_show, NULL);
+}
+
+static const struct file_operations pm_profile_fops = {
+	.open		= pm_profile_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init pm_profile_debugfs_init(void)
+{
+	debugfs_create_file("suspend_profile", S_IRUGO, NULL, NULL,
+			    &pm_profile_fops);
+	return 0;
+}
+late_initcall(pm_profile_debugfs_init);
+#endif
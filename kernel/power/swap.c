@@ -24,6 +24,10 @@
 #include <linux/swapops.h>
 #include <linux/pm.h>
 #include <linux/slab.h>
+#include <linux/lzo.h>
+#include <linux/vmalloc.h>
+#include <linux/kthread.h>
+#include <linux/wait.h>
 
 #include "power.h"
 
@@ -404,6 +408,263 @@ static int save_image(struct swap_map_handle *handle,
 	return ret;
 }
 
+/*
+ * The image is compressed in blocks of LZO_UNC_PAGES pages.  Each
+ * compressed block is written to consecutive swap pages, prefixed by a
+ * LZO_HEADER holding the compressed length.  Up to LZO_THREADS blocks are
+ * compressed or decompressed concurrently by kernel threads.
+ */
+#define LZO_HEADER	sizeof(size_t)
+
+#define LZO_UNC_PAGES	32
+#define LZO_UNC_SIZE	(LZO_UNC_PAGES * PAGE_SIZE)
+
+#define LZO_CMP_PAGES	DIV_ROUND_UP(lzo1x_worst_compress(LZO_UNC_SIZE) + \
+			             LZO_HEADER, PAGE_SIZE)
+#define LZO_CMP_SIZE	(LZO_CMP_PAGES * PAGE_SIZE)
+
+#define LZO_THREADS	4
+
+static unsigned int lzo_nr_threads(void)
+{
+	/* Leave one CPU for the I/O and the snapshot copying */
+	return clamp_t(unsigned int, num_online_cpus() - 1, 1, LZO_THREADS);
+}
+
+/*
+ * Per-thread state shared between the image writer or reader and the
+ * compression or decompression threads.  @ready is set by the caller to
+ * start the thread on a block, @done is set by the thread when the block
+ * has been processed.
+ */
+struct lzo_data {
+	struct task_struct *thr;
+	atomic_t ready;
+	atomic_t done;
+	int ret;
+	wait_queue_head_t go;
+	wait_queue_head_t finished;
+	size_t unc_len;
+	size_t cmp_len;
+	unsigned char unc[LZO_UNC_SIZE];
+	unsigned char cmp[LZO_CMP_SIZE];
+};
+
+struct lzo_cmp_data {
+	struct lzo_data d;
+	unsigned char wrk[LZO1X_1_MEM_COMPRESS];
+};
+
+struct lzo_dec_data {
+	struct lzo_data d;
+	size_t next_cmp_len;		/* of the block read into page[] */
+	void *page[LZO_CMP_PAGES];	/* lowmem pages the block is read into */
+};
+
+static int lzo_compress_threadfn(void *data)
+{
+	struct lzo_cmp_data *c = data;
+	struct lzo_data *d = &c->d;
+
+	for (;;) {
+		wait_event(d->go, atomic_read(&d->ready) ||
+				  kthread_should_stop());
+		if (kthread_should_stop())
+			break;
+		atomic_set(&d->ready, 0);
+
+		d->ret = lzo1x_1_compress(d->unc, d->unc_len,
+					  d->cmp + LZO_HEADER, &d->cmp_len,
+					  c->wrk);
+		atomic_set(&d->done, 1);
+		wake_up(&d->finished);
+	}
+	return 0;
+}
+
+static int lzo_decompress_threadfn(void *data)
+{
+	struct lzo_dec_data *dd = data;
+	struct lzo_data *d = &dd->d;
+
+	for (;;) {
+		wait_event(d->go, atomic_read(&d->ready) ||
+				  kthread_should_stop());
+		if (kthread_should_stop())
+			break;
+		atomic_set(&d->ready, 0);
+
+		d->unc_len = LZO_UNC_SIZE;
+		d->ret = lzo1x_decompress_safe(d->cmp + LZO_HEADER, d->cmp_len,
+					       d->unc, &d->unc_len);
+		atomic_set(&d->done, 1);
+		wake_up(&d->finished);
+	}
+	return 0;
+}
+
+static void lzo_start(struct lzo_data *d)
+{
+	atomic_set(&d->ready, 1);
+	wake_up(&d->go);
+}
+
+static int lzo_wait(struct lzo_data *d)
+{
+	wait_event(d->finished, atomic_read(&d->done));
+	atomic_set(&d->done, 0);
+	return d->ret;
+}
+
+/**
+ *	save_image_lzo - save the suspend image data, LZO-compressed
+ */
+
+static int save_image_lzo(struct swap_map_handle *handle,
+			  struct snapshot_handle *snapshot,
+			  unsigned int nr_to_write)
+{
+	unsigned int m;
+	int ret = 0;
+	int nr_pages;
+	int err2;
+	struct bio *bio;
+	struct timeval start;
+	struct timeval stop;
+	struct lzo_cmp_data *data;
+	struct lzo_data *d;
+	unsigned int nr_threads = lzo_nr_threads();
+	unsigned int run_threads;
+	unsigned int thr;
+	size_t off;
+	void *page;
+
+	page = (void *)__get_free_page(__GFP_WAIT | __GFP_HIGH);
+	if (!page) {
+		printk(KERN_ERR "PM: Failed to allocate LZO page\n");
+		return -ENOMEM;
+	}
+
+	data = vmalloc(sizeof(*data) * nr_threads);
+	if (!data) {
+		printk(KERN_ERR "PM: Failed to allocate LZO data\n");
+		free_page((unsigned long)page);
+		return -ENOMEM;
+	}
+
+	for (thr = 0; thr < nr_threads; thr++) {
+		d = &data[thr].d;
+		memset(d, 0, offsetof(struct lzo_data, unc));
+		init_waitqueue_head(&d->go);
+		init_waitqueue_head(&d->finished);
+	}
+
+	for (thr = 0; thr < nr_threads; thr++) {
+		d = &data[thr].d;
+		d->thr = kthread_run(lzo_compress_threadfn, &data[thr],
+				     "image_compress/%u", thr);
+		if (IS_ERR(d->thr)) {
+			ret = PTR_ERR(d->thr);
+			d->thr = NULL;
+			printk(KERN_ERR "PM: Cannot start compression "
+			       "threads\n");
+			goto out_clean;
+		}
+	}
+
+	printk(KERN_INFO "PM: Compressing and saving image data "
+	       "(%u pages, %u threads) ...     ", nr_to_write, nr_threads);
+	m = nr_to_write / 100;
+	if (!m)
+		m = 1;
+	nr_pages = 0;
+	bio = NULL;
+	do_gettimeofday(&start);
+	for (;;) {
+		/* Hand a full block to each thread */
+		for (thr = 0; thr < nr_threads; thr++) {
+			d = &data[thr].d;
+			for (off = 0; off < LZO_UNC_SIZE; off += PAGE_SIZE) {
+				ret = snapshot_read_next(snapshot);
+				if (ret < 0)
+					goto out_finish;
+				if (!ret)
+					break;
+
+				memcpy(d->unc + off, data_of(*snapshot),
+				       PAGE_SIZE);
+
+				if (!(nr_pages % m))
+					printk(KERN_CONT "\b\b\b\b%3d%%",
+					       nr_pages / m);
+				nr_pages++;
+			}
+			if (!off)
+				break;
+
+			d->unc_len = off;
+			lzo_start(d);
+		}
+
+		if (!thr)
+			break;
+
+		/* Write the compressed blocks out in order */
+		for (run_threads = thr, thr = 0; thr < run_threads; thr++) {
+			d = &data[thr].d;
+			ret = lzo_wait(d);
+			if (ret < 0) {
+				printk(KERN_ERR "PM: LZO compression failed\n");
+				goto out_finish;
+			}
+
+			if (unlikely(!d->cmp_len ||
+				     d->cmp_len >
+				     lzo1x_worst_compress(d->unc_len))) {
+				printk(KERN_ERR "PM: Invalid LZO compressed "
+				       "length\n");
+				ret = -EINVAL;
+				goto out_finish;
+			}
+
+			*(size_t *)d->cmp = d->cmp_len;
+
+			/*
+			 * The block is copied to a lowmem page first, the
+			 * vmalloc()ed buffer cannot be handed to the bio
+			 * layer directly.
+			 */
+			for (off = 0; off < LZO_HEADER + d->cmp_len;
+			     off += PAGE_SIZE) {
+				memcpy(page, d->cmp + off, PAGE_SIZE);
+
+				ret = swap_write_page(handle, page, &bio);
+				if (ret)
+					goto out_finish;
+			}
+		}
+	}
+
+out_finish:
+	err2 = hib_wait_on_bio_chain(&bio);
+	do_gettimeofday(&stop);
+	if (!ret)
+		ret = err2;
+	if (!ret)
+		printk(KERN_CONT "\b\b\b\bdone\n");
+	else
+		printk(KERN_CONT "\n");
+	swsusp_show_speed(&start, &stop, nr_to_write, "Wrote");
+out_clean:
+	for (thr = 0; thr < nr_threads; thr++)
+		if (data[thr].d.thr)
+			kthread_stop(data[thr].d.thr);
+	vfree(data);
+	free_page((unsigned long)page);
+
+	return ret;
+}
+
 /**
  *	enough_swap - Make sure we have enough swap to save the image.
  *
@@ -411,12 +672,17 @@ static int save_image(struct swap_map_handle *handle,
  *	space avaiable from the resume partition.
  */
 
-static int enough_swap(unsigned int nr_pages)
+static int enough_swap(unsigned int nr_pages, unsigned int flags)
 {
 	unsigned int free_swap = count_swap_pages(root_swap, 1);
+	unsigned int required;
 
 	pr_debug("PM: Free swap pages: %u\n", free_swap);
-	return free_swap > nr_pages + PAGES_FOR_IO;
+
+	/* Compressed blocks may be larger than the data in the worst case */
+	required = PAGES_FOR_IO + ((flags & SF_NOCOMPRESS_MODE) ?
+		nr_pages : (nr_pages * LZO_CMP_PAGES) / LZO_UNC_PAGES + 1);
+	return free_swap > required;
 }
 
 /**
@@ -443,7 +709,7 @@ int swsusp_write(unsigned int flags)
 		printk(KERN_ERR "PM: Cannot get swap writer\n");
 		return error;
 	}
-	if (!enough_swap(pages)) {
+	if (!enough_swap(pages, flags)) {
 		printk(KERN_ERR "PM: Not enough free swap\n");
 		error = -ENOSPC;
 		goto out_finish;
@@ -458,8 +724,12 @@ int swsusp_write(unsigned int flags)
 	}
 	header = (struct swsusp_info *)data_of(snapshot);
 	error = swap_write_page(&handle, header, NULL);
-	if (!error)
-		error = save_image(&handle, &snapshot, pages - 1);
+	if (!error) {
+		if (flags & SF_NOCOMPRESS_MODE)
+			error = save_image(&handle, &snapshot, pages - 1);
+		else
+			error = save_image_lzo(&handle, &snapshot, pages - 1);
+	}
 out_finish:
 	error = swap_writer_finish(&handle, flags, error);
 	return error;
@@ -589,6 +859,219 @@ static int load_image(struct swap_map_handle *handle,
 	return error;
 }
 
+/*
+ * Reads the next @run_threads compressed blocks into the page arrays of
+ * the decompression threads.  Only the first page of each block, which
+ * holds its length, is read synchronously; the rest of the reads stay
+ * queued on @bio_chain so the I/O overlaps with decompression.  The
+ * lengths go to ->next_cmp_len, the threads may still be decompressing
+ * the previous blocks.
+ */
+static int lzo_read_blocks(struct swap_map_handle *handle,
+			   struct lzo_dec_data *data, unsigned int run_threads,
+			   struct bio **bio_chain)
+{
+	struct lzo_dec_data *dd;
+	unsigned int thr;
+	unsigned int i;
+	size_t cmp_len;
+	size_t off;
+	int error;
+
+	for (thr = 0; thr < run_threads; thr++) {
+		dd = &data[thr];
+		error = swap_read_page(handle, dd->page[0], NULL);
+		if (error)
+			return error;
+
+		cmp_len = *(size_t *)dd->page[0];
+		if (unlikely(!cmp_len ||
+			     cmp_len > lzo1x_worst_compress(LZO_UNC_SIZE))) {
+			printk(KERN_ERR "PM: Invalid LZO compressed length\n");
+			return -EINVAL;
+		}
+
+		dd->next_cmp_len = cmp_len;
+
+		for (off = PAGE_SIZE, i = 1; off < LZO_HEADER + cmp_len;
+		     off += PAGE_SIZE, i++) {
+			error = swap_read_page(handle, dd->page[i], bio_chain);
+			if (error)
+				return error;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ *	load_image_lzo - load the LZO-compressed image using the swap map
+ *	handle @handle and the snapshot handle @snapshot
+ *	(assume there are @nr_to_read pages to load)
+ */
+
+static int load_image_lzo(struct swap_map_handle *handle,
+			  struct snapshot_handle *snapshot,
+			  unsigned int nr_to_read)
+{
+	unsigned int m;
+	int error = 0;
+	int err2;
+	struct timeval start;
+	struct timeval stop;
+	struct bio *bio;
+	unsigned nr_pages;
+	struct lzo_dec_data *data;
+	struct lzo_data *d;
+	unsigned int nr_threads = lzo_nr_threads();
+	unsigned int run_threads;
+	unsigned int next_threads;
+	unsigned int blocks;
+	unsigned int thr;
+	unsigned int i;
+	size_t off;
+
+	data = vmalloc(sizeof(*data) * nr_threads);
+	if (!data) {
+		printk(KERN_ERR "PM: Failed to allocate LZO data\n");
+		return -ENOMEM;
+	}
+
+	for (thr = 0; thr < nr_threads; thr++) {
+		d = &data[thr].d;
+		memset(d, 0, offsetof(struct lzo_data, unc));
+		memset(data[thr].page, 0, sizeof(data[thr].page));
+		init_waitqueue_head(&d->go);
+		init_waitqueue_head(&d->finished);
+	}
+
+	for (thr = 0; thr < nr_threads; thr++) {
+		for (i = 0; i < LZO_CMP_PAGES; i++) {
+			data[thr].page[i] = (void *)__get_free_page(
+				__GFP_WAIT | __GFP_HIGH);
+			if (!data[thr].page[i]) {
+				printk(KERN_ERR "PM: Failed to allocate LZO "
+				       "pages\n");
+				error = -ENOMEM;
+				goto out_clean;
+			}
+		}
+
+		d = &data[thr].d;
+		d->thr = kthread_run(lzo_decompress_threadfn, &data[thr],
+				     "image_decompress/%u", thr);
+		if (IS_ERR(d->thr)) {
+			error = PTR_ERR(d->thr);
+			d->thr = NULL;
+			printk(KERN_ERR "PM: Cannot start decompression "
+			       "threads\n");
+			goto out_clean;
+		}
+	}
+
+	printk(KERN_INFO "PM: Loading and decompressing image data "
+	       "(%u pages, %u threads) ...     ", nr_to_read, nr_threads);
+	m = nr_to_read / 100;
+	if (!m)
+		m = 1;
+	nr_pages = 0;
+	bio = NULL;
+	do_gettimeofday(&start);
+
+	error = snapshot_write_next(snapshot);
+	if (error <= 0)
+		goto out_finish;
+
+	/* Every block but the last one holds LZO_UNC_PAGES pages */
+	blocks = DIV_ROUND_UP(nr_to_read, LZO_UNC_PAGES);
+	run_threads = min(nr_threads, blocks);
+	error = lzo_read_blocks(handle, data, run_threads, &bio);
+	if (error)
+		goto out_finish;
+
+	while (run_threads) {
+		error = hib_wait_on_bio_chain(&bio);
+		if (error)
+			goto out_finish;
+
+		/* All threads are idle here, lzo_wait() saw them finish */
+		for (thr = 0; thr < run_threads; thr++) {
+			d = &data[thr].d;
+			d->cmp_len = data[thr].next_cmp_len;
+			for (off = 0, i = 0; off < LZO_HEADER + d->cmp_len;
+			     off += PAGE_SIZE, i++)
+				memcpy(d->cmp + off, data[thr].page[i],
+				       PAGE_SIZE);
+			lzo_start(d);
+		}
+
+		/* Read ahead the next blocks while these are decompressed */
+		blocks -= run_threads;
+		next_threads = min(nr_threads, blocks);
+		error = lzo_read_blocks(handle, data, next_threads, &bio);
+		if (error)
+			goto out_finish;
+
+		for (thr = 0; thr < run_threads; thr++) {
+			d = &data[thr].d;
+			error = lzo_wait(d);
+			if (error < 0) {
+				printk(KERN_ERR "PM: LZO decompression "
+				       "failed\n");
+				goto out_finish;
+			}
+
+			if (unlikely(!d->unc_len || d->unc_len > LZO_UNC_SIZE ||
+				     d->unc_len & (PAGE_SIZE - 1))) {
+				printk(KERN_ERR "PM: Invalid LZO uncompressed "
+				       "length\n");
+				error = -EINVAL;
+				goto out_finish;
+			}
+
+			for (off = 0; off < d->unc_len; off += PAGE_SIZE) {
+				memcpy(data_of(*snapshot), d->unc + off,
+				       PAGE_SIZE);
+
+				if (!(nr_pages % m))
+					printk("\b\b\b\b%3d%%", nr_pages / m);
+				nr_pages++;
+
+				error = snapshot_write_next(snapshot);
+				if (error <= 0)
+					goto out_finish;
+			}
+		}
+
+		run_threads = next_threads;
+	}
+
+out_finish:
+	err2 = hib_wait_on_bio_chain(&bio);
+	do_gettimeofday(&stop);
+	if (!error)
+		error = err2;
+	if (!error) {
+		printk("\b\b\b\bdone\n");
+		snapshot_write_finalize(snapshot);
+		if (!snapshot_image_loaded(snapshot))
+			error = -ENODATA;
+	} else
+		printk("\n");
+	swsusp_show_speed(&start, &stop, nr_to_read, "Read");
+out_clean:
+	for (thr = 0; thr < nr_threads; thr++) {
+		if (data[thr].d.thr)
+			kthread_stop(data[thr].d.thr);
+		for (i = 0; i < LZO_CMP_PAGES; i++)
+			if (data[thr].page[i])
+				free_page((unsigned long)data[thr].page[i]);
+	}
+	vfree(data);
+
+	return error;
+}
+
 /**
  *	swsusp_read - read the hibernation image.
  *	@flags_p: flags passed by the "frozen" kernel in the image header should
@@ -612,8 +1095,14 @@ int swsusp_read(unsigned int *flags_p)
 		goto end;
 	if (!error)
 		error = swap_read_page(&handle, header, NULL);
-	if (!error)
-		error = load_image(&handle, &snapshot, header->pages - 1);
+	if (!error) {
+		if (*flags_p & SF_NOCOMPRESS_MODE)
+			error = load_image(&handle, &snapshot,
+					   header->pages - 1);
+		else
+			error = load_image_lzo(&handle, &snapshot,
+					       header->pages - 1);
+	}
 	swap_reader_finish(&handle);
 end:
 	if (!error)
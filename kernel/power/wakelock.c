@@ -43,6 +43,20 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 static DEFINE_SPINLOCK(list_lock);
 static LIST_HEAD(inactive_locks);
 static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
+
+/*
+ * Active wake locks of one type, indexed so that has_wake_lock does not
+ * have to walk the active list.  Locks with a timeout are kept in an
+ * rbtree sorted by expiry, with the earliest and latest entries cached.
+ * Locks without a timeout are only counted.  Protected by list_lock.
+ */
+struct wake_lock_queue {
+	struct rb_root timeouts;
+	struct rb_node *first;
+	struct rb_node *last;
+	int no_timeout_count;
+};
+static struct wake_lock_queue active_queues[WAKE_LOCK_TYPE_COUNT];
 static int current_event_num;
 struct workqueue_struct *suspend_work_queue;
 struct wake_lock main_wake_lock;
@@ -139,16 +153,17 @@ static int wakelock_stats_show(struct seq_file *m, void *unused)
 	return 0;
 }
 
-static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
+/* now is sampled by the caller under list_lock, so that the time stamps
+ * of a lock never go backwards. */
+static void wake_unlock_stat_locked(struct wake_lock *lock, int expired,
+				    ktime_t now)
 {
 	ktime_t duration;
-	ktime_t now;
+	ktime_t unlock_time = now;
 	if (!(lock->flags & WAKE_LOCK_ACTIVE))
 		return;
 	if (get_expired_time(lock, &now))
 		expired = 1;
-	else
-		now = ktime_get();
 	lock->stat.count++;
 	if (expired)
 		lock->stat.expire_count++;
@@ -156,7 +171,7 @@ static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 	lock->stat.total_time = ktime_add(lock->stat.total_time, duration);
 	if (ktime_to_ns(duration) > ktime_to_ns(lock->stat.max_time))
 		lock->stat.max_time = duration;
-	lock->stat.last_time = ktime_get();
+	lock->stat.last_time = unlock_time;
 	if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
 		duration = ktime_sub(now, last_sleep_time_update);
 		lock->stat.prevent_suspend_time = ktime_add(
@@ -165,13 +180,12 @@ static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 	}
 }
 
-static void update_sleep_wait_stats_locked(int done)
+static void update_sleep_wait_stats_locked(int done, ktime_t now)
 {
 	struct wake_lock *lock;
-	ktime_t now, etime, elapsed, add;
+	ktime_t etime, elapsed, add;
 	int expired;
 
-	now = ktime_get();
 	elapsed = ktime_sub(now, last_sleep_time_update);
 	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link) {
 		expired = get_expired_time(lock, &etime);
@@ -193,11 +207,66 @@ static void update_sleep_wait_stats_locked(int done)
 #endif
 
 
-static void expire_wake_lock(struct wake_lock *lock)
+static void wake_lock_queue_add(struct wake_lock *lock, int type)
+{
+	struct wake_lock_queue *q = &active_queues[type];
+	struct rb_node **link = &q->timeouts.rb_node;
+	struct rb_node *parent = NULL;
+	struct wake_lock *entry;
+	bool leftmost = true;
+	bool rightmost = true;
+
+	if (!(lock->flags & WAKE_LOCK_AUTO_EXPIRE)) {
+		q->no_timeout_count++;
+		return;
+	}
+
+	while (*link) {
+		parent = *link;
+		entry = rb_entry(parent, struct wake_lock, expire_node);
+		if (time_before(lock->expires, entry->expires)) {
+			link = &parent->rb_left;
+			rightmost = false;
+		} else {
+			link = &parent->rb_right;
+			leftmost = false;
+		}
+	}
+	rb_link_node(&lock->expire_node, parent, link);
+	rb_insert_color(&lock->expire_node, &q->timeouts);
+
+	if (leftmost)
+		q->first = &lock->expire_node;
+	if (rightmost)
+		q->last = &lock->expire_node;
+}
+
+/* Must be called before WAKE_LOCK_ACTIVE or WAKE_LOCK_AUTO_EXPIRE change */
+static void wake_lock_queue_del(struct wake_lock *lock, int type)
+{
+	struct wake_lock_queue *q = &active_queues[type];
+
+	if (!(lock->flags & WAKE_LOCK_ACTIVE))
+		return;
+
+	if (!(lock->flags & WAKE_LOCK_AUTO_EXPIRE)) {
+		q->no_timeout_count--;
+		return;
+	}
+
+	if (q->first == &lock->expire_node)
+		q->first = rb_next(&lock->expire_node);
+	if (q->last == &lock->expire_node)
+		q->last = rb_prev(&lock->expire_node);
+	rb_erase(&lock->expire_node, &q->timeouts);
+}
+
+static void expire_wake_lock(struct wake_lock *lock, ktime_t now)
 {
 #ifdef CONFIG_WAKELOCK_STAT
-	wake_unlock_stat_locked(lock, 1);
+	wake_unlock_stat_locked(lock, 1, now);
 #endif
+	wake_lock_queue_del(lock, lock->flags & WAKE_LOCK_TYPE_MASK);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
 	list_del(&lock->link);
 	list_add(&lock->link, &inactive_locks);
@@ -228,31 +297,46 @@ static void print_active_locks(int type)
 	}
 }
 
-static long has_wake_lock_locked(int type)
+/* Expires any timed out locks and returns the time until the last one
+ * expires.  Each lock is expired at most once, so apart from that this
+ * only looks at the cached ends of the timeout tree. */
+static long has_wake_lock_locked(int type, ktime_t now)
 {
-	struct wake_lock *lock, *n;
-	long max_timeout = 0;
+	struct wake_lock_queue *q;
+	struct wake_lock *lock;
+	unsigned long j = jiffies;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout <= 0)
-				expire_wake_lock(lock);
-			else if (timeout > max_timeout)
-				max_timeout = timeout;
-		} else
-			return -1;
+	q = &active_queues[type];
+	if (q->no_timeout_count)
+		return -1;
+
+	while (q->first) {
+		lock = rb_entry(q->first, struct wake_lock, expire_node);
+		if ((long)(lock->expires - j) > 0)
+			break;
+		expire_wake_lock(lock, now);
 	}
-	return max_timeout;
+
+	if (!q->last)
+		return 0;
+
+	lock = rb_entry(q->last, struct wake_lock, expire_node);
+	return lock->expires - j;
 }
 
+#ifdef CONFIG_WAKELOCK_STAT
+#define wake_lock_stat_time()	ktime_get()
+#else
+#define wake_lock_stat_time()	ktime_set(0, 0)
+#endif
+
 long has_wake_lock(int type)
 {
 	long ret;
 	unsigned long irqflags;
 	spin_lock_irqsave(&list_lock, irqflags);
-	ret = has_wake_lock_locked(type);
+	ret = has_wake_lock_locked(type, wake_lock_stat_time());
 	if (ret && (debug_mask & DEBUG_SUSPEND) && type == WAKE_LOCK_SUSPEND)
 		print_active_locks(type);
 	spin_unlock_irqrestore(&list_lock, irqflags);
@@ -302,7 +386,8 @@ static void expire_wake_locks(unsigned long data)
 	spin_lock_irqsave(&list_lock, irqflags);
 	if (debug_mask & DEBUG_SUSPEND)
 		print_active_locks(WAKE_LOCK_SUSPEND);
-	has_lock = has_wake_lock_locked(WAKE_LOCK_SUSPEND);
+	has_lock = has_wake_lock_locked(WAKE_LOCK_SUSPEND,
+					wake_lock_stat_time());
 	if (debug_mask & DEBUG_EXPIRE)
 		pr_info("expire_wake_locks: done, has_lock %ld\n", has_lock);
 	if (has_lock == 0)
@@ -356,6 +441,7 @@ void wake_lock_init(struct wake_lock *lock, int type, const char *name)
 	lock->flags = (type & WAKE_LOCK_TYPE_MASK) | WAKE_LOCK_INITIALIZED;
 
 	INIT_LIST_HEAD(&lock->link);
+	RB_CLEAR_NODE(&lock->expire_node);
 	spin_lock_irqsave(&list_lock, irqflags);
 	list_add(&lock->link, &inactive_locks);
 	spin_unlock_irqrestore(&list_lock, irqflags);
@@ -384,6 +470,7 @@ void wake_lock_destroy(struct wake_lock *lock)
 				  lock->stat.max_time);
 	}
 #endif
+	wake_lock_queue_del(lock, lock->flags & WAKE_LOCK_TYPE_MASK);
 	list_del(&lock->link);
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
@@ -395,8 +482,10 @@ static void wake_lock_internal(
 	int type;
 	unsigned long irqflags;
 	long expire_in;
+	ktime_t now;
 
 	spin_lock_irqsave(&list_lock, irqflags);
+	now = wake_lock_stat_time();
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
 	BUG_ON(!(lock->flags & WAKE_LOCK_INITIALIZED));
@@ -409,14 +498,15 @@ static void wake_lock_internal(
 	}
 	if ((lock->flags & WAKE_LOCK_AUTO_EXPIRE) &&
 	    (long)(lock->expires - jiffies) <= 0) {
-		wake_unlock_stat_locked(lock, 0);
-		lock->stat.last_time = ktime_get();
+		wake_unlock_stat_locked(lock, 0, now);
+		lock->stat.last_time = now;
 	}
 #endif
+	wake_lock_queue_del(lock, type);
 	if (!(lock->flags & WAKE_LOCK_ACTIVE)) {
 		lock->flags |= WAKE_LOCK_ACTIVE;
 #ifdef CONFIG_WAKELOCK_STAT
-		lock->stat.last_time = ktime_get();
+		lock->stat.last_time = now;
 #endif
 	}
 	list_del(&lock->link);
@@ -435,16 +525,17 @@ static void wake_lock_internal(
 		lock->flags &= ~WAKE_LOCK_AUTO_EXPIRE;
 		list_add(&lock->link, &active_wake_locks[type]);
 	}
+	wake_lock_queue_add(lock, type);
 	if (type == WAKE_LOCK_SUSPEND) {
 		current_event_num++;
 #ifdef CONFIG_WAKELOCK_STAT
 		if (lock == &main_wake_lock)
-			update_sleep_wait_stats_locked(1);
+			update_sleep_wait_stats_locked(1, now);
 		else if (!wake_lock_active(&main_wake_lock))
-			update_sleep_wait_stats_locked(0);
+			update_sleep_wait_stats_locked(0, now);
 #endif
 		if (has_timeout)
-			expire_in = has_wake_lock_locked(type);
+			expire_in = has_wake_lock_locked(type, now);
 		else
 			expire_in = -1;
 		if (expire_in > 0) {
@@ -480,18 +571,21 @@ void wake_unlock(struct wake_lock *lock)
 {
 	int type;
 	unsigned long irqflags;
+	ktime_t now;
 	spin_lock_irqsave(&list_lock, irqflags);
+	now = wake_lock_stat_time();
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
 #ifdef CONFIG_WAKELOCK_STAT
-	wake_unlock_stat_locked(lock, 0);
+	wake_unlock_stat_locked(lock, 0, now);
 #endif
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_unlock: %s\n", lock->name);
+	wake_lock_queue_del(lock, type);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
 	list_del(&lock->link);
 	list_add(&lock->link, &inactive_locks);
 	if (type == WAKE_LOCK_SUSPEND) {
-		long has_lock = has_wake_lock_locked(type);
+		long has_lock = has_wake_lock_locked(type, now);
 		if (has_lock > 0) {
 			if (debug_mask & DEBUG_EXPIRE)
 				pr_info("wake_unlock: %s, start expire timer, "
@@ -509,7 +603,7 @@ void wake_unlock(struct wake_lock *lock)
 			if (debug_mask & DEBUG_SUSPEND)
 				print_active_locks(WAKE_LOCK_SUSPEND);
 #ifdef CONFIG_WAKELOCK_STAT
-			update_sleep_wait_stats_locked(0);
+			update_sleep_wait_stats_locked(0, now);
 #endif
 		}
 	}
@@ -541,8 +635,10 @@ static int __init wakelocks_init(void)
 	int ret;
 	int i;
 
-	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++)
+	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++) {
 		INIT_LIST_HEAD(&active_wake_locks[i]);
+		active_queues[i].timeouts = RB_ROOT;
+	}
 
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_lock_init(&deleted_wake_locks, WAKE_LOCK_SUSPEND,
@@ -0,0 +1,119 @@
+/*
+ * Wake lock benchmark module
+ *
+ * Takes and releases a wake lock of its own over and over on every cpu
+ * at the same time, so the cpus contend on the wake lock list_lock the
+ * way frequent network and sensor wake locks do.  The rounds use idle
+ * and suspend wake locks, each with and without a timeout; suspend wake
+ * locks also run the expiry and sleep statistics code.  A suspend wake
+ * lock is held across the whole run so that the benchmark itself never
+ * lets the system suspend.  The costs per lock/unlock pair are reported
+ * for every round, see linux/cpubench.h.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ */
+
+#include <linux/cpubench.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/wakelock.h>
+
+static int nthreads;
+static int nr_ops = 100000;
+
+module_param_named(nr_threads, nthreads, int, 0444);
+MODULE_PARM_DESC(nr_threads, "Number of threads (default: one per cpu)");
+module_param(nr_ops, int, 0444);
+MODULE_PARM_DESC(nr_ops, "Lock/unlock pairs per round and thread");
+
+static const struct {
+	int type;
+	int timeout;
+	const char *name;
+} rounds[] = {
+	{ WAKE_LOCK_IDLE,	0,	"idle lock+unlock" },
+	{ WAKE_LOCK_IDLE,	1,	"idle timeout+unlock" },
+	{ WAKE_LOCK_SUSPEND,	0,	"suspend lock+unlock" },
+	{ WAKE_LOCK_SUSPEND,	1,	"suspend timeout+unlock" },
+};
+
+static struct wake_lock *locks;		/* one per thread and round */
+static struct wake_lock hold_lock;
+
+static void wakelock_bench_fn(struct cpu_bench *bench, int thread, int round)
+{
+	struct wake_lock *lock = &locks[thread * ARRAY_SIZE(rounds) + round];
+	struct cpu_bench_clock clk;
+	int j;
+
+	cpu_bench_clock_start(&clk);
+	if (rounds[round].timeout) {
+		for (j = 0; j < nr_ops; j++) {
+			wake_lock_timeout(lock, HZ);
+			wake_unlock(lock);
+		}
+	} else {
+		for (j = 0; j < nr_ops; j++) {
+			wake_lock(lock);
+			wake_unlock(lock);
+		}
+	}
+	cpu_bench_clock_stop(&clk, cpu_bench_time(bench, thread, round, 0));
+}
+
+static struct cpu_bench wakelock_bench = {
+	.name		= "wakelocktest",
+	.nr_rounds	= ARRAY_SIZE(rounds),
+	.nr_tests	= 1,
+	.fn		= wakelock_bench_fn,
+};
+
+static int __init wakelock_test(void)
+{
+	int i, nr_locks, ret;
+
+	if (nthreads <= 0)
+		nthreads = num_online_cpus();
+	if (nr_ops <= 0)
+		return -EINVAL;
+
+	nr_locks = nthreads * ARRAY_SIZE(rounds);
+	locks = kcalloc(nr_locks, sizeof(*locks), GFP_KERNEL);
+	if (!locks)
+		return -ENOMEM;
+	for (i = 0; i < nr_locks; i++)
+		wake_lock_init(&locks[i], rounds[i % ARRAY_SIZE(rounds)].type,
+			       "wakelocktest");
+	wake_lock_init(&hold_lock, WAKE_LOCK_SUSPEND, "wakelocktest_hold");
+	wake_lock(&hold_lock);
+
+	wakelock_bench.nr_threads = nthreads;
+	ret = cpu_bench_run(&wakelock_bench);
+
+	wake_unlock(&hold_lock);
+	wake_lock_destroy(&hold_lock);
+	for (i = 0; i < nr_locks; i++)
+		wake_lock_destroy(&locks[i]);
+	kfree(locks);
+	if (ret)
+		return ret;
+
+	printk(KERN_INFO "wakelocktest: %d threads, %d ops, "
+	       "cost per lock/unlock pair:\n", nthreads, nr_ops);
+	for (i = 0; i < ARRAY_SIZE(rounds); i++)
+		cpu_bench_report(&wakelock_bench, i, 0, nr_ops,
+				 rounds[i].name);
+	cpu_bench_free(&wakelock_bench);
+	return 0;
+}
+
+static void __exit wakelock_test_exit(void)
+{
+}
+
+module_init(wakelock_test);
+module_exit(wakelock_test_exit);
+MODULE_LICENSE("GPL");
@@ -134,6 +134,7 @@ static atomic_t n_rcu_torture_alloc_fail;
 static atomic_t n_rcu_torture_free;
 static atomic_t n_rcu_torture_mberror;
 static atomic_t n_rcu_torture_error;
+static atomic_t n_rcu_torture_cbs;	/* Queued but not yet invoked. */
 static long n_rcu_torture_timers;
 static struct list_head rcu_torture_removed;
 static cpumask_var_t shuffle_tmp_mask;
@@ -321,6 +322,7 @@ rcu_torture_cb(struct rcu_head *p)
 	int i;
 	struct rcu_torture *rp = container_of(p, struct rcu_torture, rtort_rcu);
 
+	atomic_dec(&n_rcu_torture_cbs);
 	if (fullstop != FULLSTOP_DONTSTOP) {
 		/* Test is ending, just drop callbacks on the floor. */
 		/* The next initialization will pick up the pieces. */
@@ -344,6 +346,7 @@ static int rcu_no_completed(void)
 
 static void rcu_torture_deferred_free(struct rcu_torture *p)
 {
+	atomic_inc(&n_rcu_torture_cbs);
 	call_rcu(&p->rtort_rcu, rcu_torture_cb);
 }
 
@@ -443,6 +446,7 @@ static int rcu_bh_torture_completed(void)
 
 static void rcu_bh_torture_deferred_free(struct rcu_torture *p)
 {
+	atomic_inc(&n_rcu_torture_cbs);
 	call_rcu_bh(&p->rtort_rcu, rcu_torture_cb);
 }
 
@@ -620,6 +624,7 @@ static void sched_torture_read_unlock(int idx)
 
 static void rcu_sched_torture_deferred_free(struct rcu_torture *p)
 {
+	atomic_inc(&n_rcu_torture_cbs);
 	call_rcu_sched(&p->rtort_rcu, rcu_torture_cb);
 }
 
@@ -924,7 +929,7 @@ rcu_torture_printk(char *page)
 	cnt += sprintf(&page[cnt], "%s%s ", torture_type, TORTURE_FLAG);
 	cnt += sprintf(&page[cnt],
 		       "rtc: %p ver: %ld tfle: %d rta: %d rtaf: %d rtf: %d "
-		       "rtmbe: %d nt: %ld",
+		       "rtmbe: %d nt: %ld ncb: %d",
 		       rcu_torture_current,
 		       rcu_torture_current_version,
 		       list_empty(&rcu_torture_freelist),
@@ -932,7 +937,8 @@ rcu_torture_printk(char *page)
 		       atomic_read(&n_rcu_torture_alloc_fail),
 		       atomic_read(&n_rcu_torture_free),
 		       atomic_read(&n_rcu_torture_mberror),
-		       n_rcu_torture_timers);
+		       n_rcu_torture_timers,
+		       atomic_read(&n_rcu_torture_cbs));
 	if (atomic_read(&n_rcu_torture_mberror) != 0)
 		cnt += sprintf(&page[cnt], " !!!");
 	cnt += sprintf(&page[cnt], "\n%s%s ", torture_type, TORTURE_FLAG);
@@ -1178,9 +1184,21 @@ rcu_torture_cleanup(void)
 
 	/* Wait for all RCU callbacks to fire.  */
 
-	if (cur_ops->cb_barrier != NULL)
+	if (cur_ops->cb_barrier != NULL) {
 		cur_ops->cb_barrier();
 
+		/*
+		 * Every callback must have run by now, including those
+		 * offloaded from rcu_nocbs= CPUs to their kthreads.
+		 */
+		if (atomic_read(&n_rcu_torture_cbs) != 0) {
+			printk(KERN_ALERT "%s" TORTURE_FLAG
+			       "!!! %d callbacks outstanding after barrier\n",
+			       torture_type, atomic_read(&n_rcu_torture_cbs));
+			atomic_inc(&n_rcu_torture_error);
+		}
+	}
+
 	rcu_torture_stats_print();  /* -After- the stats thread is stopped! */
 
 	if (cur_ops->cleanup)
@@ -1254,6 +1272,7 @@ rcu_torture_init(void)
 	atomic_set(&n_rcu_torture_free, 0);
 	atomic_set(&n_rcu_torture_mberror, 0);
 	atomic_set(&n_rcu_torture_error, 0);
+	atomic_set(&n_rcu_torture_cbs, 0);
 	for (i = 0; i < RCU_TORTURE_PIPE_LEN + 1; i++)
 		atomic_set(&rcu_torture_wcount[i], 0);
 	for_each_possible_cpu(cpu) {
@@ -1048,6 +1048,7 @@ static void __rcu_offline_cpu(int cpu, struct rcu_state *rsp)
 		rcu_report_exp_rnp(rsp, rnp);
 
 	rcu_adopt_orphan_cbs(rsp);
+	rcu_nocb_offline_cpu(rdp);
 }
 
 /*
@@ -1193,6 +1194,7 @@ void rcu_check_callbacks(int cpu, int user)
 		rcu_bh_qs(cpu);
 	}
 	rcu_preempt_check_callbacks(cpu);
+	rcu_nocb_deferred_wakeup(cpu);
 	if (rcu_pending(cpu))
 		raise_softirq(RCU_SOFTIRQ);
 }
@@ -1382,9 +1384,14 @@ static void rcu_process_callbacks(struct softirq_action *unused)
 	rcu_needs_cpu_flush();
 }
 
+/*
+ * Queue a callback on the current CPU.  If @offload is set and this CPU
+ * was named in rcu_nocbs=, the callback is instead handed to the CPU's
+ * callback kthread, which waits for the grace period on its own.
+ */
 static void
-__call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
-	   struct rcu_state *rsp)
+___call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
+	    struct rcu_state *rsp, bool offload)
 {
 	unsigned long flags;
 	struct rcu_data *rdp;
@@ -1403,6 +1410,11 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
 	 */
 	local_irq_save(flags);
 	rdp = rsp->rda[smp_processor_id()];
+	if (offload &&
+	    rcu_nocb_enqueue(rdp, head, irqs_disabled_flags(flags))) {
+		local_irq_restore(flags);
+		return;
+	}
 	rcu_process_gp_end(rsp, rdp);
 	check_for_new_grace_period(rsp, rdp);
 
@@ -1438,6 +1450,13 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
 	local_irq_restore(flags);
 }
 
+static void
+__call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
+	   struct rcu_state *rsp)
+{
+	___call_rcu(head, func, rsp, true);
+}
+
 /*
  * Queue an RCU-sched callback for invocation after a grace period.
  */
@@ -1614,7 +1633,8 @@ static int rcu_needs_cpu_quick_check(int cpu)
 	/* RCU callbacks either ready or pending? */
 	return per_cpu(rcu_sched_data, cpu).nxtlist ||
 	       per_cpu(rcu_bh_data, cpu).nxtlist ||
-	       rcu_preempt_needs_cpu(cpu);
+	       rcu_preempt_needs_cpu(cpu) ||
+	       rcu_nocb_need_deferred_wakeup(cpu);
 }
 
 static DEFINE_PER_CPU(struct rcu_head, rcu_barrier_head) = {NULL};
@@ -1715,6 +1735,7 @@ rcu_boot_init_percpu_data(int cpu, struct rcu_state *rsp)
 	rdp->dynticks = &per_cpu(rcu_dynticks, cpu);
 #endif /* #ifdef CONFIG_NO_HZ */
 	rdp->cpu = cpu;
+	rcu_boot_init_nocb_percpu_data(rdp, rsp);
 	raw_spin_unlock_irqrestore(&rnp->lock, flags);
 }
 
@@ -27,6 +27,7 @@
 #include <linux/threads.h>
 #include <linux/cpumask.h>
 #include <linux/seqlock.h>
+#include <linux/wait.h>
 
 /*
  * Define shape of hierarchy based on NR_CPUS and CONFIG_RCU_FANOUT.
@@ -231,6 +232,19 @@ struct rcu_data {
 	unsigned long n_rp_need_fqs;
 	unsigned long n_rp_need_nothing;
 
+#ifdef CONFIG_RCU_NOCB_CPU
+	/* 6) Callback offloading for rcu_nocbs= CPUs. */
+	struct rcu_head *nocb_head;	/* Callbacks waiting for kthread. */
+	struct rcu_head **nocb_tail;
+	atomic_long_t nocb_q_count;	/* # callbacks not yet invoked. */
+	unsigned long nocb_invoked;	/* # callbacks invoked by kthread. */
+	wait_queue_head_t nocb_wq;	/* For the kthread to sleep on. */
+	bool nocb_defer_wakeup;		/* Wake kthread at next tick. */
+	bool nocb_softirq;		/* No kthread, invoke from softirq. */
+	struct task_struct *nocb_kthread;
+	struct rcu_state *rsp;		/* Flavor the kthread waits for. */
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+
 	int cpu;
 };
 
@@ -385,5 +399,14 @@ static void __cpuinit rcu_preempt_init_percpu_data(int cpu);
 static void rcu_preempt_send_cbs_to_orphanage(void);
 static void __init __rcu_init_preempt(void);
 static void rcu_needs_cpu_flush(void);
+static bool rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *head,
+			     bool irqs_were_disabled);
+static bool rcu_nocb_need_deferred_wakeup(int cpu);
+static void rcu_nocb_deferred_wakeup(int cpu);
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp,
+						  struct rcu_state *rsp);
+#ifdef CONFIG_HOTPLUG_CPU
+static void rcu_nocb_offline_cpu(struct rcu_data *rdp);
+#endif /* #ifdef CONFIG_HOTPLUG_CPU */
 
 #endif /* #ifndef RCU_TREE_NONCORE */
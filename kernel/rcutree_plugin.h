@@ -25,6 +25,8 @@
  */
 
 #include <linux/delay.h>
+#include <linux/kthread.h>
+#include <linux/bootmem.h>
 
 /*
  * Check the RCU kernel configuration parameters and print informative
@@ -1120,3 +1122,300 @@ static void rcu_needs_cpu_flush(void)
 }
 
 #endif /* #else #if !defined(CONFIG_RCU_FAST_NO_HZ) */
+
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * CPUs named in the rcu_nocbs= boot parameter never invoke RCU callbacks
+ * from softirq.  Callbacks queued on them are instead moved to a per-CPU,
+ * per-flavor "rcuo" kthread, which waits for a grace period and invokes
+ * them.  The kthreads are not bound to any CPU, so they can be moved off
+ * latency-sensitive CPUs with sched_setaffinity() or cpusets.
+ */
+static cpumask_var_t rcu_nocb_mask;
+static bool have_rcu_nocb_mask;
+
+static int __init rcu_nocb_setup(char *str)
+{
+	alloc_bootmem_cpumask_var(&rcu_nocb_mask);
+	if (cpulist_parse(str, rcu_nocb_mask)) {
+		printk(KERN_WARNING "RCU: ignoring malformed rcu_nocbs=%s\n",
+		       str);
+		return 1;
+	}
+	have_rcu_nocb_mask = true;
+	return 1;
+}
+__setup("rcu_nocbs=", rcu_nocb_setup);
+
+/* Is the specified CPU a no-CBs CPU? */
+static bool rcu_is_nocb_cpu(int cpu)
+{
+	if (have_rcu_nocb_mask)
+		return cpumask_test_cpu(cpu, rcu_nocb_mask);
+	return false;
+}
+
+/*
+ * Enqueue the callback on the CPU's no-CBs list if it has one, waking up
+ * the kthread if the list was empty.  Lock-free, because the kthread only
+ * ever removes the whole list at once.  Returns false if the caller must
+ * queue the callback normally.
+ *
+ * call_rcu() may be invoked with the runqueue or pi locks held, which
+ * wake_up() would need too.  Those are only ever taken with irqs disabled,
+ * so if the caller had irqs disabled, leave the wakeup to the next
+ * scheduling-clock interrupt instead.
+ */
+static bool rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *head,
+			     bool irqs_were_disabled)
+{
+	struct rcu_head **old_tail;
+
+	if (!rcu_is_nocb_cpu(rdp->cpu) || rdp->nocb_softirq)
+		return false;
+	old_tail = xchg(&rdp->nocb_tail, &head->next);
+	ACCESS_ONCE(*old_tail) = head;
+	atomic_long_inc(&rdp->nocb_q_count);
+	if (old_tail == &rdp->nocb_head) {
+		if (irqs_were_disabled)
+			rdp->nocb_defer_wakeup = true;
+		else
+			wake_up(&rdp->nocb_wq);
+	}
+	return true;
+}
+
+/* Does the CPU still have to wake one of its kthreads? */
+static bool rcu_nocb_need_deferred_wakeup(int cpu)
+{
+	return per_cpu(rcu_sched_data, cpu).nocb_defer_wakeup ||
+	       per_cpu(rcu_bh_data, cpu).nocb_defer_wakeup ||
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	       per_cpu(rcu_preempt_data, cpu).nocb_defer_wakeup ||
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	       false;
+}
+
+static void __rcu_nocb_deferred_wakeup(struct rcu_data *rdp)
+{
+	if (rdp->nocb_defer_wakeup) {
+		rdp->nocb_defer_wakeup = false;
+		wake_up(&rdp->nocb_wq);
+	}
+}
+
+/*
+ * Do the wakeups rcu_nocb_enqueue() deferred, called from the
+ * scheduling-clock interrupt with irqs disabled, the same as
+ * rcu_nocb_enqueue() runs with, so the flags need no atomics.
+ */
+static void rcu_nocb_deferred_wakeup(int cpu)
+{
+	__rcu_nocb_deferred_wakeup(&per_cpu(rcu_sched_data, cpu));
+	__rcu_nocb_deferred_wakeup(&per_cpu(rcu_bh_data, cpu));
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	__rcu_nocb_deferred_wakeup(&per_cpu(rcu_preempt_data, cpu));
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+}
+
+/*
+ * Wait for a grace period of the kthread's flavor.  The wakeup callback
+ * must bypass the no-CBs lists, as the kthread waiting for it might be
+ * the one that would have to invoke it.
+ */
+static void rcu_nocb_wait_gp(struct rcu_data *rdp)
+{
+	struct rcu_synchronize rcu;
+
+	init_rcu_head_on_stack(&rcu.head);
+	init_completion(&rcu.completion);
+	___call_rcu(&rcu.head, wakeme_after_rcu, rdp->rsp, false);
+	wait_for_completion(&rcu.completion);
+	destroy_rcu_head_on_stack(&rcu.head);
+}
+
+/*
+ * Per-CPU, per-flavor kthread that invokes the callbacks of a no-CBs CPU.
+ * Each pass takes the whole list, so callbacks keep their queueing order,
+ * which is what rcu_barrier() relies on.
+ */
+static int rcu_nocb_kthread(void *arg)
+{
+	struct rcu_data *rdp = arg;
+	struct rcu_head *list, *next, **tail;
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(rdp->nocb_wq,
+					 ACCESS_ONCE(rdp->nocb_head) ||
+					 kthread_should_stop());
+
+		/*
+		 * Take the list, leaving it empty for rcu_nocb_enqueue().
+		 * The xchg() keeps rcu_nocb_adopt_cbs() from taking it too.
+		 */
+		list = xchg(&rdp->nocb_head, NULL);
+		if (!list)
+			continue;
+		tail = xchg(&rdp->nocb_tail, &rdp->nocb_head);
+
+		rcu_nocb_wait_gp(rdp);
+
+		while (list) {
+			/* An enqueuer might still be linking in the tail. */
+			next = ACCESS_ONCE(list->next);
+			while (next == NULL && &list->next != tail) {
+				schedule_timeout_interruptible(1);
+				next = ACCESS_ONCE(list->next);
+			}
+			debug_rcu_head_unqueue(list);
+			local_bh_disable();
+			list->func(list);
+			local_bh_enable();
+			atomic_long_dec(&rdp->nocb_q_count);
+			rdp->nocb_invoked++;
+			list = next;
+		}
+
+		/* For rcu_nocb_offline_cpu(), waiting for the batch. */
+		wake_up(&rdp->nocb_wq);
+	}
+	return 0;
+}
+
+/*
+ * Move the callbacks still queued for the kthread of @rdp to the current
+ * CPU's own list, to be invoked from softirq.  The caller makes sure that
+ * nothing is queued on @rdp meanwhile, so the list is fully linked.
+ */
+static void rcu_nocb_adopt_cbs(struct rcu_data *rdp)
+{
+	struct rcu_data *this_rdp;
+	struct rcu_head *list, *rhp, **tail;
+	unsigned long flags;
+	long n = 0;
+
+	list = xchg(&rdp->nocb_head, NULL);
+	if (!list)
+		return;
+	tail = xchg(&rdp->nocb_tail, &rdp->nocb_head);
+	for (rhp = list; rhp; rhp = rhp->next)
+		n++;
+
+	local_irq_save(flags);
+	this_rdp = rdp->rsp->rda[smp_processor_id()];
+	*this_rdp->nxttail[RCU_NEXT_TAIL] = list;
+	this_rdp->nxttail[RCU_NEXT_TAIL] = tail;
+	this_rdp->qlen += n;
+	local_irq_restore(flags);
+	atomic_long_sub(n, &rdp->nocb_q_count);
+}
+
+#ifdef CONFIG_HOTPLUG_CPU
+
+/*
+ * The CPU is gone, so nothing is queued on it anymore.  Adopt what its
+ * kthread did not take yet, as for the CPU's other callbacks, and wait
+ * for the kthread to invoke the batch it did take, so that rcu_barrier()
+ * covers all of the CPU's callbacks from here on.
+ */
+static void rcu_nocb_offline_cpu(struct rcu_data *rdp)
+{
+	if (!rcu_is_nocb_cpu(rdp->cpu))
+		return;
+	rcu_nocb_adopt_cbs(rdp);
+	wait_event(rdp->nocb_wq, !atomic_long_read(&rdp->nocb_q_count));
+}
+
+#endif /* #ifdef CONFIG_HOTPLUG_CPU */
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp,
+						  struct rcu_state *rsp)
+{
+	rdp->nocb_head = NULL;
+	rdp->nocb_tail = &rdp->nocb_head;
+	atomic_long_set(&rdp->nocb_q_count, 0);
+	init_waitqueue_head(&rdp->nocb_wq);
+	rdp->nocb_defer_wakeup = false;
+	rdp->nocb_softirq = false;
+	rdp->rsp = rsp;
+}
+
+static void __init rcu_spawn_nocb_kthreads(struct rcu_state *rsp)
+{
+	struct task_struct *t;
+	struct rcu_data *rdp;
+	int cpu;
+
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		if (cpu >= nr_cpu_ids)
+			break;
+		rdp = rsp->rda[cpu];
+		t = kthread_run(rcu_nocb_kthread, rdp,
+				"rcuo%c/%d", rsp->name[4], cpu);
+		if (IS_ERR(t)) {
+			printk(KERN_WARNING "RCU: no rcuo%c kthread for "
+			       "CPU %d, invoking its callbacks from softirq.\n",
+			       rsp->name[4], cpu);
+			/*
+			 * Only the boot CPU is online this early, and
+			 * rcu_nocb_enqueue() runs with irqs disabled, so
+			 * once the flag is set nothing is added to the list.
+			 */
+			rdp->nocb_softirq = true;
+			barrier();
+			rcu_nocb_adopt_cbs(rdp);
+			continue;
+		}
+		rdp->nocb_kthread = t;
+	}
+}
+
+static int __init rcu_spawn_nocb_kthreads_all(void)
+{
+	char buf[128];
+
+	if (!have_rcu_nocb_mask)
+		return 0;
+	cpulist_scnprintf(buf, sizeof(buf), rcu_nocb_mask);
+	printk(KERN_INFO "RCU: callbacks offloaded from CPUs: %s.\n", buf);
+	rcu_spawn_nocb_kthreads(&rcu_sched_state);
+	rcu_spawn_nocb_kthreads(&rcu_bh_state);
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	rcu_spawn_nocb_kthreads(&rcu_preempt_state);
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	return 0;
+}
+early_initcall(rcu_spawn_nocb_kthreads_all);
+
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+
+static bool rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *head,
+			     bool irqs_were_disabled)
+{
+	return false;
+}
+
+static bool rcu_nocb_need_deferred_wakeup(int cpu)
+{
+	return false;
+}
+
+static void rcu_nocb_deferred_wakeup(int cpu)
+{
+}
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp,
+						  struct rcu_state *rsp)
+{
+}
+
+#ifdef CONFIG_HOTPLUG_CPU
+
+static void rcu_nocb_offline_cpu(struct rcu_data *rdp)
+{
+}
+
+#endif /* #ifdef CONFIG_HOTPLUG_CPU */
+
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
@@ -64,7 +64,14 @@ static void print_one_rcu_data(struct seq_file *m, struct rcu_data *rdp)
 		   rdp->dynticks_fqs);
 #endif /* #ifdef CONFIG_NO_HZ */
 	seq_printf(m, " of=%lu ri=%lu", rdp->offline_fqs, rdp->resched_ipi);
-	seq_printf(m, " ql=%ld b=%ld\n", rdp->qlen, rdp->blimit);
+	seq_printf(m, " ql=%ld b=%ld", rdp->qlen, rdp->blimit);
+#ifdef CONFIG_RCU_NOCB_CPU
+	if (rdp->nocb_kthread)
+		seq_printf(m, " nq=%ld ni=%lu",
+			   atomic_long_read(&rdp->nocb_q_count),
+			   rdp->nocb_invoked);
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+	seq_puts(m, "\n");
 }
 
 #define PRINT_RCU_DATA(name, func, m) \
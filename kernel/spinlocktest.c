@@ -0,0 +1,129 @@
+/*
+ * Spinlock contention benchmark module
+ *
+ * Starts one kthread per online cpu (or nr_threads of them), all of
+ * which take the same spinlock over and over for a while, and reports
+ * how many times the lock was taken in total and how evenly it was
+ * shared between the threads.  The threads also check that they never
+ * find the lock owned by somebody else, so that this doubles as a
+ * torture test for a new spinlock implementation.  Compare kernels with
+ * and without CONFIG_ARM_QUEUED_SPINLOCKS, e.g. under "qemu -smp 4".
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ */
+
+#include <linux/cpubench.h>
+#include <linux/jiffies.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+
+static int nthreads;
+static int seconds = 5;
+static int hold_loops = 50;
+static int pause_loops = 50;
+
+module_param_named(nr_threads, nthreads, int, 0444);
+MODULE_PARM_DESC(nr_threads, "Number of threads (default: one per cpu)");
+module_param(seconds, int, 0444);
+MODULE_PARM_DESC(seconds, "How long to run (s)");
+module_param(hold_loops, int, 0444);
+MODULE_PARM_DESC(hold_loops, "Busy loops with the lock held");
+module_param(pause_loops, int, 0444);
+MODULE_PARM_DESC(pause_loops, "Busy loops between two lock operations");
+
+static DEFINE_SPINLOCK(test_lock);
+static int test_owner = -1;		/* protected by test_lock */
+static unsigned long test_count;	/* protected by test_lock */
+static atomic_t test_errors;
+
+static unsigned long *acquired;		/* per thread */
+
+static void busy_loop(int loops)
+{
+	while (loops--)
+		cpu_relax();
+}
+
+static void lock_thread_fn(struct cpu_bench *bench, int thread, int round)
+{
+	unsigned long end = jiffies + seconds * HZ;
+
+	while (time_before(jiffies, end)) {
+		spin_lock(&test_lock);
+		if (test_owner != -1)
+			atomic_inc(&test_errors);
+		test_owner = thread;
+		test_count++;
+		busy_loop(hold_loops);
+		if (test_owner != thread)
+			atomic_inc(&test_errors);
+		test_owner = -1;
+		spin_unlock(&test_lock);
+
+		acquired[thread]++;
+		busy_loop(pause_loops);
+		if (!(acquired[thread] & 1023))
+			cond_resched();
+	}
+}
+
+static struct cpu_bench spinlock_bench = {
+	.name		= "spinlocktest",
+	.nr_rounds	= 1,
+	.nr_tests	= 1,
+	.fn		= lock_thread_fn,
+};
+
+static int __init spinlock_test(void)
+{
+	unsigned long total = 0, lo = ULONG_MAX, hi = 0;
+	int i, ret;
+
+	if (nthreads <= 0)
+		nthreads = num_online_cpus();
+	if (seconds <= 0 || hold_loops < 0 || pause_loops < 0)
+		return -EINVAL;
+
+	acquired = kcalloc(nthreads, sizeof(*acquired), GFP_KERNEL);
+	if (!acquired)
+		return -ENOMEM;
+
+	spinlock_bench.nr_threads = nthreads;
+	ret = cpu_bench_run(&spinlock_bench);
+	if (ret)
+		goto free;
+	cpu_bench_free(&spinlock_bench);
+
+	for (i = 0; i < nthreads; i++) {
+		total += acquired[i];
+		lo = min(lo, acquired[i]);
+		hi = max(hi, acquired[i]);
+	}
+	if (total != test_count)
+		atomic_inc(&test_errors);
+
+	printk(KERN_INFO "spinlocktest: %d threads, %d s, hold %d, "
+	       "pause %d\n", nthreads, seconds, hold_loops, pause_loops);
+	printk(KERN_INFO "spinlocktest: %lu locks/s, per thread min %lu "
+	       "max %lu (%lu%%), %d errors\n", total / seconds, lo, hi,
+	       hi ? lo * 100 / hi : 0, atomic_read(&test_errors));
+
+	if (atomic_read(&test_errors))
+		ret = -EIO;
+free:
+	kfree(acquired);
+	return ret;
+}
+
+static void __exit spinlock_test_exit(void)
+{
+}
+
+module_init(spinlock_test);
+module_exit(spinlock_test_exit);
+MODULE_LICENSE("GPL");
@@ -124,6 +124,50 @@ static int __init setup_tick_nohz(char *str)
 
 __setup("nohz=", setup_tick_nohz);
 
+/*
+ * An idle CPU that still has RCU callbacks used to keep its tick running
+ * until RCU was done with it. With nohz_batch=, let it sleep until the
+ * next batch boundary instead. The boundaries are global multiples of
+ * tick_nohz_batch, so the idle CPUs waiting on RCU all wake up on the
+ * same tick, which is a tick the busy CPUs take anyway. Deferrable timers
+ * never wake an idle CPU and simply expire with the batch.
+ *
+ * The price is grace period latency: the callbacks of an idle CPU only
+ * advance on its own tick, so every call_rcu(), synchronize_rcu() or
+ * rcu_barrier() that involves a batched CPU waits up to a batch longer
+ * for each step. 0, the default, keeps the tick running.
+ */
+static unsigned long tick_nohz_batch __read_mostly;
+
+static int __init setup_tick_nohz_batch(char *str)
+{
+	unsigned long msecs;
+
+	if (strict_strtoul(str, 0, &msecs))
+		return 0;
+	tick_nohz_batch = msecs_to_jiffies(msecs);
+	return 1;
+}
+
+__setup("nohz_batch=", setup_tick_nohz_batch);
+
+/*
+ * Count the ticks a batched CPU slept through: with its tick running for
+ * RCU, it would have woken up on each of them.
+ */
+static void tick_nohz_account_batch(struct tick_sched *ts, unsigned long now)
+{
+	unsigned long ticks;
+
+	if (!ts->batch_active)
+		return;
+
+	ts->batch_active = 0;
+	ticks = now - ts->batch_jiffies;
+	if (ticks > 1 && ticks < LONG_MAX)
+		ts->wakeups_avoided += ticks - 1;
+}
+
 /**
  * tick_nohz_update_jiffies - update jiffies when idle was interrupted
  *
@@ -262,7 +306,7 @@ void tick_nohz_stop_sched_tick(int inidle)
 	ktime_t last_update, expires, now;
 	struct clock_event_device *dev = __get_cpu_var(tick_cpu_device).evtdev;
 	u64 time_delta;
-	int cpu;
+	int cpu, rcu_pending;
 
 	local_irq_save(flags);
 
@@ -324,13 +368,29 @@ void tick_nohz_stop_sched_tick(int inidle)
 		time_delta = timekeeping_max_deferment();
 	} while (read_seqretry(&xtime_lock, seq));
 
-	if (rcu_needs_cpu(cpu) || printk_needs_cpu(cpu) ||
+	tick_nohz_account_batch(ts, last_jiffies);
+
+	rcu_pending = rcu_needs_cpu(cpu);
+	if ((rcu_pending && !tick_nohz_batch) || printk_needs_cpu(cpu) ||
 	    arch_needs_cpu(cpu)) {
 		next_jiffies = last_jiffies + 1;
 		delta_jiffies = 1;
 	} else {
 		/* Get the next timer wheel timer */
 		next_jiffies = get_next_timer_interrupt(last_jiffies);
+
+		if (rcu_pending) {
+			unsigned long batch = last_jiffies + tick_nohz_batch -
+					      last_jiffies % tick_nohz_batch;
+
+			if (time_before(batch, next_jiffies))
+				next_jiffies = batch;
+			if (next_jiffies - last_jiffies > 1) {
+				ts->idle_batched++;
+				ts->batch_jiffies = last_jiffies;
+				ts->batch_active = 1;
+			}
+		}
 		delta_jiffies = next_jiffies - last_jiffies;
 	}
 	/*
@@ -526,6 +586,7 @@ void tick_nohz_restart_sched_tick(void)
 	select_nohz_load_balancer(0);
 	tick_do_update_jiffies64(now);
 	cpumask_clear_cpu(cpu, nohz_cpu_mask);
+	tick_nohz_account_batch(ts, jiffies);
 
 #ifndef CONFIG_VIRT_CPU_ACCOUNTING
 	/*
@@ -40,6 +40,8 @@
 #include <linux/perf_event.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 
 #include <asm/uaccess.h>
 #include <asm/unistd.h>
@@ -55,33 +57,91 @@ u64 jiffies_64 __cacheline_aligned_in_smp = INITIAL_JIFFIES;
 EXPORT_SYMBOL(jiffies_64);
 
 /*
- * per-CPU timer vector definitions:
+ * The timer wheel has LVL_DEPTH levels of LVL_SIZE buckets each. Level 0
+ * has a granularity of one jiffy, and each following level is LVL_CLK_DIV
+ * times coarser than the previous one:
+ *
+ * HZ 1000, LVL_DEPTH 9
+ * Level Offset  Granularity            Range
+ *  0      0          1 ms               0 ms -         62 ms
+ *  1     64          8 ms              63 ms -        503 ms
+ *  2    128         64 ms             504 ms -       4031 ms
+ *  3    192        512 ms            4032 ms -      32255 ms
+ *  4    256       4096 ms           32256 ms -     258047 ms
+ *  5    320      32768 ms          258048 ms -    2064383 ms
+ *  6    384     262144 ms         2064384 ms -   16515071 ms
+ *  7    448    2097152 ms        16515072 ms -  132120575 ms
+ *  8    512   16777216 ms       132120576 ms - ~12 days
+ *
+ * HZ 100, LVL_DEPTH 8
+ * Level Offset  Granularity            Range
+ *  0      0         10 ms               0 ms -        620 ms
+ *  1     64         80 ms             630 ms -       5030 ms
+ *  2    128        640 ms            5040 ms -      40310 ms
+ *  3    192       5120 ms           40320 ms -     322550 ms
+ *  4    256      40960 ms          322560 ms -    2580470 ms
+ *  5    320     327680 ms         2580480 ms -   20643830 ms
+ *  6    384    2621440 ms        20643840 ms -  165150710 ms
+ *  7    448   20971520 ms       165150720 ms - ~15 days
+ *
+ * A timer is queued in the level that covers its timeout, in the bucket
+ * that expires at or after timer->expires. Timers are never cascaded down
+ * to finer levels, so a timer in an outer level expires up to one bucket
+ * granularity late, which is at most ~12% of its timeout. In exchange
+ * nothing ever has to be moved around at the tick, and all the timers of a
+ * bucket expire together in one batch. Timeouts beyond the range of the
+ * last level are clamped to its capacity.
+ *
+ * pending_map has one bit per bucket, set when the bucket is not empty. It
+ * lets the expiry path and the NOHZ next event search skip empty buckets.
  */
-#define TVN_BITS (CONFIG_BASE_SMALL ? 4 : 6)
-#define TVR_BITS (CONFIG_BASE_SMALL ? 6 : 8)
-#define TVN_SIZE (1 << TVN_BITS)
-#define TVR_SIZE (1 << TVR_BITS)
-#define TVN_MASK (TVN_SIZE - 1)
-#define TVR_MASK (TVR_SIZE - 1)
-
-struct tvec {
-	struct list_head vec[TVN_SIZE];
-};
+#define LVL_CLK_SHIFT	3
+#define LVL_CLK_DIV	(1UL << LVL_CLK_SHIFT)
+#define LVL_CLK_MASK	(LVL_CLK_DIV - 1)
+#define LVL_SHIFT(n)	((n) * LVL_CLK_SHIFT)
+#define LVL_GRAN(n)	(1UL << LVL_SHIFT(n))
+
+#define LVL_BITS	6
+#define LVL_SIZE	(1UL << LVL_BITS)
+#define LVL_MASK	(LVL_SIZE - 1)
+#define LVL_OFFS(n)	((n) * LVL_SIZE)
+
+/* First timeout (delta) that goes to level n */
+#define LVL_START(n)	((LVL_SIZE - 1) << (((n) - 1) * LVL_CLK_SHIFT))
+
+#if HZ > 100
+# define LVL_DEPTH	9
+#else
+# define LVL_DEPTH	8
+#endif
+
+#define WHEEL_SIZE	(LVL_SIZE * LVL_DEPTH)
 
-struct tvec_root {
-	struct list_head vec[TVR_SIZE];
+/* Longer timeouts are clamped to WHEEL_TIMEOUT_MAX */
+#define WHEEL_TIMEOUT_CUTOFF	LVL_START(LVL_DEPTH)
+#define WHEEL_TIMEOUT_MAX	(WHEEL_TIMEOUT_CUTOFF - LVL_GRAN(LVL_DEPTH - 1))
+
+/*
+ * Per-CPU expiry statistics, shown in /proc/timer_wheel. A batch is one
+ * jiffy of the wheel clock that expired at least one timer, so batches
+ * approximate the timer wakeups of the CPU.
+ */
+struct tvec_stats {
+	unsigned long expired;
+	unsigned long batches;
+	unsigned long max_batch;
+	unsigned long late;
+	unsigned long buckets[LVL_DEPTH];
 };
 
 struct tvec_base {
 	spinlock_t lock;
 	struct timer_list *running_timer;
-	unsigned long timer_jiffies;
+	unsigned long clk;
 	unsigned long next_timer;
-	struct tvec_root tv1;
-	struct tvec tv2;
-	struct tvec tv3;
-	struct tvec tv4;
-	struct tvec tv5;
+	DECLARE_BITMAP(pending_map, WHEEL_SIZE);
+	struct list_head vectors[WHEEL_SIZE];
+	struct tvec_stats stats;
 } ____cacheline_aligned;
 
 struct tvec_base boot_tvec_bases;
@@ -334,8 +394,8 @@ EXPORT_SYMBOL_GPL(round_jiffies_up_relative);
  * will schedule the actual timer somewhere between
  * the time mod_timer() asks for, and that time plus the slack.
  *
- * By setting the slack to -1, a percentage of the delay is used
- * instead.
+ * By setting the slack to -1, the default, the timer only gets the
+ * implicit slack of the timer wheel bucket it is queued in.
  */
 void set_timer_slack(struct timer_list *timer, int slack_hz)
 {
@@ -352,46 +412,61 @@ static inline void set_running_timer(struct tvec_base *base,
 #endif
 }
 
-static void internal_add_timer(struct tvec_base *base, struct timer_list *timer)
+/*
+ * Bucket of @expires in level @lvl. The bucket is rounded up so the timer
+ * never expires early, and its expiry time is returned in @bucket_expiry.
+ */
+static inline unsigned int calc_index(unsigned long expires, unsigned int lvl,
+				      unsigned long *bucket_expiry)
+{
+	expires = (expires + LVL_GRAN(lvl) - 1) >> LVL_SHIFT(lvl);
+	*bucket_expiry = expires << LVL_SHIFT(lvl);
+	return LVL_OFFS(lvl) + (expires & LVL_MASK);
+}
+
+static unsigned int calc_wheel_index(unsigned long expires, unsigned long clk,
+				     unsigned long *bucket_expiry)
 {
-	unsigned long expires = timer->expires;
-	unsigned long idx = expires - base->timer_jiffies;
-	struct list_head *vec;
-
-	if (idx < TVR_SIZE) {
-		int i = expires & TVR_MASK;
-		vec = base->tv1.vec + i;
-	} else if (idx < 1 << (TVR_BITS + TVN_BITS)) {
-		int i = (expires >> TVR_BITS) & TVN_MASK;
-		vec = base->tv2.vec + i;
-	} else if (idx < 1 << (TVR_BITS + 2 * TVN_BITS)) {
-		int i = (expires >> (TVR_BITS + TVN_BITS)) & TVN_MASK;
-		vec = base->tv3.vec + i;
-	} else if (idx < 1 << (TVR_BITS + 3 * TVN_BITS)) {
-		int i = (expires >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK;
-		vec = base->tv4.vec + i;
-	} else if ((signed long) idx < 0) {
+	unsigned long delta = expires - clk;
+	unsigned int lvl;
+
+	if ((long) delta < 0) {
 		/*
 		 * Can happen if you add a timer with expires == jiffies,
 		 * or you set a timer to go off in the past
 		 */
-		vec = base->tv1.vec + (base->timer_jiffies & TVR_MASK);
-	} else {
-		int i;
-		/* If the timeout is larger than 0xffffffff on 64-bit
-		 * architectures then we use the maximum timeout:
-		 */
-		if (idx > 0xffffffffUL) {
-			idx = 0xffffffffUL;
-			expires = idx + base->timer_jiffies;
-		}
-		i = (expires >> (TVR_BITS + 3 * TVN_BITS)) & TVN_MASK;
-		vec = base->tv5.vec + i;
+		*bucket_expiry = clk;
+		return clk & LVL_MASK;
+	}
+
+	if (delta >= WHEEL_TIMEOUT_CUTOFF) {
+		expires = clk + WHEEL_TIMEOUT_MAX;
+		delta = WHEEL_TIMEOUT_MAX;
 	}
+
+	for (lvl = 0; lvl < LVL_DEPTH - 1; lvl++)
+		if (delta < LVL_START(lvl + 1))
+			break;
+
+	return calc_index(expires, lvl, bucket_expiry);
+}
+
+static void internal_add_timer(struct tvec_base *base, struct timer_list *timer)
+{
+	unsigned long bucket_expiry;
+	unsigned int idx;
+
+	idx = calc_wheel_index(timer->expires, base->clk, &bucket_expiry);
+
 	/*
 	 * Timers are FIFO:
 	 */
-	list_add_tail(&timer->entry, vec);
+	list_add_tail(&timer->entry, base->vectors + idx);
+	__set_bit(idx, base->pending_map);
+
+	if (time_before(bucket_expiry, base->next_timer) &&
+	    !tbase_get_deferrable(timer->base))
+		base->next_timer = bucket_expiry;
 }
 
 #ifdef CONFIG_TIMER_STATS
@@ -637,6 +712,52 @@ static inline void detach_timer(struct timer_list *timer,
 	entry->prev = LIST_POISON2;
 }
 
+/*
+ * Remove a pending timer from the wheel of @base. The last timer of a
+ * bucket clears its pending bit. Timers that __run_timers() has already
+ * taken off the wheel sit on a private list and are only unlinked.
+ */
+static void detach_wheel_timer(struct tvec_base *base,
+			       struct timer_list *timer, int clear_pending)
+{
+	struct list_head *head = timer->entry.next;
+
+	if (head == timer->entry.prev &&
+	    head >= base->vectors && head < base->vectors + WHEEL_SIZE)
+		__clear_bit(head - base->vectors, base->pending_map);
+
+	detach_timer(timer, clear_pending);
+
+	/* It may have been the first one to expire: recompute later */
+	if (time_before_eq(timer->expires, base->next_timer) &&
+	    !tbase_get_deferrable(timer->base))
+		base->next_timer = base->clk;
+}
+
+/*
+ * The wheel clock of an idle NOHZ CPU lags behind jiffies. Catch it up
+ * before queueing a timer, or the timer would be sorted into a coarser
+ * level than its timeout asks for. The clock may only skip over empty
+ * buckets, so it stops at the first pending one.
+ */
+static unsigned long next_wheel_event(struct tvec_base *base,
+				      bool skip_deferrable);
+
+static inline void forward_timer_base(struct tvec_base *base)
+{
+	unsigned long jnow = jiffies;
+	unsigned long next;
+
+	if ((long)(jnow - base->clk) < 2)
+		return;
+
+	next = next_wheel_event(base, false);
+	if (time_after(next, jnow))
+		base->clk = jnow;
+	else
+		base->clk = next;
+}
+
 /*
  * We are using hashed locking: holding per_cpu(tvec_bases).lock
  * means that all timers which are tied to this base via timer->base are
@@ -683,10 +804,7 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 	base = lock_timer_base(timer, &flags);
 
 	if (timer_pending(timer)) {
-		detach_timer(timer, 0);
-		if (timer->expires == base->next_timer &&
-		    !tbase_get_deferrable(timer->base))
-			base->next_timer = base->timer_jiffies;
+		detach_wheel_timer(base, timer, 0);
 		ret = 1;
 	} else {
 		if (pending_only)
@@ -722,9 +840,7 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 	}
 
 	timer->expires = expires;
-	if (time_before(timer->expires, base->next_timer) &&
-	    !tbase_get_deferrable(timer->base))
-		base->next_timer = timer->expires;
+	forward_timer_base(base);
 	internal_add_timer(base, timer);
 
 out_unlock:
@@ -752,6 +868,10 @@ EXPORT_SYMBOL(mod_timer_pending);
 /*
  * Decide where to put the timer while taking the slack into account
  *
+ * Timers with an explicit slack are pushed to the most rounded jiffy within
+ * their slack, so that the slack timers of a whole window land in the same
+ * wheel bucket and expire in one batch.
+ *
  * Algorithm:
  *   1) calculate the maximum (absolute) time
  *   2) calculate the highest bit where the expires and new max are different
@@ -765,17 +885,11 @@ unsigned long apply_slack(struct timer_list *timer, unsigned long expires)
 	unsigned long expires_limit, mask;
 	int bit;
 
-	expires_limit = expires;
-
-	if (timer->slack >= 0) {
-		expires_limit = expires + timer->slack;
-	} else {
-		unsigned long now = jiffies;
+	/* The wheel granularity is all the slack these get */
+	if (timer->slack < 0)
+		return expires;
 
-		/* No slack, if already expired else auto slack 0.4% */
-		if (time_after(expires, now))
-			expires_limit = expires + (expires - now)/256;
-	}
+	expires_limit = expires + timer->slack;
 	mask = expires ^ expires_limit;
 	if (mask == 0)
 		return expires;
@@ -885,9 +999,7 @@ void add_timer_on(struct timer_list *timer, int cpu)
 	spin_lock_irqsave(&base->lock, flags);
 	timer_set_base(timer, base);
 	debug_activate(timer, timer->expires);
-	if (time_before(timer->expires, base->next_timer) &&
-	    !tbase_get_deferrable(timer->base))
-		base->next_timer = timer->expires;
+	forward_timer_base(base);
 	internal_add_timer(base, timer);
 	/*
 	 * Check whether the other CPU is idle and needs to be
@@ -923,10 +1035,7 @@ int del_timer(struct timer_list *timer)
 	if (timer_pending(timer)) {
 		base = lock_timer_base(timer, &flags);
 		if (timer_pending(timer)) {
-			detach_timer(timer, 1);
-			if (timer->expires == base->next_timer &&
-			    !tbase_get_deferrable(timer->base))
-				base->next_timer = base->timer_jiffies;
+			detach_wheel_timer(base, timer, 1);
 			ret = 1;
 		}
 		spin_unlock_irqrestore(&base->lock, flags);
@@ -960,10 +1069,7 @@ int try_to_del_timer_sync(struct timer_list *timer)
 	timer_stats_timer_clear_start_info(timer);
 	ret = 0;
 	if (timer_pending(timer)) {
-		detach_timer(timer, 1);
-		if (timer->expires == base->next_timer &&
-		    !tbase_get_deferrable(timer->base))
-			base->next_timer = base->timer_jiffies;
+		detach_wheel_timer(base, timer, 1);
 		ret = 1;
 	}
 out:
@@ -1011,26 +1117,6 @@ int del_timer_sync(struct timer_list *timer)
 EXPORT_SYMBOL(del_timer_sync);
 #endif
 
-static int cascade(struct tvec_base *base, struct tvec *tv, int index)
-{
-	/* cascade all the timers from tv up one level */
-	struct timer_list *timer, *tmp;
-	struct list_head tv_list;
-
-	list_replace_init(tv->vec + index, &tv_list);
-
-	/*
-	 * We are removing _all_ timers from the list, so we
-	 * don't have to detach them individually.
-	 */
-	list_for_each_entry_safe(timer, tmp, &tv_list, entry) {
-		BUG_ON(tbase_get_base(timer->base) != base);
-		internal_add_timer(base, timer);
-	}
-
-	return index;
-}
-
 static void call_timer_fn(struct timer_list *timer, void (*fn)(unsigned long),
 			  unsigned long data)
 {
@@ -1072,133 +1158,196 @@ static void call_timer_fn(struct timer_list *timer, void (*fn)(unsigned long),
 	}
 }
 
-#define INDEX(N) ((base->timer_jiffies >> (TVR_BITS + (N) * TVN_BITS)) & TVN_MASK)
+static void expire_timers(struct tvec_base *base, struct list_head *head)
+{
+	unsigned long now = base->clk - 1;
+
+	while (!list_empty(head)) {
+		struct timer_list *timer;
+		void (*fn)(unsigned long);
+		unsigned long data;
+
+		timer = list_first_entry(head, struct timer_list, entry);
+		fn = timer->function;
+		data = timer->data;
+
+		timer_stats_account_timer(timer);
+
+		base->stats.expired++;
+		if (time_after(now, timer->expires))
+			base->stats.late++;
+
+		set_running_timer(base, timer);
+		detach_timer(timer, 1);
+
+		spin_unlock_irq(&base->lock);
+		call_timer_fn(timer, fn, data);
+		spin_lock_irq(&base->lock);
+	}
+}
+
+/*
+ * Move the buckets that expire at base->clk, at most one per level, to
+ * @heads and return how many there are.
+ */
+static int __collect_expired_timers(struct tvec_base *base,
+				    struct list_head *heads)
+{
+	unsigned long clk = base->clk;
+	unsigned int idx;
+	int i, levels = 0;
+
+	for (i = 0; i < LVL_DEPTH; i++) {
+		idx = (clk & LVL_MASK) + i * LVL_SIZE;
+
+		if (__test_and_clear_bit(idx, base->pending_map)) {
+			list_replace_init(base->vectors + idx, heads++);
+			base->stats.buckets[i]++;
+			levels++;
+		}
+		/* Is it time to look at the next level? */
+		if (clk & LVL_CLK_MASK)
+			break;
+		/* Shift clock for the next level granularity */
+		clk >>= LVL_CLK_SHIFT;
+	}
+	return levels;
+}
+
+#ifdef CONFIG_NO_HZ
+static int collect_expired_timers(struct tvec_base *base,
+				  struct list_head *heads)
+{
+	/*
+	 * After a long idle sleep the wheel clock is far behind jiffies.
+	 * Instead of walking it up one jiffy at a time, jump straight to
+	 * the next pending bucket, or to jiffies if that is later.
+	 */
+	if ((long)(jiffies - base->clk) > 2) {
+		unsigned long next = next_wheel_event(base, false);
+
+		if (time_after(next, jiffies)) {
+			/* The caller increments the clock */
+			base->clk = jiffies - 1;
+			return 0;
+		}
+		base->clk = next;
+	}
+	return __collect_expired_timers(base, heads);
+}
+#else
+static inline int collect_expired_timers(struct tvec_base *base,
+					 struct list_head *heads)
+{
+	return __collect_expired_timers(base, heads);
+}
+#endif
 
 /**
  * __run_timers - run all expired timers (if any) on this CPU.
  * @base: the timer vector to be processed.
  *
- * This function cascades all vectors and executes all expired timer
- * vectors.
+ * This function takes all the expired buckets off the wheel, one jiffy
+ * of the wheel clock at a time, and runs their timers.
  */
 static inline void __run_timers(struct tvec_base *base)
 {
-	struct timer_list *timer;
+	struct list_head heads[LVL_DEPTH];
+	unsigned long batch;
+	int levels;
 
 	spin_lock_irq(&base->lock);
-	while (time_after_eq(jiffies, base->timer_jiffies)) {
-		struct list_head work_list;
-		struct list_head *head = &work_list;
-		int index = base->timer_jiffies & TVR_MASK;
+	while (time_after_eq(jiffies, base->clk)) {
+		levels = collect_expired_timers(base, heads);
+		base->clk++;
 
-		/*
-		 * Cascade timers:
-		 */
-		if (!index &&
-			(!cascade(base, &base->tv2, INDEX(0))) &&
-				(!cascade(base, &base->tv3, INDEX(1))) &&
-					!cascade(base, &base->tv4, INDEX(2)))
-			cascade(base, &base->tv5, INDEX(3));
-		++base->timer_jiffies;
-		list_replace_init(base->tv1.vec + index, &work_list);
-		while (!list_empty(head)) {
-			void (*fn)(unsigned long);
-			unsigned long data;
-
-			timer = list_first_entry(head, struct timer_list,entry);
-			fn = timer->function;
-			data = timer->data;
-
-			timer_stats_account_timer(timer);
-
-			set_running_timer(base, timer);
-			detach_timer(timer, 1);
-
-			spin_unlock_irq(&base->lock);
-			call_timer_fn(timer, fn, data);
-			spin_lock_irq(&base->lock);
-		}
+		if (!levels)
+			continue;
+
+		batch = base->stats.expired;
+		while (levels--)
+			expire_timers(base, heads + levels);
+
+		batch = base->stats.expired - batch;
+		base->stats.batches++;
+		if (batch > base->stats.max_batch)
+			base->stats.max_batch = batch;
 	}
 	set_running_timer(base, NULL);
 	spin_unlock_irq(&base->lock);
 }
 
-#ifdef CONFIG_NO_HZ
+static inline bool bucket_has_wakeup(struct tvec_base *base, unsigned int idx)
+{
+	struct timer_list *timer;
+
+	list_for_each_entry(timer, base->vectors + idx, entry)
+		if (!tbase_get_deferrable(timer->base))
+			return true;
+	return false;
+}
+
 /*
- * Find out when the next timer event is due to happen. This
- * is used on S/390 to stop all activity when a CPU is idle.
- * This function needs to be called with interrupts disabled.
+ * Distance from bucket @clk of the level starting at @offset to the next
+ * pending bucket of that level, or -1 if the level is empty. With
+ * @skip_deferrable, buckets that only hold deferrable timers are ignored.
  */
-static unsigned long __next_timer_interrupt(struct tvec_base *base)
-{
-	unsigned long timer_jiffies = base->timer_jiffies;
-	unsigned long expires = timer_jiffies + NEXT_TIMER_MAX_DELTA;
-	int index, slot, array, found = 0;
-	struct timer_list *nte;
-	struct tvec *varray[4];
-
-	/* Look for timer events in tv1. */
-	index = slot = timer_jiffies & TVR_MASK;
-	do {
-		list_for_each_entry(nte, base->tv1.vec + slot, entry) {
-			if (tbase_get_deferrable(nte->base))
-				continue;
-
-			found = 1;
-			expires = nte->expires;
-			/* Look at the cascade bucket(s)? */
-			if (!index || slot < index)
-				goto cascade;
-			return expires;
-		}
-		slot = (slot + 1) & TVR_MASK;
-	} while (slot != index);
-
-cascade:
-	/* Calculate the next cascade event */
-	if (index)
-		timer_jiffies += TVR_SIZE - index;
-	timer_jiffies >>= TVR_BITS;
-
-	/* Check tv2-tv5. */
-	varray[0] = &base->tv2;
-	varray[1] = &base->tv3;
-	varray[2] = &base->tv4;
-	varray[3] = &base->tv5;
-
-	for (array = 0; array < 4; array++) {
-		struct tvec *varp = varray[array];
-
-		index = slot = timer_jiffies & TVN_MASK;
-		do {
-			list_for_each_entry(nte, varp->vec + slot, entry) {
-				if (tbase_get_deferrable(nte->base))
-					continue;
-
-				found = 1;
-				if (time_before(nte->expires, expires))
-					expires = nte->expires;
-			}
-			/*
-			 * Do we still search for the first timer or are
-			 * we looking up the cascade buckets ?
-			 */
-			if (found) {
-				/* Look at the cascade bucket(s)? */
-				if (!index || slot < index)
-					break;
-				return expires;
-			}
-			slot = (slot + 1) & TVN_MASK;
-		} while (slot != index);
+static int next_pending_bucket(struct tvec_base *base, unsigned int offset,
+			       unsigned int clk, bool skip_deferrable)
+{
+	unsigned int pos, start = offset + clk;
+	unsigned int end = offset + LVL_SIZE;
+
+	for (pos = find_next_bit(base->pending_map, end, start); pos < end;
+	     pos = find_next_bit(base->pending_map, end, pos + 1))
+		if (!skip_deferrable || bucket_has_wakeup(base, pos))
+			return pos - start;
+
+	for (pos = find_next_bit(base->pending_map, start, offset); pos < start;
+	     pos = find_next_bit(base->pending_map, start, pos + 1))
+		if (!skip_deferrable || bucket_has_wakeup(base, pos))
+			return pos + LVL_SIZE - start;
+
+	return -1;
+}
+
+/*
+ * Find the wheel clock value at which the next pending bucket expires,
+ * or base->clk + NEXT_TIMER_MAX_DELTA if there is none.
+ */
+static unsigned long next_wheel_event(struct tvec_base *base,
+				      bool skip_deferrable)
+{
+	unsigned long clk, next, adj;
+	unsigned int lvl, offset = 0;
+
+	next = base->clk + NEXT_TIMER_MAX_DELTA;
+	clk = base->clk;
+	for (lvl = 0; lvl < LVL_DEPTH; lvl++, offset += LVL_SIZE) {
+		int pos = next_pending_bucket(base, offset, clk & LVL_MASK,
+					      skip_deferrable);
+
+		if (pos >= 0) {
+			unsigned long tmp = clk + (unsigned long) pos;
 
-		if (index)
-			timer_jiffies += TVN_SIZE - index;
-		timer_jiffies >>= TVN_BITS;
+			tmp <<= LVL_SHIFT(lvl);
+			if (time_before(tmp, next))
+				next = tmp;
+		}
+		/*
+		 * Clock for the next level. If the lower bits of this
+		 * level's clock are zero, the next level's current bucket
+		 * is still ahead of us. Otherwise it already went by and
+		 * the next expiring bucket of that level is the one after.
+		 */
+		adj = clk & LVL_CLK_MASK ? 1 : 0;
+		clk >>= LVL_CLK_SHIFT;
+		clk += adj;
 	}
-	return expires;
+	return next;
 }
 
+#ifdef CONFIG_NO_HZ
 /*
  * Check, if the next hrtimer event is before the next timer wheel
  * event:
@@ -1259,8 +1408,8 @@ unsigned long get_next_timer_interrupt(unsigned long now)
 	if (cpu_is_offline(smp_processor_id()))
 		return now + NEXT_TIMER_MAX_DELTA;
 	spin_lock(&base->lock);
-	if (time_before_eq(base->next_timer, base->timer_jiffies))
-		base->next_timer = __next_timer_interrupt(base);
+	if (time_before_eq(base->next_timer, base->clk))
+		base->next_timer = next_wheel_event(base, true);
 	expires = base->next_timer;
 	spin_unlock(&base->lock);
 
@@ -1299,7 +1448,7 @@ static void run_timer_softirq(struct softirq_action *h)
 
 	hrtimer_run_pending();
 
-	if (time_after_eq(jiffies, base->timer_jiffies))
+	if (time_after_eq(jiffies, base->clk))
 		__run_timers(base);
 }
 
@@ -1637,17 +1786,12 @@ static int __cpuinit init_timers_cpu(int cpu)
 
 	spin_lock_init(&base->lock);
 
-	for (j = 0; j < TVN_SIZE; j++) {
-		INIT_LIST_HEAD(base->tv5.vec + j);
-		INIT_LIST_HEAD(base->tv4.vec + j);
-		INIT_LIST_HEAD(base->tv3.vec + j);
-		INIT_LIST_HEAD(base->tv2.vec + j);
-	}
-	for (j = 0; j < TVR_SIZE; j++)
-		INIT_LIST_HEAD(base->tv1.vec + j);
+	for (j = 0; j < WHEEL_SIZE; j++)
+		INIT_LIST_HEAD(base->vectors + j);
+	bitmap_zero(base->pending_map, WHEEL_SIZE);
 
-	base->timer_jiffies = jiffies;
-	base->next_timer = base->timer_jiffies;
+	base->clk = jiffies;
+	base->next_timer = base->clk;
 	return 0;
 }
 
@@ -1660,9 +1804,6 @@ static void migrate_timer_list(struct tvec_base *new_base, struct list_head *hea
 		timer = list_first_entry(head, struct timer_list, entry);
 		detach_timer(timer, 0);
 		timer_set_base(timer, new_base);
-		if (time_before(timer->expires, new_base->next_timer) &&
-		    !tbase_get_deferrable(timer->base))
-			new_base->next_timer = timer->expires;
 		internal_add_timer(new_base, timer);
 	}
 }
@@ -1685,14 +1826,10 @@ static void __cpuinit migrate_timers(int cpu)
 
 	BUG_ON(old_base->running_timer);
 
-	for (i = 0; i < TVR_SIZE; i++)
-		migrate_timer_list(new_base, old_base->tv1.vec + i);
-	for (i = 0; i < TVN_SIZE; i++) {
-		migrate_timer_list(new_base, old_base->tv2.vec + i);
-		migrate_timer_list(new_base, old_base->tv3.vec + i);
-		migrate_timer_list(new_base, old_base->tv4.vec + i);
-		migrate_timer_list(new_base, old_base->tv5.vec + i);
-	}
+	forward_timer_base(new_base);
+	for (i = 0; i < WHEEL_SIZE; i++)
+		migrate_timer_list(new_base, old_base->vectors + i);
+	bitmap_zero(old_base->pending_map, WHEEL_SIZE);
 
 	spin_unlock(&old_base->lock);
 	spin_unlock_irq(&new_base->lock);
@@ -1730,6 +1867,53 @@ static struct notifier_block __cpuinitdata timers_nb = {
 };
 
 
+#ifdef CONFIG_PROC_FS
+static int timer_wheel_show(struct seq_file *m, void *v)
+{
+	int cpu, lvl;
+
+	seq_printf(m, "cpu %12s %12s %9s %12s", "expired", "batches",
+		   "max_batch", "late");
+	for (lvl = 0; lvl < LVL_DEPTH; lvl++)
+		seq_printf(m, "     lvl%d", lvl);
+	seq_putc(m, '\n');
+
+	for_each_online_cpu(cpu) {
+		struct tvec_stats *st = &per_cpu(tvec_bases, cpu)->stats;
+
+		seq_printf(m, "%3d %12lu %12lu %9lu %12lu", cpu, st->expired,
+			   st->batches, st->max_batch, st->late);
+		for (lvl = 0; lvl < LVL_DEPTH; lvl++)
+			seq_printf(m, " %9lu", st->buckets[lvl]);
+		seq_putc(m, '\n');
+	}
+	return 0;
+}
+
+static int timer_wheel_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, timer_wheel_show, NULL);
+}
+
+static const struct file_operations timer_wheel_fops = {
+	.open		= timer_wheel_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init init_timer_wheel_procfs(void)
+{
+	struct proc_dir_entry *pe;
+
+	pe = proc_create("timer_wheel", 0444, NULL, &timer_wheel_fops);
+	if (!pe)
+		return -ENOMEM;
+	return 0;
+}
+__initcall(init_timer_wheel_procfs);
+#endif
+
 void __init init_timers(void)
 {
 	int err = timer_cpu_notify(&timers_nb, (unsigned long)CPU_UP_PREPARE,
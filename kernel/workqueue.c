@@ -41,6 +41,8 @@
 #include <linux/debug_locks.h>
 #include <linux/lockdep.h>
 #include <linux/idr.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/workqueue.h>
@@ -87,6 +89,8 @@ enum {
 	CREATE_COOLDOWN		= HZ,		/* time to breath after fail */
 	TRUSTEE_COOLDOWN	= HZ / 10,	/* for trustee draining */
 
+	STEAL_SCAN_MAX		= 16,		/* works to look at per steal */
+
 	/*
 	 * Rescue workers are used only on emergencies and shared by
 	 * all cpus.  Give -20.
@@ -168,6 +172,14 @@ struct global_cwq {
 	unsigned int		trustee_state;	/* L: trustee state */
 	wait_queue_head_t	trustee_wait;	/* trustee wait */
 	struct worker		*first_idle;	/* L: first idle worker */
+
+#ifdef CONFIG_WORKQUEUE_STATS
+	unsigned long		nr_stolen;	/* L: works stolen from others */
+	unsigned long		nr_lost;	/* L: works stolen by others */
+	unsigned long		nr_executed;	/* L: works started */
+	u64			lat_total;	/* L: sum of queueing latency */
+	u64			lat_max;	/* L: max queueing latency */
+#endif
 } ____cacheline_aligned_in_smp;
 
 /*
@@ -456,6 +468,17 @@ static DEFINE_PER_CPU_SHARED_ALIGNED(atomic_t, gcwq_nr_running);
 static struct global_cwq unbound_global_cwq;
 static atomic_t unbound_gcwq_nr_running = ATOMIC_INIT(0);	/* always 0 */
 
+/* number of WQ_STEALABLE workqueues, stealing is skipped while zero */
+static atomic_t wq_nr_stealable = ATOMIC_INIT(0);
+
+/*
+ * cpus whose gcwq had nothing to do when a worker last went idle there,
+ * so that wake_up_thief() only has to look at those.  A hint only, the
+ * bits are set and cleared under each gcwq's lock but read without.
+ */
+static DECLARE_BITMAP(gcwq_idle_bits, CONFIG_NR_CPUS);
+static struct cpumask *const gcwq_idle_mask = to_cpumask(gcwq_idle_bits);
+
 static int worker_thread(void *__worker);
 
 static struct global_cwq *get_gcwq(unsigned int cpu)
@@ -607,6 +630,17 @@ static bool keep_working(struct global_cwq *gcwq)
 	return !list_empty(&gcwq->worklist) && atomic_read(nr_running) <= 1;
 }
 
+/*
+ * Are there works on @gcwq which wait behind a running one and could
+ * be executed right away by an idle cpu?  May be called without
+ * gcwq->lock as a hint.
+ */
+static bool may_steal_from(struct global_cwq *gcwq)
+{
+	return !list_empty(&gcwq->worklist) &&
+		atomic_read(get_gcwq_nr_running(gcwq->cpu));
+}
+
 /* Do we need a new worker?  Called from manager. */
 static bool need_to_create_worker(struct global_cwq *gcwq)
 {
@@ -904,6 +938,37 @@ static inline struct list_head *gcwq_determine_ins_pos(struct global_cwq *gcwq,
 	return &twork->entry;
 }
 
+#ifdef CONFIG_WORKQUEUE_STATS
+static void work_stamp_queued(struct work_struct *work)
+{
+	work->queued_at = local_clock();
+}
+
+/*
+ * Account the time @work waited on the worklist.  It might have been
+ * queued on another cpu, so don't trust the clocks to be ordered.
+ */
+static void gcwq_account_start(struct global_cwq *gcwq,
+			       struct work_struct *work)
+{
+	s64 lat = local_clock() - work->queued_at;
+
+	if (lat < 0)
+		lat = 0;
+	gcwq->nr_executed++;
+	gcwq->lat_total += lat;
+	if (lat > gcwq->lat_max)
+		gcwq->lat_max = lat;
+}
+
+#define gcwq_stat_inc(gcwq, field)	((gcwq)->field++)
+#else
+static inline void work_stamp_queued(struct work_struct *work) { }
+static inline void gcwq_account_start(struct global_cwq *gcwq,
+				      struct work_struct *work) { }
+#define gcwq_stat_inc(gcwq, field)	do { } while (0)
+#endif
+
 /**
  * insert_work - insert a work into gcwq
  * @cwq: cwq @work belongs to
@@ -925,6 +990,7 @@ static void insert_work(struct cpu_workqueue_struct *cwq,
 
 	/* we own @work, set data and link */
 	set_work_cwq(work, cwq, extra_flags);
+	work_stamp_queued(work);
 
 	/*
 	 * Ensure that we get the right work->data if we see the
@@ -945,14 +1011,87 @@ static void insert_work(struct cpu_workqueue_struct *cwq,
 		wake_up_worker(gcwq);
 }
 
+/**
+ * cwq_queue_work - queue a work on its cwq
+ * @cwq: cwq to queue @work on
+ * @work: work to queue
+ *
+ * Queue @work, whose PENDING bit the caller owns, on @cwq with the
+ * current work color, either on the worklist or, if @cwq is already at
+ * max_active, on the delayed list.
+ *
+ * CONTEXT:
+ * spin_lock_irq(gcwq->lock).
+ */
+static void cwq_queue_work(struct cpu_workqueue_struct *cwq,
+			   struct work_struct *work)
+{
+	struct list_head *worklist;
+	unsigned int work_flags;
+
+	BUG_ON(!list_empty(&work->entry));
+
+	cwq->nr_in_flight[cwq->work_color]++;
+	work_flags = work_color_to_flags(cwq->work_color);
+
+	if (likely(cwq->nr_active < cwq->max_active)) {
+		cwq->nr_active++;
+		worklist = gcwq_determine_ins_pos(cwq->gcwq, cwq);
+	} else {
+		work_flags |= WORK_STRUCT_DELAYED;
+		worklist = &cwq->delayed_works;
+	}
+
+	insert_work(cwq, work, worklist, work_flags);
+}
+
+/**
+ * wake_up_thief - wake up an idle worker on another cpu
+ * @victim: gcwq with works waiting behind a running one
+ *
+ * Find a gcwq other than @victim which has nothing to do and wake up
+ * one of its idle workers.  The worker won't find anything to do
+ * locally and will try steal_work() before going back to sleep.  Only
+ * the cpus in gcwq_idle_mask are looked at.
+ *
+ * CONTEXT:
+ * Don't hold any gcwq->lock.
+ */
+static void wake_up_thief(struct global_cwq *victim)
+{
+	struct global_cwq *gcwq;
+	unsigned long flags;
+	unsigned int cpu;
+	bool woken = false;
+
+	for_each_cpu(cpu, gcwq_idle_mask) {
+		gcwq = get_gcwq(cpu);
+		if (gcwq == victim || !gcwq->nr_idle ||
+		    !list_empty(&gcwq->worklist) ||
+		    atomic_read(get_gcwq_nr_running(cpu)))
+			continue;
+
+		spin_lock_irqsave(&gcwq->lock, flags);
+		if (!(gcwq->flags & GCWQ_DISASSOCIATED) &&
+		    list_empty(&gcwq->worklist) &&
+		    !atomic_read(get_gcwq_nr_running(cpu)) &&
+		    first_worker(gcwq)) {
+			wake_up_worker(gcwq);
+			woken = true;
+		}
+		spin_unlock_irqrestore(&gcwq->lock, flags);
+
+		if (woken)
+			break;
+	}
+}
+
 static void __queue_work(unsigned int cpu, struct workqueue_struct *wq,
 			 struct work_struct *work)
 {
 	struct global_cwq *gcwq;
-	struct cpu_workqueue_struct *cwq;
-	struct list_head *worklist;
-	unsigned int work_flags;
 	unsigned long flags;
+	bool kick;
 
 	debug_work_activate(work);
 
@@ -996,24 +1135,18 @@ static void __queue_work(unsigned int cpu, struct workqueue_struct *wq,
 	}
 
 	/* gcwq determined, get cwq and queue */
-	cwq = get_cwq(gcwq->cpu, wq);
-
-	BUG_ON(!list_empty(&work->entry));
-
-	cwq->nr_in_flight[cwq->work_color]++;
-	work_flags = work_color_to_flags(cwq->work_color);
-
-	if (likely(cwq->nr_active < cwq->max_active)) {
-		cwq->nr_active++;
-		worklist = gcwq_determine_ins_pos(gcwq, cwq);
-	} else {
-		work_flags |= WORK_STRUCT_DELAYED;
-		worklist = &cwq->delayed_works;
-	}
+	cwq_queue_work(get_cwq(gcwq->cpu, wq), work);
 
-	insert_work(cwq, work, worklist, work_flags);
+	/*
+	 * If @work has to wait behind a running one, see whether an
+	 * idle cpu could steal it.
+	 */
+	kick = wq->flags & WQ_STEALABLE && may_steal_from(gcwq);
 
 	spin_unlock_irqrestore(&gcwq->lock, flags);
+
+	if (kick)
+		wake_up_thief(gcwq);
 }
 
 /**
@@ -1175,6 +1308,11 @@ static void worker_enter_idle(struct worker *worker)
 	} else
 		wake_up_all(&gcwq->trustee_wait);
 
+	if (gcwq->cpu != WORK_CPU_UNBOUND && list_empty(&gcwq->worklist) &&
+	    !atomic_read(get_gcwq_nr_running(gcwq->cpu)) &&
+	    !cpumask_test_cpu(gcwq->cpu, gcwq_idle_mask))
+		cpumask_set_cpu(gcwq->cpu, gcwq_idle_mask);
+
 	/* sanity check nr_running */
 	WARN_ON_ONCE(gcwq->nr_workers == gcwq->nr_idle &&
 		     atomic_read(get_gcwq_nr_running(gcwq->cpu)));
@@ -1197,6 +1335,10 @@ static void worker_leave_idle(struct worker *worker)
 	worker_clr_flags(worker, WORKER_IDLE);
 	gcwq->nr_idle--;
 	list_del_init(&worker->entry);
+
+	if (gcwq->cpu != WORK_CPU_UNBOUND &&
+	    cpumask_test_cpu(gcwq->cpu, gcwq_idle_mask))
+		cpumask_clear_cpu(gcwq->cpu, gcwq_idle_mask);
 }
 
 /**
@@ -1782,6 +1924,7 @@ __acquires(&gcwq->lock)
 
 	/* claim and process */
 	debug_work_deactivate(work);
+	gcwq_account_start(gcwq, work);
 	hlist_add_head(&worker->hentry, bwh);
 	worker->current_work = work;
 	worker->current_cwq = cwq;
@@ -1872,6 +2015,150 @@ static void process_scheduled_works(struct worker *worker)
 	}
 }
 
+/**
+ * grab_stealable_work - take a waiting work off a busy gcwq
+ * @gcwq: gcwq to steal from
+ *
+ * Look for a work of a WQ_STEALABLE workqueue among the first few on
+ * @gcwq's worklist and dequeue it as if it had been cancelled, leaving
+ * its PENDING bit set.  Works linked to a barrier, works currently
+ * executing on @gcwq and works queued before an ongoing flush are left
+ * alone.  wq->flush_mutex keeps the work color of all cwqs in sync, so
+ * it's held across the whole move and the work keeps its color.
+ *
+ * CONTEXT:
+ * spin_lock_irq(gcwq->lock).
+ *
+ * RETURNS:
+ * The dequeued work with its workqueue's flush_mutex held, %NULL if
+ * nothing could be stolen.
+ */
+static struct work_struct *grab_stealable_work(struct global_cwq *gcwq)
+{
+	struct work_struct *work;
+	int scanned = 0;
+
+	if (gcwq->flags & (GCWQ_DISASSOCIATED | GCWQ_FREEZING) ||
+	    !may_steal_from(gcwq))
+		return NULL;
+
+	list_for_each_entry(work, &gcwq->worklist, entry) {
+		struct cpu_workqueue_struct *cwq = get_work_cwq(work);
+		struct workqueue_struct *wq = cwq->wq;
+
+		if (++scanned > STEAL_SCAN_MAX)
+			break;
+		if (!(wq->flags & WQ_STEALABLE) ||
+		    *work_data_bits(work) & WORK_STRUCT_LINKED ||
+		    find_worker_executing_work(gcwq, work))
+			continue;
+
+		if (!mutex_trylock(&wq->flush_mutex))
+			continue;
+		if (wq->flags & WQ_DYING ||
+		    get_work_color(work) != wq->work_color) {
+			mutex_unlock(&wq->flush_mutex);
+			continue;
+		}
+
+		debug_work_deactivate(work);
+		list_del_init(&work->entry);
+		cwq_dec_nr_in_flight(cwq, get_work_color(work), false);
+		return work;
+	}
+	return NULL;
+}
+
+/**
+ * steal_work - steal a waiting work from another cpu
+ * @worker: self
+ *
+ * Called by a worker which is about to go idle.  If nothing else is
+ * going on on this cpu and some WQ_STEALABLE workqueue has works
+ * waiting behind a running one on another cpu, move one of them over
+ * to the local cwq of its workqueue.  Both gcwq locks are held, taken
+ * in cpu order, across the move, so that the work is never seen off
+ * both worklists by try_to_grab_pending() or flush_work(), which retry
+ * when they find it queued on another gcwq than they locked.
+ *
+ * CONTEXT:
+ * spin_lock_irq(gcwq->lock) which may be released and regrabbed.
+ *
+ * RETURNS:
+ * %true if a work was stolen, %false otherwise.
+ */
+static bool steal_work(struct worker *worker)
+__releases(&gcwq->lock)
+__acquires(&gcwq->lock)
+{
+	struct global_cwq *gcwq = worker->gcwq;
+	struct global_cwq *victim;
+	struct work_struct *work = NULL;
+	struct workqueue_struct *wq;
+	unsigned int cpu;
+#ifdef CONFIG_WORKQUEUE_STATS
+	u64 queued_at;
+#endif
+
+	if (likely(!atomic_read(&wq_nr_stealable)) ||
+	    worker->flags & (WORKER_ROGUE | WORKER_UNBOUND) ||
+	    gcwq->flags & GCWQ_DISASSOCIATED ||
+	    !list_empty(&gcwq->worklist) ||
+	    atomic_read(get_gcwq_nr_running(gcwq->cpu)))
+		return false;
+
+	spin_unlock_irq(&gcwq->lock);
+
+	for_each_online_cpu(cpu) {
+		victim = get_gcwq(cpu);
+		if (victim == gcwq || !may_steal_from(victim))
+			continue;
+
+		local_irq_disable();
+		if (victim->cpu < gcwq->cpu) {
+			spin_lock(&victim->lock);
+			spin_lock_nested(&gcwq->lock, SINGLE_DEPTH_NESTING);
+		} else {
+			spin_lock(&gcwq->lock);
+			spin_lock_nested(&victim->lock, SINGLE_DEPTH_NESTING);
+		}
+
+		/* things may have changed here while gcwq->lock was dropped */
+		if (gcwq->flags & GCWQ_DISASSOCIATED ||
+		    !list_empty(&gcwq->worklist)) {
+			spin_unlock(&victim->lock);
+			return false;
+		}
+
+		work = grab_stealable_work(victim);
+		if (work) {
+			gcwq_stat_inc(victim, nr_lost);
+			break;
+		}
+		spin_unlock(&victim->lock);
+		spin_unlock_irq(&gcwq->lock);
+	}
+
+	if (!work) {
+		spin_lock_irq(&gcwq->lock);
+		return false;
+	}
+
+	wq = get_work_cwq(work)->wq;
+	debug_work_activate(work);
+#ifdef CONFIG_WORKQUEUE_STATS
+	queued_at = work->queued_at;
+	cwq_queue_work(get_cwq(gcwq->cpu, wq), work);
+	work->queued_at = queued_at;
+#else
+	cwq_queue_work(get_cwq(gcwq->cpu, wq), work);
+#endif
+	spin_unlock(&victim->lock);
+	gcwq_stat_inc(gcwq, nr_stolen);
+	mutex_unlock(&wq->flush_mutex);
+	return true;
+}
+
 /**
  * worker_thread - the worker thread function
  * @__worker: self
@@ -1944,6 +2231,10 @@ sleep:
 	if (unlikely(need_to_manage_workers(gcwq)) && manage_workers(worker))
 		goto recheck;
 
+	/* nothing to do here, help out a busy cpu if possible */
+	if (steal_work(worker))
+		goto recheck;
+
 	/*
 	 * gcwq->lock is held and there's no work to process and no
 	 * need to manage, sleep.  Workers are woken up only while
@@ -2344,6 +2635,7 @@ int flush_work(struct work_struct *work)
 	struct wq_barrier barr;
 
 	might_sleep();
+retry:
 	gcwq = get_work_gcwq(work);
 	if (!gcwq)
 		return 0;
@@ -2352,13 +2644,18 @@ int flush_work(struct work_struct *work)
 	if (!list_empty(&work->entry)) {
 		/*
 		 * See the comment near try_to_grab_pending()->smp_rmb().
-		 * If it was re-queued to a different gcwq under us, we
-		 * are not going to wait.
+		 * The caller keeps @work from being requeued, so if it is
+		 * queued on a different gcwq, steal_work() moved it there
+		 * under us: go after it.
 		 */
 		smp_rmb();
 		cwq = get_work_cwq(work);
-		if (unlikely(!cwq || gcwq != cwq->gcwq))
+		if (unlikely(!cwq))
 			goto already_gone;
+		if (unlikely(gcwq != cwq->gcwq)) {
+			spin_unlock_irq(&gcwq->lock);
+			goto retry;
+		}
 	} else {
 		worker = find_worker_executing_work(gcwq, work);
 		if (!worker)
@@ -2768,7 +3065,7 @@ struct workqueue_struct *__alloc_workqueue_key(const char *name,
 	 * dispatched to workers immediately.
 	 */
 	if (flags & WQ_UNBOUND)
-		flags |= WQ_HIGHPRI;
+		flags = (flags | WQ_HIGHPRI) & ~WQ_STEALABLE;
 
 	max_active = max_active ?: WQ_DFL_ACTIVE;
 	max_active = wq_clamp_max_active(max_active, flags, name);
@@ -2836,6 +3133,9 @@ struct workqueue_struct *__alloc_workqueue_key(const char *name,
 
 	spin_unlock(&workqueue_lock);
 
+	if (wq->flags & WQ_STEALABLE)
+		atomic_inc(&wq_nr_stealable);
+
 	return wq;
 err:
 	if (wq) {
@@ -2861,6 +3161,9 @@ void destroy_workqueue(struct workqueue_struct *wq)
 	wq->flags |= WQ_DYING;
 	flush_workqueue(wq);
 
+	if (wq->flags & WQ_STEALABLE)
+		atomic_dec(&wq_nr_stealable);
+
 	/*
 	 * wq list is used to freeze wq, remove from list after
 	 * flushing is complete in case freeze races us.
@@ -3616,3 +3919,61 @@ static int __init init_workqueues(void)
 	return 0;
 }
 early_initcall(init_workqueues);
+
+#ifdef CONFIG_WORKQUEUE_STATS
+static int workqueue_stats_show(struct seq_file *m, void *v)
+{
+	unsigned long stolen, lost, executed;
+	u64 total, max;
+	unsigned int cpu;
+
+	seq_printf(m, "%-7s %10s %10s %12s %12s %12s\n", "cpu", "stolen",
+		   "lost", "executed", "avg_lat_us", "max_lat_us");
+
+	for_each_online_gcwq_cpu(cpu) {
+		struct global_cwq *gcwq = get_gcwq(cpu);
+
+		spin_lock_irq(&gcwq->lock);
+		stolen = gcwq->nr_stolen;
+		lost = gcwq->nr_lost;
+		executed = gcwq->nr_executed;
+		total = gcwq->lat_total;
+		max = gcwq->lat_max;
+		spin_unlock_irq(&gcwq->lock);
+
+		if (executed)
+			do_div(total, executed);
+		do_div(total, NSEC_PER_USEC);
+		do_div(max, NSEC_PER_USEC);
+
+		if (cpu == WORK_CPU_UNBOUND)
+			seq_printf(m, "%-7s", "unbound");
+		else
+			seq_printf(m, "%-7u", cpu);
+		seq_printf(m, " %10lu %10lu %12lu %12llu %12llu\n",
+			   stolen, lost, executed, (unsigned long long)total,
+			   (unsigned long long)max);
+	}
+	return 0;
+}
+
+static int workqueue_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, workqueue_stats_show, NULL);
+}
+
+static const struct file_operations workqueue_stats_fops = {
+	.open		= workqueue_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init workqueue_stats_init(void)
+{
+	debugfs_create_file("workqueue_stats", S_IRUGO, NULL, NULL,
+			    &workqueue_stats_fops);
+	return 0;
+}
+__initcall(workqueue_stats_init);
+#endif /* CONFIG_WORKQUEUE_STATS */
@@ -0,0 +1,134 @@
+/*
+ * Work stealing benchmark module
+ *
+ * Queues a flood of work items on a single cpu from interrupt context,
+ * the way a device interrupt handler would, and reports how long the
+ * workqueue took to get through them, how long they waited before
+ * starting, and on how many cpus they ended up running.  Load it with
+ * steal=0 and steal=1 to compare a plain workqueue with WQ_STEALABLE.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ */
+
+#include <linux/completion.h>
+#include <linux/delay.h>
+#include <linux/hrtimer.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/smp.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+
+static int nr_works = 4096;
+static int work_usecs = 20;
+static int cpu;
+static int steal = 1;
+
+module_param(nr_works, int, 0444);
+MODULE_PARM_DESC(nr_works, "Number of work items to queue");
+module_param(work_usecs, int, 0444);
+MODULE_PARM_DESC(work_usecs, "Busy time of each work item (us)");
+module_param(cpu, int, 0444);
+MODULE_PARM_DESC(cpu, "CPU to queue the work items on");
+module_param(steal, bool, 0444);
+MODULE_PARM_DESC(steal, "Use a WQ_STEALABLE workqueue");
+
+struct flood_work {
+	struct work_struct work;
+	ktime_t queued;
+};
+
+static struct workqueue_struct *flood_wq;
+static struct flood_work *flood_works;
+static atomic_t *flood_ran_on;
+static atomic_t flood_remaining;
+static DECLARE_COMPLETION(flood_done);
+
+static DEFINE_SPINLOCK(flood_lat_lock);
+static s64 flood_lat_total;
+static s64 flood_lat_max;
+
+static void flood_work_fn(struct work_struct *work)
+{
+	struct flood_work *fw = container_of(work, struct flood_work, work);
+	s64 lat = ktime_us_delta(ktime_get(), fw->queued);
+
+	spin_lock(&flood_lat_lock);
+	flood_lat_total += lat;
+	if (lat > flood_lat_max)
+		flood_lat_max = lat;
+	spin_unlock(&flood_lat_lock);
+
+	atomic_inc(&flood_ran_on[raw_smp_processor_id()]);
+	udelay(work_usecs);
+
+	if (atomic_dec_and_test(&flood_remaining))
+		complete(&flood_done);
+}
+
+/* IPI handler on the target cpu, stands in for a device interrupt */
+static void flood_queue(void *unused)
+{
+	int i;
+
+	for (i = 0; i < nr_works; i++) {
+		flood_works[i].queued = ktime_get();
+		queue_work(flood_wq, &flood_works[i].work);
+	}
+}
+
+static int __init wq_flood_test(void)
+{
+	ktime_t start;
+	s64 elapsed;
+	int i, nr_cpus = 0;
+	int ret = -ENOMEM;
+
+	if (nr_works <= 0 || work_usecs < 0 || cpu < 0 ||
+	    cpu >= nr_cpu_ids || !cpu_online(cpu))
+		return -EINVAL;
+
+	flood_works = kcalloc(nr_works, sizeof(*flood_works), GFP_KERNEL);
+	flood_ran_on = kcalloc(nr_cpu_ids, sizeof(*flood_ran_on), GFP_KERNEL);
+	flood_wq = alloc_workqueue("wqflood", steal ? WQ_STEALABLE : 0, 0);
+	if (!flood_works || !flood_ran_on || !flood_wq)
+		goto out;
+
+	for (i = 0; i < nr_works; i++)
+		INIT_WORK(&flood_works[i].work, flood_work_fn);
+	atomic_set(&flood_remaining, nr_works);
+
+	start = ktime_get();
+	smp_call_function_single(cpu, flood_queue, NULL, 1);
+	wait_for_completion(&flood_done);
+	elapsed = ktime_us_delta(ktime_get(), start);
+
+	for_each_possible_cpu(i)
+		if (atomic_read(&flood_ran_on[i]))
+			nr_cpus++;
+
+	printk(KERN_INFO "wqflood: %d works of %d us queued on cpu %d, "
+	       "stealing %s\n", nr_works, work_usecs, cpu,
+	       steal ? "on" : "off");
+	printk(KERN_INFO "wqflood: total %lld us, avg latency %lld us, "
+	       "max latency %lld us, ran on %d cpus\n", elapsed,
+	       div_s64(flood_lat_total, nr_works), flood_lat_max, nr_cpus);
+	ret = 0;
+out:
+	if (flood_wq)
+		destroy_workqueue(flood_wq);
+	kfree(flood_ran_on);
+	kfree(flood_works);
+	return ret;
+}
+
+static void __exit wq_flood_test_exit(void)
+{
+}
+
+module_init(wq_flood_test);
+module_exit(wq_flood_test_exit);
+MODULE_LICENSE("GPL");
@@ -0,0 +1,184 @@
+/*
+ * Harness for the benchmark modules that run on every cpu at once
+ *
+ * See include/linux/cpubench.h.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ */
+
+#include <linux/completion.h>
+#include <linux/cpubench.h>
+#include <linux/cpumask.h>
+#include <linux/err.h>
+#include <linux/kthread.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+
+struct cpu_bench_thread {
+	struct cpu_bench *bench;
+	struct task_struct *task;
+	int id;
+};
+
+static void wait_for_threads(struct cpu_bench *bench, atomic_t *barrier)
+{
+	atomic_inc(barrier);
+	/* more threads than cpus share a cpu, let the others get there */
+	while (atomic_read(barrier) < bench->nr_threads)
+		cond_resched();
+}
+
+static int cpu_bench_thread_fn(void *arg)
+{
+	struct cpu_bench_thread *t = arg;
+	struct cpu_bench *bench = t->bench;
+	int round;
+
+	for (round = 0; round < bench->nr_rounds; round++) {
+		wait_for_threads(bench, &bench->start_barrier[round]);
+		bench->fn(bench, t->id, round);
+		cond_resched();
+	}
+
+	if (atomic_inc_return(&bench->threads_done) == bench->nr_threads)
+		complete(bench->done);
+	/* wait for kthread_stop(), it must not find us gone */
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+}
+
+/**
+ * cpu_bench_run - run a benchmark on all cpus at once
+ * @bench: the benchmark, with name, nr_rounds, nr_tests and fn set
+ *
+ * Returns 0 once all threads ran all rounds, or the error starting them.
+ * On success the times stay valid for cpu_bench_report() until the next
+ * cpu_bench_run() on @bench, or cpu_bench_free().
+ */
+int cpu_bench_run(struct cpu_bench *bench)
+{
+	DECLARE_COMPLETION_ONSTACK(done);
+	struct cpu_bench_thread *threads;
+	int i, cpu = -1, ret = 0;
+
+	if (bench->nr_threads <= 0)
+		bench->nr_threads = num_online_cpus();
+	if (bench->nr_rounds <= 0 || bench->nr_tests <= 0)
+		return -EINVAL;
+
+	cpu_bench_free(bench);
+	bench->times = vmalloc(sizeof(*bench->times) * bench->nr_threads *
+			       bench->nr_rounds * bench->nr_tests);
+	bench->start_barrier = kcalloc(bench->nr_rounds,
+				       sizeof(*bench->start_barrier),
+				       GFP_KERNEL);
+	threads = kcalloc(bench->nr_threads, sizeof(*threads), GFP_KERNEL);
+	if (!bench->times || !bench->start_barrier || !threads) {
+		ret = -ENOMEM;
+		goto free;
+	}
+	memset(bench->times, 0, sizeof(*bench->times) * bench->nr_threads *
+	       bench->nr_rounds * bench->nr_tests);
+	atomic_set(&bench->threads_done, 0);
+	bench->done = &done;
+
+	/* spread the threads over the online cpus, round robin */
+	for (i = 0; i < bench->nr_threads; i++) {
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+
+		threads[i].bench = bench;
+		threads[i].id = i;
+		threads[i].task = kthread_create(cpu_bench_thread_fn,
+						 &threads[i], "%s/%d",
+						 bench->name, i);
+		if (IS_ERR(threads[i].task)) {
+			ret = PTR_ERR(threads[i].task);
+			threads[i].task = NULL;
+			goto out;
+		}
+		kthread_bind(threads[i].task, cpu);
+	}
+
+	for (i = 0; i < bench->nr_threads; i++)
+		wake_up_process(threads[i].task);
+	wait_for_completion(&done);
+
+out:
+	for (i = 0; i < bench->nr_threads; i++) {
+		/* also fine for threads that were never woken up */
+		if (threads[i].task)
+			kthread_stop(threads[i].task);
+	}
+free:
+	kfree(threads);
+	kfree(bench->start_barrier);
+	bench->start_barrier = NULL;
+	bench->done = NULL;
+	if (ret)
+		cpu_bench_free(bench);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(cpu_bench_run);
+
+/**
+ * cpu_bench_free - free the times of a benchmark run
+ * @bench: the benchmark
+ */
+void cpu_bench_free(struct cpu_bench *bench)
+{
+	vfree(bench->times);
+	bench->times = NULL;
+}
+EXPORT_SYMBOL_GPL(cpu_bench_free);
+
+/**
+ * cpu_bench_report - print the cost per operation of one test
+ * @bench: the benchmark, after cpu_bench_run()
+ * @round: round of the test
+ * @test: which of the times kept per round
+ * @ops: operations each thread did in that time
+ * @label: what the operations were
+ */
+void cpu_bench_report(struct cpu_bench *bench, int round, int test,
+		      unsigned long ops, const char *label)
+{
+	unsigned long long cycles = 0, nsecs = 0;
+	unsigned long long max_cycles = 0, max_nsecs = 0;
+	int i;
+
+	if (!bench->times || !ops)
+		return;
+
+	for (i = 0; i < bench->nr_threads; i++) {
+		struct cpu_bench_time *time;
+
+		time = cpu_bench_time(bench, i, round, test);
+		cycles += time->cycles;
+		nsecs += time->nsecs;
+		max_cycles = max(max_cycles, time->cycles);
+		max_nsecs = max(max_nsecs, time->nsecs);
+	}
+
+	do_div(cycles, ops * bench->nr_threads);
+	do_div(nsecs, ops * bench->nr_threads);
+	do_div(max_cycles, ops);
+	do_div(max_nsecs, ops);
+	printk(KERN_INFO "%s: %-20s %8llu cycles %8llu ns, "
+	       "slowest cpu %8llu cycles %8llu ns\n", bench->name, label,
+	       cycles, nsecs, max_cycles, max_nsecs);
+}
+EXPORT_SYMBOL_GPL(cpu_bench_report);
+
+MODULE_LICENSE("GPL");
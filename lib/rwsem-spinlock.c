@@ -46,6 +46,9 @@ void __init_rwsem(struct rw_semaphore *sem, const char *name,
 	sem->activity = 0;
 	spin_lock_init(&sem->wait_lock);
 	INIT_LIST_HEAD(&sem->wait_list);
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+	sem->owner = NULL;
+#endif
 }
 EXPORT_SYMBOL(__init_rwsem);
 
@@ -136,6 +139,77 @@ __rwsem_wake_one_writer(struct rw_semaphore *sem)
 	return sem;
 }
 
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+/*
+ * Readers only spin on a writer, writers spin unless the lock is read
+ * owned.  Neither spins once somebody is queued: the unlock then hands
+ * the semaphore straight to the first waiter.
+ */
+static inline int rwsem_can_spin_on_owner(struct rw_semaphore *sem, int write)
+{
+	struct thread_info *owner = ACCESS_ONCE(sem->owner);
+
+	if (owner == RWSEM_READER_OWNED || !list_empty(&sem->wait_list))
+		return 0;
+	return write || owner;
+}
+
+/*
+ * Optimistic spinning, as in lib/rwsem.c: while the semaphore is write
+ * locked by a task that is running on another cpu, it is likely to be
+ * released soon, and spinning for it beats a sleep and a wakeup.
+ *
+ * Called with the wait_lock held, which is dropped while spinning and
+ * held again on return.  The caller then checks whether it can have
+ * the semaphore, and queues up if not.
+ */
+static void rwsem_optimistic_spin(struct rw_semaphore *sem, int write,
+				  unsigned long *flags)
+{
+	struct thread_info *owner;
+
+	if (!rwsem_can_spin_on_owner(sem, write))
+		return;
+
+	spin_unlock_irqrestore(&sem->wait_lock, *flags);
+	preempt_disable();
+	for (;;) {
+		if (write ? ACCESS_ONCE(sem->activity) == 0 :
+			    ACCESS_ONCE(sem->activity) >= 0)
+			break;
+		if (!list_empty(&sem->wait_list))
+			break;
+
+		owner = ACCESS_ONCE(sem->owner);
+		if (owner == RWSEM_READER_OWNED)
+			break;
+		if (owner) {
+			if (!rwsem_spin_on_owner(sem, owner))
+				break;
+			continue;
+		}
+
+		/*
+		 * No owner: a writer has the lock but hasn't set ->owner
+		 * yet.  Readers give up right away, writers keep trying as
+		 * long as we have nothing better to do; an rt task would
+		 * live-lock with a lower priority owner it has preempted.
+		 */
+		if (!write || need_resched() || rt_task(current))
+			break;
+
+		cpu_relax();
+	}
+	preempt_enable();
+	spin_lock_irqsave(&sem->wait_lock, *flags);
+}
+#else
+static inline void rwsem_optimistic_spin(struct rw_semaphore *sem, int write,
+					 unsigned long *flags)
+{
+}
+#endif
+
 /*
  * get a read lock on the semaphore
  */
@@ -147,6 +221,9 @@ void __sched __down_read(struct rw_semaphore *sem)
 
 	spin_lock_irqsave(&sem->wait_lock, flags);
 
+	if (sem->activity < 0 && list_empty(&sem->wait_list))
+		rwsem_optimistic_spin(sem, 0, &flags);
+
 	if (sem->activity >= 0 && list_empty(&sem->wait_list)) {
 		/* granted */
 		sem->activity++;
@@ -214,6 +291,9 @@ void __sched __down_write_nested(struct rw_semaphore *sem, int subclass)
 
 	spin_lock_irqsave(&sem->wait_lock, flags);
 
+	if (sem->activity != 0 && list_empty(&sem->wait_list))
+		rwsem_optimistic_spin(sem, 1, &flags);
+
 	if (sem->activity == 0 && list_empty(&sem->wait_list)) {
 		/* granted */
 		sem->activity = -1;
@@ -24,6 +24,9 @@ void __init_rwsem(struct rw_semaphore *sem, const char *name,
 	sem->count = RWSEM_UNLOCKED_VALUE;
 	spin_lock_init(&sem->wait_lock);
 	INIT_LIST_HEAD(&sem->wait_list);
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+	sem->owner = NULL;
+#endif
 }
 
 EXPORT_SYMBOL(__init_rwsem);
@@ -101,22 +104,22 @@ __rwsem_do_wake(struct rw_semaphore *sem, int wake_type)
  readers_only:
 	/* If we come here from up_xxxx(), another thread might have reached
 	 * rwsem_down_failed_common() before we acquired the spinlock and
-	 * woken up a waiter, making it now active.  We prefer to check for
-	 * this first in order to not spend too much time with the spinlock
-	 * held if we're not going to be able to wake up readers in the end.
-	 *
-	 * Note that we do not need to update the rwsem count: any writer
-	 * trying to acquire rwsem will run rwsem_down_write_failed() due
-	 * to the waiting threads and block trying to acquire the spinlock.
-	 *
-	 * We use a dummy atomic update in order to acquire the cache line
-	 * exclusively since we expect to succeed and run the final rwsem
-	 * count adjustment pretty soon.
+	 * woken up a waiter, making it now active.  A writer spinning in
+	 * rwsem_down_write_failed() may also have grabbed the lock without
+	 * going through the wait queue.  So grant the first read lock before
+	 * anything else, which keeps such writers out, and back off if a
+	 * writer got in before us.
 	 */
-	if (wake_type == RWSEM_WAKE_ANY &&
-	    rwsem_atomic_update(0, sem) < RWSEM_WAITING_BIAS)
-		/* Someone grabbed the sem for write already */
-		goto out;
+	adjustment = RWSEM_ACTIVE_READ_BIAS;
+ try_reader_grant:
+	oldcount = rwsem_atomic_update(adjustment, sem) - adjustment;
+	if (unlikely(oldcount < RWSEM_WAITING_BIAS)) {
+		/* Someone grabbed the sem for write already. If it left
+		 * again meanwhile, nobody else is going to wake us up. */
+		if (rwsem_atomic_update(-adjustment, sem) & RWSEM_ACTIVE_MASK)
+			goto out;
+		goto try_reader_grant;
+	}
 
 	/* Grant an infinite number of read locks to the readers at the front
 	 * of the queue.  Note we increment the 'active part' of the count by
@@ -134,12 +137,14 @@ __rwsem_do_wake(struct rw_semaphore *sem, int wake_type)
 
 	} while (waiter->flags & RWSEM_WAITING_FOR_READ);
 
-	adjustment = woken * RWSEM_ACTIVE_READ_BIAS;
+	/* the first read lock has been granted already */
+	adjustment = (woken - 1) * RWSEM_ACTIVE_READ_BIAS;
 	if (waiter->flags & RWSEM_WAITING_FOR_READ)
 		/* hit end of list above */
 		adjustment -= RWSEM_WAITING_BIAS;
 
-	rwsem_atomic_add(adjustment, sem);
+	if (adjustment)
+		rwsem_atomic_add(adjustment, sem);
 
 	next = sem->wait_list.next;
 	for (loop = woken; loop > 0; loop--) {
@@ -201,7 +206,7 @@ rwsem_down_failed_common(struct rw_semaphore *sem,
 	if (count == RWSEM_WAITING_BIAS)
 		sem = __rwsem_do_wake(sem, RWSEM_WAKE_NO_ACTIVE);
 	else if (count > RWSEM_WAITING_BIAS &&
-		 adjustment == -RWSEM_ACTIVE_WRITE_BIAS)
+		 (flags & RWSEM_WAITING_FOR_WRITE))
 		sem = __rwsem_do_wake(sem, RWSEM_WAKE_READ_OWNED);
 
 	spin_unlock_irq(&sem->wait_lock);
@@ -219,14 +224,131 @@ rwsem_down_failed_common(struct rw_semaphore *sem,
 	return sem;
 }
 
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+/*
+ * Take the lock without queueing, if nobody holds it.  A writer may
+ * jump ahead of queued waiters, just like the fastpath does; a reader
+ * may not, or a stream of readers would starve the queued writers.
+ */
+static inline int rwsem_try_write_lock_unqueued(struct rw_semaphore *sem)
+{
+	rwsem_count_t count = ACCESS_ONCE(sem->count);
+
+	while (count == RWSEM_UNLOCKED_VALUE || count == RWSEM_WAITING_BIAS) {
+		rwsem_count_t old = cmpxchg(&sem->count, count,
+					    count + RWSEM_ACTIVE_WRITE_BIAS);
+		if (old == count)
+			return 1;
+		count = old;
+	}
+	return 0;
+}
+
+static inline int rwsem_try_read_lock_unqueued(struct rw_semaphore *sem)
+{
+	rwsem_count_t count = ACCESS_ONCE(sem->count);
+
+	while (count >= 0) {
+		rwsem_count_t old = cmpxchg(&sem->count, count,
+					    count + RWSEM_ACTIVE_READ_BIAS);
+		if (old == count)
+			return 1;
+		count = old;
+	}
+	return 0;
+}
+
+/*
+ * Readers only spin on a running writer, writers spin unless the lock
+ * is read owned.
+ */
+static inline int rwsem_can_spin_on_owner(struct rw_semaphore *sem, int write)
+{
+	struct thread_info *owner = ACCESS_ONCE(sem->owner);
+
+	if (owner == RWSEM_READER_OWNED)
+		return 0;
+	return write || owner;
+}
+
+/*
+ * Optimistic spinning, as in __mutex_lock_common(): while the rwsem is
+ * write locked by a task that is running on another cpu, it is likely
+ * to be released soon, and spinning for it beats a sleep and a wakeup.
+ * We can't tell whether the readers of a read locked rwsem are running,
+ * so we never spin on those.
+ *
+ * The caller must have backed its bias out of the count.  Returns 1 if
+ * we got the lock, 0 if the caller has to queue up and sleep.
+ */
+static int rwsem_optimistic_spin(struct rw_semaphore *sem, int write)
+{
+	struct thread_info *owner;
+	int taken = 0;
+
+	preempt_disable();
+	for (;;) {
+		if (write ? rwsem_try_write_lock_unqueued(sem) :
+			    rwsem_try_read_lock_unqueued(sem)) {
+			taken = 1;
+			break;
+		}
+
+		owner = ACCESS_ONCE(sem->owner);
+		if (owner == RWSEM_READER_OWNED)
+			break;
+		if (owner) {
+			if (!rwsem_spin_on_owner(sem, owner))
+				break;
+			continue;
+		}
+
+		/*
+		 * No owner: either a writer has the lock but hasn't set
+		 * ->owner yet, or, for a reader, there are waiters which
+		 * we must not overtake.  Readers give up right away.
+		 * Writers keep trying as long as we have nothing better
+		 * to do; an rt task would live-lock with a lower priority
+		 * owner it has preempted.
+		 */
+		if (!write || need_resched() || rt_task(current))
+			break;
+
+		cpu_relax();
+	}
+	preempt_enable();
+
+	return taken;
+}
+#else
+static inline int rwsem_can_spin_on_owner(struct rw_semaphore *sem, int write)
+{
+	return 0;
+}
+
+static inline int rwsem_optimistic_spin(struct rw_semaphore *sem, int write)
+{
+	return 0;
+}
+#endif
+
 /*
  * wait for the read lock to be granted
  */
 asmregparm struct rw_semaphore __sched *
 rwsem_down_read_failed(struct rw_semaphore *sem)
 {
+	signed long adjustment = -RWSEM_ACTIVE_READ_BIAS;
+
+	if (rwsem_can_spin_on_owner(sem, 0)) {
+		/* back out of the fastpath, then try again while spinning */
+		rwsem_atomic_add(-RWSEM_ACTIVE_READ_BIAS, sem);
+		if (rwsem_optimistic_spin(sem, 0))
+			return sem;
+		adjustment = 0;
+	}
 	return rwsem_down_failed_common(sem, RWSEM_WAITING_FOR_READ,
-					-RWSEM_ACTIVE_READ_BIAS);
+					adjustment);
 }
 
 /*
@@ -235,8 +357,16 @@ rwsem_down_read_failed(struct rw_semaphore *sem)
 asmregparm struct rw_semaphore __sched *
 rwsem_down_write_failed(struct rw_semaphore *sem)
 {
+	signed long adjustment = -RWSEM_ACTIVE_WRITE_BIAS;
+
+	if (rwsem_can_spin_on_owner(sem, 1)) {
+		rwsem_atomic_add(-RWSEM_ACTIVE_WRITE_BIAS, sem);
+		if (rwsem_optimistic_spin(sem, 1))
+			return sem;
+		adjustment = 0;
+	}
 	return rwsem_down_failed_common(sem, RWSEM_WAITING_FOR_WRITE,
-					-RWSEM_ACTIVE_WRITE_BIAS);
+					adjustment);
 }
 
 /*
@@ -14,6 +14,9 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/cpu.h>
 #include "internal.h"
 
 /*
@@ -38,6 +41,7 @@ struct compact_control {
 	unsigned int order;		/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
 	struct zone *zone;
+	bool proactive;			/* kcompactd ahead of demand */
 };
 
 static unsigned long release_freepages(struct list_head *freelist)
@@ -354,6 +358,14 @@ static int compact_finished(struct zone *zone,
 	if (cc->free_pfn <= cc->migrate_pfn)
 		return COMPACT_COMPLETE;
 
+	/* Proactive compaction: done once the zone is below the low mark */
+	if (cc->proactive) {
+		if (fragmentation_score_zone(zone) <=
+					fragmentation_score_wmark(true))
+			return COMPACT_PARTIAL;
+		return COMPACT_CONTINUE;
+	}
+
 	/* Compaction run is not finished if the watermark is not met */
 	if (!zone_watermark_ok(zone, cc->order, watermark, 0, 0))
 		return COMPACT_CONTINUE;
@@ -436,6 +448,53 @@ static unsigned long compact_zone_order(struct zone *zone,
 
 int sysctl_extfrag_threshold = 500;
 
+/**
+ * compaction_suitable - Is it worth compacting a zone for an allocation
+ * @zone: The zone to compact
+ * @order: The order of the allocation
+ *
+ * Returns COMPACT_SKIPPED if there is too little free memory for migration
+ * or a failure would be due to a lack of memory rather than external
+ * fragmentation, COMPACT_PARTIAL if the allocation should already succeed
+ * and COMPACT_CONTINUE if compaction should go ahead.
+ */
+unsigned long compaction_suitable(struct zone *zone, int order)
+{
+	int fragindex;
+	unsigned long watermark;
+
+	/*
+	 * Watermarks for order-0 must be met for compaction. Note
+	 * the 2UL. This is because during migration, copies of
+	 * pages need to be allocated and for a short time, the
+	 * footprint is higher
+	 */
+	watermark = low_wmark_pages(zone) + (2UL << order);
+	if (!zone_watermark_ok(zone, 0, watermark, 0, 0))
+		return COMPACT_SKIPPED;
+
+	/*
+	 * fragmentation index determines if allocation failures are
+	 * due to low memory or external fragmentation
+	 *
+	 * index of -1000 implies allocations might succeed depending
+	 * 	on watermarks
+	 * index towards 0 implies failure is due to lack of memory
+	 * index towards 1000 implies failure is due to fragmentation
+	 *
+	 * Only compact if a failure would be due to fragmentation.
+	 */
+	fragindex = fragmentation_index(zone, order);
+	if (fragindex >= 0 && fragindex <= sysctl_extfrag_threshold)
+		return COMPACT_SKIPPED;
+
+	if (fragindex == -1000 && zone_watermark_ok(zone, order, watermark,
+						    0, 0))
+		return COMPACT_PARTIAL;
+
+	return COMPACT_CONTINUE;
+}
+
 /**
  * try_to_compact_pages - Direct compact to satisfy a high-order allocation
  * @zonelist: The zonelist used for the current allocation
@@ -469,35 +528,13 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 	/* Compact each zone in the list */
 	for_each_zone_zonelist_nodemask(zone, z, zonelist, high_zoneidx,
 								nodemask) {
-		int fragindex;
 		int status;
 
-		/*
-		 * Watermarks for order-0 must be met for compaction. Note
-		 * the 2UL. This is because during migration, copies of
-		 * pages need to be allocated and for a short time, the
-		 * footprint is higher
-		 */
-		watermark = low_wmark_pages(zone) + (2UL << order);
-		if (!zone_watermark_ok(zone, 0, watermark, 0, 0))
-			continue;
-
-		/*
-		 * fragmentation index determines if allocation failures are
-		 * due to low memory or external fragmentation
-		 *
-		 * index of -1 implies allocations might succeed depending
-		 * 	on watermarks
-		 * index towards 0 implies failure is due to lack of memory
-		 * index towards 1000 implies failure is due to fragmentation
-		 *
-		 * Only compact if a failure would be due to fragmentation.
-		 */
-		fragindex = fragmentation_index(zone, order);
-		if (fragindex >= 0 && fragindex <= sysctl_extfrag_threshold)
+		status = compaction_suitable(zone, order);
+		if (status == COMPACT_SKIPPED)
 			continue;
 
-		if (fragindex == -1 && zone_watermark_ok(zone, order, watermark, 0, 0)) {
+		if (status == COMPACT_PARTIAL) {
 			rc = COMPACT_PARTIAL;
 			break;
 		}
@@ -505,6 +542,7 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 		status = compact_zone_order(zone, order, gfp_mask);
 		rc = max(status, rc);
 
+		watermark = low_wmark_pages(zone) + (2UL << order);
 		if (zone_watermark_ok(zone, order, watermark, 0, 0))
 			break;
 	}
@@ -583,6 +621,306 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * The fragmentation score of a zone is the percentage of its free memory
+ * that cannot be used for an allocation of COMPACTION_SCORE_ORDER, the
+ * size of a pageblock, which is also what anti-fragmentation groups pages
+ * by. kcompactd compacts a node ahead of demand once its score is above
+ * the high mark derived from vm.compaction_proactiveness and stops once
+ * it is back below the low mark.
+ */
+#define COMPACTION_SCORE_ORDER	pageblock_order
+
+int sysctl_compaction_proactiveness = 20;
+
+unsigned int fragmentation_score_zone(struct zone *zone)
+{
+	return extfrag_for_order(zone, COMPACTION_SCORE_ORDER);
+}
+
+/*
+ * The score of a node is the score of its zones weighted by their size,
+ * so a small zone such as ZONE_DMA cannot keep kcompactd busy on its own.
+ */
+unsigned int fragmentation_score_node(pg_data_t *pgdat)
+{
+	unsigned long score = 0;
+	int zoneid;
+
+	if (!pgdat->node_present_pages)
+		return 0;
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+
+		if (!populated_zone(zone))
+			continue;
+		score += fragmentation_score_zone(zone) * zone->present_pages;
+	}
+
+	return score / pgdat->node_present_pages;
+}
+
+unsigned int fragmentation_score_wmark(bool low)
+{
+	unsigned int wmark_low;
+
+	/* A score of 0 is out of reach on a busy system, don't aim for it */
+	wmark_low = max(100U - sysctl_compaction_proactiveness, 5U);
+
+	return low ? wmark_low : min(wmark_low + 10, 100U);
+}
+
+/* How often kcompactd checks the fragmentation score of its node */
+#define KCOMPACTD_PROACTIVE_INTERVAL	(HZ / 2)
+
+static void kcompactd_compact_zone(struct zone *zone, int order,
+						bool proactive)
+{
+	struct compact_control cc = {
+		.nr_freepages = 0,
+		.nr_migratepages = 0,
+		.order = order,
+		.migratetype = MIGRATE_MOVABLE,
+		.zone = zone,
+		.proactive = proactive,
+	};
+	INIT_LIST_HEAD(&cc.freepages);
+	INIT_LIST_HEAD(&cc.migratepages);
+
+	compact_zone(zone, &cc);
+
+	VM_BUG_ON(!list_empty(&cc.freepages));
+	VM_BUG_ON(!list_empty(&cc.migratepages));
+}
+
+/*
+ * Compact the zones of a node that kswapd balanced for a high-order
+ * allocation, so the next allocation of that order finds a free page
+ * instead of stalling in direct compaction. Zones where compaction keeps
+ * failing are deferred the same way direct compaction defers them.
+ */
+static void kcompactd_do_work(pg_data_t *pgdat)
+{
+	int order = pgdat->kcompactd_max_order;
+	int zoneid;
+
+	count_vm_event(KCOMPACTD_WAKE);
+
+	for (zoneid = 0; zoneid < pgdat->nr_zones; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+
+		if (!populated_zone(zone))
+			continue;
+
+		if (compaction_deferred(zone))
+			continue;
+
+		if (compaction_suitable(zone, order) != COMPACT_CONTINUE)
+			continue;
+
+		kcompactd_compact_zone(zone, order, false);
+
+		if (zone_watermark_ok(zone, order, low_wmark_pages(zone),
+				      0, 0)) {
+			zone->compact_considered = 0;
+			zone->compact_defer_shift = 0;
+		} else
+			defer_compaction(zone);
+
+		if (kthread_should_stop())
+			return;
+	}
+
+	/* A larger order requested meanwhile is left for the next round */
+	if (pgdat->kcompactd_max_order <= order)
+		pgdat->kcompactd_max_order = 0;
+}
+
+/* Compact the zones of a node whose score is above the low mark */
+static void kcompactd_proactive(pg_data_t *pgdat)
+{
+	int zoneid;
+
+	count_vm_event(KCOMPACTD_PROACTIVE);
+
+	for (zoneid = 0; zoneid < pgdat->nr_zones; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+
+		if (!populated_zone(zone))
+			continue;
+
+		if (fragmentation_score_zone(zone) <=
+					fragmentation_score_wmark(true))
+			continue;
+
+		/* Too little free memory to migrate pages into */
+		if (compaction_suitable(zone, COMPACTION_SCORE_ORDER) ==
+							COMPACT_SKIPPED)
+			continue;
+
+		kcompactd_compact_zone(zone, -1, true);
+
+		if (kthread_should_stop())
+			return;
+	}
+}
+
+/*
+ * The background compaction daemon, one per node. It sleeps until kswapd
+ * wakes it up after balancing the node for a high-order allocation, and
+ * every KCOMPACTD_PROACTIVE_INTERVAL checks whether the node has become
+ * fragmented enough to be compacted ahead of demand.
+ */
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = (pg_data_t *)p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+	unsigned int proactive_defer = 0;
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		unsigned int prev_score, score;
+		long remaining;
+
+		remaining = wait_event_freezable_timeout(pgdat->kcompactd_wait,
+				pgdat->kcompactd_max_order ||
+				kthread_should_stop(),
+				KCOMPACTD_PROACTIVE_INTERVAL);
+		if (kthread_should_stop())
+			break;
+
+		if (pgdat->kcompactd_max_order) {
+			kcompactd_do_work(pgdat);
+			continue;
+		}
+
+		if (remaining || !sysctl_compaction_proactiveness)
+			continue;
+
+		if (proactive_defer) {
+			proactive_defer--;
+			continue;
+		}
+
+		prev_score = fragmentation_score_node(pgdat);
+		if (prev_score <= fragmentation_score_wmark(false))
+			continue;
+
+		kcompactd_proactive(pgdat);
+
+		/*
+		 * Back off for a while when a round did not bring the score
+		 * down: what is left is likely pinned by unmovable pages and
+		 * scanning the node again right away would only burn CPU.
+		 */
+		score = fragmentation_score_node(pgdat);
+		if (score >= prev_score)
+			proactive_defer = 1 << COMPACT_MAX_DEFER_SHIFT;
+	}
+
+	return 0;
+}
+
+/*
+ * kswapd has balanced a node for a high-order allocation: wake kcompactd
+ * if compacting one of its zones is likely to produce a page of that order.
+ */
+void wakeup_kcompactd(pg_data_t *pgdat, int order)
+{
+	int zoneid;
+
+	if (!order)
+		return;
+
+	for (zoneid = 0; zoneid < pgdat->nr_zones; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+
+		if (populated_zone(zone) &&
+		    compaction_suitable(zone, order) == COMPACT_CONTINUE)
+			break;
+	}
+	if (zoneid == pgdat->nr_zones)
+		return;
+
+	if (pgdat->kcompactd_max_order < order)
+		pgdat->kcompactd_max_order = order;
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+/*
+ * This kcompactd start function will be called by init and node-hot-add.
+ * Unlike kswapd, the system can do without it, so failing is not fatal.
+ */
+int kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int ret = 0;
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(pgdat->kcompactd)) {
+		printk(KERN_ERR "Failed to start kcompactd on node %d\n", nid);
+		ret = PTR_ERR(pgdat->kcompactd);
+		pgdat->kcompactd = NULL;
+	}
+	return ret;
+}
+
+/*
+ * Called by memory hotplug when all memory in a node is offlined.
+ */
+void kcompactd_stop(int nid)
+{
+	struct task_struct *kcompactd = NODE_DATA(nid)->kcompactd;
+
+	if (kcompactd) {
+		kthread_stop(kcompactd);
+		NODE_DATA(nid)->kcompactd = NULL;
+	}
+}
+
+/* Restore the node binding of kcompactd as its CPUs come back, see kswapd */
+static int __devinit kcompactd_cpu_callback(struct notifier_block *nfb,
+					unsigned long action, void *hcpu)
+{
+	int nid;
+
+	if (action == CPU_ONLINE || action == CPU_ONLINE_FROZEN) {
+		for_each_node_state(nid, N_HIGH_MEMORY) {
+			pg_data_t *pgdat = NODE_DATA(nid);
+			const struct cpumask *mask;
+
+			if (!pgdat->kcompactd)
+				continue;
+
+			mask = cpumask_of_node(pgdat->node_id);
+			if (cpumask_any_and(cpu_online_mask, mask) < nr_cpu_ids)
+				set_cpus_allowed_ptr(pgdat->kcompactd, mask);
+		}
+	}
+	return NOTIFY_OK;
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		kcompactd_run(nid);
+	hotcpu_notifier(kcompactd_cpu_callback, 0);
+	return 0;
+}
+
+module_init(kcompactd_init)
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct sys_device *dev,
 			struct sysdev_attribute *attr,
@@ -0,0 +1,127 @@
+/*
+ * kmalloc/kfree benchmark module
+ *
+ * Runs through a range of kmalloc sizes on every cpu at the same time.
+ * For each size a thread first allocates nr_objects objects and then
+ * frees them all, which walks through the cpu slab and has the slow
+ * paths refill and drain it, and then allocates and immediately frees
+ * an object as many times, which stays on the fast paths.  The costs
+ * per operation are reported for every size, see linux/cpubench.h.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ */
+
+#include <linux/cpubench.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+
+static int nthreads;
+static int nr_objects = 10000;
+
+module_param_named(nr_threads, nthreads, int, 0444);
+MODULE_PARM_DESC(nr_threads, "Number of threads (default: one per cpu)");
+module_param(nr_objects, int, 0444);
+MODULE_PARM_DESC(nr_objects, "Objects allocated per size and thread");
+
+static const size_t sizes[] = {
+	8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192
+};
+
+enum { BATCH_ALLOC, BATCH_FREE, PAIRED, NR_TESTS };
+
+static const char * const test_names[] = {
+	[BATCH_ALLOC]	= "alloc",
+	[BATCH_FREE]	= "free",
+	[PAIRED]	= "alloc+free",
+};
+
+static void **objects;			/* nr_objects per thread */
+static atomic_t failures;
+
+/* one round per size */
+static void kmalloc_bench_fn(struct cpu_bench *bench, int thread, int round)
+{
+	void **objs = objects + thread * nr_objects;
+	size_t size = sizes[round];
+	struct cpu_bench_clock clk;
+	int j;
+
+	cpu_bench_clock_start(&clk);
+	for (j = 0; j < nr_objects; j++)
+		objs[j] = kmalloc(size, GFP_KERNEL);
+	cpu_bench_clock_stop(&clk,
+		cpu_bench_time(bench, thread, round, BATCH_ALLOC));
+
+	for (j = 0; j < nr_objects; j++)
+		if (!objs[j])
+			atomic_inc(&failures);
+
+	cpu_bench_clock_start(&clk);
+	for (j = 0; j < nr_objects; j++)
+		kfree(objs[j]);
+	cpu_bench_clock_stop(&clk,
+		cpu_bench_time(bench, thread, round, BATCH_FREE));
+
+	cpu_bench_clock_start(&clk);
+	for (j = 0; j < nr_objects; j++)
+		kfree(kmalloc(size, GFP_KERNEL));
+	cpu_bench_clock_stop(&clk,
+		cpu_bench_time(bench, thread, round, PAIRED));
+}
+
+static struct cpu_bench kmalloc_bench = {
+	.name		= "kmalloc-bench",
+	.nr_rounds	= ARRAY_SIZE(sizes),
+	.nr_tests	= NR_TESTS,
+	.fn		= kmalloc_bench_fn,
+};
+
+static int __init kmalloc_bench_init(void)
+{
+	char label[32];
+	int i, test, ret;
+
+	if (nthreads <= 0)
+		nthreads = num_online_cpus();
+	if (nr_objects <= 0)
+		return -EINVAL;
+
+	objects = vmalloc(sizeof(void *) * nr_objects * nthreads);
+	if (!objects)
+		return -ENOMEM;
+
+	kmalloc_bench.nr_threads = nthreads;
+	ret = cpu_bench_run(&kmalloc_bench);
+	if (ret)
+		goto free;
+
+	printk(KERN_INFO "kmalloc-bench: %d threads, %d objects, "
+	       "cost per operation:\n", nthreads, nr_objects);
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		for (test = 0; test < NR_TESTS; test++) {
+			snprintf(label, sizeof(label), "%5zu %s",
+				 sizes[i], test_names[test]);
+			cpu_bench_report(&kmalloc_bench, i, test,
+					 nr_objects, label);
+		}
+	}
+	cpu_bench_free(&kmalloc_bench);
+
+	if (atomic_read(&failures))
+		ret = -ENOMEM;
+free:
+	vfree(objects);
+	return ret;
+}
+
+static void __exit kmalloc_bench_exit(void)
+{
+}
+
+module_init(kmalloc_bench_init);
+module_exit(kmalloc_bench_exit);
+MODULE_LICENSE("GPL");
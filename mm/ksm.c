@@ -34,6 +34,7 @@
 #include <linux/swap.h>
 #include <linux/ksm.h>
 #include <linux/hash.h>
+#include <linux/seq_file.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -84,12 +85,31 @@
  * @mm_list: link into the mm_slots list, rooted in ksm_mm_head
  * @rmap_list: head for this mm_slot's singly-linked list of rmap_items
  * @mm: the mm that this information is valid for
+ * @full_scans: count of passes of the scanner that reached this mm
+ * @pages_scanned: count of pages scanned in this mm
+ * @pages_merged: count of pages of this mm merged into ksm pages
+ * @pass_start: jiffies when the scanner last entered this mm
+ * @pass_scanned: pages_scanned when the scanner last entered this mm
+ * @pass_merged: pages_merged when the scanner last entered this mm
+ * @scan_rate: pages scanned per second, over the last full pass
+ * @merge_rate: pages merged per second, over the last full pass
+ *
+ * The statistics are only updated by ksmd, under ksm_thread_mutex, and
+ * read for /proc/<pid>/ksm_stat under ksm_mmlist_lock.
  */
 struct mm_slot {
 	struct hlist_node link;
 	struct list_head mm_list;
 	struct rmap_item *rmap_list;
 	struct mm_struct *mm;
+	unsigned long full_scans;
+	unsigned long pages_scanned;
+	unsigned long pages_merged;
+	unsigned long pass_start;
+	unsigned long pass_scanned;
+	unsigned long pass_merged;
+	unsigned long scan_rate;
+	unsigned long merge_rate;
 };
 
 /**
@@ -113,11 +133,13 @@ struct ksm_scan {
  * @node: rb node of this ksm page in the stable tree
  * @hlist: hlist head of rmap_items using this ksm page
  * @kpfn: page frame number of this ksm page
+ * @checksum: checksum of this ksm page, its first key in the stable tree
  */
 struct stable_node {
 	struct rb_node node;
 	struct hlist_head hlist;
 	unsigned long kpfn;
+	u32 checksum;
 };
 
 /**
@@ -126,7 +148,8 @@ struct stable_node {
  * @anon_vma: pointer to anon_vma for this mm,address, when in stable tree
  * @mm: the memory structure this rmap_item is pointing into
  * @address: the virtual address this rmap_item tracks (+ flags in low bits)
- * @oldchecksum: previous checksum of the page at that virtual address
+ * @oldchecksum: previous checksum of the page at that virtual address,
+ *	and its first key in the unstable tree
  * @node: rb node of this rmap_item in the unstable tree
  * @head: pointer to stable_node heading this list in the stable tree
  * @hlist: link into hlist of rmap_items hanging off that stable_node
@@ -146,6 +169,21 @@ struct rmap_item {
 	};
 };
 
+/**
+ * struct scan_entry - page gathered by ksmd for the scan pool
+ * @rmap_item: the reverse mapping of the page being scanned
+ * @page: the page being scanned, with a reference held on it
+ * @kpage: ksm page of identical content found by the scan pool, or NULL,
+ *	or ERR_PTR(-EAGAIN) when ksmd has to search the stable tree again
+ * @checksum: checksum of the page, calculated by the scan pool
+ */
+struct scan_entry {
+	struct rmap_item *rmap_item;
+	struct page *page;
+	struct page *kpage;
+	u32 checksum;
+};
+
 #define SEQNR_MASK	0x0ff	/* low bits of unstable tree seqnr */
 #define UNSTABLE_FLAG	0x100	/* is a node of the unstable tree */
 #define STABLE_FLAG	0x200	/* is listed from the stable tree */
@@ -187,6 +225,37 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/*
+ * Number of threads checksumming pages and searching the stable tree:
+ * ksmd itself, and the ksmd/N threads of the scan pool.
+ */
+static unsigned int ksm_scan_threads = 1;
+static struct task_struct **ksm_scan_pool;
+
+/* How many of them to run once ksmd is set running: see run_store */
+static unsigned int ksm_scan_threads_wanted = 1;
+
+/*
+ * The batch of pages ksmd hands to the scan pool.  ksmd fills it in and
+ * publishes it under ksm_batch_lock; ksmd and the pool then claim entries
+ * one by one, and ksmd waits for them all to be done before merging the
+ * pages, and before gathering the next batch.  Meanwhile, the pool only
+ * reads the stable tree: nothing changes it while ksmd is waiting.
+ */
+#define KSM_SCAN_BATCH	64
+static struct scan_entry ksm_batch[KSM_SCAN_BATCH];
+static unsigned int ksm_batch_nr;
+static unsigned int ksm_batch_next;
+static unsigned int ksm_batch_done;
+static unsigned long ksm_batch_seq;
+static DEFINE_SPINLOCK(ksm_batch_lock);
+static DECLARE_WAIT_QUEUE_HEAD(ksm_pool_wait);
+static DECLARE_WAIT_QUEUE_HEAD(ksm_batch_wait);
+
+/* Bumped on every insertion into the stable tree, and its batch snapshot */
+static unsigned long ksm_stable_seq;
+static unsigned long ksm_batch_stable_seq;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -488,8 +557,11 @@ static void remove_node_from_stable_tree(struct stable_node *stable_node)
  * then page the next, if the page is in between page_freeze_refs() and
  * page_unfreeze_refs(): this shouldn't be a problem anywhere, the page
  * is on its way to being freed; but it is an anomaly to bear in mind.
+ *
+ * The scan pool uses __get_ksm_page(), which leaves a stale node in the
+ * tree for ksmd to remove: the pool must not change the stable tree.
  */
-static struct page *get_ksm_page(struct stable_node *stable_node)
+static struct page *__get_ksm_page(struct stable_node *stable_node)
 {
 	struct page *page;
 	void *expected_mapping;
@@ -510,10 +582,19 @@ static struct page *get_ksm_page(struct stable_node *stable_node)
 	return page;
 stale:
 	rcu_read_unlock();
-	remove_node_from_stable_tree(stable_node);
 	return NULL;
 }
 
+static struct page *get_ksm_page(struct stable_node *stable_node)
+{
+	struct page *page;
+
+	page = __get_ksm_page(stable_node);
+	if (!page)
+		remove_node_from_stable_tree(stable_node);
+	return page;
+}
+
 /*
  * Removing rmap_item from stable or unstable tree.
  * This function will clean the information from the stable/unstable tree.
@@ -667,11 +748,26 @@ error:
 }
 #endif /* CONFIG_SYSFS */
 
+/*
+ * The checksum samples CHECKSUM_CHUNKS runs of CHECKSUM_WORDS words, spread
+ * evenly over the page, instead of hashing all of it.  That still notices
+ * most pages changing between passes; and it is the first key of both trees,
+ * so most steps down them compare checksums rather than the whole pages.
+ * A change which the samples miss is caught by the full comparison of the
+ * write-protected pages before they are merged.
+ */
+#define CHECKSUM_CHUNKS	8
+#define CHECKSUM_WORDS	16
+
 static u32 calc_checksum(struct page *page)
 {
-	u32 checksum;
-	void *addr = kmap_atomic(page, KM_USER0);
-	checksum = jhash2(addr, PAGE_SIZE / 4, 17);
+	u32 checksum = 17;
+	u32 *addr = kmap_atomic(page, KM_USER0);
+	int i;
+
+	for (i = 0; i < CHECKSUM_CHUNKS; i++)
+		checksum = jhash2(addr + i * (PAGE_SIZE / 4 / CHECKSUM_CHUNKS),
+				  CHECKSUM_WORDS, checksum);
 	kunmap_atomic(addr, KM_USER0);
 	return checksum;
 }
@@ -944,9 +1040,12 @@ static struct page *try_to_merge_two_pages(struct rmap_item *rmap_item,
  * with identical content to the page that we are scanning right now.
  *
  * This function returns the stable tree node of identical content if found,
- * NULL otherwise.
+ * NULL otherwise.  The scan pool calls it with @prune false: then a stale
+ * node on the way is left in the tree, and ERR_PTR(-EAGAIN) is returned
+ * for ksmd to search again.
  */
-static struct page *stable_tree_search(struct page *page)
+static struct page *stable_tree_search(struct page *page, u32 checksum,
+				       bool prune)
 {
 	struct rb_node *node = root_stable_tree.rb_node;
 	struct stable_node *stable_node;
@@ -963,9 +1062,23 @@ static struct page *stable_tree_search(struct page *page)
 
 		cond_resched();
 		stable_node = rb_entry(node, struct stable_node, node);
-		tree_page = get_ksm_page(stable_node);
-		if (!tree_page)
-			return NULL;
+		if (checksum < stable_node->checksum) {
+			node = node->rb_left;
+			continue;
+		} else if (checksum > stable_node->checksum) {
+			node = node->rb_right;
+			continue;
+		}
+
+		if (!prune) {
+			tree_page = __get_ksm_page(stable_node);
+			if (!tree_page)
+				return ERR_PTR(-EAGAIN);
+		} else {
+			tree_page = get_ksm_page(stable_node);
+			if (!tree_page)
+				return NULL;
+		}
 
 		ret = memcmp_pages(page, tree_page);
 
@@ -994,6 +1107,10 @@ static struct stable_node *stable_tree_insert(struct page *kpage)
 	struct rb_node **new = &root_stable_tree.rb_node;
 	struct rb_node *parent = NULL;
 	struct stable_node *stable_node;
+	u32 checksum;
+
+	/* kpage is write-protected now: its checksum cannot change */
+	checksum = calc_checksum(kpage);
 
 	while (*new) {
 		struct page *tree_page;
@@ -1001,12 +1118,16 @@ static struct stable_node *stable_tree_insert(struct page *kpage)
 
 		cond_resched();
 		stable_node = rb_entry(*new, struct stable_node, node);
-		tree_page = get_ksm_page(stable_node);
-		if (!tree_page)
-			return NULL;
+		if (checksum != stable_node->checksum) {
+			ret = checksum < stable_node->checksum ? -1 : 1;
+		} else {
+			tree_page = get_ksm_page(stable_node);
+			if (!tree_page)
+				return NULL;
 
-		ret = memcmp_pages(kpage, tree_page);
-		put_page(tree_page);
+			ret = memcmp_pages(kpage, tree_page);
+			put_page(tree_page);
+		}
 
 		parent = *new;
 		if (ret < 0)
@@ -1033,7 +1154,9 @@ static struct stable_node *stable_tree_insert(struct page *kpage)
 	INIT_HLIST_HEAD(&stable_node->hlist);
 
 	stable_node->kpfn = page_to_pfn(kpage);
+	stable_node->checksum = checksum;
 	set_page_stable_node(kpage, stable_node);
+	ksm_stable_seq++;
 
 	return stable_node;
 }
@@ -1050,7 +1173,8 @@ static struct stable_node *stable_tree_insert(struct page *kpage)
  * to the currently scanned page, NULL otherwise.
  *
  * This function does both searching and inserting, because they share
- * the same walking algorithm in an rbtree.
+ * the same walking algorithm in an rbtree.  The rmap_item's oldchecksum,
+ * just found equal to the page's checksum, is its first key in the tree.
  */
 static
 struct rmap_item *unstable_tree_search_insert(struct rmap_item *rmap_item,
@@ -1060,6 +1184,7 @@ struct rmap_item *unstable_tree_search_insert(struct rmap_item *rmap_item,
 {
 	struct rb_node **new = &root_unstable_tree.rb_node;
 	struct rb_node *parent = NULL;
+	u32 checksum = rmap_item->oldchecksum;
 
 	while (*new) {
 		struct rmap_item *tree_rmap_item;
@@ -1068,6 +1193,15 @@ struct rmap_item *unstable_tree_search_insert(struct rmap_item *rmap_item,
 
 		cond_resched();
 		tree_rmap_item = rb_entry(*new, struct rmap_item, node);
+		if (checksum != tree_rmap_item->oldchecksum) {
+			parent = *new;
+			if (checksum < tree_rmap_item->oldchecksum)
+				new = &parent->rb_left;
+			else
+				new = &parent->rb_right;
+			continue;
+		}
+
 		tree_page = get_mergeable_page(tree_rmap_item);
 		if (IS_ERR_OR_NULL(tree_page))
 			return NULL;
@@ -1112,6 +1246,8 @@ struct rmap_item *unstable_tree_search_insert(struct rmap_item *rmap_item,
 static void stable_tree_append(struct rmap_item *rmap_item,
 			       struct stable_node *stable_node)
 {
+	struct mm_slot *mm_slot;
+
 	rmap_item->head = stable_node;
 	rmap_item->address |= STABLE_FLAG;
 	hlist_add_head(&rmap_item->hlist, &stable_node->hlist);
@@ -1120,6 +1256,12 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 		ksm_pages_sharing++;
 	else
 		ksm_pages_shared++;
+
+	spin_lock(&ksm_mmlist_lock);
+	mm_slot = get_mm_slot(rmap_item->mm);
+	if (mm_slot)
+		mm_slot->pages_merged++;
+	spin_unlock(&ksm_mmlist_lock);
 }
 
 /*
@@ -1128,22 +1270,30 @@ static void stable_tree_append(struct rmap_item *rmap_item,
  * be inserted into the unstable tree, or merged with a page already there and
  * both transferred to the stable tree.
  *
- * @page: the page that we are searching identical page to.
- * @rmap_item: the reverse mapping into the virtual address of this page
+ * @entry: the page that we are searching identical page to, its rmap_item,
+ *	and what the scan pool found out about it
  */
-static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
+static void cmp_and_merge_page(struct scan_entry *entry)
 {
+	struct page *page = entry->page;
+	struct rmap_item *rmap_item = entry->rmap_item;
 	struct rmap_item *tree_rmap_item;
 	struct page *tree_page = NULL;
 	struct stable_node *stable_node;
 	struct page *kpage;
-	unsigned int checksum;
+	unsigned int checksum = entry->checksum;
 	int err;
 
 	remove_rmap_item_from_tree(rmap_item);
 
-	/* We first start with searching the page inside the stable tree */
-	kpage = stable_tree_search(page);
+	/*
+	 * We first start with searching the page inside the stable tree:
+	 * the scan pool did so already, but has to leave it to us if it
+	 * met a stale node, or if a ksm page was inserted since then.
+	 */
+	kpage = entry->kpage;
+	if (IS_ERR(kpage) || (!kpage && ksm_stable_seq != ksm_batch_stable_seq))
+		kpage = stable_tree_search(page, checksum, true);
 	if (kpage) {
 		err = try_to_merge_with_ksm_page(rmap_item, page, kpage);
 		if (!err) {
@@ -1165,7 +1315,6 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 	 * don't want to insert it in the unstable tree, and we don't want
 	 * to waste our time searching for something identical to it there.
 	 */
-	checksum = calc_checksum(page);
 	if (rmap_item->oldchecksum != checksum) {
 		rmap_item->oldchecksum = checksum;
 		return;
@@ -1235,7 +1384,36 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
-static struct rmap_item *scan_get_next_rmap_item(struct page **page)
+/*
+ * Called when the scanner enters an mm, to update its per-pass statistics.
+ */
+static void mm_slot_start_pass(struct mm_slot *slot)
+{
+	unsigned long now = jiffies;
+	unsigned int msecs = jiffies_to_msecs(now - slot->pass_start);
+
+	if (slot->full_scans++ && msecs) {
+		slot->scan_rate = div_u64((u64)(slot->pages_scanned -
+				slot->pass_scanned) * MSEC_PER_SEC, msecs);
+		slot->merge_rate = div_u64((u64)(slot->pages_merged -
+				slot->pass_merged) * MSEC_PER_SEC, msecs);
+	}
+	slot->pass_start = now;
+	slot->pass_scanned = slot->pages_scanned;
+	slot->pass_merged = slot->pages_merged;
+}
+
+/*
+ * scan_get_next_rmap_item - advance the scanning cursor to the next page.
+ * @page: returns the page, with a reference held on it
+ * @batched: number of pages the caller is still holding on to
+ *
+ * Moving on from one mm to the next may free the rmap_items of an exiting
+ * mm: so if the caller is still holding on to any, NULL is returned at the
+ * end of the mm instead, for it to finish with those and call again.
+ */
+static struct rmap_item *scan_get_next_rmap_item(struct page **page,
+						 unsigned int batched)
 {
 	struct mm_struct *mm;
 	struct mm_slot *slot;
@@ -1256,6 +1434,7 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 next_mm:
 		ksm_scan.address = 0;
 		ksm_scan.rmap_list = &slot->rmap_list;
+		mm_slot_start_pass(slot);
 	}
 
 	mm = slot->mm;
@@ -1298,6 +1477,11 @@ next_mm:
 		}
 	}
 
+	if (batched) {
+		up_read(&mm->mmap_sem);
+		return NULL;
+	}
+
 	if (ksm_test_exit(mm)) {
 		ksm_scan.address = 0;
 		ksm_scan.rmap_list = &slot->rmap_list;
@@ -1343,6 +1527,70 @@ next_mm:
 	return NULL;
 }
 
+/*
+ * Checksum the pages of the current batch, and search the stable tree for
+ * them: run by ksmd and by the scan pool, until all entries are claimed.
+ */
+static void ksm_scan_batch(void)
+{
+	struct scan_entry *entry;
+
+	spin_lock(&ksm_batch_lock);
+	while (ksm_batch_next < ksm_batch_nr) {
+		entry = &ksm_batch[ksm_batch_next++];
+		spin_unlock(&ksm_batch_lock);
+
+		entry->checksum = calc_checksum(entry->page);
+		entry->kpage = stable_tree_search(entry->page,
+						  entry->checksum, false);
+
+		spin_lock(&ksm_batch_lock);
+		if (++ksm_batch_done == ksm_batch_nr)
+			wake_up(&ksm_batch_wait);
+	}
+	spin_unlock(&ksm_batch_lock);
+}
+
+static int ksm_batch_complete(void)
+{
+	int ret;
+
+	spin_lock(&ksm_batch_lock);
+	ret = ksm_batch_done == ksm_batch_nr;
+	spin_unlock(&ksm_batch_lock);
+	return ret;
+}
+
+/*
+ * Hand the nr pages gathered in ksm_batch to the scan pool, then merge
+ * them one by one and drop their references.
+ */
+static void ksm_merge_batch(unsigned int nr)
+{
+	struct scan_entry *entry;
+
+	ksm_batch_stable_seq = ksm_stable_seq;
+	spin_lock(&ksm_batch_lock);
+	ksm_batch_nr = nr;
+	ksm_batch_next = 0;
+	ksm_batch_done = 0;
+	ksm_batch_seq++;
+	spin_unlock(&ksm_batch_lock);
+
+	if (ksm_scan_threads > 1 && nr > 1)
+		wake_up_interruptible_all(&ksm_pool_wait);
+	ksm_scan_batch();
+	wait_event(ksm_batch_wait, ksm_batch_complete());
+
+	for (entry = ksm_batch; entry < ksm_batch + nr; entry++) {
+		cond_resched();
+		cmp_and_merge_page(entry);
+		if (!IS_ERR_OR_NULL(entry->kpage))
+			put_page(entry->kpage);
+		put_page(entry->page);
+	}
+}
+
 /**
  * ksm_do_scan  - the ksm scanner main worker function.
  * @scan_npages - number of pages we want to scan before we return.
@@ -1351,16 +1599,71 @@ static void ksm_do_scan(unsigned int scan_npages)
 {
 	struct rmap_item *rmap_item;
 	struct page *uninitialized_var(page);
+	unsigned int nr = 0;
 
-	while (scan_npages--) {
+	while (scan_npages) {
 		cond_resched();
-		rmap_item = scan_get_next_rmap_item(&page);
-		if (!rmap_item)
-			return;
-		if (!PageKsm(page) || !in_stable_tree(rmap_item))
-			cmp_and_merge_page(page, rmap_item);
-		put_page(page);
+		rmap_item = scan_get_next_rmap_item(&page, nr);
+		if (!rmap_item) {
+			if (!nr)
+				return;
+			/* end of this mm: merge what we have, then go on */
+			ksm_merge_batch(nr);
+			nr = 0;
+			continue;
+		}
+		scan_npages--;
+		ksm_scan.mm_slot->pages_scanned++;
+		if (PageKsm(page) && in_stable_tree(rmap_item)) {
+			put_page(page);
+			continue;
+		}
+		ksm_batch[nr].rmap_item = rmap_item;
+		ksm_batch[nr].page = page;
+		if (++nr == KSM_SCAN_BATCH) {
+			ksm_merge_batch(nr);
+			nr = 0;
+		}
 	}
+	if (nr)
+		ksm_merge_batch(nr);
+}
+
+static int ksm_scan_pool_thread(void *nothing)
+{
+	unsigned long seq = 0;
+
+	set_user_nice(current, 5);
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(ksm_pool_wait,
+			ACCESS_ONCE(ksm_batch_seq) != seq ||
+			kthread_should_stop());
+		seq = ACCESS_ONCE(ksm_batch_seq);
+		ksm_scan_batch();
+	}
+	return 0;
+}
+
+/*
+ * Start or stop ksmd/N threads of the scan pool, to have nr threads
+ * scanning with ksmd.  Called under ksm_thread_mutex, so never while
+ * the pool is working on a batch.
+ */
+static int ksm_set_scan_threads(unsigned int nr)
+{
+	struct task_struct *thread;
+
+	while (ksm_scan_threads < nr) {
+		thread = kthread_run(ksm_scan_pool_thread, NULL, "ksmd/%u",
+				     ksm_scan_threads);
+		if (IS_ERR(thread))
+			return PTR_ERR(thread);
+		ksm_scan_pool[ksm_scan_threads++ - 1] = thread;
+	}
+	while (ksm_scan_threads > nr)
+		kthread_stop(ksm_scan_pool[--ksm_scan_threads - 1]);
+	return 0;
 }
 
 static int ksmd_should_run(void)
@@ -1747,6 +2050,35 @@ static int ksm_memory_callback(struct notifier_block *self,
 }
 #endif /* CONFIG_MEMORY_HOTREMOVE */
 
+/*
+ * Show the scanning statistics of an mm for /proc/<pid>/ksm_stat.
+ */
+void ksm_mm_stat(struct seq_file *m, struct mm_struct *mm)
+{
+	struct mm_slot *mm_slot;
+	unsigned long full_scans = 0, pages_scanned = 0, pages_merged = 0;
+	unsigned long scan_rate = 0, merge_rate = 0;
+
+	spin_lock(&ksm_mmlist_lock);
+	mm_slot = get_mm_slot(mm);
+	if (mm_slot) {
+		full_scans = mm_slot->full_scans;
+		pages_scanned = mm_slot->pages_scanned;
+		pages_merged = mm_slot->pages_merged;
+		scan_rate = mm_slot->scan_rate;
+		merge_rate = mm_slot->merge_rate;
+	}
+	spin_unlock(&ksm_mmlist_lock);
+
+	seq_printf(m, "full_scans %lu\n"
+		      "pages_scanned %lu\n"
+		      "pages_merged %lu\n"
+		      "scan_rate %lu\n"
+		      "merge_rate %lu\n",
+		   full_scans, pages_scanned, pages_merged,
+		   scan_rate, merge_rate);
+}
+
 #ifdef CONFIG_SYSFS
 /*
  * This all compiles without CONFIG_SYSFS, but is a waste of space.
@@ -1804,6 +2136,33 @@ static ssize_t pages_to_scan_store(struct kobject *kobj,
 }
 KSM_ATTR(pages_to_scan);
 
+static ssize_t scan_threads_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_scan_threads_wanted);
+}
+
+static ssize_t scan_threads_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buf, size_t count)
+{
+	int err;
+	unsigned long nr;
+
+	err = strict_strtoul(buf, 10, &nr);
+	if (err || !nr || nr > nr_cpu_ids)
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	ksm_scan_threads_wanted = nr;
+	if (ksm_run & KSM_RUN_MERGE)
+		err = ksm_set_scan_threads(nr);
+	mutex_unlock(&ksm_thread_mutex);
+
+	return err ? err : count;
+}
+KSM_ATTR(scan_threads);
+
 static ssize_t run_show(struct kobject *kobj, struct kobj_attribute *attr,
 			char *buf)
 {
@@ -1841,6 +2200,13 @@ static ssize_t run_store(struct kobject *kobj, struct kobj_attribute *attr,
 				count = err;
 			}
 		}
+		/*
+		 * The scan pool only runs while ksmd does: a failure to
+		 * start it just leaves ksmd scanning with fewer threads.
+		 */
+		if (ksm_set_scan_threads(ksm_run & KSM_RUN_MERGE ?
+					 ksm_scan_threads_wanted : 1))
+			printk(KERN_WARNING "ksm: creating scan pool failed\n");
 	}
 	mutex_unlock(&ksm_thread_mutex);
 
@@ -1899,6 +2265,7 @@ KSM_ATTR_RO(full_scans);
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
+	&scan_threads_attr.attr,
 	&run_attr.attr,
 	&pages_shared_attr.attr,
 	&pages_sharing_attr.attr,
@@ -1923,22 +2290,36 @@ static int __init ksm_init(void)
 	if (err)
 		goto out;
 
+	ksm_scan_pool = kcalloc(nr_cpu_ids - 1, sizeof(*ksm_scan_pool),
+				GFP_KERNEL);
+	if (!ksm_scan_pool) {
+		err = -ENOMEM;
+		goto out_free;
+	}
+
 	ksm_thread = kthread_run(ksm_scan_thread, NULL, "ksmd");
 	if (IS_ERR(ksm_thread)) {
 		printk(KERN_ERR "ksm: creating kthread failed\n");
 		err = PTR_ERR(ksm_thread);
-		goto out_free;
+		goto out_free_pool;
 	}
 
+	/* A scan pool thread per cpu, started when ksmd is set running */
+	ksm_scan_threads_wanted = num_online_cpus();
+
 #ifdef CONFIG_SYSFS
 	err = sysfs_create_group(mm_kobj, &ksm_attr_group);
 	if (err) {
 		printk(KERN_ERR "ksm: register sysfs failed\n");
 		kthread_stop(ksm_thread);
-		goto out_free;
+		goto out_free_pool;
 	}
 #else
 	ksm_run = KSM_RUN_MERGE;	/* no way for user to start it */
+	mutex_lock(&ksm_thread_mutex);
+	if (ksm_set_scan_threads(ksm_scan_threads_wanted))
+		printk(KERN_WARNING "ksm: creating scan pool failed\n");
+	mutex_unlock(&ksm_thread_mutex);
 
 #endif /* CONFIG_SYSFS */
 
@@ -1951,6 +2332,8 @@ static int __init ksm_init(void)
 #endif
 	return 0;
 
+out_free_pool:
+	kfree(ksm_scan_pool);
 out_free:
 	ksm_slab_free();
 out:
@@ -0,0 +1,867 @@
+/*
+ * Large pages for anonymous memory
+ *
+ * Anonymous memory is normally faulted in one page at a time, and each
+ * of those pages takes a TLB entry of its own.  Where the architecture
+ * can map a naturally aligned block of LARGE_ANON_NR pages with a single
+ * TLB entry (64K large pages on ARM), we allocate the whole block at the
+ * first write fault into it instead, and ask the architecture to map it
+ * with a large page.  Blocks that were faulted in page by page anyway
+ * are collapsed into a new block later on by klargepaged.
+ *
+ * Unlike hugetlbfs or transparent huge pages, the pages of a block are
+ * split into ordinary order-0 pages straight after allocation, with
+ * ordinary ptes, rmap, LRU and memcg accounting each.  So reclaim, swap,
+ * migration, mprotect, fork and partial munmap all keep working as they
+ * always have: the only thing they do differently is that changing a
+ * pte of a block first splits its large page mapping (set_pte_at() and
+ * pte_clear() do that), and the block falls back to small TLB entries.
+ *
+ * Which areas get large pages is controlled by
+ * /sys/kernel/mm/large_anon/enabled: "always", "madvise" for areas given
+ * MADV_HUGEPAGE only (the default), or "never".
+ */
+
+#include <linux/errno.h>
+#include <linux/mm.h>
+#include <linux/mman.h>
+#include <linux/sched.h>
+#include <linux/rwsem.h>
+#include <linux/highmem.h>
+#include <linux/rmap.h>
+#include <linux/ksm.h>
+#include <linux/spinlock.h>
+#include <linux/kthread.h>
+#include <linux/wait.h>
+#include <linux/slab.h>
+#include <linux/swap.h>
+#include <linux/hash.h>
+#include <linux/memcontrol.h>
+#include <linux/mmu_notifier.h>
+#include <linux/large_anon.h>
+
+#include <asm/cacheflush.h>
+#include <asm/tlbflush.h>
+
+/**
+ * struct mm_slot - klargepaged information per mm that is being scanned
+ * @hash: link to the mm_slots hash list
+ * @mm_list: link into the mm_slots list, rooted in large_anon_scan
+ * @mm: the mm that this information is valid for
+ */
+struct mm_slot {
+	struct hlist_node hash;
+	struct list_head mm_list;
+	struct mm_struct *mm;
+};
+
+/**
+ * struct large_anon_scan - cursor for scanning
+ * @mm_head: the head of the mm list to scan
+ * @mm_slot: the current mm_slot we are scanning
+ * @address: the next address inside that to be scanned
+ *
+ * There is only the one large_anon_scan instance of this cursor structure.
+ */
+struct large_anon_scan {
+	struct list_head mm_head;
+	struct mm_slot *mm_slot;
+	unsigned long address;
+};
+
+static struct large_anon_scan large_anon_scan = {
+	.mm_head = LIST_HEAD_INIT(large_anon_scan.mm_head),
+};
+
+#define MM_SLOTS_HASH_SHIFT 8
+#define MM_SLOTS_HASH_HEADS (1 << MM_SLOTS_HASH_SHIFT)
+static struct hlist_head mm_slots_hash[MM_SLOTS_HASH_HEADS];
+
+static struct kmem_cache *mm_slot_cache;
+
+unsigned int large_anon_mode = LARGE_ANON_MADVISE;
+
+/* Number of pages klargepaged looks at in one batch */
+static unsigned int large_anon_pages_to_scan = LARGE_ANON_NR * 64;
+
+/* Milliseconds klargepaged sleeps between batches */
+static unsigned int large_anon_scan_sleep_millisecs = 1000;
+
+/* Up to how many unmapped pages of a block klargepaged fills in */
+static unsigned int large_anon_max_ptes_none = LARGE_ANON_NR - 1;
+
+/* The number of completed passes over all registered mms */
+static unsigned long large_anon_full_scans;
+
+static DECLARE_WAIT_QUEUE_HEAD(klargepaged_wait);
+static DEFINE_SPINLOCK(large_anon_mmlist_lock);
+
+/* Areas we never map with large pages */
+#define LARGE_ANON_VM_EXCLUDE	(VM_SHARED   | VM_MAYSHARE  | VM_PFNMAP   | \
+				 VM_IO       | VM_DONTEXPAND | VM_RESERVED | \
+				 VM_HUGETLB  | VM_INSERTPAGE | VM_NONLINEAR | \
+				 VM_MIXEDMAP | VM_SAO)
+
+static inline struct mm_slot *alloc_mm_slot(void)
+{
+	if (!mm_slot_cache)	/* initialization failed */
+		return NULL;
+	return kmem_cache_zalloc(mm_slot_cache, GFP_KERNEL);
+}
+
+static inline void free_mm_slot(struct mm_slot *mm_slot)
+{
+	kmem_cache_free(mm_slot_cache, mm_slot);
+}
+
+static struct mm_slot *get_mm_slot(struct mm_struct *mm)
+{
+	struct mm_slot *mm_slot;
+	struct hlist_head *bucket;
+	struct hlist_node *node;
+
+	bucket = &mm_slots_hash[hash_ptr(mm, MM_SLOTS_HASH_SHIFT)];
+	hlist_for_each_entry(mm_slot, node, bucket, hash) {
+		if (mm == mm_slot->mm)
+			return mm_slot;
+	}
+	return NULL;
+}
+
+static void insert_to_mm_slots_hash(struct mm_struct *mm,
+				    struct mm_slot *mm_slot)
+{
+	struct hlist_head *bucket;
+
+	bucket = &mm_slots_hash[hash_ptr(mm, MM_SLOTS_HASH_SHIFT)];
+	mm_slot->mm = mm;
+	hlist_add_head(&mm_slot->hash, bucket);
+}
+
+/*
+ * As for ksmd: klargepaged must not touch the page tables of an mm
+ * that has passed through large_anon_exit(), and backs out as soon as
+ * mm_users is zero.
+ */
+static inline bool large_anon_test_exit(struct mm_struct *mm)
+{
+	return atomic_read(&mm->mm_users) == 0;
+}
+
+static int large_anon_vma_suitable(struct vm_area_struct *vma)
+{
+	if (vma->vm_ops || vma->vm_file)
+		return 0;
+	if (!(vma->vm_flags & VM_WRITE) ||
+	    (vma->vm_flags & LARGE_ANON_VM_EXCLUDE))
+		return 0;
+	return large_anon_enabled(vma);
+}
+
+static inline int large_anon_block_in_vma(struct vm_area_struct *vma,
+					  unsigned long haddr)
+{
+	return haddr >= vma->vm_start && haddr + LARGE_ANON_SIZE <= vma->vm_end;
+}
+
+static int large_anon_count_none(pte_t *pte)
+{
+	int i, none = 0;
+
+	for (i = 0; i < LARGE_ANON_NR; i++)
+		if (pte_none(pte[i]))
+			none++;
+	return none;
+}
+
+/*
+ * Allocate a block, split it into LARGE_ANON_NR pages and charge each
+ * of them to mm.
+ */
+static struct page *large_anon_alloc(struct mm_struct *mm)
+{
+	struct page *page;
+	int i;
+
+	page = alloc_pages(GFP_HIGHUSER_MOVABLE | __GFP_NOWARN | __GFP_NORETRY,
+			   LARGE_ANON_ORDER);
+	if (!page)
+		return NULL;
+	split_page(page, LARGE_ANON_ORDER);
+
+	for (i = 0; i < LARGE_ANON_NR; i++) {
+		if (mem_cgroup_newpage_charge(page + i, mm, GFP_KERNEL))
+			goto uncharge;
+	}
+	return page;
+
+uncharge:
+	while (i--)
+		mem_cgroup_uncharge_page(page + i);
+	for (i = 0; i < LARGE_ANON_NR; i++)
+		page_cache_release(page + i);
+	return NULL;
+}
+
+static void large_anon_free(struct page *page)
+{
+	int i;
+
+	for (i = 0; i < LARGE_ANON_NR; i++) {
+		mem_cgroup_uncharge_page(page + i);
+		page_cache_release(page + i);
+	}
+}
+
+static void large_anon_set_pte(struct mm_struct *mm,
+			       struct vm_area_struct *vma, unsigned long addr,
+			       pte_t *pte, struct page *page)
+{
+	pte_t entry;
+
+	entry = mk_pte(page, vma->vm_page_prot);
+	entry = pte_mkwrite(pte_mkdirty(entry));
+
+	page_add_new_anon_rmap(page, vma, addr);
+	set_pte_at(mm, addr, pte, entry);
+	update_mmu_cache(vma, addr, pte);
+}
+
+/*
+ * Called from do_anonymous_page() on a write fault, with mmap_sem held
+ * for reading and the anon_vma prepared.  If the whole block around
+ * address is unmapped, fill it with a new block of zeroed pages and map
+ * it with a large page.  Returns 0 if it did, otherwise the caller falls
+ * back to a single page.
+ */
+int do_large_anon_page(struct mm_struct *mm, struct vm_area_struct *vma,
+		       unsigned long address, pmd_t *pmd)
+{
+	unsigned long haddr = address & LARGE_ANON_MASK;
+	struct page *page;
+	spinlock_t *ptl;
+	pte_t *pte;
+	int i, none;
+
+	if (!large_anon_vma_suitable(vma) || !large_anon_block_in_vma(vma, haddr))
+		return -EINVAL;
+
+	/* no point in allocating if the block is partly mapped already */
+	pte = pte_offset_map(pmd, haddr);
+	none = large_anon_count_none(pte);
+	pte_unmap(pte);
+	if (none != LARGE_ANON_NR)
+		return -EBUSY;
+
+	if (!test_bit(MMF_VM_LARGE_ANON, &mm->flags))
+		__large_anon_enter(mm);
+
+	page = large_anon_alloc(mm);
+	if (!page) {
+		count_vm_event(LARGE_ANON_FAULT_FALLBACK);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < LARGE_ANON_NR; i++) {
+		clear_user_highpage(page + i, haddr + i * PAGE_SIZE);
+		__SetPageUptodate(page + i);
+	}
+
+	pte = pte_offset_map_lock(mm, pmd, haddr, &ptl);
+	if (large_anon_count_none(pte) != LARGE_ANON_NR) {
+		pte_unmap_unlock(pte, ptl);
+		large_anon_free(page);
+		return -EBUSY;
+	}
+
+	for (i = 0; i < LARGE_ANON_NR; i++)
+		large_anon_set_pte(mm, vma, haddr + i * PAGE_SIZE, pte + i,
+				   page + i);
+	add_mm_counter(mm, MM_ANONPAGES, LARGE_ANON_NR);
+
+	if (arch_promote_large_anon(mm, haddr, pte))
+		count_vm_event(LARGE_ANON_PROMOTE);
+	pte_unmap_unlock(pte, ptl);
+
+	count_vm_event(LARGE_ANON_FAULT_ALLOC);
+	return 0;
+}
+
+/*
+ * A page we may copy and replace: an anonymous page which is mapped
+ * writable by this pte only, and which nobody else holds a reference to
+ * (get_user_pages, reclaim or migration in progress).
+ */
+static struct page *large_anon_exclusive_page(struct vm_area_struct *vma,
+					      unsigned long addr, pte_t pteval)
+{
+	struct page *page;
+
+	if (!pte_present(pteval) || !pte_write(pteval))
+		return NULL;
+	page = vm_normal_page(vma, addr, pteval);
+	if (!page || !PageAnon(page) || PageKsm(page) || PageSwapCache(page))
+		return NULL;
+	if (page_mapcount(page) != 1 || page_count(page) != 1)
+		return NULL;
+	return page;
+}
+
+enum {
+	SCAN_SKIP,
+	SCAN_PROMOTE,
+	SCAN_COLLAPSE,
+};
+
+/*
+ * What can be done about the block starting at haddr: if its pages are
+ * already contiguous it only needs a large page mapping, otherwise its
+ * pages may have to be replaced by a new block.
+ */
+static int large_anon_check_block(struct vm_area_struct *vma,
+				  unsigned long haddr, pte_t *pte)
+{
+	unsigned long pfn = pte_pfn(pte[0]);
+	int i, none = 0, contiguous = !(pfn & (LARGE_ANON_NR - 1));
+
+	if (pte_large_anon(pte))
+		return SCAN_SKIP;
+
+	for (i = 0; i < LARGE_ANON_NR; i++) {
+		if (pte_none(pte[i])) {
+			none++;
+			contiguous = 0;
+			continue;
+		}
+		if (!pte_present(pte[i]))
+			return SCAN_SKIP;
+		if (pte_pfn(pte[i]) != pfn + i)
+			contiguous = 0;
+	}
+	if (none == LARGE_ANON_NR || none > large_anon_max_ptes_none)
+		return SCAN_SKIP;
+	if (contiguous)
+		return SCAN_PROMOTE;
+
+	for (i = 0; i < LARGE_ANON_NR; i++) {
+		if (pte_none(pte[i]))
+			continue;
+		if (!large_anon_exclusive_page(vma, haddr + i * PAGE_SIZE,
+					       pte[i]))
+			return SCAN_SKIP;
+	}
+	return SCAN_COLLAPSE;
+}
+
+/*
+ * Replace the pages of the block at haddr by a new block, copying their
+ * contents and zero filling the holes.  Called with mmap_sem held for
+ * reading; everything else is done under the pte lock, which keeps out
+ * faults on the block as well as rmap walks on the old pages.
+ */
+static void large_anon_collapse(struct mm_struct *mm,
+				struct vm_area_struct *vma,
+				unsigned long haddr, pmd_t *pmd)
+{
+	unsigned long end = haddr + LARGE_ANON_SIZE;
+	struct page *new, *old[LARGE_ANON_NR];
+	pte_t orig[LARGE_ANON_NR];
+	spinlock_t *ptl;
+	pte_t *pte;
+	int i, none;
+
+	new = large_anon_alloc(mm);
+	if (!new) {
+		count_vm_event(LARGE_ANON_COLLAPSE_ALLOC_FAILED);
+		return;
+	}
+	count_vm_event(LARGE_ANON_COLLAPSE_ALLOC);
+
+	mmu_notifier_invalidate_range_start(mm, haddr, end);
+	pte = pte_offset_map_lock(mm, pmd, haddr, &ptl);
+	if (large_anon_check_block(vma, haddr, pte) != SCAN_COLLAPSE) {
+		pte_unmap_unlock(pte, ptl);
+		mmu_notifier_invalidate_range_end(mm, haddr, end);
+		large_anon_free(new);
+		return;
+	}
+
+	flush_cache_range(vma, haddr, end);
+	for (i = 0; i < LARGE_ANON_NR; i++)
+		orig[i] = ptep_get_and_clear(mm, haddr + i * PAGE_SIZE,
+					     pte + i);
+	flush_tlb_range(vma, haddr, end);
+
+	none = 0;
+	for (i = 0; i < LARGE_ANON_NR; i++) {
+		unsigned long addr = haddr + i * PAGE_SIZE;
+
+		if (pte_none(orig[i])) {
+			old[i] = NULL;
+			clear_user_highpage(new + i, addr);
+			none++;
+		} else {
+			old[i] = vm_normal_page(vma, addr, orig[i]);
+			copy_user_highpage(new + i, old[i], addr, vma);
+		}
+		__SetPageUptodate(new + i);
+		large_anon_set_pte(mm, vma, addr, pte + i, new + i);
+		if (old[i])
+			page_remove_rmap(old[i]);
+	}
+	add_mm_counter(mm, MM_ANONPAGES, none);
+
+	if (arch_promote_large_anon(mm, haddr, pte))
+		count_vm_event(LARGE_ANON_PROMOTE);
+	pte_unmap_unlock(pte, ptl);
+	mmu_notifier_invalidate_range_end(mm, haddr, end);
+
+	for (i = 0; i < LARGE_ANON_NR; i++)
+		if (old[i])
+			page_cache_release(old[i]);
+}
+
+static pmd_t *large_anon_pmd(struct mm_struct *mm, unsigned long addr)
+{
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+
+	pgd = pgd_offset(mm, addr);
+	if (!pgd_present(*pgd))
+		return NULL;
+	pud = pud_offset(pgd, addr);
+	if (!pud_present(*pud))
+		return NULL;
+	pmd = pmd_offset(pud, addr);
+	if (pmd_none(*pmd) || unlikely(pmd_bad(*pmd)))
+		return NULL;
+	return pmd;
+}
+
+static void large_anon_scan_block(struct mm_struct *mm,
+				  struct vm_area_struct *vma,
+				  unsigned long haddr)
+{
+	spinlock_t *ptl;
+	pmd_t *pmd;
+	pte_t *pte;
+	int ret;
+
+	pmd = large_anon_pmd(mm, haddr);
+	if (!pmd)
+		return;
+
+	/* a racy first look, to keep the pte lock for blocks worth it */
+	pte = pte_offset_map(pmd, haddr);
+	ret = large_anon_check_block(vma, haddr, pte);
+	pte_unmap(pte);
+
+	if (ret == SCAN_COLLAPSE) {
+		large_anon_collapse(mm, vma, haddr, pmd);
+	} else if (ret == SCAN_PROMOTE) {
+		pte = pte_offset_map_lock(mm, pmd, haddr, &ptl);
+		if (large_anon_check_block(vma, haddr, pte) == SCAN_PROMOTE &&
+		    arch_promote_large_anon(mm, haddr, pte))
+			count_vm_event(LARGE_ANON_PROMOTE);
+		pte_unmap_unlock(pte, ptl);
+	}
+}
+
+/*
+ * Free the mm_slot of an mm that has exited.  Called with
+ * large_anon_mmlist_lock held.
+ */
+static void collect_mm_slot(struct mm_slot *mm_slot)
+{
+	struct mm_struct *mm = mm_slot->mm;
+
+	if (large_anon_test_exit(mm)) {
+		hlist_del(&mm_slot->hash);
+		list_del(&mm_slot->mm_list);
+		free_mm_slot(mm_slot);
+		mmdrop(mm);
+	}
+}
+
+static unsigned int large_anon_scan_mm_slot(unsigned int pages)
+{
+	struct mm_slot *mm_slot;
+	struct mm_struct *mm;
+	struct vm_area_struct *vma;
+	unsigned int progress = 0;
+
+	spin_lock(&large_anon_mmlist_lock);
+	if (list_empty(&large_anon_scan.mm_head)) {
+		/* every mm exited since the caller looked */
+		spin_unlock(&large_anon_mmlist_lock);
+		return 0;
+	}
+	if (!large_anon_scan.mm_slot) {
+		large_anon_scan.mm_slot = list_entry(
+			large_anon_scan.mm_head.next, struct mm_slot, mm_list);
+		large_anon_scan.address = 0;
+	}
+	mm_slot = large_anon_scan.mm_slot;
+	spin_unlock(&large_anon_mmlist_lock);
+
+	mm = mm_slot->mm;
+	down_read(&mm->mmap_sem);
+	if (large_anon_test_exit(mm))
+		vma = NULL;
+	else
+		vma = find_vma(mm, large_anon_scan.address);
+
+	for (; vma; vma = vma->vm_next) {
+		unsigned long start, end;
+
+		cond_resched();
+		progress++;
+		if (!vma->anon_vma || !large_anon_vma_suitable(vma))
+			continue;
+
+		start = ALIGN(vma->vm_start, LARGE_ANON_SIZE);
+		end = vma->vm_end & LARGE_ANON_MASK;
+		if (large_anon_scan.address < start)
+			large_anon_scan.address = start;
+
+		while (large_anon_scan.address < end) {
+			if (large_anon_test_exit(mm))
+				goto out;
+			large_anon_scan_block(mm, vma, large_anon_scan.address);
+			large_anon_scan.address += LARGE_ANON_SIZE;
+			progress += LARGE_ANON_NR;
+			if (progress >= pages)
+				goto out;
+		}
+	}
+out:
+	up_read(&mm->mmap_sem);
+
+	spin_lock(&large_anon_mmlist_lock);
+	if (large_anon_test_exit(mm) || !vma) {
+		/* done with this mm: move on to the next one */
+		if (mm_slot->mm_list.next != &large_anon_scan.mm_head) {
+			large_anon_scan.mm_slot = list_entry(
+				mm_slot->mm_list.next, struct mm_slot, mm_list);
+			large_anon_scan.address = 0;
+		} else {
+			large_anon_scan.mm_slot = NULL;
+			large_anon_full_scans++;
+		}
+		collect_mm_slot(mm_slot);
+	}
+	spin_unlock(&large_anon_mmlist_lock);
+
+	return progress;
+}
+
+static int klargepaged_should_run(void)
+{
+	return large_anon_mode != LARGE_ANON_NEVER &&
+		!list_empty(&large_anon_scan.mm_head);
+}
+
+static void klargepaged_do_scan(void)
+{
+	unsigned int progress = 0, pages = large_anon_pages_to_scan;
+	int passes = 0;
+
+	/* pages still on our lru pagevecs look referenced */
+	lru_add_drain();
+
+	while (progress < pages && !kthread_should_stop()) {
+		cond_resched();
+
+		spin_lock(&large_anon_mmlist_lock);
+		if (!large_anon_scan.mm_slot)
+			passes++;
+		spin_unlock(&large_anon_mmlist_lock);
+
+		/* at most one full pass over all the mms per batch */
+		if (passes > 1 || !klargepaged_should_run())
+			break;
+		progress += large_anon_scan_mm_slot(pages - progress);
+	}
+}
+
+static int klargepaged(void *nothing)
+{
+	set_user_nice(current, 19);
+
+	while (!kthread_should_stop()) {
+		if (klargepaged_should_run())
+			klargepaged_do_scan();
+
+		if (klargepaged_should_run()) {
+			schedule_timeout_interruptible(
+				msecs_to_jiffies(large_anon_scan_sleep_millisecs));
+		} else {
+			wait_event_interruptible(klargepaged_wait,
+				klargepaged_should_run() || kthread_should_stop());
+		}
+	}
+	return 0;
+}
+
+int large_anon_madvise(struct vm_area_struct *vma, unsigned long *vm_flags,
+		       int advice)
+{
+	int err;
+
+	switch (advice) {
+	case MADV_HUGEPAGE:
+		if (*vm_flags & (VM_HUGEPAGE | LARGE_ANON_VM_EXCLUDE))
+			return 0;		/* just ignore the advice */
+		if (vma->vm_ops || vma->vm_file)
+			return 0;
+
+		err = __large_anon_enter(vma->vm_mm);
+		if (err)
+			return err;
+
+		*vm_flags |= VM_HUGEPAGE;
+		break;
+
+	case MADV_NOHUGEPAGE:
+		*vm_flags &= ~VM_HUGEPAGE;
+		break;
+	}
+
+	return 0;
+}
+
+int __large_anon_enter(struct mm_struct *mm)
+{
+	struct mm_slot *mm_slot;
+	int needs_wakeup;
+
+	/* faults in "always" mode may race to get here */
+	if (test_and_set_bit(MMF_VM_LARGE_ANON, &mm->flags))
+		return 0;
+
+	mm_slot = alloc_mm_slot();
+	if (!mm_slot) {
+		clear_bit(MMF_VM_LARGE_ANON, &mm->flags);
+		return -ENOMEM;
+	}
+
+	spin_lock(&large_anon_mmlist_lock);
+	insert_to_mm_slots_hash(mm, mm_slot);
+	needs_wakeup = list_empty(&large_anon_scan.mm_head);
+	list_add_tail(&mm_slot->mm_list, &large_anon_scan.mm_head);
+	spin_unlock(&large_anon_mmlist_lock);
+
+	atomic_inc(&mm->mm_count);
+
+	if (needs_wakeup)
+		wake_up_interruptible(&klargepaged_wait);
+
+	return 0;
+}
+
+void __large_anon_exit(struct mm_struct *mm)
+{
+	struct mm_slot *mm_slot;
+	int easy_to_free = 0;
+
+	/*
+	 * If klargepaged is not at this mm, free the mm_slot right away.
+	 * Otherwise leave it for klargepaged to free, and wait for it to
+	 * let go of mmap_sem before the page tables are torn down.
+	 */
+	spin_lock(&large_anon_mmlist_lock);
+	mm_slot = get_mm_slot(mm);
+	if (mm_slot && large_anon_scan.mm_slot != mm_slot) {
+		hlist_del(&mm_slot->hash);
+		list_del(&mm_slot->mm_list);
+		easy_to_free = 1;
+	}
+	spin_unlock(&large_anon_mmlist_lock);
+
+	if (easy_to_free) {
+		clear_bit(MMF_VM_LARGE_ANON, &mm->flags);
+		free_mm_slot(mm_slot);
+		mmdrop(mm);
+	} else if (mm_slot) {
+		down_write(&mm->mmap_sem);
+		up_write(&mm->mmap_sem);
+	}
+}
+
+#ifdef CONFIG_SYSFS
+#define LARGE_ANON_ATTR_RO(_name) \
+	static struct kobj_attribute _name##_attr = __ATTR_RO(_name)
+#define LARGE_ANON_ATTR(_name) \
+	static struct kobj_attribute _name##_attr = \
+		__ATTR(_name, 0644, _name##_show, _name##_store)
+
+static const char *large_anon_modes[] = {
+	[LARGE_ANON_NEVER]	= "never",
+	[LARGE_ANON_MADVISE]	= "madvise",
+	[LARGE_ANON_ALWAYS]	= "always",
+};
+
+static ssize_t enabled_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	ssize_t len = 0;
+	int i;
+
+	for (i = LARGE_ANON_ALWAYS; i >= LARGE_ANON_NEVER; i--)
+		len += sprintf(buf + len, i == large_anon_mode ? "[%s]%s" : "%s%s",
+			       large_anon_modes[i], i ? " " : "\n");
+	return len;
+}
+
+static ssize_t enabled_store(struct kobject *kobj,
+			     struct kobj_attribute *attr,
+			     const char *buf, size_t count)
+{
+	int i;
+
+	for (i = LARGE_ANON_NEVER; i <= LARGE_ANON_ALWAYS; i++) {
+		if (sysfs_streq(buf, large_anon_modes[i])) {
+			large_anon_mode = i;
+			wake_up_interruptible(&klargepaged_wait);
+			return count;
+		}
+	}
+	return -EINVAL;
+}
+LARGE_ANON_ATTR(enabled);
+
+static ssize_t scan_sleep_millisecs_show(struct kobject *kobj,
+					 struct kobj_attribute *attr,
+					 char *buf)
+{
+	return sprintf(buf, "%u\n", large_anon_scan_sleep_millisecs);
+}
+
+static ssize_t scan_sleep_millisecs_store(struct kobject *kobj,
+					  struct kobj_attribute *attr,
+					  const char *buf, size_t count)
+{
+	unsigned long msecs;
+	int err;
+
+	err = strict_strtoul(buf, 10, &msecs);
+	if (err || msecs > UINT_MAX)
+		return -EINVAL;
+
+	large_anon_scan_sleep_millisecs = msecs;
+
+	return count;
+}
+LARGE_ANON_ATTR(scan_sleep_millisecs);
+
+static ssize_t pages_to_scan_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", large_anon_pages_to_scan);
+}
+
+static ssize_t pages_to_scan_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buf, size_t count)
+{
+	unsigned long nr_pages;
+	int err;
+
+	err = strict_strtoul(buf, 10, &nr_pages);
+	if (err || !nr_pages || nr_pages > UINT_MAX)
+		return -EINVAL;
+
+	large_anon_pages_to_scan = nr_pages;
+
+	return count;
+}
+LARGE_ANON_ATTR(pages_to_scan);
+
+static ssize_t max_ptes_none_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", large_anon_max_ptes_none);
+}
+
+static ssize_t max_ptes_none_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buf, size_t count)
+{
+	unsigned long max_ptes_none;
+	int err;
+
+	err = strict_strtoul(buf, 10, &max_ptes_none);
+	if (err || max_ptes_none > LARGE_ANON_NR - 1)
+		return -EINVAL;
+
+	large_anon_max_ptes_none = max_ptes_none;
+
+	return count;
+}
+LARGE_ANON_ATTR(max_ptes_none);
+
+static ssize_t full_scans_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", large_anon_full_scans);
+}
+LARGE_ANON_ATTR_RO(full_scans);
+
+static ssize_t block_size_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", LARGE_ANON_SIZE);
+}
+LARGE_ANON_ATTR_RO(block_size);
+
+static struct attribute *large_anon_attrs[] = {
+	&enabled_attr.attr,
+	&scan_sleep_millisecs_attr.attr,
+	&pages_to_scan_attr.attr,
+	&max_ptes_none_attr.attr,
+	&full_scans_attr.attr,
+	&block_size_attr.attr,
+	NULL,
+};
+
+static struct attribute_group large_anon_attr_group = {
+	.attrs = large_anon_attrs,
+	.name = "large_anon",
+};
+#endif /* CONFIG_SYSFS */
+
+static int __init large_anon_init(void)
+{
+	struct task_struct *klargepaged_thread;
+	int err;
+
+	mm_slot_cache = kmem_cache_create("large_anon_mm_slot",
+			sizeof(struct mm_slot), __alignof__(struct mm_slot),
+			0, NULL);
+	if (!mm_slot_cache)
+		return -ENOMEM;
+
+	klargepaged_thread = kthread_run(klargepaged, NULL, "klargepaged");
+	if (IS_ERR(klargepaged_thread)) {
+		printk(KERN_ERR "large_anon: creating kthread failed\n");
+		err = PTR_ERR(klargepaged_thread);
+		goto out_free;
+	}
+
+#ifdef CONFIG_SYSFS
+	err = sysfs_create_group(mm_kobj, &large_anon_attr_group);
+	if (err) {
+		printk(KERN_ERR "large_anon: register sysfs failed\n");
+		kthread_stop(klargepaged_thread);
+		goto out_free;
+	}
+#endif
+	return 0;
+
+out_free:
+	kmem_cache_destroy(mm_slot_cache);
+	mm_slot_cache = NULL;
+	return err;
+}
+module_init(large_anon_init)
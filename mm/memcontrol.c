@@ -48,6 +48,7 @@
 #include <linux/page_cgroup.h>
 #include <linux/cpu.h>
 #include <linux/oom.h>
+#include <linux/writeback.h>
 #include "internal.h"
 
 #include <asm/uaccess.h>
@@ -86,6 +87,9 @@ enum mem_cgroup_stat_index {
 	MEM_CGROUP_STAT_CACHE, 	   /* # of pages charged as cache */
 	MEM_CGROUP_STAT_RSS,	   /* # of pages charged as anon rss */
 	MEM_CGROUP_STAT_FILE_MAPPED,  /* # of pages charged as file rss */
+	MEM_CGROUP_STAT_FILE_DIRTY,	/* # of dirty pages in page cache */
+	MEM_CGROUP_STAT_FILE_WRITEBACK,	/* # of pages under writeback */
+	MEM_CGROUP_STAT_FILE_UNSTABLE_NFS, /* # of NFS unstable pages */
 	MEM_CGROUP_STAT_PGPGIN_COUNT,	/* # of pages paged in */
 	MEM_CGROUP_STAT_PGPGOUT_COUNT,	/* # of pages paged out */
 	MEM_CGROUP_STAT_SWAPOUT, /* # of pages, swapped out */
@@ -182,6 +186,17 @@ struct mem_cgroup_eventfd_list {
 static void mem_cgroup_threshold(struct mem_cgroup *mem);
 static void mem_cgroup_oom_notify(struct mem_cgroup *mem);
 
+/*
+ * Dirty limits, as the vm.dirty_* sysctls: a ratio of the memory the cgroup
+ * may use for page cache, or an amount of bytes if not 0.
+ */
+struct mem_cgroup_dirty_param {
+	int dirty_ratio;
+	unsigned long dirty_bytes;
+	int dirty_background_ratio;
+	unsigned long dirty_background_bytes;
+};
+
 /*
  * The memory controller data structure. The memory controller controls both
  * page cache and RSS per cgroup. We would eventually like to provide
@@ -227,6 +242,8 @@ struct mem_cgroup {
 	atomic_t	refcnt;
 
 	unsigned int	swappiness;
+	/* dirty limits, protected by reclaim_param_lock */
+	struct mem_cgroup_dirty_param dirty_param;
 	/* OOM-Killer disable */
 	int		oom_kill_disable;
 
@@ -1461,37 +1478,106 @@ bool mem_cgroup_handle_oom(struct mem_cgroup *mem, gfp_t mask)
 }
 
 /*
- * Currently used to update mapped file statistics, but the routine can be
- * generalized to update other statistics as well.
+ * A mapping remembers which cgroup dirtied its pages, for the writeback
+ * of a cgroup over its dirty limits to find the inodes to write: the id
+ * of that cgroup, or MAPPING_MEMCG_SHARED once several of them did, or 0
+ * when unknown.  css ids never exceed 65535.
+ */
+#define MAPPING_MEMCG_SHARED	(1U << 16)
+
+static void mem_cgroup_mark_mapping(struct address_space *mapping,
+				    struct mem_cgroup *mem)
+{
+	unsigned int id = css_id(&mem->css);
+	unsigned int old = ACCESS_ONCE(mapping->i_memcg);
+
+	if (old == id || old == MAPPING_MEMCG_SHARED)
+		return;
+	mapping->i_memcg = old ? MAPPING_MEMCG_SHARED : id;
+}
+
+/**
+ * mem_cgroup_mapping_dirtied_by - is @mapping to be written for a cgroup
+ * @mapping: the mapping of a dirty inode
+ * @id: css id of the cgroup over its dirty limits, or 0 for none
  */
-void mem_cgroup_update_file_mapped(struct page *page, int val)
+bool mem_cgroup_mapping_dirtied_by(struct address_space *mapping,
+				   unsigned short id)
+{
+	unsigned int owner = ACCESS_ONCE(mapping->i_memcg);
+
+	return !id || !owner || owner == id || owner == MAPPING_MEMCG_SHARED;
+}
+
+/* called once all the dirty pages of @mapping were written */
+void mem_cgroup_mapping_clean(struct address_space *mapping)
+{
+	mapping->i_memcg = 0;
+}
+
+void mem_cgroup_update_page_stat(struct page *page,
+				 enum mem_cgroup_page_stat_item idx, int val)
 {
 	struct mem_cgroup *mem;
 	struct page_cgroup *pc;
+	unsigned long flags;
+	int stat, flag;
 
+	if (mem_cgroup_disabled())
+		return;
 	pc = lookup_page_cgroup(page);
 	if (unlikely(!pc))
 		return;
 
-	lock_page_cgroup(pc);
+	/*
+	 * Dirty and writeback pages are accounted from interrupt context
+	 * too, so only the move lock may be taken here.
+	 */
+	move_lock_page_cgroup(pc, &flags);
 	mem = pc->mem_cgroup;
 	if (!mem || !PageCgroupUsed(pc))
 		goto done;
 
+	switch (idx) {
+	case MEMCG_NR_FILE_MAPPED:
+		flag = PCG_FILE_MAPPED;
+		stat = MEM_CGROUP_STAT_FILE_MAPPED;
+		break;
+	case MEMCG_NR_FILE_DIRTY:
+		flag = PCG_FILE_DIRTY;
+		stat = MEM_CGROUP_STAT_FILE_DIRTY;
+		break;
+	case MEMCG_NR_FILE_WRITEBACK:
+		flag = PCG_FILE_WRITEBACK;
+		stat = MEM_CGROUP_STAT_FILE_WRITEBACK;
+		break;
+	case MEMCG_NR_FILE_UNSTABLE_NFS:
+		flag = PCG_FILE_UNSTABLE_NFS;
+		stat = MEM_CGROUP_STAT_FILE_UNSTABLE_NFS;
+		break;
+	default:
+		BUG();
+	}
+
 	/*
-	 * Preemption is already disabled. We can use __this_cpu_xxx
+	 * The flag tells what the page was accounted as, for the accounting
+	 * to be moved along with the page: a page which was, say, dirtied
+	 * before it was charged must not be uncounted from its cgroup.
 	 */
 	if (val > 0) {
-		__this_cpu_inc(mem->stat->count[MEM_CGROUP_STAT_FILE_MAPPED]);
-		SetPageCgroupFileMapped(pc);
-	} else {
-		__this_cpu_dec(mem->stat->count[MEM_CGROUP_STAT_FILE_MAPPED]);
-		ClearPageCgroupFileMapped(pc);
-	}
+		if (test_and_set_bit(flag, &pc->flags))
+			goto done;
+		if (idx == MEMCG_NR_FILE_DIRTY && page->mapping)
+			mem_cgroup_mark_mapping(page->mapping, mem);
+	} else if (!test_and_clear_bit(flag, &pc->flags))
+		goto done;
 
+	/* interrupts are disabled by the move lock */
+	__this_cpu_add(mem->stat->count[stat], val);
 done:
-	unlock_page_cgroup(pc);
+	move_unlock_page_cgroup(pc, &flags);
 }
+EXPORT_SYMBOL(mem_cgroup_update_page_stat);
 
 /*
  * size of first charge trial. "32" comes from vmscan.c's magic value.
@@ -1942,6 +2028,14 @@ static void __mem_cgroup_commit_charge(struct mem_cgroup *mem,
 	memcg_check_events(mem, pc->page);
 }
 
+static void mem_cgroup_move_stat(struct mem_cgroup *from,
+				 struct mem_cgroup *to, int idx)
+{
+	/* interrupts are disabled by the move lock */
+	__this_cpu_dec(from->stat->count[idx]);
+	__this_cpu_inc(to->stat->count[idx]);
+}
+
 /**
  * __mem_cgroup_move_account - move account of the page
  * @pc:	page_cgroup of the page.
@@ -1962,26 +2056,33 @@ static void __mem_cgroup_commit_charge(struct mem_cgroup *mem,
 static void __mem_cgroup_move_account(struct page_cgroup *pc,
 	struct mem_cgroup *from, struct mem_cgroup *to, bool uncharge)
 {
+	unsigned long flags;
+
 	VM_BUG_ON(from == to);
 	VM_BUG_ON(PageLRU(pc->page));
 	VM_BUG_ON(!PageCgroupLocked(pc));
 	VM_BUG_ON(!PageCgroupUsed(pc));
 	VM_BUG_ON(pc->mem_cgroup != from);
 
-	if (PageCgroupFileMapped(pc)) {
-		/* Update mapped_file data for mem_cgroup */
-		preempt_disable();
-		__this_cpu_dec(from->stat->count[MEM_CGROUP_STAT_FILE_MAPPED]);
-		__this_cpu_inc(to->stat->count[MEM_CGROUP_STAT_FILE_MAPPED]);
-		preempt_enable();
-	}
 	mem_cgroup_charge_statistics(from, pc, false);
 	if (uncharge)
 		/* This is not "cancel", but cancel_charge does all we need. */
 		mem_cgroup_cancel_charge(from);
 
 	/* caller should have done css_get */
+	move_lock_page_cgroup(pc, &flags);
+	/* Update file page statistics for mem_cgroup */
+	if (PageCgroupFileMapped(pc))
+		mem_cgroup_move_stat(from, to, MEM_CGROUP_STAT_FILE_MAPPED);
+	if (PageCgroupFileDirty(pc))
+		mem_cgroup_move_stat(from, to, MEM_CGROUP_STAT_FILE_DIRTY);
+	if (PageCgroupFileWriteback(pc))
+		mem_cgroup_move_stat(from, to, MEM_CGROUP_STAT_FILE_WRITEBACK);
+	if (PageCgroupFileUnstableNFS(pc))
+		mem_cgroup_move_stat(from, to,
+				     MEM_CGROUP_STAT_FILE_UNSTABLE_NFS);
 	pc->mem_cgroup = to;
+	move_unlock_page_cgroup(pc, &flags);
 	mem_cgroup_charge_statistics(to, pc, true);
 	/*
 	 * We charges against "to" which may not have any tasks. Then, "to"
@@ -3356,6 +3457,9 @@ enum {
 	MCS_CACHE,
 	MCS_RSS,
 	MCS_FILE_MAPPED,
+	MCS_FILE_DIRTY,
+	MCS_WRITEBACK,
+	MCS_UNSTABLE_NFS,
 	MCS_PGPGIN,
 	MCS_PGPGOUT,
 	MCS_SWAP,
@@ -3378,6 +3482,9 @@ struct {
 	{"cache", "total_cache"},
 	{"rss", "total_rss"},
 	{"mapped_file", "total_mapped_file"},
+	{"dirty", "total_dirty"},
+	{"writeback", "total_writeback"},
+	{"nfs_unstable", "total_nfs_unstable"},
 	{"pgpgin", "total_pgpgin"},
 	{"pgpgout", "total_pgpgout"},
 	{"swap", "total_swap"},
@@ -3401,6 +3508,12 @@ static int mem_cgroup_get_local_stat(struct mem_cgroup *mem, void *data)
 	s->stat[MCS_RSS] += val * PAGE_SIZE;
 	val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_FILE_MAPPED);
 	s->stat[MCS_FILE_MAPPED] += val * PAGE_SIZE;
+	val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_FILE_DIRTY);
+	s->stat[MCS_FILE_DIRTY] += val * PAGE_SIZE;
+	val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_FILE_WRITEBACK);
+	s->stat[MCS_WRITEBACK] += val * PAGE_SIZE;
+	val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_FILE_UNSTABLE_NFS);
+	s->stat[MCS_UNSTABLE_NFS] += val * PAGE_SIZE;
 	val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_PGPGIN_COUNT);
 	s->stat[MCS_PGPGIN] += val;
 	val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_PGPGOUT_COUNT);
@@ -3534,6 +3647,220 @@ static int mem_cgroup_swappiness_write(struct cgroup *cgrp, struct cftype *cft,
 	return 0;
 }
 
+/*
+ * Dirty limits.  The root cgroup is limited by the vm.dirty_* sysctls
+ * alone.  Every other cgroup is also limited by its memory.dirty_* files,
+ * inherited from its parent on creation, which apply to the dirty pages
+ * charged to it (and to its children under use_hierarchy), and to the
+ * memory it could use for page cache: its file pages plus what its limit
+ * leaves unused, but never more than the dirtyable memory of the system.
+ */
+enum {
+	MEM_CGROUP_DIRTY_RATIO,
+	MEM_CGROUP_DIRTY_BYTES,
+	MEM_CGROUP_DIRTY_BACKGROUND_RATIO,
+	MEM_CGROUP_DIRTY_BACKGROUND_BYTES,
+};
+
+static void get_dirty_param(struct mem_cgroup *memcg,
+			    struct mem_cgroup_dirty_param *param)
+{
+	/* root ? */
+	if (memcg->css.cgroup->parent == NULL) {
+		param->dirty_ratio = vm_dirty_ratio;
+		param->dirty_bytes = vm_dirty_bytes;
+		param->dirty_background_ratio = dirty_background_ratio;
+		param->dirty_background_bytes = dirty_background_bytes;
+		return;
+	}
+
+	spin_lock(&memcg->reclaim_param_lock);
+	*param = memcg->dirty_param;
+	spin_unlock(&memcg->reclaim_param_lock);
+}
+
+static unsigned long mem_cgroup_read_stat_pages(struct mem_cgroup *mem,
+						enum mem_cgroup_stat_index idx)
+{
+	s64 val;
+
+	mem_cgroup_get_recursive_idx_stat(mem, idx, &val);
+	/* the per-cpu counters may sum up to less than 0 for a moment */
+	return val > 0 ? val : 0;
+}
+
+static unsigned long mem_cgroup_dirtyable_pages(struct mem_cgroup *mem,
+						unsigned long available)
+{
+	unsigned long long limit, memsw_limit, usage;
+	unsigned long pages;
+
+	memcg_get_hierarchical_limit(mem, &limit, &memsw_limit);
+	usage = res_counter_read_u64(&mem->res, RES_USAGE);
+	if (limit <= usage)
+		pages = 0;
+	else
+		pages = min_t(unsigned long long, (limit - usage) >> PAGE_SHIFT,
+			      available);
+	pages += mem_cgroup_read_stat_pages(mem, MEM_CGROUP_STAT_CACHE);
+
+	return min(pages, available);
+}
+
+static void __mem_cgroup_dirty_info(struct mem_cgroup *mem,
+				    unsigned long available,
+				    struct mem_cgroup_dirty_info *info)
+{
+	struct mem_cgroup_dirty_param param;
+	unsigned long dirtyable;
+
+	get_dirty_param(mem, &param);
+	dirtyable = mem_cgroup_dirtyable_pages(mem, available);
+
+	if (param.dirty_bytes)
+		info->dirty_thresh = DIV_ROUND_UP(param.dirty_bytes, PAGE_SIZE);
+	else
+		info->dirty_thresh = param.dirty_ratio * dirtyable / 100;
+	if (param.dirty_background_bytes)
+		info->background_thresh =
+			DIV_ROUND_UP(param.dirty_background_bytes, PAGE_SIZE);
+	else
+		info->background_thresh =
+			param.dirty_background_ratio * dirtyable / 100;
+	if (info->background_thresh >= info->dirty_thresh)
+		info->background_thresh = info->dirty_thresh / 2;
+
+	info->nr_reclaimable =
+		mem_cgroup_read_stat_pages(mem, MEM_CGROUP_STAT_FILE_DIRTY) +
+		mem_cgroup_read_stat_pages(mem,
+				MEM_CGROUP_STAT_FILE_UNSTABLE_NFS);
+	info->nr_writeback =
+		mem_cgroup_read_stat_pages(mem, MEM_CGROUP_STAT_FILE_WRITEBACK);
+}
+
+/**
+ * mem_cgroup_dirty_info - dirty limits of the cgroup of current
+ * @available: dirtyable memory of the system, in pages
+ * @info: filled with the limits and the dirty page counts of the cgroup
+ *
+ * Returns the css id of the cgroup, or 0 when current is in the root
+ * cgroup, whose limits are the global ones, and @info was left alone.
+ */
+unsigned short mem_cgroup_dirty_info(unsigned long available,
+				     struct mem_cgroup_dirty_info *info)
+{
+	struct mem_cgroup *mem;
+	unsigned short id = 0;
+
+	if (mem_cgroup_disabled())
+		return 0;
+
+	rcu_read_lock();
+	mem = mem_cgroup_from_task(current);
+	if (mem && !mem_cgroup_is_root(mem) && css_tryget(&mem->css))
+		id = css_id(&mem->css);
+	rcu_read_unlock();
+	if (!id)
+		return 0;
+
+	__mem_cgroup_dirty_info(mem, available, info);
+	css_put(&mem->css);
+	return id;
+}
+
+/**
+ * mem_cgroup_over_bground_thresh - is a cgroup over its background limit
+ * @id: css id of the cgroup
+ * @available: dirtyable memory of the system, in pages
+ */
+bool mem_cgroup_over_bground_thresh(unsigned short id,
+				    unsigned long available)
+{
+	struct mem_cgroup_dirty_info info;
+	struct mem_cgroup *mem;
+
+	rcu_read_lock();
+	mem = mem_cgroup_lookup(id);
+	if (mem && !css_tryget(&mem->css))
+		mem = NULL;
+	rcu_read_unlock();
+	if (!mem)
+		return false;
+
+	__mem_cgroup_dirty_info(mem, available, &info);
+	css_put(&mem->css);
+	return info.nr_reclaimable >= info.background_thresh;
+}
+
+static u64 mem_cgroup_dirty_read(struct cgroup *cgrp, struct cftype *cft)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
+	struct mem_cgroup_dirty_param param;
+	u64 val;
+
+	get_dirty_param(memcg, &param);
+	switch (cft->private) {
+	case MEM_CGROUP_DIRTY_RATIO:
+		val = param.dirty_ratio;
+		break;
+	case MEM_CGROUP_DIRTY_BYTES:
+		val = param.dirty_bytes;
+		break;
+	case MEM_CGROUP_DIRTY_BACKGROUND_RATIO:
+		val = param.dirty_background_ratio;
+		break;
+	case MEM_CGROUP_DIRTY_BACKGROUND_BYTES:
+		val = param.dirty_background_bytes;
+		break;
+	default:
+		BUG();
+	}
+	return val;
+}
+
+/* as the sysctls, setting a ratio resets the bytes and vice versa */
+static int mem_cgroup_dirty_write(struct cgroup *cgrp, struct cftype *cft,
+				  u64 val)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
+	struct mem_cgroup_dirty_param *param = &memcg->dirty_param;
+	int type = cft->private;
+
+	/* the root cgroup is set with the vm.dirty_* sysctls */
+	if (cgrp->parent == NULL)
+		return -EINVAL;
+	if ((type == MEM_CGROUP_DIRTY_RATIO ||
+	     type == MEM_CGROUP_DIRTY_BACKGROUND_RATIO) && val > 100)
+		return -EINVAL;
+	if (val > ULONG_MAX)
+		return -EINVAL;
+
+	spin_lock(&memcg->reclaim_param_lock);
+	switch (type) {
+	case MEM_CGROUP_DIRTY_RATIO:
+		param->dirty_ratio = val;
+		param->dirty_bytes = 0;
+		break;
+	case MEM_CGROUP_DIRTY_BYTES:
+		param->dirty_bytes = val;
+		param->dirty_ratio = 0;
+		break;
+	case MEM_CGROUP_DIRTY_BACKGROUND_RATIO:
+		param->dirty_background_ratio = val;
+		param->dirty_background_bytes = 0;
+		break;
+	case MEM_CGROUP_DIRTY_BACKGROUND_BYTES:
+		param->dirty_background_bytes = val;
+		param->dirty_background_ratio = 0;
+		break;
+	default:
+		BUG();
+	}
+	spin_unlock(&memcg->reclaim_param_lock);
+
+	return 0;
+}
+
 static void __mem_cgroup_threshold(struct mem_cgroup *memcg, bool swap)
 {
 	struct mem_cgroup_threshold_ary *t;
@@ -3912,6 +4239,30 @@ static struct cftype mem_cgroup_files[] = {
 		.read_u64 = mem_cgroup_swappiness_read,
 		.write_u64 = mem_cgroup_swappiness_write,
 	},
+	{
+		.name = "dirty_ratio",
+		.read_u64 = mem_cgroup_dirty_read,
+		.write_u64 = mem_cgroup_dirty_write,
+		.private = MEM_CGROUP_DIRTY_RATIO,
+	},
+	{
+		.name = "dirty_bytes",
+		.read_u64 = mem_cgroup_dirty_read,
+		.write_u64 = mem_cgroup_dirty_write,
+		.private = MEM_CGROUP_DIRTY_BYTES,
+	},
+	{
+		.name = "dirty_background_ratio",
+		.read_u64 = mem_cgroup_dirty_read,
+		.write_u64 = mem_cgroup_dirty_write,
+		.private = MEM_CGROUP_DIRTY_BACKGROUND_RATIO,
+	},
+	{
+		.name = "dirty_background_bytes",
+		.read_u64 = mem_cgroup_dirty_read,
+		.write_u64 = mem_cgroup_dirty_write,
+		.private = MEM_CGROUP_DIRTY_BACKGROUND_BYTES,
+	},
 	{
 		.name = "move_charge_at_immigrate",
 		.read_u64 = mem_cgroup_move_charge_read,
@@ -4183,8 +4534,10 @@ mem_cgroup_create(struct cgroup_subsys *ss, struct cgroup *cont)
 	spin_lock_init(&mem->reclaim_param_lock);
 	INIT_LIST_HEAD(&mem->oom_notify);
 
-	if (parent)
+	if (parent) {
 		mem->swappiness = get_swappiness(parent);
+		get_dirty_param(parent, &mem->dirty_param);
+	}
 	atomic_set(&mem->refcnt, 1);
 	mem->move_charge_at_immigrate = 0;
 	mutex_init(&mem->thresholds_lock);
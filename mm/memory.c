@@ -46,6 +46,7 @@
 #include <linux/highmem.h>
 #include <linux/pagemap.h>
 #include <linux/ksm.h>
+#include <linux/large_anon.h>
 #include <linux/rmap.h>
 #include <linux/module.h>
 #include <linux/delayacct.h>
@@ -901,6 +902,7 @@ static unsigned long zap_pte_range(struct mmu_gather *tlb,
 	init_rss_vec(rss);
 
 	pte = pte_offset_map_lock(mm, pmd, addr, &ptl);
+	flush_tlb_batched_pending(mm);
 	arch_enter_lazy_mmu_mode();
 	do {
 		pte_t ptent = *pte;
@@ -2856,6 +2858,12 @@ static int do_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	/* Allocate our own private page. */
 	if (unlikely(anon_vma_prepare(vma)))
 		goto oom;
+
+	/* Or a whole block of them, if it can be mapped with a large page */
+	if (large_anon_enabled(vma) &&
+	    !do_large_anon_page(mm, vma, address, pmd))
+		return 0;
+
 	page = alloc_zeroed_user_highpage_movable(vma, address);
 	if (!page)
 		goto oom;
@@ -3227,6 +3235,178 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	return handle_pte_fault(mm, vma, address, pte, pmd, flags);
 }
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+/*
+ * Speculative page faults handle the simplest and most common faults on
+ * anonymous memory without mmap_sem: the first touch of a page, and the
+ * setting of the young and dirty bits of a present pte.  Instead:
+ *
+ * - mm_rb_lock is held for reading from the lookup of the vma until the
+ *   pte is set.  It keeps the vma linked, so that munmap can free neither
+ *   the vma nor the page tables under it meanwhile;
+ * - vm_sequence of the vma, sampled before looking at it and checked again
+ *   under the pte lock, catches changes to its bounds, flags and protection
+ *   by vma_adjust, mprotect, mlock and madvise;
+ * - mm->move_sequence catches mremap moving page tables around.
+ *
+ * Whatever else, or whatever changed meanwhile, is left to handle_mm_fault
+ * under mmap_sem.  Nothing may sleep under mm_rb_lock, so a write fault
+ * which needs a new page asks for one with -ENOMEM, and is tried again.
+ */
+static int spf_seq_begin(const seqcount_t *s, unsigned int *seq)
+{
+	*seq = ACCESS_ONCE(s->sequence);
+	smp_rmb();
+	return !(*seq & 1);
+}
+
+static int __handle_speculative_fault(struct mm_struct *mm,
+		unsigned long address, unsigned int flags, struct page **pagep)
+{
+	struct vm_area_struct *vma = NULL;
+	struct rb_node *rb_node;
+	unsigned long vm_flags;
+	unsigned int seq, move_seq;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+	pte_t *pte, entry;
+	spinlock_t *ptl;
+	int write = flags & FAULT_FLAG_WRITE;
+	int ret = -EAGAIN;
+
+	read_lock(&mm->mm_rb_lock);
+	if (!spf_seq_begin(&mm->move_sequence, &move_seq))
+		goto out;
+
+	rb_node = mm->mm_rb.rb_node;
+	while (rb_node) {
+		vma = rb_entry(rb_node, struct vm_area_struct, vm_rb);
+		if (address < vma->vm_start)
+			rb_node = rb_node->rb_left;
+		else if (address >= vma->vm_end)
+			rb_node = rb_node->rb_right;
+		else
+			break;
+	}
+	if (!rb_node || !spf_seq_begin(&vma->vm_sequence, &seq))
+		goto out;
+
+	vm_flags = vma->vm_flags;
+	if (address < vma->vm_start || address >= vma->vm_end)
+		goto out;
+	if (vma->vm_ops || (vm_flags & (VM_LOCKED | VM_GROWSDOWN | VM_GROWSUP)))
+		goto out;
+	if (!(vm_flags & (write ? VM_WRITE : (VM_READ | VM_WRITE | VM_EXEC))))
+		goto out;
+
+	pgd = pgd_offset(mm, address);
+	if (pgd_none(*pgd) || unlikely(pgd_bad(*pgd)))
+		goto out;
+	pud = pud_offset(pgd, address);
+	if (pud_none(*pud) || unlikely(pud_bad(*pud)))
+		goto out;
+	pmd = pmd_offset(pud, address);
+	if (pmd_none(*pmd) || unlikely(pmd_bad(*pmd)))
+		goto out;
+
+	pte = pte_offset_map_lock(mm, pmd, address, &ptl);
+	if (read_seqcount_retry(&vma->vm_sequence, seq) ||
+	    read_seqcount_retry(&mm->move_sequence, move_seq))
+		goto unlock;
+
+	entry = *pte;
+	if (pte_present(entry)) {
+		/* as at the end of handle_pte_fault(), but no COW */
+		if (write) {
+			if (!pte_write(entry))
+				goto unlock;
+			entry = pte_mkdirty(entry);
+		}
+		entry = pte_mkyoung(entry);
+		if (ptep_set_access_flags(vma, address, pte, entry, write))
+			update_mmu_cache(vma, address, pte);
+		else if (write)
+			flush_tlb_page(vma, address);
+		ret = 0;
+	} else if (pte_none(entry)) {
+		/* as in do_anonymous_page(), for a vma already faulted */
+		if (!write) {
+			entry = pte_mkspecial(pfn_pte(my_zero_pfn(address),
+						vma->vm_page_prot));
+		} else {
+			if (!vma->anon_vma || large_anon_enabled(vma))
+				goto unlock;
+			if (!*pagep) {
+				ret = -ENOMEM;
+				goto unlock;
+			}
+			entry = mk_pte(*pagep, vma->vm_page_prot);
+			entry = pte_mkwrite(pte_mkdirty(entry));
+			inc_mm_counter_fast(mm, MM_ANONPAGES);
+			page_add_new_anon_rmap(*pagep, vma, address);
+			*pagep = NULL;
+		}
+		set_pte_at(mm, address, pte, entry);
+		update_mmu_cache(vma, address, pte);
+		ret = 0;
+	}
+unlock:
+	pte_unmap_unlock(pte, ptl);
+out:
+	read_unlock(&mm->mm_rb_lock);
+	return ret;
+}
+
+/**
+ * handle_speculative_fault - handle a page fault without mmap_sem
+ * @mm: the faulting mm, that of current
+ * @address: the faulting address
+ * @flags: FAULT_FLAG_WRITE for a write fault
+ *
+ * Called by the architecture's fault handler before it takes mmap_sem.
+ * Returns 0 if the fault was handled, as a minor fault, or -EAGAIN for
+ * the caller to go on to handle_mm_fault(), which will also report any
+ * error: speculative faults are never fatal.
+ */
+int handle_speculative_fault(struct mm_struct *mm, unsigned long address,
+			     unsigned int flags)
+{
+	struct page *page = NULL;
+	int ret;
+
+	address &= PAGE_MASK;
+	check_sync_rss_stat(current);
+
+	ret = __handle_speculative_fault(mm, address, flags, &page);
+	if (ret == -ENOMEM) {
+		/* the vma is only used for its mempolicy, and may be NULL */
+		page = alloc_zeroed_user_highpage_movable(NULL, address);
+		if (!page)
+			goto abort;
+		__SetPageUptodate(page);
+		if (mem_cgroup_newpage_charge(page, mm, GFP_KERNEL)) {
+			page_cache_release(page);
+			goto abort;
+		}
+		ret = __handle_speculative_fault(mm, address, flags, &page);
+		if (page) {
+			mem_cgroup_uncharge_page(page);
+			page_cache_release(page);
+		}
+	}
+	if (ret)
+		goto abort;
+
+	count_vm_event(PGFAULT);
+	count_vm_event(SPF_FAULT);
+	return 0;
+abort:
+	count_vm_event(SPF_ABORT);
+	return -EAGAIN;
+}
+#endif /* CONFIG_SPECULATIVE_PAGE_FAULT */
+
 #ifndef __PAGETABLE_PUD_FOLDED
 /*
  * Allocate page upper directory.
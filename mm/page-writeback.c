@@ -34,6 +34,7 @@
 #include <linux/syscalls.h>
 #include <linux/buffer_head.h>
 #include <linux/pagevec.h>
+#include <linux/memcontrol.h>
 #include <trace/events/writeback.h>
 
 /*
@@ -471,6 +472,70 @@ unsigned long bdi_dirty_limit(struct backing_dev_info *bdi, unsigned long dirty)
 	return bdi_dirty;
 }
 
+/*
+ * The part of balance_dirty_pages() for a memory cgroup with dirty limits
+ * of its own, that of the caller: while the cgroup is over them, write
+ * back the inodes it dirtied on this bdi and wait for the writeback to
+ * catch up, as below for the global limits, and then start a background
+ * writeback of those inodes if the cgroup is still over its background
+ * threshold.  The cgroup's dirty pages can be on other bdis as well, or
+ * only there, so the flushers of all bdis write its inodes meanwhile.
+ * The other cgroups keep dirtying pages up to the global limits.
+ */
+static void balance_mem_cgroup_dirty_pages(struct backing_dev_info *bdi,
+					   unsigned long write_chunk)
+{
+	struct mem_cgroup_dirty_info info;
+	unsigned long pages_written = 0;
+	unsigned long pause = 1;
+	unsigned short memcg_id;
+	bool flushers_started = false;
+
+	for (;;) {
+		struct writeback_control wbc = {
+			.sync_mode	= WB_SYNC_NONE,
+			.older_than_this = NULL,
+			.nr_to_write	= write_chunk,
+			.range_cyclic	= 1,
+		};
+
+		memcg_id = mem_cgroup_dirty_info(determine_dirtyable_memory(),
+						 &info);
+		if (!memcg_id)
+			return;
+		if (info.nr_reclaimable + info.nr_writeback <=
+				info.dirty_thresh)
+			break;
+
+		/*
+		 * Kick the flushers again whenever this bdi had nothing of
+		 * the cgroup to write: the work they had may be done.
+		 */
+		if (!flushers_started) {
+			wakeup_memcg_flusher_threads(memcg_id);
+			flushers_started = true;
+		}
+		if (info.nr_reclaimable) {
+			wbc.memcg_id = memcg_id;
+			writeback_inodes_wb(&bdi->wb, &wbc);
+			pages_written += write_chunk - wbc.nr_to_write;
+			if (pages_written >= write_chunk)
+				break;		/* We've done our duty */
+		}
+		if (wbc.nr_to_write == write_chunk)
+			flushers_started = false;
+		__set_current_state(TASK_INTERRUPTIBLE);
+		io_schedule_timeout(pause);
+
+		pause <<= 1;
+		if (pause > HZ / 10)
+			pause = HZ / 10;
+	}
+
+	if (info.nr_reclaimable > info.background_thresh)
+		bdi_start_memcg_writeback(bdi, memcg_id);
+}
+
 /*
  * balance_dirty_pages() must be called by processes which are generating dirty
  * data.  It looks at the number of dirty pages in the machine and will force
@@ -491,6 +556,8 @@ static void balance_dirty_pages(struct address_space *mapping,
 	bool dirty_exceeded = false;
 	struct backing_dev_info *bdi = mapping->backing_dev_info;
 
+	balance_mem_cgroup_dirty_pages(bdi, write_chunk);
+
 	for (;;) {
 		struct writeback_control wbc = {
 			.sync_mode	= WB_SYNC_NONE,
@@ -1120,6 +1187,7 @@ int __set_page_dirty_no_writeback(struct page *page)
 void account_page_dirtied(struct page *page, struct address_space *mapping)
 {
 	if (mapping_cap_account_dirty(mapping)) {
+		mem_cgroup_inc_page_stat(page, MEMCG_NR_FILE_DIRTY);
 		__inc_zone_page_state(page, NR_FILE_DIRTY);
 		__inc_bdi_stat(mapping->backing_dev_info, BDI_RECLAIMABLE);
 		task_dirty_inc(current);
@@ -1296,6 +1364,7 @@ int clear_page_dirty_for_io(struct page *page)
 		 * for more comments.
 		 */
 		if (TestClearPageDirty(page)) {
+			mem_cgroup_dec_page_stat(page, MEMCG_NR_FILE_DIRTY);
 			dec_zone_page_state(page, NR_FILE_DIRTY);
 			dec_bdi_stat(mapping->backing_dev_info,
 					BDI_RECLAIMABLE);
@@ -1331,8 +1400,10 @@ int test_clear_page_writeback(struct page *page)
 	} else {
 		ret = TestClearPageWriteback(page);
 	}
-	if (ret)
+	if (ret) {
+		mem_cgroup_dec_page_stat(page, MEMCG_NR_FILE_WRITEBACK);
 		dec_zone_page_state(page, NR_WRITEBACK);
+	}
 	return ret;
 }
 
@@ -1365,8 +1436,10 @@ int test_set_page_writeback(struct page *page)
 	} else {
 		ret = TestSetPageWriteback(page);
 	}
-	if (!ret)
+	if (!ret) {
+		mem_cgroup_inc_page_stat(page, MEMCG_NR_FILE_WRITEBACK);
 		inc_zone_page_state(page, NR_WRITEBACK);
+	}
 	return ret;
 
 }
@@ -918,7 +918,7 @@ void page_add_file_rmap(struct page *page)
 {
 	if (atomic_inc_and_test(&page->_mapcount)) {
 		__inc_zone_page_state(page, NR_FILE_MAPPED);
-		mem_cgroup_update_file_mapped(page, 1);
+		mem_cgroup_inc_page_stat(page, MEMCG_NR_FILE_MAPPED);
 	}
 }
 
@@ -956,7 +956,7 @@ void page_remove_rmap(struct page *page)
 		__dec_zone_page_state(page, NR_ANON_PAGES);
 	} else {
 		__dec_zone_page_state(page, NR_FILE_MAPPED);
-		mem_cgroup_update_file_mapped(page, -1);
+		mem_cgroup_dec_page_stat(page, MEMCG_NR_FILE_MAPPED);
 	}
 	/*
 	 * It would be tidy to reset the PageAnon mapping here,
@@ -973,6 +973,122 @@ void page_remove_rmap(struct page *page)
  * Subfunctions of try_to_unmap: try_to_unmap_one called
  * repeatedly from either try_to_unmap_anon or try_to_unmap_file.
  */
+#ifdef CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH
+static void percpu_flush_tlb_batch_pages(void *data)
+{
+	local_flush_tlb();
+}
+
+/*
+ * Flush the TLB entries of the ptes try_to_unmap() left behind with
+ * TTU_BATCH_FLUSH: one full flush on each cpu that may have cached one,
+ * instead of one flush per page.  Must be called before the pages are
+ * freed, and before any of them that was mapped dirty is written back.
+ */
+void try_to_unmap_flush(void)
+{
+	struct tlbflush_unmap_batch *tlb_ubc = &current->tlb_ubc;
+	int cpu;
+
+	if (!tlb_ubc->flush_required)
+		return;
+
+	cpu = get_cpu();
+	if (cpumask_test_cpu(cpu, &tlb_ubc->cpumask))
+		percpu_flush_tlb_batch_pages(NULL);
+	if (cpumask_any_but(&tlb_ubc->cpumask, cpu) < nr_cpu_ids)
+		smp_call_function_many(&tlb_ubc->cpumask,
+				       percpu_flush_tlb_batch_pages, NULL, 1);
+	cpumask_clear(&tlb_ubc->cpumask);
+	tlb_ubc->flush_required = false;
+	tlb_ubc->writable = false;
+	put_cpu();
+
+	count_vm_event(PGRECLAIM_TLB_FLUSH);
+}
+
+/* Flush only if a cpu might still write to one of the unmapped pages */
+void try_to_unmap_flush_dirty(void)
+{
+	if (current->tlb_ubc.writable)
+		try_to_unmap_flush();
+}
+
+/* mm->tlb_flush_batched wraps back to 1, never to 0 */
+#define TLB_FLUSH_BATCHED_MAX	(INT_MAX / 2)
+
+static void set_tlb_ubc_flush_pending(struct mm_struct *mm, bool writable)
+{
+	struct tlbflush_unmap_batch *tlb_ubc = &current->tlb_ubc;
+	int old, new;
+
+	cpumask_or(&tlb_ubc->cpumask, &tlb_ubc->cpumask, mm_cpumask(mm));
+	tlb_ubc->flush_required = true;
+
+	/*
+	 * Seen by flush_tlb_batched_pending() once the pte lock is dropped.
+	 * A count rather than a flag, so that a flusher can tell whether
+	 * more flushes got deferred while it flushed.  The cmpxchg also
+	 * orders the pte clear before it.
+	 */
+	do {
+		old = atomic_read(&mm->tlb_flush_batched);
+		new = old < TLB_FLUSH_BATCHED_MAX ? old + 1 : 1;
+	} while (atomic_cmpxchg(&mm->tlb_flush_batched, old, new) != old);
+
+	if (writable)
+		tlb_ubc->writable = true;
+	count_vm_event(PGRECLAIM_TLB_DEFERRED);
+}
+
+/*
+ * mprotect, munmap and mremap skip pte_none() entries, which may still
+ * be cached writable by some cpu if reclaim deferred the flush.  Called
+ * under the pte lock of the ptes about to be changed, but reclaim may be
+ * deferring flushes for other page tables of the mm meanwhile: the count
+ * is only cleared if none got deferred since it was read, otherwise the
+ * next caller flushes again.
+ */
+void flush_tlb_batched_pending(struct mm_struct *mm)
+{
+	int batched = atomic_read(&mm->tlb_flush_batched);
+
+	if (batched) {
+		flush_tlb_mm(mm);
+		atomic_cmpxchg(&mm->tlb_flush_batched, batched, 0);
+	}
+}
+
+/*
+ * Defer the flush only when the mm may be cached by another cpu: a local
+ * flush of a single page is cheaper than flushing everything later.  Nor
+ * when the architecture flushes the other cpus without IPIs, see
+ * arch_tlbbatch_should_defer().
+ */
+static bool should_defer_flush(struct mm_struct *mm, enum ttu_flags flags)
+{
+	bool ret = false;
+
+	if (!(flags & TTU_BATCH_FLUSH) || !arch_tlbbatch_should_defer(mm))
+		return false;
+
+	if (cpumask_any_but(mm_cpumask(mm), get_cpu()) < nr_cpu_ids)
+		ret = true;
+	put_cpu();
+
+	return ret;
+}
+#else
+static void set_tlb_ubc_flush_pending(struct mm_struct *mm, bool writable)
+{
+}
+
+static bool should_defer_flush(struct mm_struct *mm, enum ttu_flags flags)
+{
+	return false;
+}
+#endif /* CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH */
+
 int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 		     unsigned long address, enum ttu_flags flags)
 {
@@ -1007,7 +1123,17 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 
 	/* Nuke the page table entry. */
 	flush_cache_page(vma, address, page_to_pfn(page));
-	pteval = ptep_clear_flush_notify(vma, address, pte);
+	if (should_defer_flush(mm, flags)) {
+		/*
+		 * The caller flushes the TLBs of all the cpus this mm ran on
+		 * later, in one go with those of the other pages it unmaps.
+		 */
+		pteval = ptep_get_and_clear(mm, address, pte);
+		set_tlb_ubc_flush_pending(mm, pte_dirty(pteval));
+		mmu_notifier_invalidate_page(mm, address);
+	} else {
+		pteval = ptep_clear_flush_notify(vma, address, pte);
+	}
 
 	/* Move the dirty bit to the physical page now the pte is gone. */
 	if (pte_dirty(pteval))
@@ -1302,11 +1302,47 @@ static inline int lock_and_freeze_slab(struct kmem_cache_node *n,
 }
 
 /*
- * Try to allocate a partial slab from a specific node.
+ * Does the cache keep partial slabs per cpu? Debugging needs all of them
+ * on the node lists.
  */
-static struct page *get_partial_node(struct kmem_cache_node *n)
+static inline int kmem_cache_has_cpu_partial(struct kmem_cache *s)
 {
-	struct page *page;
+	return s->cpu_partial && !kmem_cache_debug(s);
+}
+
+/*
+ * Push a frozen slab onto the partial list of a cpu. The first slab of
+ * the list keeps the number of slabs and of free objects on the list.
+ *
+ * Interrupts must be disabled.
+ */
+static inline void push_cpu_partial(struct kmem_cache_cpu *c,
+						struct page *page)
+{
+	struct page *oldpage = c->partial;
+
+	page->pages = 1;
+	page->pobjects = page->objects - page->inuse;
+	if (oldpage) {
+		page->pages += oldpage->pages;
+		page->pobjects += oldpage->pobjects;
+	}
+	page->next = oldpage;
+	c->partial = page;
+}
+
+/*
+ * Try to allocate a partial slab from a specific node. The first slab
+ * found is returned locked to become the cpu slab. While the list_lock is
+ * held, more slabs are moved to the partial list of the cpu, until about
+ * half of cpu_partial objects are available, so the following slab
+ * exhaustions of this cpu do not need the list_lock.
+ */
+static struct page *get_partial_node(struct kmem_cache *s,
+		struct kmem_cache_node *n, struct kmem_cache_cpu *c)
+{
+	struct page *page, *page2, *first = NULL;
+	int available = 0;
 
 	/*
 	 * Racy check. If we mistakenly see no partial slabs then we
@@ -1318,19 +1354,31 @@ static struct page *get_partial_node(struct kmem_cache_node *n)
 		return NULL;
 
 	spin_lock(&n->list_lock);
-	list_for_each_entry(page, &n->partial, lru)
-		if (lock_and_freeze_slab(n, page))
-			goto out;
-	page = NULL;
-out:
+	list_for_each_entry_safe(page, page2, &n->partial, lru) {
+		if (!lock_and_freeze_slab(n, page))
+			continue;
+
+		available += page->objects - page->inuse;
+		if (!first)
+			first = page;
+		else {
+			slab_unlock(page);
+			push_cpu_partial(c, page);
+			stat(s, CPU_PARTIAL_NODE);
+		}
+		if (!kmem_cache_has_cpu_partial(s) ||
+		    available > s->cpu_partial / 2)
+			break;
+	}
 	spin_unlock(&n->list_lock);
-	return page;
+	return first;
 }
 
 /*
  * Get a page from somewhere. Search in increasing NUMA distances.
  */
-static struct page *get_any_partial(struct kmem_cache *s, gfp_t flags)
+static struct page *get_any_partial(struct kmem_cache *s, gfp_t flags,
+					struct kmem_cache_cpu *c)
 {
 #ifdef CONFIG_NUMA
 	struct zonelist *zonelist;
@@ -1370,7 +1418,7 @@ static struct page *get_any_partial(struct kmem_cache *s, gfp_t flags)
 
 		if (n && cpuset_zone_allowed_hardwall(zone, flags) &&
 				n->nr_partial > s->min_partial) {
-			page = get_partial_node(n);
+			page = get_partial_node(s, n, c);
 			if (page) {
 				put_mems_allowed();
 				return page;
@@ -1385,17 +1433,52 @@ static struct page *get_any_partial(struct kmem_cache *s, gfp_t flags)
 /*
  * Get a partial page, lock it and return it.
  */
-static struct page *get_partial(struct kmem_cache *s, gfp_t flags, int node)
+static struct page *get_partial(struct kmem_cache *s, gfp_t flags, int node,
+					struct kmem_cache_cpu *c)
 {
 	struct page *page;
 	int searchnode = (node == NUMA_NO_NODE) ? numa_node_id() : node;
 
-	page = get_partial_node(get_node(s, searchnode));
+	page = get_partial_node(s, get_node(s, searchnode), c);
 	if (page || node != -1)
 		return page;
 
-	return get_any_partial(s, flags);
+	return get_any_partial(s, flags, c);
+}
+
+#ifdef CONFIG_CMPXCHG_LOCAL
+/*
+ * The lockless fastpaths replace the cpu freelist together with a
+ * transaction id, which every change of the freelist or the cpu slab
+ * advances. The ids of a cpu start at the cpu number and are advanced
+ * by TID_STEP, so they also tell which cpu they belong to: a fastpath
+ * that was interrupted, or that migrated to another cpu, in between
+ * reading the freelist and replacing it fails the cmpxchg and retries.
+ */
+#define TID_STEP	roundup_pow_of_two(CONFIG_NR_CPUS)
+
+static inline unsigned long next_tid(unsigned long tid)
+{
+	return tid + TID_STEP;
+}
+
+static inline unsigned long init_tid(int cpu)
+{
+	return cpu;
+}
+
+static void init_kmem_cache_cpus(struct kmem_cache *s)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		per_cpu_ptr(s->cpu_slab, cpu)->tid = init_tid(cpu);
+}
+#else
+static inline void init_kmem_cache_cpus(struct kmem_cache *s)
+{
 }
+#endif
 
 /*
  * Move a page back to the lists.
@@ -1443,6 +1526,78 @@ static void unfreeze_slab(struct kmem_cache *s, struct page *page, int tail)
 	}
 }
 
+/*
+ * Move the partial slabs of a cpu back to the partial lists of their
+ * nodes, taking the list_lock of a node once for a run of slabs of that
+ * node. Empty slabs the nodes do not need are freed.
+ *
+ * Interrupts must be disabled.
+ */
+static void unfreeze_partials(struct kmem_cache *s, struct kmem_cache_cpu *c)
+{
+	struct kmem_cache_node *n = NULL;
+	struct page *page, *discard_page = NULL;
+
+	while ((page = c->partial)) {
+		struct kmem_cache_node *n2 = get_node(s, page_to_nid(page));
+
+		c->partial = page->next;
+		if (n != n2) {
+			if (n)
+				spin_unlock(&n->list_lock);
+			n = n2;
+			spin_lock(&n->list_lock);
+		}
+
+		/*
+		 * Nesting the slab lock inside the list_lock is fine here:
+		 * the lock of a frozen slab is only taken by frees, which do
+		 * not go on to take the list_lock.
+		 */
+		slab_lock(page);
+		__ClearPageSlubFrozen(page);
+		if (!page->inuse && n->nr_partial >= s->min_partial) {
+			page->next = discard_page;
+			discard_page = page;
+		} else {
+			n->nr_partial++;
+			list_add_tail(&page->lru, &n->partial);
+			stat(s, DEACTIVATE_TO_TAIL);
+		}
+		slab_unlock(page);
+	}
+	if (n)
+		spin_unlock(&n->list_lock);
+
+	while (discard_page) {
+		page = discard_page;
+		discard_page = page->next;
+		stat(s, DEACTIVATE_EMPTY);
+		discard_slab(s, page);
+		stat(s, FREE_SLAB);
+	}
+}
+
+/*
+ * A free made a full slab partial again. Put it on the partial list of
+ * this cpu rather than of its node, so neither the free nor the
+ * allocation that later takes the slab needs the node's list_lock. Once
+ * the list holds more than cpu_partial free objects, its slabs go back
+ * to their nodes first.
+ *
+ * Interrupts must be disabled, the slab must be frozen.
+ */
+static void put_cpu_partial(struct kmem_cache *s, struct page *page)
+{
+	struct kmem_cache_cpu *c = __this_cpu_ptr(s->cpu_slab);
+
+	if (c->partial && c->partial->pobjects > s->cpu_partial) {
+		unfreeze_partials(s, c);
+		stat(s, CPU_PARTIAL_DRAIN);
+	}
+	push_cpu_partial(c, page);
+}
+
 /*
  * Remove the cpu slab
  */
@@ -1473,6 +1628,9 @@ static void deactivate_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 		page->inuse--;
 	}
 	c->page = NULL;
+#ifdef CONFIG_CMPXCHG_LOCAL
+	c->tid = next_tid(c->tid);
+#endif
 	unfreeze_slab(s, page, tail);
 }
 
@@ -1492,8 +1650,11 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
-	if (likely(c && c->page))
-		flush_slab(s, c);
+	if (likely(c)) {
+		if (c->page)
+			flush_slab(s, c);
+		unfreeze_partials(s, c);
+	}
 }
 
 static void flush_cpu_slab(void *d)
@@ -1607,6 +1768,19 @@ static void *__slab_alloc(struct kmem_cache *s, gfp_t gfpflags, int node,
 {
 	void **object;
 	struct page *new;
+#ifdef CONFIG_CMPXCHG_LOCAL
+	unsigned long flags;
+
+	local_irq_save(flags);
+#ifdef CONFIG_PREEMPT
+	/*
+	 * We may have been preempted and rescheduled on a different
+	 * cpu before disabling interrupts. Need to reload cpu area
+	 * pointer.
+	 */
+	c = this_cpu_ptr(s->cpu_slab);
+#endif
+#endif
 
 	/* We handle __GFP_ZERO in the caller */
 	gfpflags &= ~__GFP_ZERO;
@@ -1633,6 +1807,10 @@ load_freelist:
 	c->node = page_to_nid(c->page);
 unlock_out:
 	slab_unlock(c->page);
+#ifdef CONFIG_CMPXCHG_LOCAL
+	c->tid = next_tid(c->tid);
+	local_irq_restore(flags);
+#endif
 	stat(s, ALLOC_SLOWPATH);
 	return object;
 
@@ -1640,7 +1818,19 @@ another_slab:
 	deactivate_slab(s, c);
 
 new_slab:
-	new = get_partial(s, gfpflags, node);
+	if (c->partial) {
+		new = c->partial;
+		c->partial = new->next;
+		c->page = new;
+		c->node = page_to_nid(new);
+		stat(s, CPU_PARTIAL_ALLOC);
+		slab_lock(new);
+		if (unlikely(!node_match(c, node)))
+			goto another_slab;
+		goto load_freelist;
+	}
+
+	new = get_partial(s, gfpflags, node, c);
 	if (new) {
 		c->page = new;
 		stat(s, ALLOC_FROM_PARTIAL);
@@ -1667,6 +1857,9 @@ new_slab:
 	}
 	if (!(gfpflags & __GFP_NOWARN) && printk_ratelimit())
 		slab_out_of_memory(s, gfpflags, node);
+#ifdef CONFIG_CMPXCHG_LOCAL
+	local_irq_restore(flags);
+#endif
 	return NULL;
 debug:
 	if (!alloc_debug_processing(s, c->page, object, addr))
@@ -1693,7 +1886,11 @@ static __always_inline void *slab_alloc(struct kmem_cache *s,
 {
 	void **object;
 	struct kmem_cache_cpu *c;
+#ifdef CONFIG_CMPXCHG_LOCAL
+	unsigned long tid;
+#else
 	unsigned long flags;
+#endif
 
 	gfpflags &= gfp_allowed_mask;
 
@@ -1703,6 +1900,40 @@ static __always_inline void *slab_alloc(struct kmem_cache *s,
 	if (should_failslab(s->objsize, gfpflags, s->flags))
 		return NULL;
 
+#ifdef CONFIG_CMPXCHG_LOCAL
+redo:
+	/*
+	 * The cpu may change under us, but then the transaction id read
+	 * here does not match the one of the cpu that does the cmpxchg
+	 * below, and we retry. The tid must be read before the freelist:
+	 * barrier() keeps the compiler from reordering the two reads, and
+	 * only interrupts on this cpu, which complete before we resume,
+	 * can change them in between.
+	 */
+	c = __this_cpu_ptr(s->cpu_slab);
+	tid = c->tid;
+	barrier();
+
+	object = c->freelist;
+	if (unlikely(!object || !node_match(c, node)))
+
+		object = __slab_alloc(s, gfpflags, node, addr, c);
+
+	else {
+		/*
+		 * Swap the freelist with the next object only if neither the
+		 * freelist nor the tid changed since we read them.
+		 */
+		if (unlikely(!irqsafe_cpu_cmpxchg_double(
+				s->cpu_slab->freelist, s->cpu_slab->tid,
+				object, tid,
+				get_freepointer(s, object), next_tid(tid)))) {
+			stat(s, CMPXCHG_DOUBLE_CPU_FAIL);
+			goto redo;
+		}
+		stat(s, ALLOC_FASTPATH);
+	}
+#else
 	local_irq_save(flags);
 	c = __this_cpu_ptr(s->cpu_slab);
 	object = c->freelist;
@@ -1715,6 +1946,7 @@ static __always_inline void *slab_alloc(struct kmem_cache *s,
 		stat(s, ALLOC_FASTPATH);
 	}
 	local_irq_restore(flags);
+#endif
 
 	if (unlikely(gfpflags & __GFP_ZERO) && object)
 		memset(object, 0, s->objsize);
@@ -1779,7 +2011,11 @@ static void __slab_free(struct kmem_cache *s, struct page *page,
 {
 	void *prior;
 	void **object = (void *)x;
+#ifdef CONFIG_CMPXCHG_LOCAL
+	unsigned long flags;
 
+	local_irq_save(flags);
+#endif
 	stat(s, FREE_SLOWPATH);
 	slab_lock(page);
 
@@ -1805,12 +2041,28 @@ checks_ok:
 	 * then add it.
 	 */
 	if (unlikely(!prior)) {
+		if (kmem_cache_has_cpu_partial(s)) {
+			/*
+			 * Freeze the slab and keep it on this cpu, so the
+			 * node's list_lock is not needed to put it on the
+			 * partial list, nor to take it off again.
+			 */
+			__SetPageSlubFrozen(page);
+			slab_unlock(page);
+			put_cpu_partial(s, page);
+			stat(s, CPU_PARTIAL_FREE);
+			goto out;
+		}
 		add_partial(get_node(s, page_to_nid(page)), page, 1);
 		stat(s, FREE_ADD_PARTIAL);
 	}
 
 out_unlock:
 	slab_unlock(page);
+out:
+#ifdef CONFIG_CMPXCHG_LOCAL
+	local_irq_restore(flags);
+#endif
 	return;
 
 slab_empty:
@@ -1822,6 +2074,9 @@ slab_empty:
 		stat(s, FREE_REMOVE_PARTIAL);
 	}
 	slab_unlock(page);
+#ifdef CONFIG_CMPXCHG_LOCAL
+	local_irq_restore(flags);
+#endif
 	stat(s, FREE_SLAB);
 	discard_slab(s, page);
 	return;
@@ -1848,9 +2103,41 @@ static __always_inline void slab_free(struct kmem_cache *s,
 {
 	void **object = (void *)x;
 	struct kmem_cache_cpu *c;
+#ifdef CONFIG_CMPXCHG_LOCAL
+	unsigned long tid;
+	void **freelist;
+#else
 	unsigned long flags;
+#endif
 
 	kmemleak_free_recursive(x, s->flags);
+#ifdef CONFIG_CMPXCHG_LOCAL
+	kmemcheck_slab_free(s, object, s->objsize);
+	debug_check_no_locks_freed(object, s->objsize);
+	if (!(s->flags & SLAB_DEBUG_OBJECTS))
+		debug_check_no_obj_freed(object, s->objsize);
+
+redo:
+	/* Same ordering against the cpu and tid as in slab_alloc() */
+	c = __this_cpu_ptr(s->cpu_slab);
+	tid = c->tid;
+	barrier();
+
+	if (likely(page == c->page && c->node >= 0)) {
+		freelist = c->freelist;
+		set_freepointer(s, object, freelist);
+
+		if (unlikely(!irqsafe_cpu_cmpxchg_double(
+				s->cpu_slab->freelist, s->cpu_slab->tid,
+				freelist, tid,
+				object, next_tid(tid)))) {
+			stat(s, CMPXCHG_DOUBLE_CPU_FAIL);
+			goto redo;
+		}
+		stat(s, FREE_FASTPATH);
+	} else
+		__slab_free(s, page, x, addr);
+#else
 	local_irq_save(flags);
 	c = __this_cpu_ptr(s->cpu_slab);
 	kmemcheck_slab_free(s, object, s->objsize);
@@ -1865,6 +2152,7 @@ static __always_inline void slab_free(struct kmem_cache *s,
 		__slab_free(s, page, x, addr);
 
 	local_irq_restore(flags);
+#endif
 }
 
 void kmem_cache_free(struct kmem_cache *s, void *x)
@@ -2078,6 +2366,7 @@ static inline int alloc_kmem_cache_cpus(struct kmem_cache *s, gfp_t flags)
 	if (!s->cpu_slab)
 		return 0;
 
+	init_kmem_cache_cpus(s);
 	return 1;
 }
 
@@ -2344,6 +2633,22 @@ static int kmem_cache_open(struct kmem_cache *s, gfp_t gfpflags,
 	 * list to avoid pounding the page allocator excessively.
 	 */
 	set_min_partial(s, ilog2(s->size));
+
+	/*
+	 * The number of free objects kept on the partial lists of each cpu.
+	 * Large objects come in few per slab, keep fewer slabs for them.
+	 */
+	if (kmem_cache_debug(s))
+		s->cpu_partial = 0;
+	else if (s->size >= PAGE_SIZE)
+		s->cpu_partial = 2;
+	else if (s->size >= 1024)
+		s->cpu_partial = 6;
+	else if (s->size >= 256)
+		s->cpu_partial = 13;
+	else
+		s->cpu_partial = 30;
+
 	s->refcount = 1;
 #ifdef CONFIG_NUMA
 	s->remote_node_defrag_ratio = 1000;
@@ -3784,6 +4089,15 @@ static ssize_t show_slab_objects(struct kmem_cache *s,
 				total += x;
 				nodes[c->node] += x;
 			}
+			if (!(flags & (SO_TOTAL | SO_OBJECTS))) {
+				struct page *page = ACCESS_ONCE(c->partial);
+
+				/* the first slab knows the list length */
+				if (page) {
+					total += page->pages;
+					nodes[page_to_nid(page)] += page->pages;
+				}
+			}
 			per_cpu[c->node]++;
 		}
 	}
@@ -3928,6 +4242,29 @@ static ssize_t min_partial_store(struct kmem_cache *s, const char *buf,
 }
 SLAB_ATTR(min_partial);
 
+static ssize_t cpu_partial_show(struct kmem_cache *s, char *buf)
+{
+	return sprintf(buf, "%d\n", s->cpu_partial);
+}
+
+static ssize_t cpu_partial_store(struct kmem_cache *s, const char *buf,
+				 size_t length)
+{
+	unsigned long objects;
+	int err;
+
+	err = strict_strtoul(buf, 10, &objects);
+	if (err)
+		return err;
+	if (objects && kmem_cache_debug(s))
+		return -EINVAL;
+
+	s->cpu_partial = objects;
+	flush_all(s);
+	return length;
+}
+SLAB_ATTR(cpu_partial);
+
 static ssize_t ctor_show(struct kmem_cache *s, char *buf)
 {
 	if (s->ctor) {
@@ -4269,6 +4606,11 @@ STAT_ATTR(DEACTIVATE_TO_HEAD, deactivate_to_head);
 STAT_ATTR(DEACTIVATE_TO_TAIL, deactivate_to_tail);
 STAT_ATTR(DEACTIVATE_REMOTE_FREES, deactivate_remote_frees);
 STAT_ATTR(ORDER_FALLBACK, order_fallback);
+STAT_ATTR(CMPXCHG_DOUBLE_CPU_FAIL, cmpxchg_double_cpu_fail);
+STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
+STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
+STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
+STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
 #endif
 
 static struct attribute *slab_attrs[] = {
@@ -4277,6 +4619,7 @@ static struct attribute *slab_attrs[] = {
 	&objs_per_slab_attr.attr,
 	&order_attr.attr,
 	&min_partial_attr.attr,
+	&cpu_partial_attr.attr,
 	&objects_attr.attr,
 	&objects_partial_attr.attr,
 	&total_objects_attr.attr,
@@ -4323,6 +4666,11 @@ static struct attribute *slab_attrs[] = {
 	&deactivate_to_tail_attr.attr,
 	&deactivate_remote_frees_attr.attr,
 	&order_fallback_attr.attr,
+	&cmpxchg_double_cpu_fail_attr.attr,
+	&cpu_partial_alloc_attr.attr,
+	&cpu_partial_free_attr.attr,
+	&cpu_partial_node_attr.attr,
+	&cpu_partial_drain_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
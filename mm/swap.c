@@ -120,7 +120,8 @@ static void pagevec_move_tail(struct pagevec *pvec)
 		}
 		if (PageLRU(page) && !PageActive(page) && !PageUnevictable(page)) {
 			int lru = page_lru_base_type(page);
-			list_move_tail(&page->lru, &zone->lru[lru].list);
+			if (!lru_gen_rotate_page(zone, page))
+				list_move_tail(&page->lru, &zone->lru[lru].list);
 			pgmoved++;
 		}
 	}
@@ -0,0 +1,147 @@
+/*
+ * vmalloc/vfree stress benchmark module
+ *
+ * Runs through a range of allocation sizes on every cpu at the same
+ * time.  For each size a thread vmallocs nr_areas areas and vfrees them
+ * again, in the reverse order of the allocations, and then maps the
+ * same pages nr_areas times with vm_map_ram() and unmaps them right
+ * away, which stays in the per cpu vmap blocks for sizes they serve.
+ * All of it fills the vmalloc space with lazily freed areas, so the
+ * costs include the purges and their TLB flushes.  The costs per
+ * operation are reported for every size, see linux/cpubench.h.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ */
+
+#include <linux/cpubench.h>
+#include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+
+static int nthreads;
+static int nr_areas = 100;
+
+module_param_named(nr_threads, nthreads, int, 0444);
+MODULE_PARM_DESC(nr_threads, "Number of threads (default: one per cpu)");
+module_param(nr_areas, int, 0444);
+MODULE_PARM_DESC(nr_areas, "Areas allocated per size and thread");
+
+/* in pages */
+static const int sizes[] = { 1, 4, 16, 64, 256 };
+#define MAX_PAGES 256
+
+enum { VMALLOC, VFREE, MAP_RAM, NR_TESTS };
+
+static const char * const test_names[] = {
+	[VMALLOC]	= "vmalloc",
+	[VFREE]		= "vfree",
+	[MAP_RAM]	= "map+unmap",
+};
+
+static void **areas;			/* nr_areas per thread */
+static struct page *pages[MAX_PAGES];	/* mapped by all threads */
+static atomic_t failures;
+
+/* one round per size */
+static void vmalloc_bench_fn(struct cpu_bench *bench, int thread, int round)
+{
+	void **a = areas + thread * nr_areas;
+	unsigned long size = sizes[round] * PAGE_SIZE;
+	struct cpu_bench_clock clk;
+	int j;
+
+	cpu_bench_clock_start(&clk);
+	for (j = 0; j < nr_areas; j++)
+		a[j] = vmalloc(size);
+	cpu_bench_clock_stop(&clk,
+		cpu_bench_time(bench, thread, round, VMALLOC));
+
+	for (j = 0; j < nr_areas; j++)
+		if (!a[j])
+			atomic_inc(&failures);
+
+	cpu_bench_clock_start(&clk);
+	for (j = nr_areas - 1; j >= 0; j--)
+		vfree(a[j]);
+	cpu_bench_clock_stop(&clk,
+		cpu_bench_time(bench, thread, round, VFREE));
+
+	cpu_bench_clock_start(&clk);
+	for (j = 0; j < nr_areas; j++) {
+		void *addr = vm_map_ram(pages, sizes[round], -1, PAGE_KERNEL);
+
+		if (!addr) {
+			atomic_inc(&failures);
+			continue;
+		}
+		vm_unmap_ram(addr, sizes[round]);
+	}
+	cpu_bench_clock_stop(&clk,
+		cpu_bench_time(bench, thread, round, MAP_RAM));
+}
+
+static struct cpu_bench vmalloc_bench = {
+	.name		= "vmalloc-bench",
+	.nr_rounds	= ARRAY_SIZE(sizes),
+	.nr_tests	= NR_TESTS,
+	.fn		= vmalloc_bench_fn,
+};
+
+static int __init vmalloc_bench_init(void)
+{
+	char label[32];
+	int i, test, ret = -ENOMEM;
+
+	if (nthreads <= 0)
+		nthreads = num_online_cpus();
+	if (nr_areas <= 0)
+		return -EINVAL;
+
+	areas = vmalloc(sizeof(void *) * nr_areas * nthreads);
+	if (!areas)
+		return -ENOMEM;
+	for (i = 0; i < MAX_PAGES; i++) {
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (!pages[i])
+			goto free;
+	}
+
+	vmalloc_bench.nr_threads = nthreads;
+	ret = cpu_bench_run(&vmalloc_bench);
+	if (ret)
+		goto free;
+
+	printk(KERN_INFO "vmalloc-bench: %d threads, %d areas, "
+	       "cost per operation:\n", nthreads, nr_areas);
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		for (test = 0; test < NR_TESTS; test++) {
+			snprintf(label, sizeof(label), "%3d pages %s",
+				 sizes[i], test_names[test]);
+			cpu_bench_report(&vmalloc_bench, i, test,
+					 nr_areas, label);
+		}
+	}
+	cpu_bench_free(&vmalloc_bench);
+
+	if (atomic_read(&failures))
+		ret = -ENOMEM;
+free:
+	for (i = 0; i < MAX_PAGES; i++)
+		if (pages[i])
+			__free_page(pages[i]);
+	vfree(areas);
+	return ret;
+}
+
+static void __exit vmalloc_bench_exit(void)
+{
+}
+
+module_init(vmalloc_bench_init);
+module_exit(vmalloc_bench_exit);
+MODULE_LICENSE("GPL");
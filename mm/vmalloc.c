@@ -320,6 +320,41 @@ static void __insert_vmap_area(struct vmap_area *va)
 
 static void purge_vmap_area_lazy(void);
 
+/*
+ * Free area caches, one per size class. Each remembers the area last
+ * allocated in its class and the largest hole the search for it skipped
+ * below, so that the next search of the class can resume right after
+ * that area instead of walking all the areas from vstart again. Small and
+ * large requests get classes of their own: a small one that would fit a
+ * skipped hole resets the cache of its class only, not the one the
+ * large requests keep at the top of the used space.
+ *
+ * Protected by vmap_area_lock.
+ */
+#define VMAP_CACHE_CLASSES	4
+
+struct vmap_free_cache {
+	struct rb_node *node;		/* last area of the class */
+	unsigned long hole_size;	/* largest hole skipped below it */
+	unsigned long vstart;
+	unsigned long align;
+};
+
+static struct vmap_free_cache vmap_free_cache[VMAP_CACHE_CLASSES];
+
+static struct vmap_free_cache *vmap_size_class(unsigned long size)
+{
+	unsigned long pages = size >> PAGE_SHIFT;
+
+	if (pages <= 1)
+		return &vmap_free_cache[0];
+	if (pages <= 4)
+		return &vmap_free_cache[1];
+	if (pages <= 64)
+		return &vmap_free_cache[2];
+	return &vmap_free_cache[3];
+}
+
 /*
  * Allocate a region of KVA of the specified size and alignment, within the
  * vstart and vend.
@@ -329,7 +364,8 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 				unsigned long vstart, unsigned long vend,
 				int node, gfp_t gfp_mask)
 {
-	struct vmap_area *va;
+	struct vmap_free_cache *cache = vmap_size_class(size);
+	struct vmap_area *va, *first;
 	struct rb_node *n;
 	unsigned long addr;
 	int purged = 0;
@@ -343,17 +379,38 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 		return ERR_PTR(-ENOMEM);
 
 retry:
-	addr = ALIGN(vstart, align);
-
 	spin_lock(&vmap_area_lock);
-	if (addr + size - 1 < addr)
-		goto overflow;
+	/*
+	 * The cache is no good if a hole it skipped could fit this request,
+	 * or if it was filled for a lower vstart or a smaller alignment.
+	 */
+	if (!cache->node || size <= cache->hole_size ||
+	    vstart < cache->vstart || align < cache->align) {
+nocache:
+		cache->hole_size = 0;
+		cache->node = NULL;
+	}
+	cache->vstart = vstart;
+	cache->align = align;
+
+	if (cache->node) {
+		/* resume after the area last allocated in this class */
+		first = rb_entry(cache->node, struct vmap_area, rb_node);
+		addr = ALIGN(first->va_end + PAGE_SIZE, align);
+		if (addr < vstart)
+			goto nocache;
+		if (addr + size - 1 < addr)
+			goto overflow;
+	} else {
+		addr = ALIGN(vstart, align);
+		if (addr + size - 1 < addr)
+			goto overflow;
 
-	/* XXX: could have a last_hole cache */
-	n = vmap_area_root.rb_node;
-	if (n) {
-		struct vmap_area *first = NULL;
+		n = vmap_area_root.rb_node;
+		if (!n)
+			goto found;
 
+		first = NULL;
 		do {
 			struct vmap_area *tmp;
 			tmp = rb_entry(n, struct vmap_area, rb_node);
@@ -377,18 +434,20 @@ retry:
 			else
 				goto found;
 		}
+	}
 
-		while (addr + size > first->va_start && addr + size <= vend) {
-			addr = ALIGN(first->va_end + PAGE_SIZE, align);
-			if (addr + size - 1 < addr)
-				goto overflow;
+	while (addr + size > first->va_start && addr + size <= vend) {
+		if (addr + cache->hole_size < first->va_start)
+			cache->hole_size = first->va_start - addr;
+		addr = ALIGN(first->va_end + PAGE_SIZE, align);
+		if (addr + size - 1 < addr)
+			goto overflow;
 
-			n = rb_next(&first->rb_node);
-			if (n)
-				first = rb_entry(n, struct vmap_area, rb_node);
-			else
-				goto found;
-		}
+		n = rb_next(&first->rb_node);
+		if (n)
+			first = rb_entry(n, struct vmap_area, rb_node);
+		else
+			goto found;
 	}
 found:
 	if (addr + size > vend) {
@@ -413,6 +472,7 @@ overflow:
 	va->va_end = addr + size;
 	va->flags = 0;
 	__insert_vmap_area(va);
+	cache->node = &va->rb_node;
 	spin_unlock(&vmap_area_lock);
 
 	return va;
@@ -427,7 +487,31 @@ static void rcu_free_va(struct rcu_head *head)
 
 static void __free_vmap_area(struct vmap_area *va)
 {
+	int i;
+
 	BUG_ON(RB_EMPTY_NODE(&va->rb_node));
+
+	/*
+	 * A free below the area a cache points to opens a hole its next
+	 * search would skip: move the cache to the area before the hole.
+	 * The hole sizes the caches track stay upper bounds, which is all
+	 * they need to be.
+	 */
+	for (i = 0; i < VMAP_CACHE_CLASSES; i++) {
+		struct vmap_free_cache *cache = &vmap_free_cache[i];
+		struct vmap_area *cached;
+
+		if (!cache->node)
+			continue;
+		if (va->va_end < cache->vstart) {
+			cache->node = NULL;
+			continue;
+		}
+		cached = rb_entry(cache->node, struct vmap_area, rb_node);
+		if (va->va_start <= cached->va_start)
+			cache->node = rb_prev(&va->rb_node);
+	}
+
 	rb_erase(&va->rb_node, &vmap_area_root);
 	RB_CLEAR_NODE(&va->rb_node);
 	list_del_rcu(&va->list);
@@ -513,6 +597,33 @@ static unsigned long lazy_max_pages(void)
 
 static atomic_t vmap_lazy_nr = ATOMIC_INIT(0);
 
+/*
+ * Lazily freed areas wait for the next purge on a list of the cpu that
+ * freed them, so the purge does not have to look through all the areas
+ * for them, and the frees do not all queue up on a single lock.
+ */
+struct vmap_lazy_queue {
+	spinlock_t lock;
+	struct list_head list;
+};
+
+static DEFINE_PER_CPU(struct vmap_lazy_queue, vmap_lazy_queue);
+
+/*
+ * Above this many pages, flush the whole kernel TLB rather than a range.
+ * The range the purge flushes spans all the areas it frees and the holes
+ * between them, and architectures like ARM flush a range page by page.
+ */
+#define VMAP_FLUSH_ALL_PAGES	PTRS_PER_PTE
+
+static void vmap_flush_tlb_kernel_range(unsigned long start, unsigned long end)
+{
+	if ((end - start) >> PAGE_SHIFT > VMAP_FLUSH_ALL_PAGES)
+		flush_tlb_all();
+	else
+		flush_tlb_kernel_range(start, end);
+}
+
 /* for per-CPU blocks */
 static void purge_fragmented_blocks_allcpus(void);
 
@@ -543,6 +654,7 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 	struct vmap_area *va;
 	struct vmap_area *n_va;
 	int nr = 0;
+	int cpu;
 
 	/*
 	 * If sync is 0 but force_flush is 1, we'll go sync anyway but callers
@@ -558,27 +670,33 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 	if (sync)
 		purge_fragmented_blocks_allcpus();
 
-	rcu_read_lock();
-	list_for_each_entry_rcu(va, &vmap_area_list, list) {
-		if (va->flags & VM_LAZY_FREE) {
-			if (va->va_start < *start)
-				*start = va->va_start;
-			if (va->va_end > *end)
-				*end = va->va_end;
-			nr += (va->va_end - va->va_start) >> PAGE_SHIFT;
-			unmap_vmap_area(va);
-			list_add_tail(&va->purge_list, &valist);
-			va->flags |= VM_LAZY_FREEING;
-			va->flags &= ~VM_LAZY_FREE;
-		}
+	for_each_possible_cpu(cpu) {
+		struct vmap_lazy_queue *vlq = &per_cpu(vmap_lazy_queue, cpu);
+
+		if (list_empty(&vlq->list))
+			continue;
+		spin_lock(&vlq->lock);
+		list_splice_tail_init(&vlq->list, &valist);
+		spin_unlock(&vlq->lock);
+	}
+
+	list_for_each_entry(va, &valist, purge_list) {
+		if (va->va_start < *start)
+			*start = va->va_start;
+		if (va->va_end > *end)
+			*end = va->va_end;
+		nr += (va->va_end - va->va_start) >> PAGE_SHIFT;
+		unmap_vmap_area(va);
+		va->flags |= VM_LAZY_FREEING;
+		va->flags &= ~VM_LAZY_FREE;
 	}
-	rcu_read_unlock();
 
 	if (nr)
 		atomic_sub(nr, &vmap_lazy_nr);
 
+	/* one flush for all of the areas */
 	if (nr || force_flush)
-		flush_tlb_kernel_range(*start, *end);
+		vmap_flush_tlb_kernel_range(*start, *end);
 
 	if (nr) {
 		spin_lock(&vmap_area_lock);
@@ -616,7 +734,14 @@ static void purge_vmap_area_lazy(void)
  */
 static void free_unmap_vmap_area_noflush(struct vmap_area *va)
 {
+	struct vmap_lazy_queue *vlq;
+
 	va->flags |= VM_LAZY_FREE;
+	vlq = &get_cpu_var(vmap_lazy_queue);
+	spin_lock(&vlq->lock);
+	list_add_tail(&va->purge_list, &vlq->list);
+	spin_unlock(&vlq->lock);
+	put_cpu_var(vmap_lazy_queue);
 	atomic_add((va->va_end - va->va_start) >> PAGE_SHIFT, &vmap_lazy_nr);
 	if (unlikely(atomic_read(&vmap_lazy_nr) > lazy_max_pages()))
 		try_purge_vmap_area_lazy();
@@ -670,7 +795,7 @@ static void free_unmap_vmap_area_addr(unsigned long addr)
 #endif
 
 #define VMALLOC_PAGES		(VMALLOC_SPACE / PAGE_SIZE)
-#define VMAP_MAX_ALLOC		BITS_PER_LONG	/* 256K with 4K pages */
+#define VMAP_MAX_ALLOC		64		/* 256K with 4K pages */
 #define VMAP_BBMAP_BITS_MAX	1024	/* 4MB with 4K pages */
 #define VMAP_BBMAP_BITS_MIN	(VMAP_MAX_ALLOC*2)
 #define VMAP_MIN(x, y)		((x) < (y) ? (x) : (y)) /* can't use min() */
@@ -1106,10 +1231,14 @@ void __init vmalloc_init(void)
 
 	for_each_possible_cpu(i) {
 		struct vmap_block_queue *vbq;
+		struct vmap_lazy_queue *vlq;
 
 		vbq = &per_cpu(vmap_block_queue, i);
 		spin_lock_init(&vbq->lock);
 		INIT_LIST_HEAD(&vbq->free);
+		vlq = &per_cpu(vmap_lazy_queue, i);
+		spin_lock_init(&vlq->lock);
+		INIT_LIST_HEAD(&vlq->list);
 	}
 
 	/* Import existing vmlist entries. */
@@ -40,6 +40,8 @@
 #include <linux/memcontrol.h>
 #include <linux/delayacct.h>
 #include <linux/sysctl.h>
+#include <linux/sysfs.h>
+#include <linux/compaction.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -730,7 +732,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		 * processes. Try to unmap it here.
 		 */
 		if (page_mapped(page) && mapping) {
-			switch (try_to_unmap(page, TTU_UNMAP)) {
+			switch (try_to_unmap(page, TTU_UNMAP | TTU_BATCH_FLUSH)) {
 			case SWAP_FAIL:
 				goto activate_locked;
 			case SWAP_AGAIN:
@@ -750,6 +752,12 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			if (!sc->may_writepage)
 				goto keep_locked;
 
+			/*
+			 * A cpu that still has the page in its TLB from before
+			 * the unmap could dirty it again behind the writeback.
+			 */
+			try_to_unmap_flush_dirty();
+
 			/* Page is dirty, try to write it out here */
 			switch (pageout(page, mapping, sync_writeback)) {
 			case PAGE_KEEP:
@@ -857,6 +865,8 @@ keep:
 		VM_BUG_ON(PageLRU(page) || PageUnevictable(page));
 	}
 
+	/* one TLB flush for all the pages unmapped above */
+	try_to_unmap_flush();
 	free_page_list(&free_pages);
 
 	list_splice(&ret_pages, page_list);
@@ -1017,6 +1027,14 @@ static unsigned long isolate_lru_pages(unsigned long nr_to_scan,
 					!PageSwapCache(cursor_page))
 				continue;
 
+			/*
+			 * Pages on the generation lists are only taken off
+			 * them through del_page_from_lru_list(), which keeps
+			 * the generation sizes right.
+			 */
+			if (page_lru_gen(cursor_page) >= 0)
+				continue;
+
 			if (__isolate_lru_page(cursor_page, mode, file) == 0) {
 				list_move(&cursor_page->lru, dst);
 				mem_cgroup_del_lru(cursor_page);
@@ -1289,6 +1307,8 @@ shrink_inactive_list(unsigned long nr_to_scan, struct zone *zone,
 	unsigned long nr_active;
 	unsigned long nr_anon;
 	unsigned long nr_file;
+	ktime_t start;
+	s64 usecs;
 
 	while (unlikely(too_many_isolated(zone, file, sc))) {
 		congestion_wait(BLK_RW_ASYNC, HZ/10);
@@ -1337,7 +1357,9 @@ shrink_inactive_list(unsigned long nr_to_scan, struct zone *zone,
 
 	spin_unlock_irq(&zone->lru_lock);
 
+	start = ktime_get();
 	nr_reclaimed = shrink_page_list(&page_list, sc, PAGEOUT_IO_ASYNC);
+	usecs = ktime_us_delta(ktime_get(), start);
 
 	/* Check if we should syncronously wait for writeback */
 	if (should_reclaim_stall(nr_taken, nr_reclaimed, priority, sc)) {
@@ -1350,13 +1372,16 @@ shrink_inactive_list(unsigned long nr_to_scan, struct zone *zone,
 		nr_active = clear_active_flags(&page_list, NULL);
 		count_vm_events(PGDEACTIVATE, nr_active);
 
+		start = ktime_get();
 		nr_reclaimed += shrink_page_list(&page_list, sc, PAGEOUT_IO_SYNC);
+		usecs += ktime_us_delta(ktime_get(), start);
 	}
 
 	local_irq_disable();
 	if (current_is_kswapd())
 		__count_vm_events(KSWAPD_STEAL, nr_reclaimed);
 	__count_zone_vm_events(PGSTEAL, zone, nr_reclaimed);
+	__count_zone_vm_events(PGRECLAIM_USECS, zone, usecs);
 
 	putback_lru_pages(zone, sc, nr_anon, nr_file, &page_list);
 	return nr_reclaimed;
@@ -1396,9 +1421,13 @@ static void move_active_pages_to_lru(struct zone *zone,
 		VM_BUG_ON(PageLRU(page));
 		SetPageLRU(page);
 
-		list_move(&page->lru, &zone->lru[lru].list);
-		mem_cgroup_add_lru_list(page, lru);
-		pgmoved++;
+		/* unless the generations were switched on meanwhile */
+		list_del(&page->lru);
+		if (!lru_gen_add_page(zone, page, lru)) {
+			list_add(&page->lru, &zone->lru[lru].list);
+			mem_cgroup_add_lru_list(page, lru);
+			pgmoved++;
+		}
 
 		if (!pagevec_add(&pvec, page) || list_empty(list)) {
 			spin_unlock_irq(&zone->lru_lock);
@@ -1736,6 +1765,548 @@ static void set_lumpy_reclaim_mode(int priority, struct scan_control *sc)
 		sc->lumpy_reclaim_mode = 0;
 }
 
+#ifdef CONFIG_LRU_GEN
+/*
+ * The multi-generational LRU.
+ *
+ * Instead of the active and inactive lists, each zone keeps its evictable
+ * pages in up to MAX_NR_GENS generations per type, see struct zone_lru_gen.
+ * Pages headed for an active list enter the youngest generation, and
+ * reclaim evicts from the oldest one.  Once a type is down to MIN_NR_GENS
+ * generations, reclaim ages the zone: it walks the page tables of all
+ * processes, clears the accessed bits it finds and marks those pages
+ * PG_young, and then starts a new youngest generation.  Eviction moves the
+ * marked pages it comes across into the youngest generation instead of
+ * reclaiming them, so the lists are only sorted lazily, under the lru_lock
+ * that eviction holds anyway.
+ *
+ * The page table walk visits the mapped pages once per aging, in address
+ * order, instead of following the reverse map of every page that reaches
+ * the end of the inactive list.  And the older generations still tell the
+ * pages of a process used a few agings ago from the ones that were never
+ * used again, which the two lists lose as soon as both are cycled through,
+ * as happens when switching between applications.
+ */
+#ifdef CONFIG_LRU_GEN_ENABLED
+int lru_gen_enabled __read_mostly = 1;
+#else
+int lru_gen_enabled __read_mostly;
+#endif
+
+/* every mm, for the aging walk */
+static LIST_HEAD(lru_gen_mm_list);
+static DEFINE_SPINLOCK(lru_gen_mm_lock);
+
+/* where the aging walk is on lru_gen_mm_list, under lru_gen_mm_lock */
+static struct list_head *lru_gen_walk_pos;
+
+/* one aging walk at a time */
+static DEFINE_MUTEX(lru_gen_walk_mutex);
+
+/* serializes the switches between the two LRUs */
+static DEFINE_MUTEX(lru_gen_state_mutex);
+
+static int __init setup_lru_gen(char *str)
+{
+	lru_gen_enabled = simple_strtoul(str, NULL, 0) != 0;
+	return 1;
+}
+__setup("lru_gen=", setup_lru_gen);
+
+void lru_gen_init_zone(struct zone *zone)
+{
+	struct zone_lru_gen *lrugen = &zone->lrugen;
+	int gen, file;
+
+	lrugen->max_seq = MIN_NR_GENS - 1;
+	for (file = 0; file < 2; file++) {
+		lrugen->min_seq[file] = 0;
+		for (gen = 0; gen < MAX_NR_GENS; gen++) {
+			INIT_LIST_HEAD(&lrugen->lists[gen][file]);
+			lrugen->nr_pages[gen][file] = 0;
+		}
+	}
+}
+
+void lru_gen_add_mm(struct mm_struct *mm)
+{
+	spin_lock(&lru_gen_mm_lock);
+	list_add_tail(&mm->lru_gen_list, &lru_gen_mm_list);
+	spin_unlock(&lru_gen_mm_lock);
+}
+
+/*
+ * Called from mmput() once mm_users is 0, before exit_mmap().  The walk
+ * only pins the mm with mm_count, so wait for a walk that saw mm_users
+ * above 0 to leave the page tables alone before they are freed.
+ */
+void lru_gen_del_mm(struct mm_struct *mm)
+{
+	/* mm_alloc() users other than exec never list theirs */
+	if (list_empty(&mm->lru_gen_list))
+		return;
+
+	spin_lock(&lru_gen_mm_lock);
+	if (lru_gen_walk_pos == &mm->lru_gen_list)
+		lru_gen_walk_pos = mm->lru_gen_list.prev;
+	list_del_init(&mm->lru_gen_list);
+	spin_unlock(&lru_gen_mm_lock);
+
+	down_write(&mm->mmap_sem);
+	up_write(&mm->mmap_sem);
+}
+
+static int lru_gen_walk_pmd(pmd_t *pmd, unsigned long addr,
+			    unsigned long end, struct mm_walk *walk)
+{
+	struct vm_area_struct *vma = walk->private;
+	pte_t *pte, *orig_pte;
+	spinlock_t *ptl;
+
+	orig_pte = pte = pte_offset_map_lock(walk->mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		struct page *page;
+
+		if (!pte_present(*pte) || !pte_young(*pte))
+			continue;
+#ifdef CONFIG_LARGE_ANON_PAGES
+		/*
+		 * Clearing the bit would split the large page; leave these
+		 * to page_referenced() when they come up for eviction.
+		 */
+		if (pte_large_anon(pte))
+			continue;
+#endif
+		page = vm_normal_page(vma, addr, *pte);
+		if (!page || page_lru_gen(page) < 0)
+			continue;
+		/* no TLB flush, a missed access only costs an early aging */
+		if (ptep_test_and_clear_young(vma, addr, pte))
+			SetPageYoung(page);
+	}
+	pte_unmap_unlock(orig_pte, ptl);
+	cond_resched();
+	return 0;
+}
+
+static void lru_gen_walk_mm(struct mm_struct *mm)
+{
+	struct vm_area_struct *vma;
+	struct mm_walk walk = {
+		.pmd_entry	= lru_gen_walk_pmd,
+		.mm		= mm,
+	};
+
+	if (!down_read_trylock(&mm->mmap_sem))
+		return;
+	/* exiting, lru_gen_del_mm() waits for us otherwise */
+	if (!atomic_read(&mm->mm_users)) {
+		up_read(&mm->mmap_sem);
+		return;
+	}
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (vma->vm_flags & (VM_LOCKED | VM_HUGETLB | VM_IO | VM_PFNMAP))
+			continue;
+		walk.private = vma;
+		walk_page_range(vma->vm_start, vma->vm_end, &walk);
+	}
+	up_read(&mm->mmap_sem);
+}
+
+/*
+ * The next mm of the walk, pinned with mm_count: dropping an mm_users
+ * reference here could run exit_mmap() and fput() from within reclaim.
+ * Exiting mms stay on the list until their mmput() gets to unlist them;
+ * skip those.  Called with lru_gen_mm_lock held.
+ */
+static struct mm_struct *lru_gen_next_mm(void)
+{
+	struct list_head *pos;
+	struct mm_struct *mm;
+
+	for (pos = lru_gen_walk_pos->next; pos != &lru_gen_mm_list;
+	     pos = pos->next) {
+		lru_gen_walk_pos = pos;
+		mm = list_entry(pos, struct mm_struct, lru_gen_list);
+		if (atomic_read(&mm->mm_users)) {
+			atomic_inc(&mm->mm_count);
+			return mm;
+		}
+	}
+	return NULL;
+}
+
+static void lru_gen_walk_mms(void)
+{
+	struct mm_struct *mm;
+
+	spin_lock(&lru_gen_mm_lock);
+	lru_gen_walk_pos = &lru_gen_mm_list;
+	while ((mm = lru_gen_next_mm())) {
+		spin_unlock(&lru_gen_mm_lock);
+		lru_gen_walk_mm(mm);
+		mmdrop(mm);
+		/* lru_gen_del_mm() moved lru_gen_walk_pos back if mm left */
+		spin_lock(&lru_gen_mm_lock);
+	}
+	lru_gen_walk_pos = NULL;
+	spin_unlock(&lru_gen_mm_lock);
+}
+
+/*
+ * Fold the oldest generation of a type into the next one, to make room
+ * for a new generation when that type is not being evicted.  Both are
+ * inactive, so the zone statistics stay the same.
+ */
+static void lru_gen_force_inc_min_seq(struct zone *zone, int file)
+{
+	struct zone_lru_gen *lrugen = &zone->lrugen;
+	int old_gen = lru_gen_from_seq(lrugen->min_seq[file]);
+	int new_gen = lru_gen_from_seq(lrugen->min_seq[file] + 1);
+	struct page *page;
+
+	list_for_each_entry(page, &lrugen->lists[old_gen][file], lru)
+		set_page_lru_gen(page, new_gen);
+	list_splice_tail_init(&lrugen->lists[old_gen][file],
+			      &lrugen->lists[new_gen][file]);
+	lrugen->nr_pages[new_gen][file] += lrugen->nr_pages[old_gen][file];
+	lrugen->nr_pages[old_gen][file] = 0;
+	lrugen->min_seq[file]++;
+}
+
+/* Drop the oldest generations of a type as far as they are empty */
+static void lru_gen_try_inc_min_seq(struct zone *zone, int file)
+{
+	struct zone_lru_gen *lrugen = &zone->lrugen;
+
+	while (lrugen->min_seq[file] + MIN_NR_GENS <= lrugen->max_seq) {
+		int gen = lru_gen_from_seq(lrugen->min_seq[file]);
+
+		if (!list_empty(&lrugen->lists[gen][file]))
+			break;
+		lrugen->min_seq[file]++;
+	}
+}
+
+static void lru_gen_inc_max_seq(struct zone *zone)
+{
+	struct zone_lru_gen *lrugen = &zone->lrugen;
+	int file;
+
+	for (file = 0; file < 2; file++) {
+		enum lru_list l = file ? LRU_INACTIVE_FILE : LRU_INACTIVE_ANON;
+		int gen = lru_gen_from_seq(lrugen->max_seq - 1);
+		long delta = lrugen->nr_pages[gen][file];
+
+		if (lrugen->max_seq - lrugen->min_seq[file] + 1 == MAX_NR_GENS)
+			lru_gen_force_inc_min_seq(zone, file);
+
+		/* the second youngest generation turns inactive */
+		__mod_zone_page_state(zone, NR_LRU_BASE + l + LRU_ACTIVE, -delta);
+		__mod_zone_page_state(zone, NR_LRU_BASE + l, delta);
+	}
+	lrugen->max_seq++;
+}
+
+/*
+ * Start a new generation in @zone.  The walk clears the accessed bits of
+ * all zones, but only needs doing once for all reclaimers that want to
+ * age at the same time.
+ */
+static void lru_gen_age(struct zone *zone, struct scan_control *sc)
+{
+	unsigned long max_seq = zone->lrugen.max_seq;
+
+	if (mutex_trylock(&lru_gen_walk_mutex)) {
+		lru_gen_walk_mms();
+		mutex_unlock(&lru_gen_walk_mutex);
+	}
+
+	spin_lock_irq(&zone->lru_lock);
+	/* unless somebody else aged this zone meanwhile */
+	if (zone->lrugen.max_seq == max_seq)
+		lru_gen_inc_max_seq(zone);
+	spin_unlock_irq(&zone->lru_lock);
+}
+
+/*
+ * Evict up to SWAP_CLUSTER_MAX pages of one type from the oldest
+ * generation, moving the pages marked young into the youngest one on the
+ * way.  Returns the number of pages scanned, 0 if the type is down to
+ * MIN_NR_GENS generations and needs aging first.
+ */
+static unsigned long lru_gen_evict(struct zone *zone, struct scan_control *sc,
+				   int file, unsigned long nr_to_scan)
+{
+	struct zone_lru_gen *lrugen = &zone->lrugen;
+	LIST_HEAD(page_list);
+	struct list_head *head;
+	unsigned long nr_scanned = 0;
+	unsigned long nr_taken = 0;
+	unsigned long nr_reclaimed;
+	ktime_t start;
+	s64 usecs;
+
+	while (unlikely(too_many_isolated(zone, file, sc))) {
+		congestion_wait(BLK_RW_ASYNC, HZ/10);
+
+		/* We are about to die and free our memory. Return now. */
+		if (fatal_signal_pending(current))
+			return SWAP_CLUSTER_MAX;
+	}
+
+	lru_add_drain();
+	spin_lock_irq(&zone->lru_lock);
+
+	lru_gen_try_inc_min_seq(zone, file);
+	if (lrugen->min_seq[file] + MIN_NR_GENS > lrugen->max_seq) {
+		spin_unlock_irq(&zone->lru_lock);
+		return 0;
+	}
+
+	head = &lrugen->lists[lru_gen_from_seq(lrugen->min_seq[file])][file];
+	while (nr_scanned < nr_to_scan && nr_taken < SWAP_CLUSTER_MAX &&
+	       !list_empty(head)) {
+		struct page *page = lru_to_page(head);
+
+		prefetchw_prev_lru_page(page, head, flags);
+		VM_BUG_ON(!PageLRU(page));
+		nr_scanned++;
+
+		if (TestClearPageYoung(page)) {
+			lru_gen_del_page(zone, page, 0);
+			lru_gen_add_page(zone, page,
+					 page_lru_base_type(page) + LRU_ACTIVE);
+			continue;
+		}
+
+		switch (__isolate_lru_page(page, ISOLATE_INACTIVE, file)) {
+		case 0:
+			lru_gen_del_page(zone, page, 0);
+			list_add(&page->lru, &page_list);
+			nr_taken++;
+			break;
+
+		case -EBUSY:
+			/* else it is being freed elsewhere */
+			list_move(&page->lru, head);
+			break;
+
+		default:
+			BUG();
+		}
+	}
+	lru_gen_try_inc_min_seq(zone, file);
+
+	zone->pages_scanned += nr_scanned;
+	if (current_is_kswapd())
+		__count_zone_vm_events(PGSCAN_KSWAPD, zone, nr_scanned);
+	else
+		__count_zone_vm_events(PGSCAN_DIRECT, zone, nr_scanned);
+	__mod_zone_page_state(zone, NR_ISOLATED_ANON + file, nr_taken);
+	spin_unlock_irq(&zone->lru_lock);
+
+	if (!nr_taken)
+		return nr_scanned;
+
+	start = ktime_get();
+	nr_reclaimed = shrink_page_list(&page_list, sc, PAGEOUT_IO_ASYNC);
+	usecs = ktime_us_delta(ktime_get(), start);
+
+	local_irq_disable();
+	if (current_is_kswapd())
+		__count_vm_events(KSWAPD_STEAL, nr_reclaimed);
+	__count_zone_vm_events(PGSTEAL, zone, nr_reclaimed);
+	__count_zone_vm_events(PGRECLAIM_USECS, zone, usecs);
+
+	putback_lru_pages(zone, sc, file ? 0 : nr_taken, file ? nr_taken : 0,
+			  &page_list);
+	sc->nr_reclaimed += nr_reclaimed;
+	return nr_scanned;
+}
+
+/*
+ * Evict the type whose oldest generation is older, file pages on a tie.
+ * Anon pages only when they can be swapped, and with swappiness 0 only
+ * when there are no file pages left.
+ */
+static int lru_gen_pick_type(struct zone *zone, struct scan_control *sc)
+{
+	struct zone_lru_gen *lrugen = &zone->lrugen;
+
+	if (!sc->may_swap || nr_swap_pages <= 0)
+		return 1;
+	if (!zone_page_state(zone, NR_ACTIVE_FILE) &&
+	    !zone_page_state(zone, NR_INACTIVE_FILE))
+		return 0;
+	if (!sc->swappiness)
+		return 1;
+	return lrugen->min_seq[0] >= lrugen->min_seq[1];
+}
+
+static void lru_gen_shrink_zone(int priority, struct zone *zone,
+				struct scan_control *sc)
+{
+	unsigned long nr_to_scan;
+	int aged = 0;
+
+	/* higher orders are left to compaction */
+	sc->lumpy_reclaim_mode = 0;
+
+	nr_to_scan = max(zone_reclaimable_pages(zone) >> priority,
+			 (unsigned long)SWAP_CLUSTER_MAX);
+	while (nr_to_scan) {
+		int file = lru_gen_pick_type(zone, sc);
+		unsigned long scanned;
+
+		scanned = lru_gen_evict(zone, sc, file,
+				min(nr_to_scan, (unsigned long)SWAP_CLUSTER_MAX));
+		if (!scanned) {
+			/* age at most once per call, it is expensive */
+			if (aged)
+				break;
+			lru_gen_age(zone, sc);
+			aged = 1;
+			continue;
+		}
+		nr_to_scan -= min(scanned, nr_to_scan);
+
+		if (sc->nr_reclaimed >= sc->nr_to_reclaim &&
+		    priority < DEF_PRIORITY)
+			break;
+	}
+
+	throttle_vm_writeout(sc->gfp_mask);
+}
+
+/* Move all pages of a zone from the active and inactive lists */
+static void lru_gen_fill_zone(struct zone *zone)
+{
+	enum lru_list l;
+	int batch = 0;
+
+	spin_lock_irq(&zone->lru_lock);
+	for_each_evictable_lru(l) {
+		struct list_head *head = &zone->lru[l].list;
+
+		/* oldest first, so the order within each list survives */
+		while (!list_empty(head)) {
+			struct page *page = lru_to_page(head);
+
+			del_page_from_lru_list(zone, page, l);
+			add_page_to_lru_list(zone, page, l);
+
+			if (++batch % SWAP_CLUSTER_MAX == 0) {
+				spin_unlock_irq(&zone->lru_lock);
+				cond_resched();
+				spin_lock_irq(&zone->lru_lock);
+			}
+		}
+	}
+	spin_unlock_irq(&zone->lru_lock);
+}
+
+/* Move all pages of a zone back to the active and inactive lists */
+static void lru_gen_drain_zone(struct zone *zone)
+{
+	struct zone_lru_gen *lrugen = &zone->lrugen;
+	int batch = 0;
+	int file;
+
+	spin_lock_irq(&zone->lru_lock);
+	for (file = 0; file < 2; file++) {
+		unsigned long seq;
+
+		for (seq = lrugen->min_seq[file]; seq <= lrugen->max_seq; seq++) {
+			struct list_head *head;
+
+			head = &lrugen->lists[lru_gen_from_seq(seq)][file];
+			while (!list_empty(head)) {
+				struct page *page = lru_to_page(head);
+
+				/* PG_active for the two youngest generations */
+				lru_gen_del_page(zone, page, 1);
+				ClearPageYoung(page);
+				add_page_to_lru_list(zone, page, page_lru(page));
+
+				if (++batch % SWAP_CLUSTER_MAX == 0) {
+					spin_unlock_irq(&zone->lru_lock);
+					cond_resched();
+					spin_lock_irq(&zone->lru_lock);
+				}
+			}
+		}
+	}
+	spin_unlock_irq(&zone->lru_lock);
+}
+
+/*
+ * Pages are put on the lists lru_gen_enabled asks for, and taken off the
+ * ones their LRU_GEN field says they are on, so the zones can be switched
+ * over one at a time while reclaim and everything else carries on.
+ */
+static void lru_gen_change_state(int enable)
+{
+	struct zone *zone;
+
+	mutex_lock(&lru_gen_state_mutex);
+	if (enable != lru_gen_enabled) {
+		lru_gen_enabled = enable;
+		for_each_populated_zone(zone) {
+			if (enable)
+				lru_gen_fill_zone(zone);
+			else
+				lru_gen_drain_zone(zone);
+		}
+	}
+	mutex_unlock(&lru_gen_state_mutex);
+}
+
+#ifdef CONFIG_SYSFS
+static ssize_t enabled_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", lru_gen_enabled);
+}
+
+static ssize_t enabled_store(struct kobject *kobj,
+			     struct kobj_attribute *attr,
+			     const char *buf, size_t count)
+{
+	unsigned long enable;
+
+	if (strict_strtoul(buf, 10, &enable) || enable > 1)
+		return -EINVAL;
+	lru_gen_change_state(enable);
+	return count;
+}
+
+static struct kobj_attribute enabled_attr =
+	__ATTR(enabled, 0644, enabled_show, enabled_store);
+
+static struct attribute *lru_gen_attrs[] = {
+	&enabled_attr.attr,
+	NULL,
+};
+
+static struct attribute_group lru_gen_attr_group = {
+	.attrs = lru_gen_attrs,
+	.name = "lru_gen",
+};
+
+static int __init lru_gen_init(void)
+{
+	int err;
+
+	err = sysfs_create_group(mm_kobj, &lru_gen_attr_group);
+	if (err)
+		printk(KERN_ERR "lru_gen: register sysfs failed\n");
+	return err;
+}
+late_initcall(lru_gen_init);
+#endif /* CONFIG_SYSFS */
+#endif /* CONFIG_LRU_GEN */
+
 /*
  * This is a basic per-zone page freer.  Used by both kswapd and direct reclaim.
  */
@@ -1748,6 +2319,12 @@ static void shrink_zone(int priority, struct zone *zone,
 	unsigned long nr_reclaimed = sc->nr_reclaimed;
 	unsigned long nr_to_reclaim = sc->nr_to_reclaim;
 
+#ifdef CONFIG_LRU_GEN
+	if (lru_gen_enabled) {
+		lru_gen_shrink_zone(priority, zone, sc);
+		return;
+	}
+#endif
 	get_scan_count(zone, sc, nr, priority);
 
 	set_lumpy_reclaim_mode(priority, sc);
@@ -2378,6 +2955,12 @@ static int kswapd(void *p)
 				 */
 				if (!sleeping_prematurely(pgdat, order, remaining)) {
 					trace_mm_vmscan_kswapd_sleep(pgdat->node_id);
+					/*
+					 * Free memory is there now, have it
+					 * compacted for the next high-order
+					 * allocation.
+					 */
+					wakeup_kcompactd(pgdat, order);
 					schedule();
 				} else {
 					if (remaining)
@@ -2834,10 +3417,8 @@ retry:
 	if (page_evictable(page, NULL)) {
 		enum lru_list l = page_lru_base_type(page);
 
-		__dec_zone_state(zone, NR_UNEVICTABLE);
-		list_move(&page->lru, &zone->lru[l].list);
-		mem_cgroup_move_lists(page, LRU_UNEVICTABLE, l);
-		__inc_zone_state(zone, NR_INACTIVE_ANON + l);
+		del_page_from_lru_list(zone, page, LRU_UNEVICTABLE);
+		add_page_to_lru_list(zone, page, l);
 		__count_vm_event(UNEVICTABLE_PGRESCUED);
 	} else {
 		/*
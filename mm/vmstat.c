@@ -17,6 +17,7 @@
 #include <linux/vmstat.h>
 #include <linux/sched.h>
 #include <linux/math64.h>
+#include <linux/compaction.h>
 
 #ifdef CONFIG_VM_EVENT_COUNTERS
 DEFINE_PER_CPU(struct vm_event_state, vm_event_states) = {{0}};
@@ -470,6 +471,24 @@ int fragmentation_index(struct zone *zone, unsigned int order)
 	fill_contig_page_info(zone, order, &info);
 	return __fragmentation_index(order, &info);
 }
+
+/*
+ * Calculate the percentage of free memory in a zone that cannot be used
+ * for an allocation of the given order: 0 when all of it is in blocks of
+ * at least that order, 100 when none of it is or nothing is free at all.
+ */
+int extfrag_for_order(struct zone *zone, unsigned int order)
+{
+	struct contig_page_info info;
+
+	fill_contig_page_info(zone, order, &info);
+	if (info.free_pages == 0)
+		return 100;
+
+	return div_u64((info.free_pages -
+			(info.free_blocks_suitable << order)) * 100ULL,
+			info.free_pages);
+}
 #endif
 
 #if defined(CONFIG_PROC_FS) || defined(CONFIG_COMPACTION)
@@ -680,6 +699,54 @@ static const struct file_operations fragmentation_file_operations = {
 	.release	= seq_release,
 };
 
+#ifdef CONFIG_COMPACTION
+static void fragscore_show_print(struct seq_file *m, pg_data_t *pgdat,
+						struct zone *zone)
+{
+	seq_printf(m, "Node %d, zone %8s %3u\n", pgdat->node_id, zone->name,
+		   fragmentation_score_zone(zone));
+}
+
+/*
+ * Show the fragmentation score of each zone and of the whole node, and
+ * the marks proactive compaction by kcompactd works between.
+ */
+static int fragscore_show(struct seq_file *m, void *arg)
+{
+	pg_data_t *pgdat = (pg_data_t *)arg;
+
+	/* check memoryless node */
+	if (!node_state(pgdat->node_id, N_HIGH_MEMORY))
+		return 0;
+
+	walk_zones_in_node(m, pgdat, fragscore_show_print);
+	seq_printf(m, "Node %d, score %3u low %u high %u\n",
+		   pgdat->node_id, fragmentation_score_node(pgdat),
+		   fragmentation_score_wmark(true),
+		   fragmentation_score_wmark(false));
+	return 0;
+}
+
+static const struct seq_operations fragscore_op = {
+	.start	= frag_start,
+	.next	= frag_next,
+	.stop	= frag_stop,
+	.show	= fragscore_show,
+};
+
+static int fragscore_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &fragscore_op);
+}
+
+static const struct file_operations fragscore_file_ops = {
+	.open		= fragscore_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+#endif /* CONFIG_COMPACTION */
+
 static const struct seq_operations pagetypeinfo_op = {
 	.start	= frag_start,
 	.next	= frag_next,
@@ -773,6 +840,11 @@ static const char * const vmstat_text[] = {
 	TEXTS_FOR_ZONES("pgsteal")
 	TEXTS_FOR_ZONES("pgscan_kswapd")
 	TEXTS_FOR_ZONES("pgscan_direct")
+	TEXTS_FOR_ZONES("pgreclaim_usecs")
+#ifdef CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH
+	"pgreclaim_tlb_deferred",
+	"pgreclaim_tlb_flush",
+#endif
 
 #ifdef CONFIG_NUMA
 	"zone_reclaim_failed",
@@ -796,12 +868,27 @@ static const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_daemon_wake",
+	"compact_daemon_proactive",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
 	"htlb_buddy_alloc_success",
 	"htlb_buddy_alloc_fail",
 #endif
+
+#ifdef CONFIG_LARGE_ANON_PAGES
+	"large_anon_fault_alloc",
+	"large_anon_fault_fallback",
+	"large_anon_collapse_alloc",
+	"large_anon_collapse_alloc_failed",
+	"large_anon_promote",
+	"large_anon_split",
+#endif
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	"spf_fault",
+	"spf_abort",
+#endif
 	"unevictable_pgs_culled",
 	"unevictable_pgs_scanned",
 	"unevictable_pgs_rescued",
@@ -1054,6 +1141,9 @@ static int __init setup_vmstat(void)
 	proc_create("pagetypeinfo", S_IRUGO, NULL, &pagetypeinfo_file_ops);
 	proc_create("vmstat", S_IRUGO, NULL, &proc_vmstat_file_operations);
 	proc_create("zoneinfo", S_IRUGO, NULL, &proc_zoneinfo_file_operations);
+#ifdef CONFIG_COMPACTION
+	proc_create("fragscore", S_IRUGO, NULL, &fragscore_file_ops);
+#endif
 #endif
 	return 0;
 }
@@ -0,0 +1,458 @@
+/*
+ * Compressed cache for swap pages
+ *
+ * Pages on their way out to swap are compressed with LZO and kept in
+ * RAM, in a pool bounded by a percentage of memory, instead of going
+ * to the swap device.  Swap-in of such a page is a decompression
+ * rather than a read from the device.  When the pool is full, the
+ * least recently stored or loaded entries are decompressed into the
+ * swap cache and written to the swap device they belong to, so the
+ * pool works as a write-back cache in front of any kind of swap.
+ *
+ * Entries are indexed by swap type and offset.  An entry goes away
+ * when its swap slot is freed, when it is written back, or when the
+ * same slot is stored again.  A swap-in keeps the entry: the page in
+ * the swap cache is clean and may be dropped again without a write.
+ *
+ * Statistics are in debugfs, under zswap/.
+ *
+ * Released under the terms of the GNU General Public License Version 2.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/highmem.h>
+#include <linux/init.h>
+#include <linux/list.h>
+#include <linux/lzo.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/pagemap.h>
+#include <linux/percpu.h>
+#include <linux/rbtree.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/swap.h>
+#include <linux/swapops.h>
+#include <linux/writeback.h>
+#include <linux/zswap.h>
+
+/* Compress pages as they are swapped out (/sys/module/zswap/parameters) */
+static int zswap_enabled;
+module_param_named(enabled, zswap_enabled, bool, 0644);
+
+/* Maximum size of the pool, in percent of RAM */
+static int zswap_max_pool_percent = 20;
+module_param_named(max_pool_percent, zswap_max_pool_percent, int, 0644);
+
+/*
+ * Entries come from kmalloc(), so a page that doesn't compress to half
+ * its size or less would not save any memory.
+ */
+#define ZSWAP_MAX_ENTRY_SIZE	(PAGE_SIZE / 2)
+
+/* Entries written back at most, per store into a full pool */
+#define ZSWAP_WRITEBACK_BATCH	16
+
+struct zswap_entry {
+	struct rb_node rbnode;
+	struct list_head lru;
+	unsigned int type;
+	pgoff_t offset;
+	size_t length;
+	unsigned char data[0];
+};
+
+/*
+ * zswap_lock protects the trees, the LRU and the statistics.  The LRU
+ * has the entries in the order they were last stored or loaded, oldest
+ * first.
+ */
+static DEFINE_SPINLOCK(zswap_lock);
+static struct rb_root zswap_trees[MAX_SWAPFILES];
+static LIST_HEAD(zswap_lru);
+
+/* Set once the compression buffers are there */
+static bool zswap_ready;
+static DEFINE_PER_CPU(unsigned char *, zswap_dstmem);
+static DEFINE_PER_CPU(void *, zswap_wrkmem);
+
+static u64 zswap_pool_bytes;
+static u64 zswap_stored_pages;
+static u64 zswap_load_hits;
+static u64 zswap_load_misses;
+static u64 zswap_written_back_pages;
+static u64 zswap_pool_limit_hit;
+static u64 zswap_reject_compress_poor;
+static u64 zswap_reject_alloc_fail;
+static u64 zswap_duplicate_entry;
+
+static bool zswap_is_full(void)
+{
+	return zswap_pool_bytes >> PAGE_SHIFT >
+		totalram_pages * zswap_max_pool_percent / 100;
+}
+
+static struct zswap_entry *zswap_search(unsigned type, pgoff_t offset)
+{
+	struct rb_node *node = zswap_trees[type].rb_node;
+	struct zswap_entry *entry;
+
+	while (node) {
+		entry = rb_entry(node, struct zswap_entry, rbnode);
+		if (offset < entry->offset)
+			node = node->rb_left;
+		else if (offset > entry->offset)
+			node = node->rb_right;
+		else
+			return entry;
+	}
+	return NULL;
+}
+
+/* Returns the entry @entry replaces, if any */
+static struct zswap_entry *zswap_insert(struct zswap_entry *entry)
+{
+	struct rb_root *root = &zswap_trees[entry->type];
+	struct rb_node **link = &root->rb_node, *parent = NULL;
+	struct zswap_entry *old;
+
+	while (*link) {
+		parent = *link;
+		old = rb_entry(parent, struct zswap_entry, rbnode);
+		if (entry->offset < old->offset)
+			link = &parent->rb_left;
+		else if (entry->offset > old->offset)
+			link = &parent->rb_right;
+		else {
+			rb_replace_node(parent, &entry->rbnode, root);
+			list_replace(&old->lru, &entry->lru);
+			list_move_tail(&entry->lru, &zswap_lru);
+			return old;
+		}
+	}
+	rb_link_node(&entry->rbnode, parent, link);
+	rb_insert_color(&entry->rbnode, root);
+	list_add_tail(&entry->lru, &zswap_lru);
+	return NULL;
+}
+
+/* Forgets about @entry, the caller frees it once zswap_lock is dropped */
+static void zswap_erase(struct zswap_entry *entry)
+{
+	rb_erase(&entry->rbnode, &zswap_trees[entry->type]);
+	list_del(&entry->lru);
+	zswap_pool_bytes -= ksize(entry);
+	zswap_stored_pages--;
+}
+
+static void zswap_decompress(struct zswap_entry *entry, struct page *page)
+{
+	size_t dlen = PAGE_SIZE;
+	unsigned char *dst;
+	int ret;
+
+	dst = kmap_atomic(page, KM_USER0);
+	ret = lzo1x_decompress_safe(entry->data, entry->length, dst, &dlen);
+	kunmap_atomic(dst, KM_USER0);
+	BUG_ON(ret != LZO_E_OK || dlen != PAGE_SIZE);
+}
+
+/*
+ * Decompress the entry for a swap slot into a new swap cache page and
+ * write that out to the swap device.  Slots that already have a page
+ * in the swap cache are left alone, those pages are in use.
+ */
+static int zswap_writeback_entry(unsigned type, pgoff_t offset)
+{
+	swp_entry_t swpentry = swp_entry(type, offset);
+	struct writeback_control wbc = {
+		.sync_mode = WB_SYNC_NONE,
+	};
+	struct zswap_entry *entry;
+	struct page *page;
+	int err;
+
+	page = alloc_page(GFP_NOIO | __GFP_NOWARN);
+	if (!page)
+		return -ENOMEM;
+
+	/* fails if the slot is in the swap cache or has been freed */
+	err = swapcache_prepare(swpentry);
+	if (err)
+		goto out;
+
+	__set_page_locked(page);
+	SetPageSwapBacked(page);
+	err = add_to_swap_cache(page, swpentry, GFP_NOIO);
+	if (err) {
+		ClearPageSwapBacked(page);
+		__clear_page_locked(page);
+		swapcache_free(swpentry, NULL);
+		goto out;
+	}
+	lru_cache_add_anon(page);
+
+	spin_lock(&zswap_lock);
+	entry = zswap_search(type, offset);
+	if (entry) {
+		zswap_decompress(entry, page);
+		zswap_erase(entry);
+		zswap_written_back_pages++;
+	}
+	spin_unlock(&zswap_lock);
+
+	if (!entry) {
+		/* the slot was reused meanwhile, and went to the device */
+		swap_readpage(page);
+		err = -ENOENT;
+		goto out;
+	}
+	kfree(entry);
+
+	SetPageUptodate(page);
+	/* nobody asked for it: have reclaim drop it once it's written */
+	SetPageReclaim(page);
+	__swap_writepage(page, &wbc);
+out:
+	page_cache_release(page);
+	return err;
+}
+
+static void zswap_shrink(void)
+{
+	struct zswap_entry *entry;
+	unsigned type;
+	pgoff_t offset;
+	int i;
+
+	for (i = 0; i < ZSWAP_WRITEBACK_BATCH && zswap_is_full(); i++) {
+		spin_lock(&zswap_lock);
+		if (list_empty(&zswap_lru)) {
+			spin_unlock(&zswap_lock);
+			break;
+		}
+		entry = list_first_entry(&zswap_lru, struct zswap_entry, lru);
+		/* if it can't be written back now, try the next one next time */
+		list_move_tail(&entry->lru, &zswap_lru);
+		type = entry->type;
+		offset = entry->offset;
+		spin_unlock(&zswap_lock);
+
+		zswap_writeback_entry(type, offset);
+	}
+}
+
+static int __zswap_store(struct page *page)
+{
+	swp_entry_t swpentry = { .val = page_private(page) };
+	struct zswap_entry *entry, *old;
+	unsigned char *src, *dst;
+	size_t dlen;
+	int ret;
+
+	if (!zswap_enabled || !zswap_ready)
+		return -ENODEV;
+
+	if (zswap_is_full()) {
+		spin_lock(&zswap_lock);
+		zswap_pool_limit_hit++;
+		spin_unlock(&zswap_lock);
+		zswap_shrink();
+		if (zswap_is_full())
+			return -ENOMEM;
+	}
+
+	dst = get_cpu_var(zswap_dstmem);
+	src = kmap_atomic(page, KM_USER0);
+	ret = lzo1x_1_compress(src, PAGE_SIZE, dst, &dlen,
+			       __get_cpu_var(zswap_wrkmem));
+	kunmap_atomic(src, KM_USER0);
+
+	if (ret != LZO_E_OK ||
+	    sizeof(*entry) + dlen > ZSWAP_MAX_ENTRY_SIZE) {
+		put_cpu_var(zswap_dstmem);
+		spin_lock(&zswap_lock);
+		zswap_reject_compress_poor++;
+		spin_unlock(&zswap_lock);
+		return -E2BIG;
+	}
+
+	entry = kmalloc(sizeof(*entry) + dlen,
+			GFP_NOWAIT | __GFP_NOWARN | __GFP_NOMEMALLOC);
+	if (entry)
+		memcpy(entry->data, dst, dlen);
+	put_cpu_var(zswap_dstmem);
+
+	spin_lock(&zswap_lock);
+	if (!entry) {
+		zswap_reject_alloc_fail++;
+		spin_unlock(&zswap_lock);
+		return -ENOMEM;
+	}
+	entry->type = swp_type(swpentry);
+	entry->offset = swp_offset(swpentry);
+	entry->length = dlen;
+
+	old = zswap_insert(entry);
+	if (old) {
+		/* the page was loaded, dirtied and is swapped out again */
+		zswap_pool_bytes -= ksize(old);
+		zswap_stored_pages--;
+		zswap_duplicate_entry++;
+	}
+	zswap_pool_bytes += ksize(entry);
+	zswap_stored_pages++;
+	spin_unlock(&zswap_lock);
+
+	kfree(old);
+	return 0;
+}
+
+/*
+ * Called from swap_writepage() with the page locked.  Returns 0 if the
+ * page is now in the pool, and does not have to be written out.
+ */
+int zswap_store(struct page *page)
+{
+	swp_entry_t swpentry = { .val = page_private(page) };
+	int ret;
+
+	ret = __zswap_store(page);
+	/*
+	 * The page goes to the swap device instead.  If it was loaded from
+	 * the pool earlier, the pool has an older copy of it: drop that.
+	 */
+	if (ret)
+		zswap_invalidate_page(swp_type(swpentry), swp_offset(swpentry));
+	return ret;
+}
+
+/*
+ * Called from swap_readpage() with the page locked.  Returns 0 if the
+ * page was filled from the pool.
+ */
+int zswap_load(struct page *page)
+{
+	swp_entry_t swpentry = { .val = page_private(page) };
+	struct zswap_entry *entry;
+
+	spin_lock(&zswap_lock);
+	entry = zswap_search(swp_type(swpentry), swp_offset(swpentry));
+	if (!entry) {
+		zswap_load_misses++;
+		spin_unlock(&zswap_lock);
+		return -ENOENT;
+	}
+	zswap_decompress(entry, page);
+	list_move_tail(&entry->lru, &zswap_lru);
+	zswap_load_hits++;
+	spin_unlock(&zswap_lock);
+
+	return 0;
+}
+
+/* Called with swap_lock held when a swap slot is freed */
+void zswap_invalidate_page(unsigned type, pgoff_t offset)
+{
+	struct zswap_entry *entry;
+
+	spin_lock(&zswap_lock);
+	entry = zswap_search(type, offset);
+	if (entry)
+		zswap_erase(entry);
+	spin_unlock(&zswap_lock);
+
+	kfree(entry);
+}
+
+/* Called on swapoff, once all the slots of @type have been freed */
+void zswap_invalidate_area(unsigned type)
+{
+	struct zswap_entry *entry;
+	struct rb_node *node;
+
+	spin_lock(&zswap_lock);
+	while ((node = rb_first(&zswap_trees[type]))) {
+		entry = rb_entry(node, struct zswap_entry, rbnode);
+		zswap_erase(entry);
+		kfree(entry);
+	}
+	spin_unlock(&zswap_lock);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int zswap_hit_percent_get(void *data, u64 *val)
+{
+	u64 loads;
+
+	spin_lock(&zswap_lock);
+	loads = zswap_load_hits + zswap_load_misses;
+	*val = loads ? div64_u64(zswap_load_hits * 100, loads) : 0;
+	spin_unlock(&zswap_lock);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(zswap_hit_percent_fops, zswap_hit_percent_get,
+			NULL, "%llu\n");
+
+static int __init zswap_debugfs_init(void)
+{
+	struct dentry *root;
+
+	root = debugfs_create_dir("zswap", NULL);
+	if (!root)
+		return -ENOMEM;
+
+	debugfs_create_u64("pool_bytes", 0444, root, &zswap_pool_bytes);
+	debugfs_create_u64("stored_pages", 0444, root, &zswap_stored_pages);
+	debugfs_create_u64("load_hits", 0444, root, &zswap_load_hits);
+	debugfs_create_u64("load_misses", 0444, root, &zswap_load_misses);
+	debugfs_create_file("load_hit_percent", 0444, root, NULL,
+			    &zswap_hit_percent_fops);
+	debugfs_create_u64("written_back_pages", 0444, root,
+			   &zswap_written_back_pages);
+	debugfs_create_u64("pool_limit_hit", 0444, root,
+			   &zswap_pool_limit_hit);
+	debugfs_create_u64("reject_compress_poor", 0444, root,
+			   &zswap_reject_compress_poor);
+	debugfs_create_u64("reject_alloc_fail", 0444, root,
+			   &zswap_reject_alloc_fail);
+	debugfs_create_u64("duplicate_entry", 0444, root,
+			   &zswap_duplicate_entry);
+	return 0;
+}
+#else
+static int __init zswap_debugfs_init(void)
+{
+	return 0;
+}
+#endif
+
+static int __init zswap_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		/* LZO may expand incompressible data a little */
+		per_cpu(zswap_dstmem, cpu) =
+			kmalloc(lzo1x_worst_compress(PAGE_SIZE), GFP_KERNEL);
+		per_cpu(zswap_wrkmem, cpu) =
+			kmalloc(LZO1X_1_MEM_COMPRESS, GFP_KERNEL);
+		if (!per_cpu(zswap_dstmem, cpu) || !per_cpu(zswap_wrkmem, cpu))
+			goto nomem;
+	}
+
+	zswap_debugfs_init();
+	zswap_ready = true;
+	return 0;
+
+nomem:
+	for_each_possible_cpu(cpu) {
+		kfree(per_cpu(zswap_dstmem, cpu));
+		kfree(per_cpu(zswap_wrkmem, cpu));
+		per_cpu(zswap_dstmem, cpu) = NULL;
+		per_cpu(zswap_wrkmem, cpu) = NULL;
+	}
+	return -ENOMEM;
+}
+module_init(zswap_init);
@@ -3,7 +3,16 @@
 
 extern int bench_sched_messaging(int argc, const char **argv, const char *prefix);
 extern int bench_sched_pipe(int argc, const char **argv, const char *prefix);
+extern int bench_sched_wakeup(int argc, const char **argv, const char *prefix);
+extern int bench_sched_jitter(int argc, const char **argv, const char *prefix);
 extern int bench_mem_memcpy(int argc, const char **argv, const char *prefix __used);
+extern int bench_mem_pagefault(int argc, const char **argv, const char *prefix);
+extern int bench_mem_tlb(int argc, const char **argv, const char *prefix);
+extern int bench_mem_lru(int argc, const char **argv, const char *prefix);
+extern int bench_mem_dirty(int argc, const char **argv, const char *prefix);
+extern int bench_mem_compact(int argc, const char **argv, const char *prefix);
+extern int bench_futex_hash(int argc, const char **argv, const char *prefix);
+extern int bench_timer_storm(int argc, const char **argv, const char *prefix);
 
 #define BENCH_FORMAT_DEFAULT_STR	"default"
 #define BENCH_FORMAT_DEFAULT		0
@@ -0,0 +1,176 @@
+/*
+ *
+ * futex-hash.c
+ *
+ * hash: Benchmark for futex hash bucket contention between processes
+ *
+ * Several independent multithreaded processes hammer on their own private
+ * futexes with FUTEX_WAIT calls that fail straight away because the futex
+ * value does not match. Each call still has to hash the futex and take the
+ * hash bucket lock, so the result is dominated by bucket lock contention,
+ * and by whether unrelated processes share the buckets.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <assert.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+static unsigned int nprocs = 4;
+static unsigned int nthreads = 4;
+static unsigned int nfutexes = 64;
+static unsigned int loops = 100000;
+static bool shared;
+
+static const struct option options[] = {
+	OPT_UINTEGER('p', "processes", &nprocs,
+		     "Specify number of processes"),
+	OPT_UINTEGER('t', "threads", &nthreads,
+		     "Specify number of threads per process"),
+	OPT_UINTEGER('f', "futexes", &nfutexes,
+		     "Specify number of futexes per thread"),
+	OPT_UINTEGER('l', "loop", &loops,
+		     "Specify number of futex operations per thread"),
+	OPT_BOOLEAN('S', "shared", &shared,
+		    "Use shared futexes instead of private ones"),
+	OPT_END()
+};
+
+static const char * const bench_futex_hash_usage[] = {
+	"perf bench futex hash <options>",
+	NULL
+};
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static void *worker(void *arg __used)
+{
+	int op = FUTEX_WAIT | (shared ? 0 : FUTEX_PRIVATE_FLAG);
+	unsigned int i;
+	u32 *futexes;
+
+	futexes = calloc(nfutexes, sizeof(*futexes));
+	if (!futexes)
+		barf("calloc");
+
+	/* the futex words are 0, so every wait returns EWOULDBLOCK */
+	for (i = 0; i < loops; i++)
+		syscall(SYS_futex, &futexes[i % nfutexes], op, 1,
+			NULL, NULL, 0);
+
+	free(futexes);
+	return NULL;
+}
+
+static void process(int startfd)
+{
+	pthread_t *threads;
+	unsigned int i;
+	char dummy;
+
+	threads = calloc(nthreads, sizeof(*threads));
+	if (!threads)
+		barf("calloc");
+
+	/* wait for the parent to close the pipe: everybody starts together */
+	if (read(startfd, &dummy, 1) < 0)
+		barf("read");
+
+	for (i = 0; i < nthreads; i++)
+		if (pthread_create(&threads[i], NULL, worker, NULL))
+			barf("pthread_create");
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	exit(0);
+}
+
+int bench_futex_hash(int argc, const char **argv,
+		     const char *prefix __used)
+{
+	struct timeval start, stop, diff;
+	unsigned long long ops, usecs;
+	unsigned int i;
+	int startfds[2], wait_stat;
+	pid_t pid;
+
+	argc = parse_options(argc, argv, options,
+			     bench_futex_hash_usage, 0);
+
+	if (!nprocs || !nthreads || !nfutexes)
+		usage_with_options(bench_futex_hash_usage, options);
+
+	if (pipe(startfds))
+		barf("pipe");
+
+	for (i = 0; i < nprocs; i++) {
+		pid = fork();
+		if (pid < 0)
+			barf("fork");
+		if (!pid) {
+			close(startfds[1]);
+			process(startfds[0]);
+		}
+	}
+	close(startfds[0]);
+
+	gettimeofday(&start, NULL);
+	close(startfds[1]);
+
+	for (i = 0; i < nprocs; i++) {
+		pid = wait(&wait_stat);
+		assert(pid > 0 && WIFEXITED(wait_stat));
+	}
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	ops = (unsigned long long)nprocs * nthreads * loops;
+	usecs = diff.tv_sec * 1000000ULL + diff.tv_usec;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %u processes x %u threads, %u %s futexes per thread\n\n",
+		       nprocs, nthreads, nfutexes,
+		       shared ? "shared" : "private");
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec, (unsigned long) (diff.tv_usec / 1000));
+		printf(" %14lf usecs/op\n", (double)usecs / (double)ops);
+		printf(" %14llu ops/sec\n",
+		       usecs ? ops * 1000000ULL / usecs : 0);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n", diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
@@ -0,0 +1,235 @@
+/*
+ *
+ * mem-compact.c
+ *
+ * compact: High-order allocation latency with fragmented free memory
+ *
+ * The suite maps and touches a large anonymous region, then frees every
+ * other page of it so that free memory is left in single pages pinned
+ * apart by movable ones.  It then times high-order kernel allocations:
+ * each probe sends a datagram over an AF_UNIX socket pair, whose buffer
+ * the kernel allocates in one piece, rounded up to a power of two pages.
+ * Those allocations either find a free block kcompactd has prepared
+ * ahead of demand, or stall in direct compaction.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+
+static unsigned int size_mb;
+static unsigned int alloc_kb = 60;
+static unsigned int nr_allocs = 1000;
+static unsigned int wait_secs;
+
+static const struct option options[] = {
+	OPT_UINTEGER('s', "size", &size_mb,
+		     "Specify memory to fragment in MB"),
+	OPT_UINTEGER('a', "alloc", &alloc_kb,
+		     "Specify size of each allocation in KB"),
+	OPT_UINTEGER('n', "nr", &nr_allocs,
+		     "Specify number of allocations"),
+	OPT_UINTEGER('w', "wait", &wait_secs,
+		     "Specify seconds to wait after fragmenting"),
+	OPT_END()
+};
+
+static const char * const bench_mem_compact_usage[] = {
+	"perf bench mem compact <options>",
+	NULL
+};
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static unsigned long memfree_mb(void)
+{
+	char line[128];
+	unsigned long kb = 0;
+	FILE *f;
+
+	f = fopen("/proc/meminfo", "r");
+	if (!f)
+		barf("open /proc/meminfo");
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "MemFree: %lu kB", &kb) == 1)
+			break;
+	fclose(f);
+	return kb / 1024;
+}
+
+static long long vmstat_read(const char *name)
+{
+	char key[64];
+	long long val, ret = -1;
+	FILE *f;
+
+	f = fopen("/proc/vmstat", "r");
+	if (!f)
+		return -1;
+	while (fscanf(f, "%63s %lld", key, &val) == 2) {
+		if (!strcmp(key, name)) {
+			ret = val;
+			break;
+		}
+	}
+	fclose(f);
+	return ret;
+}
+
+/* the highest fragmentation score of all nodes, -1 without /proc/fragscore */
+static int fragscore_read(void)
+{
+	char line[128];
+	unsigned int score;
+	int ret = -1;
+	FILE *f;
+
+	f = fopen("/proc/fragscore", "r");
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "Node %*d, score %u", &score) == 1 &&
+		    (int)score > ret)
+			ret = score;
+	fclose(f);
+	return ret;
+}
+
+/* leave free memory in single pages between pages still in use */
+static void *fragment(size_t len)
+{
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	size_t off;
+	char *p;
+
+	p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		barf("mmap");
+	for (off = 0; off < len; off += page_size)
+		p[off] = 1;
+	for (off = page_size; off < len; off += 2 * page_size)
+		if (madvise(p + off, page_size, MADV_DONTNEED))
+			barf("madvise");
+	return p;
+}
+
+int bench_mem_compact(int argc, const char **argv, const char *prefix __used)
+{
+	unsigned long long usecs, total_usecs = 0, max_usecs = 0;
+	long long stall, wake, proactive;
+	struct timeval start, stop, diff;
+	int score_before, score_after;
+	int sv[2], bufsize;
+	unsigned int i;
+	size_t len;
+	char *buf;
+	void *p;
+
+	argc = parse_options(argc, argv, options, bench_mem_compact_usage, 0);
+
+	if (!alloc_kb || !nr_allocs)
+		usage_with_options(bench_mem_compact_usage, options);
+	if (!size_mb)
+		size_mb = memfree_mb() * 3 / 4;
+
+	len = alloc_kb * 1024UL;
+	buf = malloc(len);
+	if (!buf)
+		barf("malloc");
+	memset(buf, 0, len);
+
+	if (socketpair(AF_UNIX, SOCK_DGRAM, 0, sv))
+		barf("socketpair");
+	bufsize = 2 * len;
+	if (setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF,
+		       &bufsize, sizeof(bufsize)) ||
+	    setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF,
+		       &bufsize, sizeof(bufsize)))
+		barf("setsockopt");
+
+	p = fragment(size_mb * 1024UL * 1024UL);
+	score_before = fragscore_read();
+	if (wait_secs)
+		sleep(wait_secs);
+	score_after = fragscore_read();
+
+	stall = vmstat_read("compact_stall");
+	wake = vmstat_read("compact_daemon_wake");
+	proactive = vmstat_read("compact_daemon_proactive");
+
+	for (i = 0; i < nr_allocs; i++) {
+		gettimeofday(&start, NULL);
+		if (send(sv[0], buf, len, 0) != (ssize_t)len)
+			barf("send (try a smaller --alloc)");
+		gettimeofday(&stop, NULL);
+		if (recv(sv[1], buf, len, 0) != (ssize_t)len)
+			barf("recv");
+
+		timersub(&stop, &start, &diff);
+		usecs = diff.tv_sec * 1000000ULL + diff.tv_usec;
+		total_usecs += usecs;
+		if (usecs > max_usecs)
+			max_usecs = usecs;
+	}
+
+	if (stall >= 0)
+		stall = vmstat_read("compact_stall") - stall;
+	if (wake >= 0)
+		wake = vmstat_read("compact_daemon_wake") - wake;
+	if (proactive >= 0)
+		proactive = vmstat_read("compact_daemon_proactive") - proactive;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Fragmented %u MB, %u allocations of %u KB\n",
+		       size_mb, nr_allocs, alloc_kb);
+		if (score_before >= 0)
+			printf("# Fragmentation score %d, %d after %u sec\n",
+			       score_before, score_after, wait_secs);
+		printf("\n");
+		printf(" %14lf usecs/alloc on average\n",
+		       (double)total_usecs / nr_allocs);
+		printf(" %14llu usecs at most\n", max_usecs);
+		if (stall >= 0)
+			printf(" %14lld compaction stalls\n", stall);
+		if (wake >= 0)
+			printf(" %14lld kcompactd wakeups\n", wake);
+		if (proactive >= 0)
+			printf(" %14lld kcompactd proactive rounds\n",
+			       proactive);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf\n", (double)total_usecs / nr_allocs);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	munmap(p, size_mb * 1024UL * 1024UL);
+	close(sv[0]);
+	close(sv[1]);
+	free(buf);
+	return 0;
+}
@@ -0,0 +1,254 @@
+/*
+ *
+ * mem-dirty.c
+ *
+ * dirty: Two tenants dirtying page cache, a heavy and a light writer
+ *
+ * The heavy writer streams a large file through the page cache as fast
+ * as write() lets it.  The light writer meanwhile writes a small chunk
+ * to a file of its own every few milliseconds, and the suite reports how
+ * long those writes took: when the heavy writer fills the page cache up
+ * to the dirty limits, balance_dirty_pages() stalls the light writer as
+ * well.  Give each of them a memory cgroup directory (--heavy-cgroup,
+ * --light-cgroup) with its own memory.dirty_ratio or memory.dirty_bytes
+ * to have the heavy one throttled against its own limits instead.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+static const char *path = "perf-bench-dirty";
+static const char *heavy_cgroup;
+static const char *light_cgroup;
+static unsigned int heavy_mb = 1024;
+static unsigned int light_kb = 64;
+static unsigned int interval_ms = 10;
+
+static const struct option options[] = {
+	OPT_STRING('p', "path", &path, "prefix",
+		   "Specify the prefix of the data files to create"),
+	OPT_UINTEGER('s', "size", &heavy_mb,
+		     "Specify data written by the heavy writer in MB"),
+	OPT_UINTEGER('l', "light", &light_kb,
+		     "Specify size of each write of the light writer in KB"),
+	OPT_UINTEGER('i', "interval", &interval_ms,
+		     "Specify milliseconds between two writes of the light writer"),
+	OPT_STRING('H', "heavy-cgroup", &heavy_cgroup, "dir",
+		   "Specify memory cgroup directory of the heavy writer"),
+	OPT_STRING('L', "light-cgroup", &light_cgroup, "dir",
+		   "Specify memory cgroup directory of the light writer"),
+	OPT_END()
+};
+
+static const char * const bench_mem_dirty_usage[] = {
+	"perf bench mem dirty <options>",
+	NULL
+};
+
+/* shared with the two writers */
+struct results {
+	unsigned long long heavy_usecs;
+	unsigned long long light_writes;
+	unsigned long long light_total_usecs;
+	unsigned long long light_max_usecs;
+	unsigned long long light_slow;		/* writes over 100ms */
+	volatile int heavy_done;
+};
+
+static struct results *res;
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static unsigned long long usecs_since(struct timeval *start)
+{
+	struct timeval now, diff;
+
+	gettimeofday(&now, NULL);
+	timersub(&now, start, &diff);
+	return diff.tv_sec * 1000000ULL + diff.tv_usec;
+}
+
+/* move the calling process into the memory cgroup directory @dir */
+static void enter_cgroup(const char *dir)
+{
+	char name[PATH_MAX], pid[32];
+	int fd, len;
+
+	if (!dir)
+		return;
+	snprintf(name, sizeof(name), "%s/tasks", dir);
+	fd = open(name, O_WRONLY);
+	if (fd < 0)
+		barf("open tasks");
+	len = snprintf(pid, sizeof(pid), "%d\n", getpid());
+	if (write(fd, pid, len) != len)
+		barf("write tasks");
+	close(fd);
+}
+
+static int open_data(const char *suffix)
+{
+	char name[PATH_MAX];
+	int fd;
+
+	snprintf(name, sizeof(name), "%s.%s", path, suffix);
+	fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0)
+		barf("open");
+	unlink(name);
+	return fd;
+}
+
+static void heavy_writer(void)
+{
+	size_t chunk = 1024 * 1024;
+	struct timeval start;
+	unsigned int i;
+	char *buf;
+	int fd;
+
+	enter_cgroup(heavy_cgroup);
+	fd = open_data("heavy");
+	buf = malloc(chunk);
+	if (!buf)
+		barf("malloc");
+	memset(buf, 0x5a, chunk);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < heavy_mb; i++)
+		if (write(fd, buf, chunk) != (ssize_t)chunk)
+			barf("write");
+	res->heavy_usecs = usecs_since(&start);
+	res->heavy_done = 1;
+	close(fd);
+	exit(0);
+}
+
+static void light_writer(void)
+{
+	size_t len = light_kb * 1024UL;
+	unsigned long long usecs;
+	struct timeval start;
+	off_t off = 0;
+	char *buf;
+	int fd;
+
+	enter_cgroup(light_cgroup);
+	fd = open_data("light");
+	buf = malloc(len);
+	if (!buf)
+		barf("malloc");
+	memset(buf, 0xa5, len);
+
+	while (!res->heavy_done) {
+		gettimeofday(&start, NULL);
+		/* overwrite the same 16 chunks, its dirty set stays small */
+		if (pwrite(fd, buf, len, off) != (ssize_t)len)
+			barf("pwrite");
+		usecs = usecs_since(&start);
+		off = (off + len) % (16 * len);
+
+		res->light_writes++;
+		res->light_total_usecs += usecs;
+		if (usecs > res->light_max_usecs)
+			res->light_max_usecs = usecs;
+		if (usecs > 100000)
+			res->light_slow++;
+		usleep(interval_ms * 1000);
+	}
+	close(fd);
+	exit(0);
+}
+
+int bench_mem_dirty(int argc, const char **argv, const char *prefix __used)
+{
+	pid_t heavy, light;
+	int status;
+
+	argc = parse_options(argc, argv, options, bench_mem_dirty_usage, 0);
+
+	if (!heavy_mb || !light_kb)
+		usage_with_options(bench_mem_dirty_usage, options);
+
+	res = mmap(NULL, sizeof(*res), PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (res == MAP_FAILED)
+		barf("mmap");
+	memset(res, 0, sizeof(*res));
+
+	light = fork();
+	if (light < 0)
+		barf("fork");
+	if (!light)
+		light_writer();
+	heavy = fork();
+	if (heavy < 0)
+		barf("fork");
+	if (!heavy)
+		heavy_writer();
+
+	if (waitpid(heavy, &status, 0) < 0)
+		barf("waitpid");
+	if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+		kill(light, SIGKILL);
+		fprintf(stderr, "heavy writer failed\n");
+		exit(1);
+	}
+	/* in case it failed before writing anything */
+	res->heavy_done = 1;
+	if (waitpid(light, &status, 0) < 0)
+		barf("waitpid");
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# heavy writer: %u MB, light writer: %u KB every %u ms\n",
+		       heavy_mb, light_kb, interval_ms);
+		printf("# cgroups: %s, %s\n\n",
+		       heavy_cgroup ? heavy_cgroup : "(current)",
+		       light_cgroup ? light_cgroup : "(current)");
+		printf(" %14s: %llu.%03llu [sec]\n", "Heavy writer",
+		       res->heavy_usecs / 1000000,
+		       res->heavy_usecs % 1000000 / 1000);
+		printf(" %14lf MB/sec\n\n", res->heavy_usecs ?
+		       heavy_mb * 1000000.0 / res->heavy_usecs : 0.0);
+		printf(" %14llu light writes\n", res->light_writes);
+		printf(" %14lf usecs/write on average\n", res->light_writes ?
+		       (double)res->light_total_usecs / res->light_writes :
+		       0.0);
+		printf(" %14llu usecs at most\n", res->light_max_usecs);
+		printf(" %14llu writes over 100ms\n", res->light_slow);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%llu\n", res->light_max_usecs);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	munmap(res, sizeof(*res));
+	return 0;
+}
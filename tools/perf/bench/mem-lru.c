@@ -0,0 +1,294 @@
+/*
+ *
+ * mem-lru.c
+ *
+ * lru: Replay of application switches under memory pressure
+ *
+ * A number of simulated applications each own a slice of a data file,
+ * mapped and read, and an anonymous heap, written once and read after
+ * that.  Every round switches through all of them in turn, and between
+ * two switches a stream of file data that is read only once goes through
+ * the page cache.  With the working sets of all applications together
+ * larger than memory, the suite counts the pages of an application that
+ * were reclaimed by the time it is switched back to (refaults), and the
+ * CPU time kswapd needed meanwhile.  Run it once per reclaim policy in a
+ * machine with little memory (a QEMU guest with mem=), switching between
+ * them with /sys/kernel/mm/lru_gen/enabled on a kernel with
+ * CONFIG_LRU_GEN.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+static const char *path = "perf-bench-lru.dat";
+static unsigned int nr_apps = 4;
+static unsigned int file_mb = 32;
+static unsigned int anon_mb = 32;
+static unsigned int stream_mb = 16;
+static unsigned int rounds = 10;
+
+static const struct option options[] = {
+	OPT_STRING('p', "path", &path, "file",
+		   "Specify the data file to create"),
+	OPT_UINTEGER('n', "apps", &nr_apps,
+		     "Specify number of applications"),
+	OPT_UINTEGER('f', "file", &file_mb,
+		     "Specify file working set of each application in MB"),
+	OPT_UINTEGER('a', "anon", &anon_mb,
+		     "Specify anonymous working set of each application in MB"),
+	OPT_UINTEGER('s', "stream", &stream_mb,
+		     "Specify file data streamed between two switches in MB"),
+	OPT_UINTEGER('r', "rounds", &rounds,
+		     "Specify number of rounds through all applications"),
+	OPT_END()
+};
+
+static const char * const bench_mem_lru_usage[] = {
+	"perf bench mem lru <options>",
+	NULL
+};
+
+struct app {
+	char *file;
+	char *anon;
+};
+
+static size_t page_size;
+static unsigned char *vec;
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+/* pages of [addr, addr + len) that are not resident */
+static unsigned long count_missing(char *addr, size_t len)
+{
+	size_t i, npages = len / page_size;
+	unsigned long missing = 0;
+
+	if (mincore(addr, len, vec))
+		barf("mincore");
+	for (i = 0; i < npages; i++)
+		if (!(vec[i] & 1))
+			missing++;
+	return missing;
+}
+
+static unsigned long touch(char *addr, size_t len)
+{
+	unsigned long sum = 0;
+	size_t off;
+
+	for (off = 0; off < len; off += page_size)
+		sum += *(volatile char *)(addr + off);
+	return sum;
+}
+
+/* user plus system time of all kswapd threads, in clock ticks */
+static unsigned long long kswapd_ticks(void)
+{
+	unsigned long long total = 0;
+	unsigned long utime, stime;
+	char name[64], buf[512], *p;
+	struct dirent *d;
+	DIR *proc;
+	FILE *f;
+
+	proc = opendir("/proc");
+	if (!proc)
+		return 0;
+	while ((d = readdir(proc)) != NULL) {
+		if (d->d_name[0] < '0' || d->d_name[0] > '9')
+			continue;
+		snprintf(name, sizeof(name), "/proc/%s/stat", d->d_name);
+		f = fopen(name, "r");
+		if (!f)
+			continue;
+		if (fgets(buf, sizeof(buf), f) && strstr(buf, "(kswapd")) {
+			/* skip state and the 10 fields up to utime */
+			p = strrchr(buf, ')');
+			if (p && sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u "
+					"%*u %*u %*u %*u %lu %lu",
+					&utime, &stime) == 2)
+				total += utime + stime;
+		}
+		fclose(f);
+	}
+	closedir(proc);
+	return total;
+}
+
+static const char *lru_policy(void)
+{
+	char buf[16] = "";
+	FILE *f;
+
+	f = fopen("/sys/kernel/mm/lru_gen/enabled", "r");
+	if (!f)
+		return "active/inactive";
+	if (!fgets(buf, sizeof(buf), f))
+		buf[0] = '0';
+	fclose(f);
+	return buf[0] == '1' ? "multi-generational" : "active/inactive";
+}
+
+int bench_mem_lru(int argc, const char **argv, const char *prefix __used)
+{
+	struct timeval start, stop, diff;
+	unsigned long long ticks;
+	unsigned long file_refaults = 0, anon_refaults = 0;
+	unsigned long checked = 0, sum = 0;
+	size_t file_len, anon_len, stream_len, total_len, off;
+	size_t stream_off = 0;
+	unsigned int i, r;
+	struct app *apps;
+	char *buf;
+	char *map;
+	int fd;
+
+	argc = parse_options(argc, argv, options, bench_mem_lru_usage, 0);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	file_len = file_mb * 1024UL * 1024UL;
+	anon_len = anon_mb * 1024UL * 1024UL;
+	stream_len = stream_mb * 1024UL * 1024UL;
+	if (!nr_apps || !rounds || (!file_len && !anon_len))
+		usage_with_options(bench_mem_lru_usage, options);
+
+	vec = malloc((file_len > anon_len ? file_len : anon_len) /
+		     page_size + 1);
+	apps = calloc(nr_apps, sizeof(*apps));
+	buf = malloc(page_size);
+	if (!vec || !apps || !buf)
+		barf("malloc");
+
+	/* the working sets first, then four rounds worth of stream */
+	total_len = nr_apps * file_len + 4 * stream_len;
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0)
+		barf("open");
+	memset(buf, 0x5a, page_size);
+	for (off = 0; off < total_len; off += page_size)
+		if (write(fd, buf, page_size) != (ssize_t)page_size)
+			barf("write");
+	if (fsync(fd))
+		barf("fsync");
+
+	map = NULL;
+	if (file_len) {
+		map = mmap(NULL, nr_apps * file_len, PROT_READ, MAP_SHARED,
+			   fd, 0);
+		if (map == MAP_FAILED)
+			barf("mmap");
+	}
+	for (i = 0; i < nr_apps; i++) {
+		if (file_len)
+			apps[i].file = map + i * file_len;
+		if (!anon_len)
+			continue;
+		apps[i].anon = mmap(NULL, anon_len, PROT_READ | PROT_WRITE,
+				    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (apps[i].anon == MAP_FAILED)
+			barf("mmap");
+	}
+
+	ticks = kswapd_ticks();
+	gettimeofday(&start, NULL);
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < nr_apps; i++) {
+			struct app *app = &apps[i];
+
+			/* the first round only faults the working sets in */
+			if (r) {
+				if (file_len)
+					file_refaults += count_missing(app->file,
+								       file_len);
+				if (anon_len)
+					anon_refaults += count_missing(app->anon,
+								       anon_len);
+				checked += (file_len + anon_len) / page_size;
+			}
+
+			if (file_len)
+				sum += touch(app->file, file_len);
+			if (anon_len && !r)
+				memset(app->anon, i + 1, anon_len);
+			else if (anon_len)
+				sum += touch(app->anon, anon_len);
+
+			/* data read once, in between */
+			for (off = 0; off < stream_len; off += page_size) {
+				if (pread(fd, buf, page_size, nr_apps * file_len +
+					  stream_off) != (ssize_t)page_size)
+					barf("pread");
+				stream_off = (stream_off + page_size) %
+					     (4 * stream_len);
+			}
+		}
+	}
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	ticks = kswapd_ticks() - ticks;
+
+	/* keep the reads from being optimized away */
+	if (!sum && file_len)
+		fprintf(stderr, "read nothing but zeroes\n");
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %u applications, %u MB file and %u MB anon each, "
+		       "%u MB streamed per switch\n",
+		       nr_apps, file_mb, anon_mb, stream_mb);
+		printf("# %u rounds, %s LRU\n\n", rounds, lru_policy());
+		printf(" %14s: %lu.%03lu [sec]\n", "Total time",
+		       diff.tv_sec, (unsigned long) (diff.tv_usec / 1000));
+		printf(" %14s: %llu.%02llu [sec]\n", "kswapd time",
+		       ticks / sysconf(_SC_CLK_TCK),
+		       ticks % sysconf(_SC_CLK_TCK) * 100 /
+		       sysconf(_SC_CLK_TCK));
+		printf(" %14s: %lu file, %lu anon pages\n", "Refaults",
+		       file_refaults, anon_refaults);
+		printf(" %14lf %% of the working sets refaulted\n\n",
+		       checked ? 100.0 * (file_refaults + anon_refaults) /
+		       checked : 0.0);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu\n", file_refaults + anon_refaults);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	for (i = 0; i < nr_apps; i++)
+		if (anon_len)
+			munmap(apps[i].anon, anon_len);
+	if (map)
+		munmap(map, nr_apps * file_len);
+	close(fd);
+	unlink(path);
+	free(apps);
+	free(buf);
+	free(vec);
+	return 0;
+}
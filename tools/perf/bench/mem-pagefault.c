@@ -0,0 +1,229 @@
+/*
+ *
+ * mem-pagefault.c
+ *
+ * pagefault: Benchmark for page faults of threads sharing one mm
+ *
+ * Every thread maps a private anonymous region, writes to each page of
+ * it and unmaps it again, over and over. The faults take mmap_sem for
+ * reading while the mmap() and munmap() calls of the other threads take
+ * it for writing, so with a few threads the result mostly measures how
+ * well mmap_sem copes with that mix of readers and writers.
+ *
+ * With --mappers, more threads keep mapping and unmapping small regions
+ * of their own meanwhile, never touching them, as allocators do.  Those
+ * take mmap_sem for writing only, which on a kernel with speculative page
+ * faults the faults do not wait for; the spf_fault and spf_abort counters
+ * of /proc/vmstat are reported when there are any.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+static unsigned int nthreads;
+static unsigned int size_kb = 4096;
+static unsigned int loops = 100;
+static unsigned int nmappers;
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads,
+		     "Specify number of threads (default: one per CPU)"),
+	OPT_UINTEGER('s', "size", &size_kb,
+		     "Specify size of each mapping in KB"),
+	OPT_UINTEGER('l', "loop", &loops,
+		     "Specify number of mappings per thread"),
+	OPT_UINTEGER('m', "mappers", &nmappers,
+		     "Specify number of threads only calling mmap and munmap"),
+	OPT_END()
+};
+
+static const char * const bench_mem_pagefault_usage[] = {
+	"perf bench mem pagefault <options>",
+	NULL
+};
+
+static size_t page_size;
+static pthread_barrier_t start_barrier;
+static volatile int done;
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static void *worker(void *arg __used)
+{
+	size_t len = size_kb * 1024UL, off;
+	unsigned int i;
+	char *p;
+
+	pthread_barrier_wait(&start_barrier);
+
+	for (i = 0; i < loops; i++) {
+		p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+			barf("mmap");
+
+		/* one fault per page */
+		for (off = 0; off < len; off += page_size)
+			p[off] = 1;
+
+		if (munmap(p, len))
+			barf("munmap");
+	}
+
+	return NULL;
+}
+
+static void *mapper(void *arg)
+{
+	unsigned long *calls = arg;
+	char *p;
+
+	pthread_barrier_wait(&start_barrier);
+
+	while (!done) {
+		p = mmap(NULL, 16 * page_size, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+			barf("mmap");
+		if (munmap(p, 16 * page_size))
+			barf("munmap");
+		(*calls)++;
+	}
+
+	return NULL;
+}
+
+/* a counter of /proc/vmstat, or -1 if there is no such counter */
+static long long vmstat_read(const char *name)
+{
+	char key[64];
+	long long val, ret = -1;
+	FILE *f;
+
+	f = fopen("/proc/vmstat", "r");
+	if (!f)
+		return -1;
+	while (fscanf(f, "%63s %lld", key, &val) == 2) {
+		if (!strcmp(key, name)) {
+			ret = val;
+			break;
+		}
+	}
+	fclose(f);
+	return ret;
+}
+
+int bench_mem_pagefault(int argc, const char **argv,
+			const char *prefix __used)
+{
+	struct timeval start, stop, diff;
+	unsigned long long faults, usecs;
+	long long spf_fault, spf_abort;
+	unsigned long *calls, mapcalls = 0;
+	pthread_t *threads;
+	unsigned int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_mem_pagefault_usage, 0);
+
+	if (!nthreads)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	page_size = sysconf(_SC_PAGESIZE);
+
+	if (!loops || size_kb * 1024UL < page_size)
+		usage_with_options(bench_mem_pagefault_usage, options);
+
+	threads = calloc(nthreads + nmappers, sizeof(*threads));
+	calls = calloc(nmappers + 1, sizeof(*calls));
+	if (!threads || !calls)
+		barf("calloc");
+
+	/* the main thread lets everybody go once they all exist */
+	if (pthread_barrier_init(&start_barrier, NULL,
+				 nthreads + nmappers + 1))
+		barf("pthread_barrier_init");
+
+	for (i = 0; i < nthreads; i++)
+		if (pthread_create(&threads[i], NULL, worker, NULL))
+			barf("pthread_create");
+	for (i = 0; i < nmappers; i++)
+		if (pthread_create(&threads[nthreads + i], NULL, mapper,
+				   &calls[i]))
+			barf("pthread_create");
+
+	spf_fault = vmstat_read("spf_fault");
+	spf_abort = vmstat_read("spf_abort");
+	pthread_barrier_wait(&start_barrier);
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	if (spf_fault >= 0)
+		spf_fault = vmstat_read("spf_fault") - spf_fault;
+	if (spf_abort >= 0)
+		spf_abort = vmstat_read("spf_abort") - spf_abort;
+
+	done = 1;
+	for (i = 0; i < nmappers; i++) {
+		pthread_join(threads[nthreads + i], NULL);
+		mapcalls += calls[i];
+	}
+	pthread_barrier_destroy(&start_barrier);
+
+	faults = (unsigned long long)nthreads * loops *
+		 (size_kb * 1024ULL / page_size);
+	usecs = diff.tv_sec * 1000000ULL + diff.tv_usec;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %u threads x %u mappings of %u KB, %u mappers\n\n",
+		       nthreads, loops, size_kb, nmappers);
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec, (unsigned long) (diff.tv_usec / 1000));
+		printf(" %14lf usecs/fault\n", (double)usecs / (double)faults);
+		printf(" %14llu faults/sec\n",
+		       usecs ? faults * 1000000ULL / usecs : 0);
+		if (nmappers)
+			printf(" %14llu mmap+munmap/sec\n",
+			       usecs ? mapcalls * 1000000ULL / usecs : 0);
+		if (spf_fault >= 0 && spf_abort >= 0)
+			printf(" %14lld speculative, %lld fell back\n",
+			       spf_fault, spf_abort);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n", diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	free(calls);
+	free(threads);
+	return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ *
+ * mem-tlb.c
+ *
+ * tlb: Benchmark for random accesses over a large anonymous area
+ *
+ * Every page of the area holds one pointer to some other page, and the
+ * pointers link all the pages into a single cycle in random order.
+ * Following that cycle is one dependent load per page with no locality
+ * at all, so once the area is larger than the TLB reach almost every
+ * load takes a TLB miss. Compare runs with and without --madvise on a
+ * kernel with large pages for anonymous memory
+ * (CONFIG_LARGE_ANON_PAGES).
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE	14
+#endif
+
+static unsigned int size_mb = 64;
+static unsigned int loops = 10;
+static bool use_madvise;
+
+static const struct option options[] = {
+	OPT_UINTEGER('s', "size", &size_mb,
+		     "Specify size of the area in MB"),
+	OPT_UINTEGER('l', "loop", &loops,
+		     "Specify number of walks over the whole area"),
+	OPT_BOOLEAN('m', "madvise", &use_madvise,
+		    "Ask for large pages with MADV_HUGEPAGE"),
+	OPT_END()
+};
+
+static const char * const bench_mem_tlb_usage[] = {
+	"perf bench mem tlb <options>",
+	NULL
+};
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+int bench_mem_tlb(int argc, const char **argv, const char *prefix __used)
+{
+	struct timeval start, stop, diff;
+	unsigned long long accesses, nsecs;
+	size_t page_size, len, npages, i, j, tmp;
+	size_t *order;
+	unsigned int l;
+	void **p;
+	char *area;
+
+	argc = parse_options(argc, argv, options, bench_mem_tlb_usage, 0);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	len = size_mb * 1024UL * 1024UL;
+	npages = len / page_size;
+	if (!loops || npages < 2)
+		usage_with_options(bench_mem_tlb_usage, options);
+
+	area = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (area == MAP_FAILED)
+		barf("mmap");
+	if (use_madvise && madvise(area, len, MADV_HUGEPAGE))
+		barf("madvise");
+
+	/* a random cyclic permutation of the pages (Sattolo) */
+	order = malloc(npages * sizeof(*order));
+	if (!order)
+		barf("malloc");
+	for (i = 0; i < npages; i++)
+		order[i] = i;
+	srandom(1);
+	for (i = npages - 1; i > 0; i--) {
+		j = random() % i;
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	/* this also faults the whole area in, before the clock starts */
+	for (i = 0; i < npages; i++)
+		*(void **)(area + order[i] * page_size) =
+			area + order[(i + 1) % npages] * page_size;
+	free(order);
+
+	p = (void **)area;
+	gettimeofday(&start, NULL);
+	for (l = 0; l < loops; l++)
+		for (i = 0; i < npages; i++)
+			p = *p;
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	/* keep the walk from being optimized away */
+	if (p != (void **)area)
+		fprintf(stderr, "walk ended at the wrong page\n");
+
+	accesses = (unsigned long long)loops * npages;
+	nsecs = (diff.tv_sec * 1000000ULL + diff.tv_usec) * 1000ULL;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %u walks over %u MB%s\n\n", loops, size_mb,
+		       use_madvise ? " (MADV_HUGEPAGE)" : "");
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec, (unsigned long) (diff.tv_usec / 1000));
+		printf(" %14lf nsecs/access\n",
+		       (double)nsecs / (double)accesses);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n", diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	munmap(area, len);
+	return 0;
+}
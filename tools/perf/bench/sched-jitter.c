@@ -0,0 +1,144 @@
+/*
+ *
+ * sched-jitter.c
+ *
+ * jitter: Benchmark for OS jitter caused by RCU callback processing
+ *
+ * A thread pinned to one CPU alternates between a burst of open()/close()
+ * calls, each of which leaves an RCU callback behind to free the struct
+ * file, and a quiet phase of busy-looping on the clock. Every gap in the
+ * loop longer than the threshold is time the kernel stole from the CPU,
+ * for instance to invoke those callbacks from softirq. Booting with
+ * rcu_nocbs= for that CPU and moving the rcuo kthreads elsewhere should
+ * make most of the gaps go away.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+static int cpu = -1;
+static unsigned int loops = 100;
+static unsigned int nfiles = 1000;
+static unsigned int quiet_usecs = 10000;
+static unsigned int threshold_usecs = 5;
+
+static const struct option options[] = {
+	OPT_INTEGER('c', "cpu", &cpu,
+		    "Specify CPU to measure (default: last online CPU)"),
+	OPT_UINTEGER('l', "loop", &loops,
+		     "Specify number of bursts"),
+	OPT_UINTEGER('f', "files", &nfiles,
+		     "Specify number of files opened and closed per burst"),
+	OPT_UINTEGER('q', "quiet", &quiet_usecs,
+		     "Specify usecs of busy-looping after each burst"),
+	OPT_UINTEGER('t', "threshold", &threshold_usecs,
+		     "Specify shortest gap in usecs counted as an interruption"),
+	OPT_END()
+};
+
+static const char * const bench_sched_jitter_usage[] = {
+	"perf bench sched jitter <options>",
+	NULL
+};
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static unsigned long long now_nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int bench_sched_jitter(int argc, const char **argv,
+		       const char *prefix __used)
+{
+	unsigned long long t, last, end, gap, threshold;
+	unsigned long long stolen = 0, max = 0, hits = 0;
+	cpu_set_t mask;
+	unsigned int i, j;
+	int fd;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_jitter_usage, 0);
+
+	if (!loops || !quiet_usecs)
+		usage_with_options(bench_sched_jitter_usage, options);
+	if (cpu < 0)
+		cpu = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	if (sched_setaffinity(0, sizeof(mask), &mask))
+		barf("sched_setaffinity");
+
+	threshold = threshold_usecs * 1000ULL;
+
+	for (i = 0; i < loops; i++) {
+		/* each close() queues an RCU callback on this CPU */
+		for (j = 0; j < nfiles; j++) {
+			fd = open("/dev/null", O_RDONLY);
+			if (fd < 0)
+				barf("open");
+			close(fd);
+		}
+
+		last = now_nsecs();
+		end = last + quiet_usecs * 1000ULL;
+		do {
+			t = now_nsecs();
+			gap = t - last;
+			if (gap > threshold) {
+				hits++;
+				stolen += gap;
+				if (gap > max)
+					max = gap;
+			}
+			last = t;
+		} while (t < end);
+	}
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# CPU %d, %u bursts of %u files, %u usecs quiet each\n\n",
+		       cpu, loops, nfiles, quiet_usecs);
+		printf(" %14s: %14llu\n", "Interruptions", hits);
+		printf(" %14s: %14.3lf [usec]\n", "Max gap",
+		       (double)max / 1000.0);
+		printf(" %14s: %14.3lf [usec]\n", "Avg gap",
+		       hits ? (double)stolen / 1000.0 / (double)hits : 0.0);
+		printf(" %14s: %14.3lf [%%]\n", "Time stolen",
+		       (double)stolen / 10.0 / ((double)loops * quiet_usecs));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%llu %.3lf\n", hits, (double)max / 1000.0);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
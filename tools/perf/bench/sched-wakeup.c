@@ -0,0 +1,171 @@
+/*
+ *
+ * sched-wakeup.c
+ *
+ * wakeup: Benchmark for interactive wakeup latency under background load
+ *
+ * A sleeper blocks on a pipe while a waker periodically writes a
+ * timestamp into it, the way an interactive task is woken up by input.
+ * Meanwhile a separate session of CPU burners (think "make -j") keeps
+ * every CPU busy. The reported latency is the time between the write
+ * and the sleeper getting to run.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#define LOOPS_DEFAULT		1000
+#define INTERVAL_DEFAULT	1000	/* usecs */
+
+static int loops = LOOPS_DEFAULT;
+static int interval = INTERVAL_DEFAULT;
+static int nr_hogs;
+static bool same_session;
+
+static const struct option options[] = {
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of wakeups"),
+	OPT_INTEGER('i', "interval", &interval,
+		    "Specify usecs between wakeups"),
+	OPT_INTEGER('b', "background", &nr_hogs,
+		    "Specify number of CPU burners (default: 2 per CPU)"),
+	OPT_BOOLEAN('s', "same-session", &same_session,
+		    "Keep the CPU burners in the caller's session"),
+	OPT_END()
+};
+
+static const char * const bench_sched_wakeup_usage[] = {
+	"perf bench sched wakeup <options>",
+	NULL
+};
+
+static void burn(void)
+{
+	for (;;)
+		;
+}
+
+/*
+ * Forks the background load. The burners share one process group so they
+ * can be killed together, and by default one new session, so that they are
+ * accounted as a single entity by session based group scheduling.
+ */
+static pid_t start_background(void)
+{
+	pid_t pid;
+	int i;
+
+	pid = fork();
+	assert(pid >= 0);
+	if (pid)
+		return pid;
+
+	if (same_session)
+		assert(!setpgid(0, 0));
+	else
+		assert(setsid() >= 0);
+
+	for (i = 1; i < nr_hogs; i++) {
+		pid = fork();
+		assert(pid >= 0);
+		if (!pid)
+			break;
+	}
+	burn();
+	return 0;
+}
+
+static unsigned long long tv_usecs(struct timeval *tv)
+{
+	return tv->tv_sec * 1000000ULL + tv->tv_usec;
+}
+
+int bench_sched_wakeup(int argc, const char **argv,
+		       const char *prefix __used)
+{
+	int pipe_1[2], pipe_2[2];
+	struct timeval tv, now;
+	unsigned long long lat, total = 0, max = 0;
+	pid_t bg, pid, retpid;
+	int i, ret, wait_stat;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_wakeup_usage, 0);
+
+	if (nr_hogs <= 0)
+		nr_hogs = 2 * sysconf(_SC_NPROCESSORS_ONLN);
+	if (loops <= 0)
+		loops = LOOPS_DEFAULT;
+
+	assert(!pipe(pipe_1));
+	assert(!pipe(pipe_2));
+
+	bg = start_background();
+
+	pid = fork();
+	assert(pid >= 0);
+
+	if (!pid) {
+		/* the interactive task: sleep until woken, report delay */
+		for (i = 0; i < loops; i++) {
+			ret = read(pipe_1[0], &tv, sizeof(tv));
+			gettimeofday(&now, NULL);
+			lat = tv_usecs(&now) - tv_usecs(&tv);
+			ret = write(pipe_2[1], &lat, sizeof(lat));
+		}
+		exit(0);
+	}
+
+	for (i = 0; i < loops; i++) {
+		usleep(interval);
+		gettimeofday(&tv, NULL);
+		ret = write(pipe_1[1], &tv, sizeof(tv));
+		ret = read(pipe_2[0], &lat, sizeof(lat));
+		total += lat;
+		if (lat > max)
+			max = lat;
+	}
+
+	retpid = waitpid(pid, &wait_stat, 0);
+	assert((retpid == pid) && WIFEXITED(wait_stat));
+
+	kill(-bg, SIGKILL);
+	waitpid(bg, &wait_stat, 0);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d wakeups against %d CPU burners in %s session\n\n",
+		       loops, nr_hogs, same_session ? "the same" : "another");
+		printf(" %14s: %14.3lf [usec]\n", "Avg latency",
+		       (double)total / (double)loops);
+		printf(" %14s: %14llu [usec]\n", "Max latency", max);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%.3lf %llu\n", (double)total / (double)loops, max);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
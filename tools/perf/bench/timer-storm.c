@@ -0,0 +1,199 @@
+/*
+ *
+ * timer-storm.c
+ *
+ * storm: Benchmark for the timer wheel under many concurrent timeouts
+ *
+ * Each thread sleeps over and over in recv() on an idle socket with a
+ * random SO_RCVTIMEO, which the kernel implements with a timer wheel
+ * timer. The benchmark reports how late the timeouts fire on average,
+ * and, when /proc/timer_wheel is there, how many timer wakeups the
+ * kernel needed to expire all of them.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+static unsigned int nthreads = 64;
+static unsigned int loops = 100;
+static unsigned int max_msecs = 100;
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads,
+		     "Specify number of sleeping threads"),
+	OPT_UINTEGER('l', "loop", &loops,
+		     "Specify number of timeouts per thread"),
+	OPT_UINTEGER('m', "max", &max_msecs,
+		     "Specify longest timeout in msecs"),
+	OPT_END()
+};
+
+static const char * const bench_timer_storm_usage[] = {
+	"perf bench timer storm <options>",
+	NULL
+};
+
+struct worker {
+	pthread_t thread;
+	unsigned int seed;
+	unsigned long long late_usecs;
+};
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static unsigned long long tv_usecs(struct timeval *tv)
+{
+	return tv->tv_sec * 1000000ULL + tv->tv_usec;
+}
+
+static void *worker(void *arg)
+{
+	struct worker *w = arg;
+	struct timeval tv, start, stop;
+	unsigned long long slept, wanted;
+	unsigned int i;
+	int fds[2];
+	char dummy;
+
+	if (socketpair(AF_UNIX, SOCK_DGRAM, 0, fds))
+		barf("socketpair");
+
+	for (i = 0; i < loops; i++) {
+		wanted = (rand_r(&w->seed) % max_msecs + 1) * 1000ULL;
+		tv.tv_sec = wanted / 1000000;
+		tv.tv_usec = wanted % 1000000;
+		if (setsockopt(fds[0], SOL_SOCKET, SO_RCVTIMEO,
+			       &tv, sizeof(tv)))
+			barf("setsockopt");
+
+		gettimeofday(&start, NULL);
+		/* nobody ever sends anything: this always times out */
+		if (recv(fds[0], &dummy, 1, 0) >= 0)
+			barf("recv");
+		gettimeofday(&stop, NULL);
+
+		slept = tv_usecs(&stop) - tv_usecs(&start);
+		if (slept > wanted)
+			w->late_usecs += slept - wanted;
+	}
+
+	close(fds[0]);
+	close(fds[1]);
+	return NULL;
+}
+
+/*
+ * Sum the expired timers and expiry batches of all CPUs from
+ * /proc/timer_wheel. Returns -1 if the kernel does not have it.
+ */
+static int read_wheel_stats(unsigned long long *expired,
+			    unsigned long long *batches)
+{
+	unsigned long long e, b;
+	char line[1024];
+	FILE *f;
+	int cpu;
+
+	f = fopen("/proc/timer_wheel", "r");
+	if (!f)
+		return -1;
+
+	*expired = *batches = 0;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%d %llu %llu", &cpu, &e, &b) != 3)
+			continue;
+		*expired += e;
+		*batches += b;
+	}
+	fclose(f);
+	return 0;
+}
+
+int bench_timer_storm(int argc, const char **argv,
+		      const char *prefix __used)
+{
+	unsigned long long expired[2], batches[2], late = 0;
+	struct timeval start, stop, diff;
+	struct worker *workers;
+	unsigned int i;
+	int have_stats;
+
+	argc = parse_options(argc, argv, options,
+			     bench_timer_storm_usage, 0);
+
+	if (!nthreads || !loops || !max_msecs)
+		usage_with_options(bench_timer_storm_usage, options);
+
+	workers = calloc(nthreads, sizeof(*workers));
+	if (!workers)
+		barf("calloc");
+
+	have_stats = !read_wheel_stats(&expired[0], &batches[0]);
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		workers[i].seed = i + 1;
+		if (pthread_create(&workers[i].thread, NULL, worker,
+				   &workers[i]))
+			barf("pthread_create");
+	}
+
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		late += workers[i].late_usecs;
+	}
+
+	gettimeofday(&stop, NULL);
+	have_stats = have_stats && !read_wheel_stats(&expired[1], &batches[1]);
+	timersub(&stop, &start, &diff);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %u threads x %u timeouts of 1-%u msecs\n\n",
+		       nthreads, loops, max_msecs);
+		printf(" %14s: %lu.%03lu [sec]\n", "Total time",
+		       diff.tv_sec, (unsigned long) (diff.tv_usec / 1000));
+		printf(" %14s: %14.3lf [usec]\n", "Avg lateness",
+		       (double)late / ((double)nthreads * loops));
+		if (have_stats) {
+			printf(" %14s: %14llu\n", "Timers expired",
+			       expired[1] - expired[0]);
+			printf(" %14s: %14llu\n", "Timer wakeups",
+			       batches[1] - batches[0]);
+		}
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu %.3lf\n", diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / 1000),
+		       (double)late / ((double)nthreads * loops));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	free(workers);
+	return 0;
+}
@@ -13,6 +13,8 @@
  * Available subsystem list:
  *  sched ... scheduler and IPC mechanism
  *  mem   ... memory access performance
+ *  futex ... futex hashing and contention
+ *  timer ... kernel timer expiry
  *
  */
 
@@ -42,6 +44,12 @@ static struct bench_suite sched_suites[] = {
 	{ "pipe",
 	  "Flood of communication over pipe() between two processes",
 	  bench_sched_pipe      },
+	{ "wakeup",
+	  "Wakeup latency of a sleeper against a session of CPU burners",
+	  bench_sched_wakeup    },
+	{ "jitter",
+	  "CPU time stolen by RCU callbacks from a pinned busy loop",
+	  bench_sched_jitter    },
 	suite_all,
 	{ NULL,
 	  NULL,
@@ -52,12 +60,47 @@ static struct bench_suite mem_suites[] = {
 	{ "memcpy",
 	  "Simple memory copy in various ways",
 	  bench_mem_memcpy },
+	{ "pagefault",
+	  "Page faults against mmap/munmap of other threads",
+	  bench_mem_pagefault },
+	{ "tlb",
+	  "Random accesses over a large anonymous area",
+	  bench_mem_tlb },
+	{ "lru",
+	  "Application switches under memory pressure",
+	  bench_mem_lru },
+	{ "dirty",
+	  "Light writer next to a heavy one, in memory cgroups",
+	  bench_mem_dirty },
+	{ "compact",
+	  "High-order allocations with fragmented free memory",
+	  bench_mem_compact },
 	suite_all,
 	{ NULL,
 	  NULL,
 	  NULL             }
 };
 
+static struct bench_suite futex_suites[] = {
+	{ "hash",
+	  "Futex hash bucket contention between processes",
+	  bench_futex_hash },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL             }
+};
+
+static struct bench_suite timer_suites[] = {
+	{ "storm",
+	  "Many threads sleeping on short timeouts at once",
+	  bench_timer_storm },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL              }
+};
+
 struct bench_subsys {
 	const char *name;
 	const char *summary;
@@ -71,6 +114,12 @@ static struct bench_subsys subsystems[] = {
 	{ "mem",
 	  "memory access performance",
 	  mem_suites },
+	{ "futex",
+	  "futex hashing and contention",
+	  futex_suites },
+	{ "timer",
+	  "kernel timer expiry",
+	  timer_suites },
 	{ "all",		/* sentinel: easy for help */
 	  "test all subsystem (pseudo subsystem)",
 	  NULL },